@@ -0,0 +1,136 @@
+#pragma once
+
+// ============================================
+// Audio ring (single producer, many consumers)
+// ============================================
+// The capture task is the only reader of the microphone. It fills fixed
+// blocks of PCM straight from the I2S driver into the ring and publishes
+// them with a sequence number and capture timestamp. Every consumer
+// (WebSocket streamer, SD recorder, analyzers) has its own Reader cursor
+// and reads blocks in place, so each one sees the whole sample stream
+// without copies and without locks.
+//
+// The producer never waits for consumers. A reader that falls a full ring
+// behind loses the oldest blocks; that is counted as an overrun on that
+// reader only. Because blocks are read in place, release() re-checks that
+// the producer did not reuse the slot while it was being read (a torn
+// block, also counted).
+//
+// Pure C++ with std::atomic, so it builds on the host too; the simulation
+// runs the same producer/reader arrangement over its WAV microphone.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#include "hal.h"
+
+#define AUDIORING_BLOCK_SAMPLES 256   // 16 ms at 16 kHz
+#define AUDIORING_BLOCKS 64           // Power of two; ~1 s of history at 16 kHz
+#define AUDIORING_MAX_READERS 6
+
+namespace audioring {
+
+struct Block {
+  uint32_t seq;
+  uint16_t samples;        // Valid samples (short only if the driver came up short)
+  int64_t timestampUs;     // Capture time of the first sample
+  int16_t pcm[AUDIORING_BLOCK_SAMPLES];
+};
+
+class Ring;
+
+class Reader {
+ public:
+  explicit Reader(const char* name) : name_(name) {}
+
+  // Oldest unread block, or nullptr when caught up. The block stays valid
+  // until release(); don't hold it for long.
+  const Block* peek();
+
+  // Finish with the block from peek() and advance. Returns false if the
+  // producer overwrote the block while it was in use (data is suspect).
+  bool release();
+
+  // Whether the block from peek() is still intact, without advancing; check
+  // after copying out of it when the block is consumed over several calls
+  bool intact() const;
+
+  // Blocks published but not yet read
+  uint32_t lag() const;
+
+  const char* name() const { return name_; }
+  bool attached() const { return ring_ != nullptr; }
+  uint32_t blocksRead() const { return blocksRead_.load(std::memory_order_relaxed); }
+  uint32_t overruns() const { return overruns_.load(std::memory_order_relaxed); }   // Blocks lost
+  uint32_t torn() const { return torn_.load(std::memory_order_relaxed); }
+
+ private:
+  friend class Ring;
+  const char* name_;
+  Ring* volatile ring_ = nullptr;
+  std::atomic<uint32_t> cursor_{0};   // Sequence number of the next block to read
+  std::atomic<uint32_t> blocksRead_{0};
+  std::atomic<uint32_t> overruns_{0};
+  std::atomic<uint32_t> torn_{0};
+};
+
+class Ring {
+ public:
+  // 'count' must be a power of two; 'blocks' must outlive the ring
+  Ring(Block* blocks, size_t count) : blocks_(blocks), mask_((uint32_t)count - 1) {}
+
+  // Producer: slot for the next block; fill pcm, then commit()
+  Block* beginWrite() { return &blocks_[head_.load(std::memory_order_relaxed) & mask_]; }
+  void commit(uint16_t samples, int64_t timestampUs);
+
+  // Start reading live (from the next block published), or up to
+  // 'backlog' blocks back (at most half the ring) for pre-roll. A reader is
+  // registered for stats the first time it attaches.
+  bool attach(Reader& reader, uint32_t backlog = 0);
+  void detach(Reader& reader);
+
+  // Blocks published since boot
+  uint32_t published() const { return head_.load(std::memory_order_acquire); }
+  size_t capacity() const { return mask_ + 1; }
+
+  // Registered readers (attached or not), for stats
+  size_t readerCount() const { return readerCount_.load(std::memory_order_acquire); }
+  const Reader* reader(size_t i) const { return readers_[i].load(std::memory_order_acquire); }
+
+ private:
+  friend class Reader;
+  Block* blocks_;
+  uint32_t mask_;
+  std::atomic<uint32_t> head_{0};   // Sequence number of the block being written
+  std::atomic<Reader*> readers_[AUDIORING_MAX_READERS] = {};
+  std::atomic<size_t> readerCount_{0};
+};
+
+// The microphone as seen by one consumer (pipeline::Recorder, the host
+// simulation's /audio): a Reader on the ring behind hal::Microphone.
+// start() joins the stream live (or with some pre-roll) and stop() leaves it. read() copies out
+// of the ring blocks, since the recorder's clip buffer has to be
+// contiguous anyway.
+class RingMicrophone : public hal::Microphone {
+ public:
+  typedef bool (*WaitFn)(uint32_t timeoutMs);   // Wait for the next published block
+
+  RingMicrophone(Ring& ring, WaitFn wait, uint32_t sampleRate, const char* name)
+    : ring_(ring), wait_(wait), sampleRate_(sampleRate), reader_(name), offset_(0), offsetSeq_(0) {}
+
+  void start(uint32_t backlogBlocks = 0) { offset_ = 0; ring_.attach(reader_, backlogBlocks); }
+  void stop() { ring_.detach(reader_); }
+  size_t read(int16_t* samples, size_t maxSamples) override;
+  uint32_t sampleRate() const override { return sampleRate_; }
+
+ private:
+  Ring& ring_;
+  WaitFn wait_;
+  uint32_t sampleRate_;
+  Reader reader_;
+  uint16_t offset_;       // Samples already taken from block offsetSeq_
+  uint32_t offsetSeq_;
+};
+
+}  // namespace audioring
@@ -0,0 +1,58 @@
+#pragma once
+
+// ============================================
+// MJPEG AVI container
+// ============================================
+// Byte layout for the timelapse files: a fixed-size RIFF/AVI header, a
+// 'movi' list of '00dc' JPEG chunks and, once the file is finished, an
+// 'idx1' index. The header is the same size whatever it says, so the
+// writer can append a frame and then rewrite the header in place; a file
+// that was never finished is still playable (players rebuild the index).
+//
+// Encode/decode only, no file I/O, so it also builds on the host.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define AVI_HEADER_BYTES 224        // Everything before the first movi chunk
+#define AVI_CHUNK_HEADER_BYTES 8    // FOURCC + u32 size
+#define AVI_INDEX_ENTRY_BYTES 16
+
+namespace avi {
+
+struct Info {
+  uint16_t width;
+  uint16_t height;
+  uint32_t fps;             // Playback rate, not the capture rate
+  uint32_t frames;
+  uint32_t moviBytes;       // Frame chunks including headers and padding
+  uint32_t maxFrameBytes;
+  uint32_t indexBytes;      // idx1 chunk including its header; 0 until finished
+};
+
+// Write the AVI_HEADER_BYTES header describing 'info' to 'out'
+void encodeHeader(uint8_t* out, const Info& info);
+
+// Read back a header written by encodeHeader(); false if it isn't one
+bool parseHeader(const uint8_t* in, size_t len, Info& out);
+
+// Chunk header for a 'jpegBytes' frame. The frame is followed by
+// framePadding() zero bytes to keep chunks word-aligned.
+void encodeFrameHeader(uint8_t* out, uint32_t jpegBytes);
+inline size_t framePadding(uint32_t jpegBytes) { return jpegBytes & 1; }
+
+// Account for a frame appended to the movi list. Returns its idx1 offset
+// (relative to the 'movi' FOURCC).
+uint32_t addFrame(Info& info, uint32_t jpegBytes);
+
+// One idx1 entry for the frame at 'offset' (from addFrame())
+void encodeIndexEntry(uint8_t* out, uint32_t offset, uint32_t jpegBytes);
+// idx1 chunk header for 'entries' entries; sets info.indexBytes
+void encodeIndexHeader(uint8_t* out, Info& info, uint32_t entries);
+
+// Size the file should be for 'info' (to spot a torn append after a reset)
+inline uint32_t fileBytes(const Info& info) {
+  return AVI_HEADER_BYTES + info.moviBytes + info.indexBytes;
+}
+
+}  // namespace avi
@@ -0,0 +1,64 @@
+#pragma once
+
+// ============================================
+// Data-path micro-benchmarks
+// ============================================
+// The same kernels run on the host ([env:bench], src/host/bench_main.cpp)
+// and on the device (BLE "BENCH" command), so numbers can be compared
+// directly. Each kernel is the production function, not a copy:
+// generate_wav_header(), apply_gain(), MjpegStreamer framing, the
+// recorder's timestamped filename, formatStatusJson() and the /metrics
+// renderer.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal.h"
+#include "pipeline.h"
+
+namespace bench {
+
+// Sizes chosen to match production: one second of 16 kHz PCM and a
+// typical SVGA JPEG sent in TCP-segment chunks
+#define BENCH_PCM_BYTES (SAMPLE_RATE * SAMPLE_BITS / 8)
+#define BENCH_FRAME_BYTES 40960
+#define BENCH_CHUNK_BYTES 1436
+
+struct Kernel {
+  const char* name;
+  // Run the kernel 'iterations' times; returns bytes processed per op
+  size_t (*run)(uint32_t iterations);
+};
+
+struct Result {
+  const char* name;
+  uint32_t iterations;
+  uint64_t elapsedNs;
+  uint64_t cycles;       // CPU cycles for all iterations (device only, else 0)
+  uint64_t allocs;       // Heap allocations for all iterations
+  bool allocsCounted;    // False when no allocation counter is installed
+  size_t bytesPerOp;
+
+  double nsPerOp() const { return iterations ? (double)elapsedNs / iterations : 0; }
+  double cyclesPerOp() const { return iterations ? (double)cycles / iterations : 0; }
+  double allocsPerOp() const { return iterations ? (double)allocs / iterations : 0; }
+  double bytesPerSecond() const { return elapsedNs ? bytesPerOp * (double)iterations * 1e9 / elapsedNs : 0; }
+};
+
+// Returns the running total of heap allocations (host: malloc interposer)
+typedef uint64_t (*AllocCountFn)();
+void setAllocCounter(AllocCountFn fn);
+
+// Allocate kernel inputs. 'clock' supplies timing and the wall-clock
+// timestamp used by the filename kernel. Returns false if out of memory.
+bool begin(hal::Clock& clock);
+void end();
+
+size_t kernelCount();
+const Kernel& kernel(size_t index);
+
+// Double the iteration count until one run takes at least 'minTimeUs',
+// then report that run
+Result run(size_t index, uint32_t minTimeUs);
+
+}  // namespace bench
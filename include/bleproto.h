@@ -0,0 +1,160 @@
+#pragma once
+
+// ============================================
+// Binary BLE protocol (v1)
+// ============================================
+// Framing for the binary control/status characteristic; see
+// BLE_PROTOCOL.md for the wire format. Every frame starts with
+// BLEPROTO_MAGIC and the protocol version. Requests carry a batch of
+// commands, each with a client-chosen request id that comes back in the
+// ack. Status is a TLV record: a full record on subscribe, read or
+// OP_GET_STATUS, and after that only the tags that changed.
+//
+// Pure encode/decode with no BLE or Arduino dependency, so it also
+// builds on the host.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLEPROTO_MAGIC 0xB1
+#define BLEPROTO_VERSION 1
+#define BLEPROTO_MAX_BATCH 16           // Commands per request frame
+#define BLEPROTO_DEFAULT_MTU 23
+#define BLEPROTO_PREFERRED_MTU 247      // One LE data packet with DLE (251 - L2CAP header)
+#define BLEPROTO_MAX_FRAME (BLEPROTO_PREFERRED_MTU - 3)
+
+namespace bleproto {
+
+enum FrameType : uint8_t {
+  FRAME_REQUEST = 0x01,
+  FRAME_ACK = 0x02,
+  FRAME_STATUS = 0x03
+};
+
+enum Opcode : uint8_t {
+  OP_PING = 0x00,          // Ack only; for round-trip measurement
+  OP_START = 0x01,
+  OP_STOP = 0x02,
+  OP_GET_STATUS = 0x03,    // Full status record after the ack
+  OP_SET_MODE = 0x04,      // u8 Mode [, u16 interval s with MODE_TIMELAPSE]
+  OP_LIST = 0x05,          // u8 0 = video, 1 = audio, 2 = all (printed on the serial console)
+  OP_USB = 0x06,           // u8 0 = disable, 1 = enable
+  OP_WIFI = 0x07,          // Switch to Wi-Fi streaming mode
+  OP_BENCH = 0x08,
+  OP_DUTY_CYCLE = 0x09     // Deep-sleep duty cycle: u32 interval s, u8 frames per wake (empty = defaults)
+};
+
+enum Result : uint8_t {
+  RESULT_OK = 0x00,
+  RESULT_ACCEPTED = 0x01,      // Queued for loop(); completion shows up in status
+  RESULT_NO_CHANGE = 0x02,     // Already in the requested state
+  RESULT_UNKNOWN_OP = 0x80,
+  RESULT_BAD_LENGTH = 0x81,
+  RESULT_BAD_VALUE = 0x82,
+  RESULT_BUSY = 0x83,
+  RESULT_FAILED = 0x84,
+  RESULT_MALFORMED = 0x85,     // Whole frame rejected (request id 0)
+  RESULT_BAD_VERSION = 0x86
+};
+
+enum Mode : uint8_t {
+  MODE_BOTH = 0,
+  MODE_AUDIO_ONLY = 1,
+  MODE_VIDEO_ONLY = 2,
+  MODE_TIMELAPSE = 3
+};
+
+// Status TLV tags. Values are little-endian.
+enum Tag : uint8_t {
+  TAG_RECORDING = 1,     // u8 0/1
+  TAG_MODE = 2,          // u8 Mode
+  TAG_STATE = 3,         // u8 firmware SystemState
+  TAG_USB = 4,           // u8 0/1
+  TAG_WIFI = 5,          // u8 0/1 (requested or connected)
+  TAG_FRAMES = 6,        // u32 frames saved
+  TAG_AUDIO_FILES = 7,   // u32 WAV clips saved
+  TAG_BATTERY_MV = 8,    // u16
+  TAG_SD_FREE_MB = 9,    // u32
+  TAG_UPTIME_S = 10,     // u32 (full records only)
+  TAG_MTU = 11,          // u16 negotiated ATT MTU
+  TAG_MAX = 11
+};
+
+#define BLEPROTO_TAG_BIT(tag) (1UL << (tag))
+#define BLEPROTO_ALL_TAGS (((1UL << (bleproto::TAG_MAX + 1)) - 1) & ~1UL)
+// Tags that change on user action and are worth an immediate notification
+#define BLEPROTO_STATE_TAGS (BLEPROTO_TAG_BIT(bleproto::TAG_RECORDING) | BLEPROTO_TAG_BIT(bleproto::TAG_MODE) | \
+                             BLEPROTO_TAG_BIT(bleproto::TAG_STATE) | BLEPROTO_TAG_BIT(bleproto::TAG_USB) |     \
+                             BLEPROTO_TAG_BIT(bleproto::TAG_WIFI) | BLEPROTO_TAG_BIT(bleproto::TAG_MTU))
+
+// Status flags byte
+#define BLEPROTO_STATUS_FULL 0x01   // Record contains every tag
+#define BLEPROTO_STATUS_MORE 0x02   // Continued in the next frame (same seq)
+
+struct Command {
+  uint16_t requestId;
+  uint8_t opcode;
+  uint8_t length;
+  const uint8_t* payload;   // Points into the request buffer
+};
+
+struct Ack {
+  uint16_t requestId;
+  uint8_t opcode;
+  uint8_t result;
+};
+
+struct StatusRecord {
+  uint8_t recording;
+  uint8_t mode;
+  uint8_t state;
+  uint8_t usb;
+  uint8_t wifi;
+  uint32_t frames;
+  uint32_t audioFiles;
+  uint16_t batteryMv;
+  uint32_t sdFreeMB;
+  uint32_t uptimeSec;
+  uint16_t mtu;
+};
+
+// True if 'data' starts like a binary frame (ASCII commands never do)
+bool isFrame(const uint8_t* data, size_t len);
+
+// Split a request frame into commands. 'count' is set to the number of
+// commands parsed; on error nothing is executed and the caller acks the
+// frame with the returned result and request id 0.
+Result parseRequest(const uint8_t* data, size_t len, Command* out, size_t max, size_t& count);
+
+// Encode acks[0..count) into one frame of at most 'cap' bytes. Returns the
+// frame length and sets 'consumed' to how many acks fit; call again with
+// the rest when consumed < count.
+size_t encodeAcks(uint8_t* out, size_t cap, const Ack* acks, size_t count, size_t& consumed);
+
+// Bitmask (BLEPROTO_TAG_BIT) of tags whose values differ. Uptime is never
+// reported as a change.
+uint32_t changedTags(const StatusRecord& previous, const StatusRecord& current);
+
+// Copy the fields selected by 'tags' from 'src' to 'dst' (tracks what a
+// client has been sent when only some tags went out)
+void applyTags(StatusRecord& dst, const StatusRecord& src, uint32_t tags);
+
+// Encode the tags in 'tags' (ascending) that fit in 'cap' bytes and clear
+// them from 'tags'. BLEPROTO_STATUS_MORE is set when some are left over.
+size_t encodeStatus(uint8_t* out, size_t cap, const StatusRecord& record, uint32_t& tags,
+                    uint8_t seq, bool full);
+
+// Request builder for C++ clients (e.g. a gateway ESP32 driving several cameras)
+class RequestWriter {
+ public:
+  RequestWriter(uint8_t* buf, size_t cap);
+  bool add(uint16_t requestId, uint8_t opcode, const uint8_t* payload = nullptr, uint8_t length = 0);
+  size_t length() const { return len_; }
+
+ private:
+  uint8_t* buf_;
+  size_t cap_;
+  size_t len_;
+};
+
+}  // namespace bleproto
@@ -0,0 +1,132 @@
+#pragma once
+
+// ============================================
+// BLE bulk file transfer
+// ============================================
+// Pulls files off the SD card over BLE (see BLE_PROTOCOL.md). The device
+// streams chunks of the file as notifications on the data characteristic,
+// each tagged with its file offset. The client acknowledges the contiguous
+// prefix it holds, names missing chunks for selective retransmit, and
+// resumes an interrupted transfer by opening at a non-zero offset.
+//
+// Window schedules which chunk goes next; ReadAhead is the ring the SD
+// reader task fills ahead of the sender. Neither does any I/O, so both
+// build on the host.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#define BLEXFER_DATA_HEADER 4            // u32 file offset before each chunk
+#define BLEXFER_MAX_NACKS 16             // Offsets per NACK frame / queued retransmits
+
+namespace blexfer {
+
+// Control characteristic frames: [BLEPROTO_MAGIC][BLEPROTO_VERSION][op]...
+enum Op : uint8_t {
+  XOP_OPEN = 0x10,     // u32 offset, u8 window (chunks), path bytes (no NUL)
+  XOP_ACK = 0x11,      // u32 offset: everything below it has arrived
+  XOP_NACK = 0x12,     // u32 offset x n: chunks to send again
+  XOP_CANCEL = 0x13,
+  XEV_OPENED = 0x20,   // u32 size, u32 offset, u16 chunk bytes, u8 window
+  XEV_DONE = 0x21,     // u32 bytes sent, u32 ms, u32 bytes/s, u32 retransmits, u32 stalls
+  XEV_ERROR = 0x22     // u8 Error
+};
+
+enum Error : uint8_t {
+  XERR_NONE = 0,
+  XERR_MALFORMED = 1,
+  XERR_NOT_FOUND = 2,
+  XERR_DENIED = 3,       // Path outside /video, /audio
+  XERR_BUSY = 4,         // Another transfer running, or USB MSC active
+  XERR_BAD_OFFSET = 5,   // Resume offset past the end of the file
+  XERR_IO = 6,
+  XERR_TIMEOUT = 7,      // Client stopped acking
+  XERR_CANCELLED = 8
+};
+
+struct Request {
+  uint8_t op;
+  uint32_t offset;           // OPEN, ACK
+  uint8_t window;            // OPEN
+  const char* path;          // OPEN; not NUL-terminated
+  size_t pathLength;
+  const uint8_t* nacks;      // NACK: nackCount little-endian u32 offsets
+  size_t nackCount;
+};
+
+// Decode a control write. Returns false for anything malformed.
+bool parseRequest(const uint8_t* data, size_t len, Request& out);
+uint32_t nackOffset(const Request& r, size_t i);
+
+size_t encodeOpened(uint8_t* out, uint32_t size, uint32_t offset, uint16_t chunk, uint8_t window);
+size_t encodeDone(uint8_t* out, uint32_t bytes, uint32_t ms, uint32_t retransmits, uint32_t stalls);
+size_t encodeError(uint8_t* out, Error error);
+
+// True for paths a client may open: absolute, under /video or /audio (or
+// those directories themselves), no ".." components
+bool pathAllowed(const char* path);
+
+// Chunk scheduler. Chunks start at the open offset and are 'chunk' bytes
+// apart; at most 'window' chunks are in flight past the acked offset.
+// Queued retransmits go before new data.
+class Window {
+ public:
+  void begin(uint32_t size, uint32_t start, uint16_t chunk, uint8_t window);
+
+  // Next chunk to send; false when the window is full or everything is sent
+  bool next(uint32_t& offset, uint16_t& length);
+  void ack(uint32_t offset);
+  bool nack(uint32_t offset);
+  // No ack for a while: resend the oldest unacked chunk (lost ack or tail)
+  void timeout();
+
+  bool done() const { return acked_ >= size_; }
+  uint32_t acked() const { return acked_; }
+  uint32_t start() const { return start_; }
+  uint32_t retransmits() const { return retransmits_; }
+
+ private:
+  uint32_t size_ = 0;
+  uint32_t start_ = 0;
+  uint32_t acked_ = 0;
+  uint32_t next_ = 0;
+  uint32_t windowBytes_ = 0;
+  uint16_t chunk_ = 0;
+  uint32_t retransmitQueue_[BLEXFER_MAX_NACKS];
+  uint8_t queued_ = 0;
+  uint32_t retransmits_ = 0;
+};
+
+// Single-producer (SD reader) / single-consumer (sender) byte ring that
+// holds file data from the acked offset up to what has been read ahead.
+// Capacity must be a power of two.
+class ReadAhead {
+ public:
+  // Start empty at file offset 'offset' on a 'capacity'-byte buffer
+  void reset(uint8_t* buf, size_t capacity, uint32_t offset);
+
+  // Producer: contiguous free space at the tail. Returns its length and
+  // the file offset it starts at; 0 when the ring is full.
+  size_t writable(uint32_t& offset, uint8_t*& ptr) const;
+  void commit(size_t n);
+
+  // Consumer: copy [offset, offset + len) if it has been read and not
+  // released yet
+  bool copy(uint32_t offset, uint8_t* out, size_t len) const;
+  // Drop everything below 'offset' (the acked offset)
+  void release(uint32_t offset);
+
+  uint32_t head() const { return head_.load(std::memory_order_acquire); }
+  uint32_t tail() const { return tail_.load(std::memory_order_acquire); }
+  size_t capacity() const { return capacity_; }
+
+ private:
+  uint8_t* buf_ = nullptr;
+  size_t capacity_ = 0;
+  std::atomic<uint32_t> head_{0};   // Oldest file offset held (consumer)
+  std::atomic<uint32_t> tail_{0};   // File offset read up to (producer)
+};
+
+}  // namespace blexfer
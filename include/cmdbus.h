@@ -0,0 +1,86 @@
+#pragma once
+
+// ============================================
+// Command bus
+// ============================================
+// Typed commands posted from BLE callbacks and HTTP handlers onto FreeRTOS
+// queues, one per consumer. Consumers are long-lived tasks that block on
+// their queue, so a command runs as soon as its consumer is free instead of
+// waiting for a poll, and commands for one consumer run strictly in order.
+//
+// Every command is stamped when posted, when its consumer picks it up and
+// when it completes. Completions feed the command latency histogram and a
+// small ring of recent commands for /api/commands.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "bleproto.h"
+
+#define CMDBUS_RECENT 16    // Completions kept for /api/commands
+#define CMDBUS_FOREVER UINT32_MAX
+
+namespace cmdbus {
+
+enum Type : uint8_t {
+  CMD_START,          // Recorder: start a session in the current mode
+  CMD_STOP,           // Recorder: completes once the session has ended
+  CMD_LIST,           // arg: 0 video, 1 audio, 2 all
+  CMD_WIFI,           // Leave BLE mode for Wi-Fi streaming
+  CMD_BENCH,
+  CMD_DUTY_CYCLE,     // arg: interval s, arg2: frames per wake
+  CMD_POWER_TARGET,   // arg: runtime target in minutes
+  CMD_USB,            // arg: 0 disable, 1 enable USB mass storage
+  CMD_TYPE_COUNT
+};
+
+struct Command {
+  Type type;
+  uint16_t seq;
+  uint32_t arg;
+  uint32_t arg2;
+  int64_t postedUs;
+  int64_t startedUs;   // Set by receive()
+};
+
+struct Completion {
+  Type type;
+  uint16_t seq;
+  bleproto::Result result;
+  uint32_t queuedUs;      // Post to pick-up
+  uint32_t totalUs;       // Post to completion
+  uint32_t completedMs;   // millis() at completion
+};
+
+class Bus {
+ public:
+  bool begin(size_t depth);
+
+  // Never blocks; false (and counted as dropped) when the queue is full
+  bool post(Type type, uint32_t arg = 0, uint32_t arg2 = 0);
+
+  // Wait up to timeoutMs (or CMDBUS_FOREVER) for the next command; 0 polls
+  bool receive(Command& cmd, uint32_t timeoutMs);
+
+  // Wait up to timeoutMs for a command to be queued, leaving it queued.
+  // Lets a consumer sleep inside a long job and still end it promptly.
+  bool wait(uint32_t timeoutMs);
+
+  // Commands waiting behind the one being run
+  size_t pending() const;
+
+ private:
+  QueueHandle_t queue_ = nullptr;
+};
+
+// Stamp a command finished with 'result'
+void complete(Command& cmd, bleproto::Result result);
+
+const char* typeName(Type type);
+
+// Copy up to 'max' recent completions, newest first
+size_t recent(Completion* out, size_t max);
+
+}  // namespace cmdbus
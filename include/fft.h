@@ -0,0 +1,35 @@
+#pragma once
+
+// ============================================
+// Radix-2 FFT shared by the audio analyzers
+// ============================================
+// Complex data is interleaved (re, im, re, im, ...). On the ESP32-S3 the
+// transform and the window multiply go through esp-dsp, whose fc32/f32
+// kernels use the S3's vector instructions; elsewhere (and on the host) a
+// portable implementation with the same results is used.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FFT_MAX_SIZE 1024
+
+namespace fft {
+
+// Build the twiddle tables. Call once before the first transform (from
+// setup(), before the analyzer tasks start); later calls do nothing.
+bool begin();
+
+// True when the esp-dsp (vector unit) kernels are in use
+bool accelerated();
+
+// data[2k] = x[k] * w[k], data[2k+1] = 0 for k < n
+void windowReal(const float* x, const float* w, float* data, size_t n);
+
+// In-place forward transform of n complex points (n a power of two up to
+// FFT_MAX_SIZE), output in natural order
+void forward(float* data, size_t n);
+
+// Periodic Hann window of n points; returns sum(w^2) for level scaling
+float hann(float* w, size_t n);
+
+}  // namespace fft
@@ -0,0 +1,82 @@
+#pragma once
+
+// ============================================
+// Fixed-capacity strings and JSON writer
+// ============================================
+// Replacements for Arduino String on paths that run every frame, poll or
+// BLE notification. Storage is a member array (stack or static), appends
+// past the capacity are cut off and flagged with truncated() instead of
+// reallocating, and integers are formatted without printf.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Appends into a caller-owned buffer; FixedString<N> supplies the storage
+class StringWriter {
+ public:
+  StringWriter(char* buf, size_t cap) : buf_(buf), cap_(cap), len_(0), truncated_(false) { buf_[0] = '\0'; }
+
+  StringWriter& append(const char* s);
+  StringWriter& append(const char* s, size_t n);
+  StringWriter& append(char c);
+  StringWriter& appendInt(int64_t v);
+  StringWriter& appendUint(uint64_t v);
+  StringWriter& appendf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+  void clear() { len_ = 0; truncated_ = false; buf_[0] = '\0'; }
+
+  const char* c_str() const { return buf_; }
+  size_t length() const { return len_; }
+  size_t capacity() const { return cap_ - 1; }
+  bool truncated() const { return truncated_; }
+
+ private:
+  char* buf_;
+  size_t cap_;
+  size_t len_;
+  bool truncated_;
+};
+
+template <size_t N>
+class FixedString : public StringWriter {
+ public:
+  FixedString() : StringWriter(storage_, N) {}
+  FixedString(const FixedString&) = delete;
+  FixedString& operator=(const FixedString&) = delete;
+
+ private:
+  char storage_[N];
+};
+
+// Streams one JSON document into a StringWriter. Keys are written as given;
+// string values are escaped. Pass a null key for array elements.
+#define JSON_MAX_DEPTH 8
+
+class JsonWriter {
+ public:
+  explicit JsonWriter(StringWriter& out) : out_(out), depth_(0) { first_[0] = true; }
+
+  JsonWriter& beginObject(const char* key = nullptr);
+  JsonWriter& endObject();
+  JsonWriter& beginArray(const char* key = nullptr);
+  JsonWriter& endArray();
+
+  JsonWriter& str(const char* key, const char* value);
+  JsonWriter& num(const char* key, int64_t value);
+  JsonWriter& boolean(const char* key, bool value);
+  // Fixed point: fixed(key, 1234, 2) writes 12.34, tenths(key, 125) writes 12.5
+  JsonWriter& fixed(const char* key, int64_t value, uint8_t decimals);
+  JsonWriter& tenths(const char* key, int64_t value) { return fixed(key, value, 1); }
+  JsonWriter& null(const char* key);
+  // A value that is already JSON (e.g. from another formatter), written as is
+  JsonWriter& raw(const char* key, const char* json, size_t len);
+
+ private:
+  void prefix(const char* key);
+  void quoted(const char* s);
+
+  StringWriter& out_;
+  uint8_t depth_;
+  bool first_[JSON_MAX_DEPTH + 1];
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+// ============================================
+// Frame hub (one capture, many consumers)
+// ============================================
+// The recorder, /stream, RTSP, /live and the timelapse all want camera
+// frames. Grabbing from the driver separately makes them take frames from
+// each other: with two viewers each one (and the recorder) gets a third of
+// the sensor rate. The hub sits in front of the camera and shares each
+// capture with every consumer that is waiting for one.
+//
+// grab() returns the next frame captured after the call. The first caller
+// to find no capture in flight grabs from the camera; everyone who arrives
+// while that grab runs waits for it and gets the same frame. Each frame is
+// refcounted and goes back to the camera when the last consumer releases
+// it, so a consumer may hold a frame as long as it held a driver frame
+// before (while it saves or sends it), and a slow consumer just skips
+// frames instead of slowing the others.
+//
+// The hub is itself a hal::Camera, so the pipelines take it unchanged.
+// begin() creates the lock; call it before the first grab().
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal.h"
+
+#define FRAMEHUB_SLOTS 4   // Frames out at once; >= the camera's frame buffers
+
+namespace framehub {
+
+class Hub : public hal::Camera {
+ public:
+  explicit Hub(hal::Camera& camera);
+
+  bool begin();
+
+  // Block until the next capture; false if that capture failed
+  bool grab(hal::Frame& out) override;
+  void release(hal::Frame& frame) override;
+
+  // Grabs from the camera, and frames handed to consumers (each grab may
+  // serve several)
+  uint32_t captures() const { return captures_; }
+  uint32_t deliveries() const { return deliveries_; }
+
+ private:
+  struct Slot {
+    hal::Frame frame;   // As the camera returned it
+    uint32_t seq;       // Capture it came from
+    uint32_t refs;      // Consumers still holding it; 0 = free
+  };
+
+  void publish(hal::Frame* frame);
+
+  hal::Camera& camera_;
+  void* lock_;
+  void* signal_;
+  bool grabbing_;        // A consumer is inside camera_.grab()
+  uint32_t published_;   // Captures finished (sequence of the latest)
+  uint32_t waiting_;     // Consumers waiting for capture published_ + 1
+  uint32_t captures_;
+  uint32_t deliveries_;
+  Slot slots_[FRAMEHUB_SLOTS];
+};
+
+}  // namespace framehub
@@ -0,0 +1,116 @@
+#pragma once
+
+// ============================================
+// Battery power governor
+// ============================================
+// Picks an operating point (CPU ceiling, camera XCLK, frame size, frame
+// rate cap, Wi-Fi power save) from the battery voltage trend and a runtime
+// target. Voltage is smoothed, mapped to state of charge through a LiPo
+// open-circuit curve, and the drain rate over the trend window, averaged
+// per amp of each point's typical draw, gives a projected runtime. The governor steps to a cheaper point when that
+// projection falls short of the time left on the target, and back up when
+// there is a comfortable margin. State-of-charge floors apply regardless
+// of the target, and a rising voltage (charging) restores full power.
+//
+// Pure decision logic with no hardware access, so it builds on the host;
+// [env:governor] replays discharge-curve fixtures through it.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GOVERNOR_TREND_SLOTS 16
+
+namespace governor {
+
+// Frame sizes the table uses (mapped to framesize_t by the firmware)
+enum FrameSize : uint8_t {
+  FRAME_QQVGA,   // 160x120
+  FRAME_HQVGA,   // 240x176
+  FRAME_QVGA     // 320x240
+};
+
+// Wi-Fi power save (mapped to wifi_ps_type_t)
+enum WifiPowerSave : uint8_t {
+  WIFI_PS_OFF,
+  WIFI_PS_MIN,   // Wake every DTIM
+  WIFI_PS_MAX    // Wake every listen interval
+};
+
+struct OperatingPoint {
+  const char* name;
+  uint16_t cpuMhz;
+  uint8_t xclkMhz;
+  FrameSize frameSize;
+  uint8_t maxFps;          // Recording frame rate cap; 0 = as fast as the camera goes
+  WifiPowerSave wifiPs;
+  uint16_t typicalMa;      // Approximate board draw while recording; relative cost of each point
+};
+
+// Index 0 is full power; higher indexes save more
+extern const OperatingPoint kOperatingPoints[];
+extern const size_t kOperatingPointCount;
+
+struct Config {
+  uint32_t targetMinutes;     // Runtime to last from begin(); 0 = SoC floors only
+  uint32_t trendWindowMs;     // Drain is measured over this span
+  uint32_t minDwellMs;        // Least time after a change before stepping back up
+  uint16_t marginPct;         // Step up only when projected > time left * (100 + margin) / 100
+};
+
+// Default configuration: 15-minute trend window and dwell, 30 % margin
+Config defaultConfig(uint32_t targetMinutes);
+
+// State of charge (0-1000, tenths of a percent) for a resting LiPo voltage
+uint16_t socFromMillivolts(uint16_t mv);
+
+class Governor {
+ public:
+  void begin(const Config& config, uint32_t nowMs);
+
+  // Feed a battery reading; returns the operating point index to use.
+  // Call every few seconds; trend samples are kept once per window / slots.
+  uint8_t update(uint32_t nowMs, uint16_t millivolts);
+
+  uint8_t level() const { return level_; }
+  const OperatingPoint& point() const { return kOperatingPoints[level_]; }
+  uint16_t filteredMillivolts() const { return (uint16_t)(filteredMv16_ >> 4); }
+  uint16_t socPermille() const { return socFromMillivolts(filteredMillivolts()); }
+  // Drain in tenths of a percent per hour over the last full trend window
+  // (negative while charging)
+  int32_t drainPermillePerHour() const { return drainPerHour_; }
+  bool charging() const;
+  // Minutes left at the current operating point; UINT32_MAX when unknown or
+  // charging
+  uint32_t projectedMinutes() const;
+  uint32_t transitions() const { return transitions_; }
+
+ private:
+  uint8_t floorLevel(uint16_t soc) const;
+  void resetTrend(uint32_t nowMs);
+  void fitTrend();
+  uint32_t projectedMinutesAt(uint8_t level) const;
+  bool trendValid() const { return trendCount_ == GOVERNOR_TREND_SLOTS; }
+
+  Config config_;
+  uint32_t startMs_ = 0;
+  uint32_t lastChangeMs_ = 0;
+  uint32_t filteredMv16_ = 0;         // EWMA in 1/16 mV
+  bool primed_ = false;
+  uint8_t level_ = 0;
+  uint32_t transitions_ = 0;
+  int32_t drainPerHour_ = 0;
+  int32_t riseMv_ = 0;                // Filtered voltage change across the window
+  int32_t drainPerAmp_ = 0;           // Smoothed permille/h per amp of typicalMa; 0 = not yet known
+
+  struct Sample {
+    uint32_t ms;
+    uint16_t soc;
+    uint16_t mv;
+  };
+  Sample trend_[GOVERNOR_TREND_SLOTS];
+  uint8_t trendHead_ = 0;
+  uint8_t trendCount_ = 0;
+  uint32_t trendResetMs_ = 0;
+};
+
+}  // namespace governor
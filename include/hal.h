@@ -0,0 +1,72 @@
+#pragma once
+
+// ============================================
+// Hardware abstraction layer
+// ============================================
+// The recording and streaming pipelines talk to the camera, microphone,
+// SD card and clock only through these interfaces. hal_esp32.h implements
+// them on the XIAO ESP32S3; hal_host.h implements them on Linux for the
+// [env:native] simulation (synthetic JPEG camera, WAV-file microphone,
+// directory-backed SD card with a latency model).
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace hal {
+
+// One captured JPEG. 'handle' belongs to the camera implementation and is
+// passed back in Camera::release().
+struct Frame {
+  const uint8_t* buf;
+  size_t len;
+  uint16_t width;
+  uint16_t height;
+  int64_t timestampUs;
+  void* handle;
+};
+
+class Camera {
+ public:
+  virtual ~Camera() {}
+  // Block until a frame is available; false on capture failure
+  virtual bool grab(Frame& out) = 0;
+  virtual void release(Frame& frame) = 0;
+};
+
+class Microphone {
+ public:
+  virtual ~Microphone() {}
+  // Read up to 'maxSamples' 16-bit mono samples; returns the number read
+  virtual size_t read(int16_t* samples, size_t maxSamples) = 0;
+  virtual uint32_t sampleRate() const = 0;
+};
+
+// Sequential file writer. One file is open at a time; implementations that
+// share the card with other tasks lock it in beginWrite() and unlock it in
+// endWrite().
+class Storage {
+ public:
+  virtual ~Storage() {}
+  virtual bool beginWrite(const char* path, uint32_t lockTimeoutMs) = 0;
+  virtual size_t append(const uint8_t* data, size_t len) = 0;
+  virtual void endWrite() = 0;
+  // Set when beginWrite() failed because the lock timed out (vs. open failure)
+  virtual bool lastBeginTimedOut() const = 0;
+  virtual bool remove(const char* path) = 0;
+  virtual bool exists(const char* path) = 0;
+  virtual bool mkdir(const char* path) = 0;
+  virtual uint64_t totalBytes() = 0;
+  virtual uint64_t usedBytes() = 0;
+};
+
+class Clock {
+ public:
+  virtual ~Clock() {}
+  virtual uint32_t millis() = 0;
+  virtual int64_t micros() = 0;
+  virtual void delayMs(uint32_t ms) = 0;
+  // Wall-clock "YYYYMMDD_HHMMSS"; false if wall time is not known yet
+  virtual bool timestamp(char* out, size_t cap) = 0;
+};
+
+}  // namespace hal
@@ -0,0 +1,61 @@
+#pragma once
+
+// ============================================
+// HAL implementations for the XIAO ESP32S3 Sense
+// ============================================
+
+#include <Arduino.h>
+#include <FS.h>
+#include <SD.h>
+
+#include "hal.h"
+
+#define SD_MOUNT_POINT "/sd"   // SD.begin() default
+
+namespace hal {
+
+// esp_camera_fb_get() / esp_camera_fb_return()
+class Esp32Camera : public Camera {
+ public:
+  bool grab(Frame& out) override;
+  void release(Frame& frame) override;
+};
+
+// SD card in SPI mode. Shares the card with the web file API, so writes
+// go through the same sdMutex lock/unlock functions as every other user.
+// Writes use the VFS file descriptor directly rather than an Arduino File:
+// no FileImpl, FILE or stdio buffer is allocated per frame.
+class SdStorage : public Storage {
+ public:
+  typedef bool (*LockFn)(uint32_t timeoutMs);
+  typedef void (*UnlockFn)();
+
+  SdStorage(LockFn lock, UnlockFn unlock) : lock_(lock), unlock_(unlock), fd_(-1), timedOut_(false) {}
+
+  bool beginWrite(const char* path, uint32_t lockTimeoutMs) override;
+  size_t append(const uint8_t* data, size_t len) override;
+  void endWrite() override;
+  bool lastBeginTimedOut() const override { return timedOut_; }
+  bool remove(const char* path) override { return SD.remove(path); }
+  bool exists(const char* path) override { return SD.exists(path); }
+  bool mkdir(const char* path) override { return SD.mkdir(path); }
+  uint64_t totalBytes() override { return SD.totalBytes(); }
+  uint64_t usedBytes() override { return SD.usedBytes(); }
+
+ private:
+  LockFn lock_;
+  UnlockFn unlock_;
+  int fd_;
+  bool timedOut_;
+};
+
+// millis()/micros() and NTP-synced local time
+class ArduinoClock : public Clock {
+ public:
+  uint32_t millis() override { return ::millis(); }
+  int64_t micros() override { return esp_timer_get_time(); }
+  void delayMs(uint32_t ms) override { vTaskDelay(pdMS_TO_TICKS(ms) ? pdMS_TO_TICKS(ms) : 1); }
+  bool timestamp(char* out, size_t cap) override;
+};
+
+}  // namespace hal
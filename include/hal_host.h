@@ -0,0 +1,134 @@
+#pragma once
+
+// ============================================
+// HAL implementations for the Linux host simulation ([env:native])
+// ============================================
+
+#include <stdint.h>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "hal.h"
+
+namespace hal {
+
+// Real time from std::chrono; wall-clock timestamps can be disabled to
+// exercise the pre-NTP filename path
+class HostClock : public Clock {
+ public:
+  explicit HostClock(bool wallTimeKnown = true);
+  uint32_t millis() override;
+  int64_t micros() override;
+  void delayMs(uint32_t ms) override;
+  bool timestamp(char* out, size_t cap) override;
+
+  void sleepUs(int64_t us);
+
+ private:
+  int64_t startUs_;
+  bool wallTimeKnown_;
+};
+
+// Decodable grey JPEGs of a fixed size, delivered at a fixed rate with
+// CAMERA_GRAB_LATEST semantics: a late caller gets a frame immediately and
+// the missed slots count as drops. Two frame buffers, like fb_count = 2.
+class SyntheticCamera : public Camera {
+ public:
+  SyntheticCamera(HostClock& clock, float fps, size_t frameBytes, uint16_t width = 800, uint16_t height = 600);
+
+  bool grab(Frame& out) override;
+  void release(Frame& frame) override;
+
+  // Fraction of grabs that fail, like esp_camera_fb_get() returning NULL
+  void setFailureRate(double rate) { failureRate_ = rate; }
+  uint32_t framesDropped() const { return dropped_; }
+
+ private:
+  static const int kBuffers = 2;
+
+  HostClock& clock_;
+  int64_t periodUs_;
+  int64_t nextDueUs_;
+  uint16_t width_;
+  uint16_t height_;
+  std::vector<uint8_t> buffers_[kBuffers];
+  bool inUse_[kBuffers];
+  uint32_t sequence_;
+  uint32_t dropped_;
+  double failureRate_;
+  std::mt19937 rng_;
+  std::mutex mutex_;
+};
+
+// Load a 16-bit PCM WAV (first channel only). Returns false on anything else.
+bool loadWav(const char* path, std::vector<int16_t>& pcm, uint32_t& rate);
+
+// 16-bit mono PCM from a WAV file (looped), or a 440 Hz tone when no file
+// is given. Paced in real time at the file's sample rate. Concurrent readers
+// split the stream between them, like I2S; the simulation has a single
+// capture thread feeding the audio ring, as on the device.
+class WavMicrophone : public Microphone {
+ public:
+  WavMicrophone(HostClock& clock, const char* wavPath, uint32_t defaultRate = 16000);
+
+  size_t read(int16_t* samples, size_t maxSamples) override;
+  uint32_t sampleRate() const override { return sampleRate_; }
+  bool loadedFile() const { return loadedFile_; }
+
+ private:
+  HostClock& clock_;
+  std::vector<int16_t> pcm_;
+  uint32_t sampleRate_;
+  size_t position_;
+  int64_t startUs_;
+  uint64_t delivered_;
+  bool loadedFile_;
+  std::mutex mutex_;
+};
+
+// Per-operation SD latency: fixed open cost, throughput cost and rare spikes
+// (FAT allocation, card wear levelling)
+struct LatencyModel {
+  uint32_t openUs;
+  uint32_t perKBUs;
+  double spikeProbability;
+  uint32_t spikeUs;
+};
+
+// SD card backed by a host directory. Writers serialise on a timed mutex,
+// standing in for sdMutex.
+class DirStorage : public Storage {
+ public:
+  DirStorage(const std::string& root, HostClock& clock, const LatencyModel& latency);
+  ~DirStorage();
+
+  bool beginWrite(const char* path, uint32_t lockTimeoutMs) override;
+  size_t append(const uint8_t* data, size_t len) override;
+  void endWrite() override;
+  bool lastBeginTimedOut() const override { return timedOut_; }
+  bool remove(const char* path) override;
+  bool exists(const char* path) override;
+  bool mkdir(const char* path) override;
+  uint64_t totalBytes() override;
+  uint64_t usedBytes() override;
+
+  // Lock shared with other simulated card users (file API handlers)
+  bool lock(uint32_t timeoutMs);
+  void unlock();
+  std::string hostPath(const char* path) const;
+
+ private:
+  void injectLatency(uint32_t us);
+
+  std::string root_;
+  HostClock& clock_;
+  LatencyModel latency_;
+  std::timed_mutex cardMutex_;
+  FILE* file_;
+  bool timedOut_;
+  std::mt19937 rng_;
+};
+
+}  // namespace hal
@@ -0,0 +1,106 @@
+#pragma once
+
+// ============================================
+// /live protocol: video, audio and control on one WebSocket
+// ============================================
+// Binary messages carry media behind a 16-byte little-endian header:
+//   u8  type         LIVE_VIDEO (JPEG follows) or LIVE_AUDIO (s16le PCM)
+//   u8  flags        0
+//   u16 rate         Audio sample rate in Hz; 0 for video
+//   u32 seq          Per type: camera frames grabbed, ring block sequence
+//   i64 captureUs    Capture time (video frame, first audio sample) on the
+//                    device's monotonic clock, shared by both types
+// Text messages are small JSON control objects:
+//   device -> page   {"type":"hello",...} on connect, {"type":"pong",...},
+//                    {"type":"stats",...} about once a second
+//   page -> device   {"type":"ack","seq":N} per decoded video frame,
+//                    {"type":"ping","t":T} (echoed with the device clock so
+//                    the page can map capture times onto its own clock),
+//                    {"type":"config","video":0|1,"audio":0|1,"rate":HZ}
+//
+// Flow control is per type. Video is credit-based: a viewer has at most
+// LIVE_VIDEO_WINDOW frames it has not acknowledged, and gets a frame only
+// while its send queue is nearly empty. A slow viewer gets fewer frames
+// instead of a growing delay. Audio is small and steady: it is sent unless
+// the queue is already deep, and dropped otherwise.
+//
+// No sockets here: the device (AsyncWebSocket), the host simulation and
+// the load generator share it.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LIVE_HEADER_SIZE 16
+#define LIVE_VIDEO_WINDOW 2     // Frames in flight (sent, not yet acknowledged)
+#define LIVE_VIDEO_QUEUE 1      // Queued messages above which video waits
+#define LIVE_AUDIO_QUEUE 12     // Queued messages above which audio is dropped (~200 ms)
+#define LIVE_CONTROL_MAX 128    // Longest control message accepted from the page
+
+namespace live {
+
+enum Type : uint8_t { LIVE_VIDEO = 1, LIVE_AUDIO = 2 };
+
+struct Header {
+  Type type;
+  uint16_t rate;
+  uint32_t seq;
+  int64_t captureUs;
+};
+
+void writeHeader(uint8_t* out, Type type, uint16_t rate, uint32_t seq, int64_t captureUs);
+// False if 'len' is too short or the type is unknown
+bool readHeader(const uint8_t* data, size_t len, Header& out);
+
+// A control message from the page
+struct Control {
+  enum Kind { NONE, ACK, PING, CONFIG } kind;
+  uint32_t seq;     // ACK
+  double t;         // PING: page time, echoed in the pong
+  int video;        // CONFIG: 0, 1, or -1 when absent
+  int audio;
+  uint32_t rate;    // CONFIG: 0 when absent
+};
+bool parseControl(const char* msg, size_t len, Control& out);
+
+// Per-viewer send decisions and counters. The ack and config side may run
+// on another task than the senders; each counter has a single writer.
+class Flow {
+ public:
+  void begin(bool video, bool audio);
+  void configure(int video, int audio);   // -1 leaves a type as it is
+
+  bool video() const { return video_; }
+  bool audio() const { return audio_; }
+  // 'queued': messages waiting in the viewer's send queue
+  bool videoReady(size_t queued) const;
+  bool audioReady(size_t queued) const;
+
+  void videoSent() { videoSent_++; }
+  void videoSkipped() { videoSkipped_++; }
+  void audioSent() { audioSent_++; }
+  void audioDropped() { audioDropped_++; }
+  void acked();
+
+  uint32_t framesSent() const { return videoSent_; }
+  uint32_t framesSkipped() const { return videoSkipped_; }
+  uint32_t framesInFlight() const { return videoSent_ - videoAcked_; }
+  uint32_t blocksSent() const { return audioSent_; }
+  uint32_t blocksDropped() const { return audioDropped_; }
+
+ private:
+  volatile bool video_ = false;
+  volatile bool audio_ = false;
+  volatile uint32_t videoSent_ = 0;
+  volatile uint32_t videoAcked_ = 0;
+  volatile uint32_t videoSkipped_ = 0;
+  volatile uint32_t audioSent_ = 0;
+  volatile uint32_t audioDropped_ = 0;
+};
+
+// Device -> page control messages; return the length written (0 if 'cap'
+// is too small)
+size_t formatHello(char* out, size_t cap, int64_t deviceUs, uint32_t maxFps, uint32_t audioRate);
+size_t formatPong(char* out, size_t cap, double t, int64_t deviceUs);
+size_t formatStats(char* out, size_t cap, const Flow& flow, size_t queued);
+
+}  // namespace live
@@ -0,0 +1,124 @@
+#pragma once
+
+// ============================================
+// Asynchronous logger
+// ============================================
+// LOG_* macros format straight into a slot of a lock-free ring and return;
+// a priority-1 drain task writes the lines out (Serial on the device, stdout
+// on the host). Claiming a slot is one compare-and-swap on a bounded
+// sequence queue, formatting is vsnprintf into the slot, and nothing is
+// allocated. When the ring is full the line is dropped and counted instead
+// of blocking the caller, so a slow UART never costs a frame.
+//
+// LOG_*_EVERY(ms, ...) rate-limits one call site: at most one line per
+// interval, with "(+N suppressed)" appended to the next line that gets out.
+//
+// Lines above LOG_LEVEL are compiled out entirely (arguments unevaluated).
+// %f goes through newlib's dtoa, which can allocate - avoid it on hot paths.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#ifndef LOG_RING_SLOTS
+#define LOG_RING_SLOTS 64           // Must be a power of two
+#endif
+
+#ifndef LOG_LINE_MAX
+#define LOG_LINE_MAX 112            // Including the terminator; longer lines are cut
+#endif
+
+#define LOG_DRAIN_INTERVAL_MS 10
+
+namespace logger {
+
+enum Level : uint8_t {
+  LEVEL_ERROR = LOG_LEVEL_ERROR,
+  LEVEL_WARN = LOG_LEVEL_WARN,
+  LEVEL_INFO = LOG_LEVEL_INFO,
+  LEVEL_DEBUG = LOG_LEVEL_DEBUG
+};
+
+// Output sink; called from the drain task with one line (no newline)
+typedef void (*WriteFn)(const char* line, size_t len);
+
+// Rate-limit state for one call site (a static inside LOG_*_EVERY)
+struct Site {
+  std::atomic<uint32_t> lastMs;
+  std::atomic<uint32_t> suppressed;
+  std::atomic<bool> primed;
+};
+
+struct Stats {
+  uint32_t written;      // Lines handed to the sink
+  uint32_t dropped;      // Lines lost to a full ring
+  uint32_t suppressed;   // Lines swallowed by per-site rate limits
+  uint32_t highWater;    // Deepest the ring has been
+};
+
+// Replace the output sink (nullptr restores the default); returns the old one
+WriteFn setSink(WriteFn sink);
+
+// Start the drain task (device) or thread (host)
+bool begin();
+
+void log(Level level, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+void logv(Level level, const char* fmt, va_list args);
+void logEvery(Site& site, uint32_t intervalMs, Level level, const char* fmt, ...)
+  __attribute__((format(printf, 4, 5)));
+
+// Write every queued line to the sink now and return how many were written.
+// Call before deep sleep or restart so the last lines are not lost.
+size_t drain();
+
+void stats(Stats& out);
+
+}  // namespace logger
+
+#define LOG_AT(level, ...) logger::log(level, __VA_ARGS__)
+#define LOG_AT_EVERY(level, ms, ...) \
+  do { static logger::Site logSite_; logger::logEvery(logSite_, ms, level, __VA_ARGS__); } while (0)
+#define LOG_NOTHING(...) do {} while (0)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_E(...) LOG_AT(logger::LEVEL_ERROR, __VA_ARGS__)
+#define LOG_E_EVERY(ms, ...) LOG_AT_EVERY(logger::LEVEL_ERROR, ms, __VA_ARGS__)
+#else
+#define LOG_E(...) LOG_NOTHING()
+#define LOG_E_EVERY(ms, ...) LOG_NOTHING()
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_W(...) LOG_AT(logger::LEVEL_WARN, __VA_ARGS__)
+#define LOG_W_EVERY(ms, ...) LOG_AT_EVERY(logger::LEVEL_WARN, ms, __VA_ARGS__)
+#else
+#define LOG_W(...) LOG_NOTHING()
+#define LOG_W_EVERY(ms, ...) LOG_NOTHING()
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_I(...) LOG_AT(logger::LEVEL_INFO, __VA_ARGS__)
+#define LOG_I_EVERY(ms, ...) LOG_AT_EVERY(logger::LEVEL_INFO, ms, __VA_ARGS__)
+#else
+#define LOG_I(...) LOG_NOTHING()
+#define LOG_I_EVERY(ms, ...) LOG_NOTHING()
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_D(...) LOG_AT(logger::LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_D_EVERY(ms, ...) LOG_AT_EVERY(logger::LEVEL_DEBUG, ms, __VA_ARGS__)
+#else
+#define LOG_D(...) LOG_NOTHING()
+#define LOG_D_EVERY(ms, ...) LOG_NOTHING()
+#endif
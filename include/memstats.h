@@ -0,0 +1,139 @@
+#pragma once
+
+// ============================================
+// Heap / PSRAM fragmentation tracking
+// ============================================
+// Per-capability heap statistics (free, largest free block, low-water mark,
+// fragmentation ratio), allocation counters for tagged subsystems, and a
+// fixed ring of periodic snapshots so /api/memory shows the trend rather
+// than a single point.
+//
+// With -DALLOC_AUDIT=1 (and the linker wrapping malloc & co., see
+// platformio.ini) every heap allocation is attributed to the calling task.
+// Hot paths wrap their steady-state work in an AllocWindow, so /api/memory
+// can show that recording and streaming allocate nothing once running.
+//
+// Fragmentation is 1 - largest_free_block / total_free, in percent: 0 means
+// all free memory is one block, values near 100 mean a large request will
+// fail even though plenty of memory is "free".
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MEMSTATS_HISTORY_LEN 48              // 4 hours at the default interval
+#define MEMSTATS_SAMPLE_INTERVAL_MS 300000   // 5 minutes
+#define MEMSTATS_AUDIT_TASKS 6               // Tasks that can open an AllocWindow
+
+#ifndef ALLOC_AUDIT
+#define ALLOC_AUDIT 0
+#endif
+
+namespace memstats {
+
+// Subsystems that own long-lived or large allocations
+enum Tag {
+  TAG_RAMDISK,    // USB MSC RAM disk
+  TAG_WAV,        // record_wav() clip buffer
+  TAG_TRACER,     // Event tracer rings
+  TAG_BLE_XFER,   // BLE file transfer read-ahead ring
+  TAG_LIVE,       // /live video message buffer
+  TAG_RTSP,       // RTSP frame copy
+  TAG_OTHER,
+  TAG_COUNT
+};
+
+enum Region {
+  REGION_INTERNAL,
+  REGION_PSRAM,
+  REGION_COUNT
+};
+
+struct RegionStats {
+  uint32_t freeBytes;
+  uint32_t largestFreeBlock;
+  uint32_t minFreeBytes;       // Low-water mark since boot
+  uint8_t fragmentationPct;
+};
+
+struct TagStats {
+  uint32_t allocs;
+  uint32_t frees;
+  uint32_t failures;
+  uint32_t liveBytes;
+  uint32_t peakBytes;
+};
+
+struct Sample {
+  uint32_t uptimeSec;
+  RegionStats regions[REGION_COUNT];
+};
+
+// Allocate / free on behalf of 'tag'. 'caps' are heap_caps MALLOC_CAP_* flags.
+void* alloc(Tag tag, size_t size, uint32_t caps);
+void release(Tag tag, void* ptr);
+
+// Read current region statistics
+void readRegion(Region region, RegionStats& out);
+
+// Record a history sample (call periodically; cheap)
+void sample();
+
+// Copy out history oldest-first; returns number of samples copied
+size_t history(Sample* out, size_t max);
+
+void tagStats(Tag tag, TagStats& out);
+
+const char* tagName(Tag tag);
+const char* regionName(Region region);
+
+// ============================================
+// Hot-path allocation audit
+// ============================================
+enum HotPath {
+  HOT_RECORD,     // recordingTask() video and audio clips
+  HOT_STREAM,     // /stream chunk fill
+  HOT_AUDIO,      // audioTask() read + send
+  HOT_PATH_COUNT
+};
+
+struct HotPathStats {
+  uint32_t runs;           // Windows closed
+  uint32_t allocs;         // Allocations by our code (expected 0)
+  uint32_t driverAllocs;   // Allocations inside DriverScopes (SD/FAT, WebSocket library)
+};
+
+// Counts allocations made by the calling task while in scope and adds
+// them to 'path' when it closes
+class AllocWindow {
+ public:
+  explicit AllocWindow(HotPath path);
+  ~AllocWindow();
+
+ private:
+  HotPath path_;
+  int slot_;
+  uint32_t startAllocs_;
+  uint32_t startDriver_;
+};
+
+// Allocations made inside are charged to a library or driver we don't
+// control rather than to the enclosing AllocWindow
+class DriverScope {
+ public:
+  DriverScope();
+  ~DriverScope();
+
+ private:
+  int slot_;
+};
+
+// Give up the calling task's audit slot; call before vTaskDelete() in
+// tasks that are created repeatedly
+void forgetTask();
+
+// False when built without ALLOC_AUDIT (every count then reads 0)
+bool auditEnabled();
+void hotPathStats(HotPath path, HotPathStats& out);
+const char* hotPathName(HotPath path);
+
+}  // namespace memstats
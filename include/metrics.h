@@ -0,0 +1,200 @@
+#pragma once
+
+// ============================================
+// Metrics registry (Prometheus text exposition)
+// ============================================
+// Counters, gauges and fixed-bucket histograms that hot paths can update
+// from any task without locks or allocation. Every metric is a static
+// object that links itself into the registry at construction; the /metrics
+// handler walks the registry and streams the text format through a sink.
+//
+// Values are 32-bit so updates stay single-instruction atomics on the
+// ESP32-S3. Counters wrap at 2^32, which Prometheus' rate() treats as a reset.
+// A histogram's _sum is kept 64-bit as a low word plus a carry word, since
+// microsecond totals would wrap within hours.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+namespace metrics {
+
+// Output sink used by writePrometheus(); called once per rendered line
+typedef void (*WriteFn)(void* ctx, const char* data, size_t len);
+
+// Unit applied when rendering. Microsecond values are exported in seconds
+// (Prometheus base unit) without floating point.
+enum Unit {
+  UNIT_NONE,
+  UNIT_MICROS,
+  UNIT_TENTHS    // Fixed point with one decimal, e.g. levels in 0.1 dB
+};
+
+class Metric {
+ public:
+  Metric(const char* name, const char* help, Unit unit);
+  virtual ~Metric() {}
+  virtual void write(WriteFn write, void* ctx) const = 0;
+
+  const char* name() const { return name_; }
+  const char* help() const { return help_; }
+  Unit unit() const { return unit_; }
+  const Metric* next() const { return next_; }
+
+ protected:
+  const char* name_;
+  const char* help_;
+  Unit unit_;
+  Metric* next_;
+};
+
+class Counter : public Metric {
+ public:
+  Counter(const char* name, const char* help, Unit unit = UNIT_NONE)
+    : Metric(name, help, unit), value_(0) {}
+
+  void inc(uint32_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+  uint32_t value() const { return value_.load(std::memory_order_relaxed); }
+  void write(WriteFn write, void* ctx) const override;
+
+ private:
+  std::atomic<uint32_t> value_;
+};
+
+class Gauge : public Metric {
+ public:
+  Gauge(const char* name, const char* help, Unit unit = UNIT_NONE)
+    : Metric(name, help, unit), value_(0) {}
+
+  void set(int32_t v) { value_.store(v, std::memory_order_relaxed); }
+  void add(int32_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+  int32_t value() const { return value_.load(std::memory_order_relaxed); }
+  void write(WriteFn write, void* ctx) const override;
+
+ private:
+  std::atomic<int32_t> value_;
+};
+
+#define METRICS_MAX_SERIES 8
+
+// Gauge with one label: a series per entry in a fixed list of label values
+class GaugeVec : public Metric {
+ public:
+  // 'labelValues' must outlive the gauge (use a static const array)
+  GaugeVec(const char* name, const char* help, const char* label,
+           const char* const* labelValues, size_t count, Unit unit = UNIT_NONE);
+
+  void set(size_t i, int32_t v) {
+    if (i < count_) values_[i].store(v, std::memory_order_relaxed);
+  }
+  int32_t value(size_t i) const { return i < count_ ? values_[i].load(std::memory_order_relaxed) : 0; }
+  size_t size() const { return count_; }
+  void write(WriteFn write, void* ctx) const override;
+
+ private:
+  const char* label_;
+  const char* const* labelValues_;
+  size_t count_;
+  std::atomic<int32_t> values_[METRICS_MAX_SERIES];
+};
+
+#define METRICS_MAX_BUCKETS 12
+
+class Histogram : public Metric {
+ public:
+  // 'bounds' are inclusive upper bounds in ascending order and must outlive
+  // the histogram (use a static const array). A +Inf bucket is implicit.
+  Histogram(const char* name, const char* help, const uint32_t* bounds,
+            size_t bucketCount, Unit unit = UNIT_NONE);
+
+  void observe(uint32_t v);
+  uint32_t count() const { return count_.load(std::memory_order_relaxed); }
+  uint64_t sum() const;
+  // Upper bound of the bucket holding quantile 'q' (0..1); 0 when empty
+  uint32_t quantile(float q) const;
+  void write(WriteFn write, void* ctx) const override;
+
+ private:
+  const uint32_t* bounds_;
+  size_t bucketCount_;
+  std::atomic<uint32_t> buckets_[METRICS_MAX_BUCKETS + 1];
+  std::atomic<uint32_t> count_;
+  // 64-bit sum as two 32-bit words (32 bits of microseconds wrap after
+  // ~72 min); a 64-bit atomic would be a lock on Xtensa
+  std::atomic<uint32_t> sumLo_;
+  std::atomic<uint32_t> sumHi_;
+};
+
+// Head of the registry (most recently constructed metric first)
+const Metric* first();
+
+// Render every registered metric in Prometheus text format 0.0.4
+void writePrometheus(WriteFn write, void* ctx);
+
+// Shared bucket layouts
+extern const uint32_t kLatencyBucketsUs[];     // 100 us .. 5 s
+extern const size_t kLatencyBucketCount;
+extern const uint32_t kFrameSizeBuckets[];     // 4 KB .. 512 KB
+extern const size_t kFrameSizeBucketCount;
+
+// ============================================
+// Firmware metrics
+// ============================================
+extern Counter framesCaptured;
+extern Counter captureErrors;
+extern Counter framesSaved;
+extern Counter frameSaveErrors;
+extern Counter audioClipsSaved;
+extern Counter streamFrames;
+extern Counter streamBytes;
+extern Counter sdMutexTimeouts;
+extern Counter logWritten;
+extern Counter logDropped;
+extern Counter logSuppressed;
+extern Counter wifiConnects;
+extern Counter wifiFastConnects;
+extern Counter wifiLinkLosses;
+extern Counter dutyCycleWakes;
+extern Counter dutyCycleFailedWakes;
+extern Counter timelapseFrames;
+extern Counter powerTransitions;
+extern Counter commandsCompleted;
+extern Counter commandsDropped;
+extern Counter audioBlocks;
+extern Counter audioReadErrors;
+extern Counter soundEvents;
+extern Counter rtspFrames;
+extern Counter rtspFramesSkipped;
+extern Counter liveFrames;
+extern Counter liveFramesSkipped;
+extern Counter liveAudioDropped;
+
+extern Gauge audioRmsDbfs;
+extern Gauge audioPeakDbfs;
+extern Gauge audioDominantHz;
+extern GaugeVec audioBandDbfs;
+
+extern Histogram captureLatency;
+extern Histogram sdWriteLatency;
+extern Histogram frameSize;
+extern Histogram streamSendTime;
+extern Histogram sdMutexWait;
+extern Histogram wifiConnectTime;
+extern Histogram wakeToFrame;
+extern Histogram timelapseShotTime;
+extern Histogram commandLatency;
+
+extern Gauge wsClients;
+extern Gauge wsQueueDepth;
+extern Gauge rtspClients;
+extern Gauge liveClients;
+extern Gauge freeHeap;
+extern Gauge freePsram;
+extern Gauge sdFreeBytesMB;
+extern Gauge wifiRssi;
+extern Gauge uptimeSeconds;
+extern Gauge logRingHighWater;
+extern Gauge powerLevel;
+extern Gauge batteryMv;
+
+}  // namespace metrics
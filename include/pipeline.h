@@ -0,0 +1,128 @@
+#pragma once
+
+// ============================================
+// Recording and streaming pipelines
+// ============================================
+// Platform-independent capture -> SD and capture -> MJPEG logic. Runs on
+// the device against hal_esp32 and on Linux against hal_host, so throughput
+// and buffering can be measured before flashing.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal.h"
+
+// Audio configuration (PDM microphone, per Seeed documentation)
+#define SAMPLE_RATE 16000U
+#define SAMPLE_BITS 16
+#define WAV_HEADER_SIZE 44
+#define VOLUME_GAIN 2
+#define RECORD_TIME 10  // seconds per file
+#define WAV_FILE_NAME "recording"
+#define AUDIO_FRAME_HEADER_SIZE 16
+
+// Generate WAV file header (per Seeed example)
+void generate_wav_header(uint8_t *wav_header, uint32_t wav_size, uint32_t sample_rate);
+
+// Header in front of each /audio frame for clients that connect with
+// ?seq=1 (little-endian): u32 block sequence, u32 sample rate, i64 capture
+// time of the first sample in Unix microseconds (0 before the clock is set)
+void generate_audio_frame_header(uint8_t *header, uint32_t seq, uint32_t sample_rate, int64_t capture_unix_us);
+
+// Left-shift every 16-bit sample by 'gain' bits (in place)
+void apply_gain(uint8_t *pcm, size_t len, int gain);
+
+namespace pipeline {
+
+enum SaveResult {
+  SAVE_OK,
+  SAVE_LOCK_TIMEOUT,
+  SAVE_OPEN_FAILED,
+  SAVE_SHORT_WRITE,
+  SAVE_NO_DATA
+};
+
+// Optional per-event callbacks (logging on the device, stats on the host)
+class Listener {
+ public:
+  virtual ~Listener() {}
+  virtual void onFrameSaved(uint32_t frameNo, const char* path, size_t len, SaveResult result) {}
+  virtual void onCaptureError() {}
+};
+
+class Recorder {
+ public:
+  Recorder(hal::Camera& camera, hal::Microphone& mic, hal::Storage& storage, hal::Clock& clock);
+
+  void setListener(Listener* listener) { listener_ = listener; }
+  // Cap recordVideoClip() at 'fps' frames per second; 0 = as fast as the
+  // camera delivers. Takes effect on the next frame.
+  void setMaxFps(uint8_t fps) { frameIntervalMs_ = fps ? 1000 / fps : 0; }
+
+  // "/video/<timestamp>_frame_<n>.jpg", or "/video/frame_<n>.jpg" before NTP sync
+  void frameFilename(char* out, size_t cap, uint32_t frameNo);
+  // "/recording_<timestamp>_<n>.wav", or "/recording_<n>.wav" before NTP sync
+  void audioFilename(char* out, size_t cap, uint32_t clipNo);
+
+  SaveResult saveFrame(const hal::Frame& frame, uint32_t frameNo, char* pathOut, size_t pathCap);
+
+  struct ClipStats {
+    uint32_t captured;
+    uint32_t saved;
+    uint32_t captureErrors;
+    uint32_t saveErrors;
+  };
+
+  // Capture and save frames for 'durationMs' or until '*running' clears.
+  // 'frameCounter' numbers the files and advances on every saved frame.
+  ClipStats recordVideoClip(uint32_t durationMs, const volatile bool* running,
+                            volatile unsigned long& frameCounter);
+
+  // Fill 'buffer' from the microphone, apply gain and write a WAV file.
+  // 'capacity' bytes of PCM are recorded (RECORD_TIME seconds by default),
+  // or less if '*running' clears first (sound-gated clips).
+  SaveResult recordAudioClip(uint8_t* buffer, size_t capacity, uint32_t clipNo,
+                             char* pathOut, size_t pathCap, const volatile bool* running = nullptr);
+
+ private:
+  hal::Camera& camera_;
+  hal::Microphone& mic_;
+  hal::Storage& storage_;
+  hal::Clock& clock_;
+  Listener* listener_;
+  volatile uint32_t frameIntervalMs_;
+};
+
+// multipart/x-mixed-replace producer. Each frame is copied out of the
+// camera buffer as soon as it is grabbed, so a slow viewer never holds one
+// of the driver's few frame buffers; the copy is sent over as many fill()
+// calls as the transport needs. The copy buffer grows to the largest frame.
+class MjpegStreamer {
+ public:
+  MjpegStreamer(hal::Camera& camera, hal::Clock& clock);
+  ~MjpegStreamer();
+
+  // Copy up to 'maxLen' bytes of stream into 'buf'. Returns 0 when the
+  // camera fails, which ends the HTTP response.
+  size_t fill(uint8_t* buf, size_t maxLen);
+
+  uint32_t framesSent() const { return framesSent_; }
+
+ private:
+  MjpegStreamer(const MjpegStreamer&);
+  MjpegStreamer& operator=(const MjpegStreamer&);
+
+  hal::Camera& camera_;
+  hal::Clock& clock_;
+  uint8_t* copy_;         // JPEG being sent
+  size_t copyCap_;
+  size_t frameLen_;
+  bool haveFrame_;
+  int64_t frameStartUs_;
+  char header_[96];
+  size_t headerLen_;
+  size_t offset_;        // Bytes of header + body + trailer already sent
+  uint32_t framesSent_;
+};
+
+}  // namespace pipeline
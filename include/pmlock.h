@@ -0,0 +1,87 @@
+#pragma once
+
+// ============================================
+// Power-management locks and residency
+// ============================================
+// One esp_pm lock per pipeline, held only while that pipeline is doing
+// work. With no lock held the CPU drops to the DFS floor and the idle task
+// may enter automatic light sleep.
+//
+// Each acquire/release also updates a residency counter for the power state
+// the firmware is asking for:
+//   cpu_max   - a CPU_FREQ_MAX lock is held (capture, Wi-Fi TX)
+//   awake     - only NO_LIGHT_SLEEP locks (camera running, SD, audio, USB)
+//   idle      - nothing held: DFS floor, light sleep allowed
+// Drivers hold their own locks too (Wi-Fi, BT, I2S), so "idle" is an upper
+// bound on light sleep. Actual light-sleep time needs
+// CONFIG_PM_LIGHT_SLEEP_CALLBACKS in the SDK build; without it
+// lightSleepUs is reported as -1.
+//
+// Before begin() (or when esp_pm is unavailable) acquire/release only count.
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace pmlock {
+
+enum Id {
+  CAMERA,     // Sensor streaming (XCLK and DMA running)    NO_LIGHT_SLEEP
+  CAPTURE,    // Grabbing and saving frames                  CPU_FREQ_MAX
+  SD_IO,      // sdMutex held                                NO_LIGHT_SLEEP
+  AUDIO,      // Microphone enabled                          NO_LIGHT_SLEEP
+  WIFI_TX,    // Producing /stream and /audio payloads       CPU_FREQ_MAX
+  USB_MSC,    // SD exposed as a USB drive                   NO_LIGHT_SLEEP
+  LOCK_COUNT
+};
+
+enum State {
+  STATE_CPU_MAX,
+  STATE_AWAKE,
+  STATE_IDLE,
+  STATE_COUNT
+};
+
+struct LockStats {
+  const char* name;
+  bool cpuMax;              // CPU_FREQ_MAX, else NO_LIGHT_SLEEP
+  uint32_t holders;         // Current (counted) holders
+  uint32_t acquisitions;
+  uint64_t heldUs;          // Total time with at least one holder
+};
+
+struct Residency {
+  uint64_t stateUs[STATE_COUNT];
+  int64_t lightSleepUs;     // -1 without light-sleep callbacks
+  uint32_t lightSleeps;
+  uint64_t sinceUs;         // Start of the accounting window (boot or reset())
+  bool pmEnabled;           // Locks are live (esp_pm configured)
+};
+
+// Create the esp_pm locks; call after esp_pm_configure() succeeds
+bool begin();
+
+// Counted: nested acquires need as many releases
+void acquire(Id id);
+void release(Id id);
+
+// Holds a lock for a scope
+class Hold {
+ public:
+  explicit Hold(Id id) : id_(id) { acquire(id_); }
+  ~Hold() { release(id_); }
+
+ private:
+  Hold(const Hold&);
+  Hold& operator=(const Hold&);
+  Id id_;
+};
+
+const char* stateName(State state);
+
+// Copy residency and per-lock stats (including time up to now)
+void snapshot(Residency& residency, LockStats locks[LOCK_COUNT]);
+
+// Restart the accounting window (held time and residency; holders stay)
+void reset();
+
+}  // namespace pmlock
@@ -0,0 +1,70 @@
+#pragma once
+
+// ============================================
+// Polyphase FIR resampler
+// ============================================
+// Converts the 16 kHz capture stream to a lower output rate for one
+// consumer, so /audio clients can take 8 kHz (half the bandwidth, enough
+// for voice) or 12 kHz while recording stays at 16 kHz and the capture
+// path is untouched.
+//
+// A rate change of up/down (1/2 for 8 kHz, 3/4 for 12 kHz) runs a Kaiser-
+// windowed low-pass designed at up x the input rate, split into 'up'
+// phases. Only the phases that land on output samples are computed, so
+// each output costs one dot product of 'taps' samples. Coefficients are
+// Q14, computed by constexpr code when the firmware is compiled, stored
+// reversed and 16-byte aligned so each dot product is a straight
+// multiply-accumulate over two contiguous int16 arrays.
+//
+// No hardware access; [env:resample] measures passband ripple, stopband
+// rejection and throughput on the host.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RESAMPLE_MAX_TAPS 104   // Per phase
+
+namespace resample {
+
+struct Filter {
+  uint8_t up;
+  uint8_t down;
+  uint16_t taps;           // Per phase
+  float passbandHz;        // Designed edges, for input at 16 kHz
+  float stopbandHz;
+  const int16_t* coeffs;   // up x taps, phase-major, each phase reversed
+};
+
+// Filters built into the firmware; resample_main.cpp walks this list
+extern const Filter kFilters[];
+extern const size_t kFilterCount;
+
+class Resampler {
+ public:
+  // False when there is no filter for this pair. Equal rates copy through.
+  bool begin(uint32_t inRate, uint32_t outRate);
+
+  // Clear the history, e.g. when a consumer joins mid-stream
+  void reset();
+
+  // Resample 'n' input samples into 'out'; returns the samples written.
+  // 'cap' must be at least maxOutput(n).
+  size_t process(const int16_t* in, size_t n, int16_t* out, size_t cap);
+
+  size_t maxOutput(size_t n) const;
+  uint32_t inRate() const { return inRate_; }
+  uint32_t outRate() const { return outRate_; }
+  const Filter* filter() const { return filter_; }
+
+ private:
+  const Filter* filter_ = nullptr;
+  uint32_t inRate_ = 0;
+  uint32_t outRate_ = 0;
+  uint16_t pos_ = 0;
+  uint8_t phase_ = 0;
+  // History written twice, at pos_ and pos_ + taps, so the newest 'taps'
+  // samples are always contiguous at &history_[pos_]
+  alignas(16) int16_t history_[RESAMPLE_MAX_TAPS * 2];
+};
+
+}  // namespace resample
@@ -0,0 +1,111 @@
+#pragma once
+
+// ============================================
+// RTP packetization (RFC 3550, 2435, 3551)
+// ============================================
+// Turns camera JPEGs and microphone PCM into RTP packets for the RTSP
+// server, without re-encoding:
+//   - JPEG per RFC 2435: the entropy-coded scan is sent as is, split into
+//     fragments behind an 8-byte JPEG header. The quantization tables go
+//     in-band (Q = 255) in the first packet of each frame, so any encoder
+//     quality works. Receivers rebuild the JPEG headers themselves and
+//     assume the standard Huffman tables, which parseJpeg() checks for.
+//   - Audio as L16 (big-endian 16-bit) or PCMU (G.711 mu-law, 8 kHz).
+//   - RTCP sender reports tying each stream's RTP clock to wall-clock (NTP)
+//     time, which is what lets a receiver line audio up with video.
+//
+// No sockets and no hardware access, so it builds on the host.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RTP_HEADER_SIZE 12
+#define RTP_MAX_PACKET 1400      // Fits one Wi-Fi/Ethernet frame with IP/UDP headers
+#define RTP_PT_PCMU 0
+#define RTP_PT_JPEG 26
+#define RTP_PT_L16 97            // Dynamic; the SDP maps it to L16/<rate>/1
+#define RTP_VIDEO_CLOCK 90000
+
+namespace rtp {
+
+// One RTP stream: SSRC, sequence numbers and the RTP clock
+class Stream {
+ public:
+  void begin(uint8_t payloadType, uint32_t clockRate, uint32_t ssrc, uint16_t firstSeq, uint32_t firstTimestamp);
+
+  // RTP timestamp for a capture time, following the last anchor
+  uint32_t timestampAt(int64_t us) const;
+  // Tie 'timestamp' to capture time 'us'; later timestamps count from here
+  void anchor(int64_t us, uint32_t timestamp);
+
+  // Write the fixed header for the next packet and count it
+  size_t header(uint8_t* out, uint32_t timestamp, bool marker, size_t payloadBytes);
+
+  // RTCP sender report plus SDES CNAME. 'unixUs' is wall-clock time at
+  // 'nowUs' (any consistent epoch works for A/V sync). Returns the length.
+  size_t senderReport(uint8_t* out, size_t cap, int64_t nowUs, int64_t unixUs, const char* cname) const;
+
+  uint8_t payloadType() const { return payloadType_; }
+  uint32_t clockRate() const { return clockRate_; }
+  uint32_t ssrc() const { return ssrc_; }
+  uint16_t nextSeq() const { return seq_; }
+  uint32_t packets() const { return packets_; }
+  uint32_t octets() const { return octets_; }
+  bool anchored() const { return anchored_; }
+
+ private:
+  uint8_t payloadType_ = 0;
+  uint32_t clockRate_ = 1;
+  uint32_t ssrc_ = 0;
+  uint16_t seq_ = 0;
+  bool anchored_ = false;
+  int64_t anchorUs_ = 0;
+  uint32_t anchorTs_ = 0;
+  uint32_t packets_ = 0;
+  uint32_t octets_ = 0;
+};
+
+// What RFC 2435 needs from a baseline JPEG
+struct JpegInfo {
+  uint16_t width;
+  uint16_t height;
+  uint8_t type;              // 0 = 4:2:2, 1 = 4:2:0; +64 with restart markers
+  uint16_t restartInterval;
+  const uint8_t* qtables[2]; // Luma and chroma, 64 bytes each in zig-zag order
+  const uint8_t* scan;       // Entropy-coded data after SOS, EOI stripped
+  size_t scanLen;
+};
+
+// Fill 'out' from a camera JPEG; returns nullptr, or why RFC 2435 cannot
+// carry it (progressive, greyscale, custom Huffman tables, too large, ...)
+const char* parseJpeg(const uint8_t* jpeg, size_t len, JpegInfo& out);
+
+// Standard Huffman tables (ITU T.81 K.3) as DHT payloads: class/id byte,
+// 16 code counts, symbols. Receivers assume these; the host test uses them
+// to rebuild JPEGs.
+extern const uint8_t kStdDcLuma[1 + 16 + 12];
+extern const uint8_t kStdAcLuma[1 + 16 + 162];
+extern const uint8_t kStdDcChroma[1 + 16 + 12];
+extern const uint8_t kStdAcChroma[1 + 16 + 162];
+
+// Splits one frame into RTP/JPEG packets
+class JpegPacketizer {
+ public:
+  void begin(const JpegInfo& info, uint32_t timestamp);
+  // Next packet (RTP header included) into 'out'; 0 once the frame is done
+  size_t next(Stream& stream, uint8_t* out, size_t cap);
+
+ private:
+  JpegInfo info_ = {};
+  uint32_t timestamp_ = 0;
+  size_t offset_ = 0;
+  bool done_ = true;
+};
+
+// Payload encoders; return the bytes written (2 per sample for L16, 1 for PCMU)
+size_t packL16(const int16_t* pcm, size_t samples, uint8_t* out);
+size_t packPcmu(const int16_t* pcm, size_t samples, uint8_t* out);
+uint8_t linearToUlaw(int16_t sample);
+int16_t ulawToLinear(uint8_t code);
+
+}  // namespace rtp
@@ -0,0 +1,114 @@
+#pragma once
+
+// ============================================
+// RTSP server sessions (RFC 2326)
+// ============================================
+// One Session per client TCP connection. It parses requests, answers
+// OPTIONS, DESCRIBE, SETUP, PLAY, GET_PARAMETER and TEARDOWN, and sends
+// media packetized by rtp.h, either interleaved on the RTSP connection
+// ($-framed, RTP/AVP/TCP) or as UDP datagrams to the client's ports.
+//
+// The session describes two tracks: JPEG video (track1) and microphone
+// audio (track2), as L16 at the capture rate or PCMU at 8 kHz. A client
+// picks the audio codec with ?audio=l16|pcmu|none on the URL; otherwise
+// Config::audio applies. Audio is handed to sendAudio() at audioRate().
+//
+// Sockets are behind Link, so the same code runs on the device (WiFiClient
+// and WiFiUDP) and on the host against a local RTSP client.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rtp.h"
+
+#define RTSP_MAX_REQUEST 2048       // Request head plus body
+#define RTSP_SESSION_TIMEOUT_S 60   // Advertised in the Session header
+#define RTSP_REPORT_INTERVAL_MS 5000
+
+namespace rtsp {
+
+enum Track { VIDEO = 0, AUDIO = 1, TRACKS = 2 };
+
+enum AudioCodec { AUDIO_NONE, AUDIO_L16, AUDIO_PCMU };
+
+// Sockets for one client
+class Link {
+ public:
+  virtual ~Link() {}
+  // RTSP responses and interleaved packets, on the client's TCP connection
+  virtual bool sendTcp(const uint8_t* data, size_t len) = 0;
+  // RTP (or RTCP when 'rtcp') to 'port' at the client's address, from the
+  // server's RTP (RTCP) port
+  virtual bool sendUdp(uint16_t port, bool rtcp, const uint8_t* data, size_t len) = 0;
+};
+
+struct Config {
+  const char* name;         // SDP session name and RTCP CNAME
+  AudioCodec audio;         // For clients that do not ask
+  uint32_t captureRate;     // Microphone rate, used for L16
+  uint16_t serverPort;      // Server RTP port for UDP (RTCP is +1)
+};
+
+class Session {
+ public:
+  // 'seed' varies the session id, SSRCs and initial sequence numbers
+  void begin(const Config& config, uint32_t seed);
+
+  // Bytes read from the client's TCP connection. Returns false when the
+  // connection should be closed (TEARDOWN or a malformed request).
+  bool receive(const uint8_t* data, size_t len, int64_t nowUs, Link& link);
+
+  bool playing(Track track) const { return playing_ && setup_[track]; }
+  AudioCodec audioCodec() const { return audio_; }
+  uint32_t audioRate() const;
+
+  // Packetize and send one camera frame; false if the link failed.
+  // Frames RFC 2435 cannot carry are skipped (see lastError()).
+  bool sendFrame(const uint8_t* jpeg, size_t len, int64_t captureUs, Link& link);
+  // Send one block of audio at audioRate(); 'captureUs' is its first sample
+  bool sendAudio(const int16_t* pcm, size_t samples, int64_t captureUs, Link& link);
+  // RTCP sender reports when due; 'unixUs' is wall-clock time at 'nowUs'
+  bool sendReports(int64_t nowUs, int64_t unixUs, Link& link);
+
+  uint32_t id() const { return id_; }
+  const char* lastError() const { return lastError_; }
+  uint32_t framesSent() const { return framesSent_; }
+  uint32_t framesSkipped() const { return framesSkipped_; }
+  const rtp::Stream& stream(Track track) const { return streams_[track]; }
+
+ private:
+  struct Transport {
+    bool interleaved = false;
+    uint8_t channel = 0;      // RTP channel; RTCP is +1
+    uint16_t clientPort = 0;  // RTP port; RTCP is +1
+  };
+
+  bool handleRequest(const char* head, int64_t nowUs, Link& link);
+  bool respond(Link& link, int status, const char* reason, const char* headers, const char* body);
+  bool sendPacket(Track track, bool rtcp, const uint8_t* data, size_t len, Link& link);
+  void describe(const char* url);
+
+  Config config_ = {};
+  uint32_t id_ = 0;
+  uint32_t cseq_ = 0;
+  AudioCodec audio_ = AUDIO_NONE;
+  bool setup_[TRACKS] = {false, false};
+  Transport transport_[TRACKS] = {};
+  bool playing_ = false;
+  rtp::Stream streams_[TRACKS];
+  rtp::JpegPacketizer jpeg_;
+  int64_t lastReportUs_[TRACKS] = {0, 0};
+  int64_t audioNextUs_ = -1;  // Capture time and timestamp the next block
+  uint32_t audioNextTs_ = 0;  // continues from, or -1 after a gap
+  const char* lastError_ = nullptr;
+  uint32_t framesSent_ = 0;
+  uint32_t framesSkipped_ = 0;
+
+  char request_[RTSP_MAX_REQUEST + 1];
+  size_t requestLen_ = 0;
+  size_t skip_ = 0;           // Bytes left of an interleaved frame from the client
+  char url_[128];             // Base URL from DESCRIBE, for Content-Base and RTP-Info
+  uint8_t packet_[4 + RTP_MAX_PACKET];   // '$' framing + RTP packet
+};
+
+}  // namespace rtsp
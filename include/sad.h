@@ -0,0 +1,123 @@
+#pragma once
+
+// ============================================
+// Sound activity detector
+// ============================================
+// Streaming detector run on 256-sample frames (one audio ring block, 16 ms
+// at 16 kHz). Per frame it computes:
+//   - band energy (200-4000 Hz by default) from a Hann-windowed FFT
+//   - spectral flatness over the same band (geometric / arithmetic mean
+//     of the power spectrum: near 0 for tones and voices, ~0.56 for white
+//     noise)
+//   - zero-crossing rate
+// Band energy is compared to an adaptive noise floor that drops straight
+// to quieter frames and creeps up slowly, so a fan or road noise that
+// starts and stays is absorbed within seconds. A frame counts as sound
+// when it is far enough above the floor and not noise-like (flat spectrum
+// and many zero crossings), unless it is loud enough that it counts anyway
+// (knocks, slams). An event starts after a few such frames in a row and
+// ends after a hangover with none.
+//
+// The window and FFT go through fft.h (esp-dsp on the device); the rest is
+// plain float loops over fixed-size arrays. No hardware access otherwise:
+// [env:sad] replays labeled fixtures through it.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SAD_FRAME_SAMPLES 256   // FFT size; matches AUDIORING_BLOCK_SAMPLES
+#define SAD_BINS (SAD_FRAME_SAMPLES / 2 + 1)
+
+namespace sad {
+
+struct Config {
+  float onDb;               // Band energy above the noise floor to count a frame
+  float offDb;              // ... to keep counting once an event is running
+  float loudDb;             // Above this, noise-like frames count too
+  float maxFlatness;        // Flatter than this (and zcr above noiseZcr) is noise-like
+  float noiseZcr;           // Zero crossings per sample
+  uint16_t bandLoHz;
+  uint16_t bandHiHz;
+  float floorRiseDbPerSec;  // How fast the floor follows louder steady sound
+  uint16_t attackMs;        // Consecutive sound frames needed to start an event
+  uint16_t hangoverMs;      // Event continues this long after the last sound frame
+  uint16_t warmupMs;        // Floor settles before the first event can start
+};
+
+// 9 dB on / 6 dB off, 25 dB loud, flatness 0.45, 200-4000 Hz,
+// 1.5 dB/s floor rise, 32 ms attack, 600 ms hangover
+Config defaultConfig();
+
+enum Transition : uint8_t {
+  NONE,
+  ONSET,     // An event started with this frame
+  OFFSET     // The hangover ran out; the event ended
+};
+
+struct Features {
+  float energyDb;     // Band energy, dB relative to a full-scale sine
+  float floorDb;
+  float snrDb;        // energyDb - floorDb
+  float flatness;     // 0-1
+  float zcr;          // Zero crossings per sample
+  bool sound;         // This frame counted as sound
+};
+
+struct Event {
+  int64_t startUs;    // Timestamp of the first sound frame
+  int64_t endUs;      // End of the last sound frame (0 while running)
+  float peakSnrDb;
+};
+
+class Detector {
+ public:
+  // Builds the window and twiddle tables; call before process()
+  void begin(const Config& config, uint32_t sampleRate);
+
+  // Feed one frame of up to SAD_FRAME_SAMPLES samples (short frames are
+  // zero-padded). 'timestampUs' is the capture time of the first sample.
+  Transition process(const int16_t* pcm, size_t samples, int64_t timestampUs);
+
+  // Forget the floor and any running event, e.g. after a gap in the audio
+  void reset();
+
+  bool active() const { return active_; }
+  const Features& features() const { return features_; }
+  // The running event while active(), otherwise the last one that ended
+  const Event& event() const { return event_; }
+  uint32_t events() const { return events_; }
+  uint32_t frames() const { return frames_; }
+  uint32_t soundFrames() const { return soundFrames_; }
+
+ private:
+  Config config_;
+  uint32_t sampleRate_ = 16000;
+  uint16_t binLo_ = 0;
+  uint16_t binHi_ = 0;
+  uint16_t attackFrames_ = 1;
+  uint16_t hangoverFrames_ = 1;
+  uint16_t warmupFrames_ = 0;
+  float floorRisePerFrame_ = 0;
+  float fullScale_ = 1;          // Band energy of a full-scale sine, for dBFS
+
+  float floorDb_ = 0;
+  bool primed_ = false;
+  bool active_ = false;
+  uint16_t run_ = 0;             // Consecutive sound frames
+  uint16_t quiet_ = 0;           // Frames since the last sound frame while active
+  int64_t runStartUs_ = 0;
+  int64_t lastSoundEndUs_ = 0;
+  float runPeakDb_ = 0;
+  uint32_t frames_ = 0;
+  uint32_t soundFrames_ = 0;
+  uint32_t events_ = 0;
+  Features features_ = {};
+  Event event_ = {};
+
+  float window_[SAD_FRAME_SAMPLES];
+  float frame_[SAD_FRAME_SAMPLES];
+  float data_[SAD_FRAME_SAMPLES * 2];   // Interleaved complex spectrum
+  float power_[SAD_BINS];
+};
+
+}  // namespace sad
@@ -0,0 +1,92 @@
+#pragma once
+
+// ============================================
+// Audio level and spectrum telemetry
+// ============================================
+// Condenses the microphone stream into one small summary per period
+// (about a second): RMS and peak level, octave band levels and the
+// strongest tones. A remote check can see noise levels and hum or alarm
+// frequencies from a few hundred bytes a second instead of 256 kbit/s of
+// PCM.
+//
+// Samples are gathered into 1024-point frames (15.6 Hz bins at 16 kHz, fine
+// enough to resolve 50/60 Hz mains hum). Each frame is Hann-windowed and
+// transformed through fft.h, and the power spectra of a period are
+// averaged. Levels are dBFS, with a full-scale sine at 0 dBFS.
+//
+// No hardware access, so it builds on the host.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SPECTRUM_FFT_SIZE 1024
+#define SPECTRUM_BINS (SPECTRUM_FFT_SIZE / 2 + 1)
+#define SPECTRUM_BANDS 8          // Octaves centred on 63 Hz .. 8 kHz
+#define SPECTRUM_TONES 3
+#define SPECTRUM_MIN_DB -120.0f   // Reported for silence
+
+namespace spectrum {
+
+extern const uint16_t kBandCenterHz[SPECTRUM_BANDS];
+
+struct Tone {
+  float hz;      // Interpolated between bins
+  float dbfs;
+};
+
+struct Summary {
+  int64_t startUs;          // Capture time of the first sample
+  uint32_t durationMs;
+  float rmsDbfs;
+  float peakDbfs;           // Largest sample, 0 dBFS = 32767
+  float bandDbfs[SPECTRUM_BANDS];
+  Tone tones[SPECTRUM_TONES];   // Strongest first
+  uint8_t toneCount;
+};
+
+class Analyzer {
+ public:
+  // Summaries cover whole FFT frames, the fewest that span 'periodMs'
+  void begin(uint32_t sampleRate, uint32_t periodMs);
+
+  // Feed samples; 'timestampUs' is the capture time of pcm[0]. Returns true
+  // when a period has completed and summary() holds it.
+  bool process(const int16_t* pcm, size_t samples, int64_t timestampUs);
+
+  // Drop the partial period, e.g. after a gap in the audio
+  void reset();
+
+  const Summary& summary() const { return summary_; }
+
+ private:
+  void transform();
+  void finish();
+
+  uint32_t sampleRate_ = 16000;
+  uint16_t framesPerSummary_ = 1;
+  uint16_t bandLo_[SPECTRUM_BANDS];
+  uint16_t bandHi_[SPECTRUM_BANDS];   // Exclusive
+  float fullScale_ = 1;               // One-sided power of a full-scale sine
+
+  // Current period
+  size_t fill_ = 0;
+  uint16_t frames_ = 0;
+  int64_t periodStartUs_ = -1;
+  uint64_t sumSquares_ = 0;
+  uint32_t samples_ = 0;
+  int32_t peak_ = 0;
+
+  Summary summary_ = {};
+  float window_[SPECTRUM_FFT_SIZE];
+  float frame_[SPECTRUM_FFT_SIZE];
+  float data_[SPECTRUM_FFT_SIZE * 2];   // Interleaved complex spectrum
+  float power_[SPECTRUM_BINS];          // Summed over the period
+};
+
+// Compact JSON for /levels and /api/audio:
+//   {"t":<ms>,"ms":1024,"rms":-41.2,"peak":-22.0,
+//    "bands":[-60.1,...],"tones":[[50.0,-44.3],...]}
+// Returns the length, or 0 if it did not fit in 'cap'.
+size_t formatJson(char* out, size_t cap, const Summary& s);
+
+}  // namespace spectrum
@@ -0,0 +1,25 @@
+#pragma once
+
+// ============================================
+// /api/status document
+// ============================================
+// Formatted with snprintf into a caller buffer so the same code runs on the
+// device and in the host benchmark (bench.cpp).
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct StatusSnapshot {
+  uint32_t uptimeSeconds;
+  uint32_t freeHeap;
+  uint32_t sdFreeMB;
+  uint32_t sdTotalMB;
+  unsigned long frames;
+  unsigned long audioFiles;
+  float batteryVoltage;
+  int rssi;
+  const char* timestamp;    // getTimestamp(): "YYYYMMDD_HHMMSS" or millis before NTP
+};
+
+// Returns the document length, or 0 if it did not fit in 'cap'
+size_t formatStatusJson(char* out, size_t cap, const StatusSnapshot& s);
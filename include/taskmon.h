@@ -0,0 +1,54 @@
+#pragma once
+
+// ============================================
+// FreeRTOS task monitor
+// ============================================
+// A sampler task periodically snapshots every FreeRTOS task:
+// CPU share per core, stack high-water mark, priority, state and affinity.
+// Per-core idle hooks detect watchdog near-misses (an idle task starved for
+// more than half the task-watchdog timeout) and the task hogging that core.
+//
+// CPU percentages need configGENERATE_RUN_TIME_STATS; without it they are
+// reported as -1 and everything else still works.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TASKMON_MAX_TASKS 40             // Listed per snapshot; CPU load counts every task
+#define TASKMON_SAMPLE_INTERVAL_MS 1000
+#define TASKMON_STACK_LOW_BYTES 512     // Flag tasks with less headroom than this
+
+namespace taskmon {
+
+struct TaskInfo {
+  char name[16];
+  uint32_t stackFreeBytes;   // High-water mark (minimum ever free)
+  uint8_t priority;
+  char state;                // X running, R ready, B blocked, S suspended, D deleted
+  int8_t core;               // -1 = no affinity
+  int8_t cpuPercent;         // Share of one core over the last interval, -1 if unknown
+};
+
+struct Snapshot {
+  uint32_t takenAtMs;
+  uint32_t intervalMs;
+  uint8_t taskCount;
+  uint8_t tasksOmitted;      // Tasks beyond TASKMON_MAX_TASKS, not listed
+  int8_t coreLoad[2];        // Busy % per core, -1 if unknown
+  uint32_t watchdogNearMisses;
+  char lastNearMissTask[16]; // Busiest task on the starved core
+  int8_t lastNearMissCore;
+  uint32_t lowStackTasks;    // Tasks below TASKMON_STACK_LOW_BYTES
+  TaskInfo tasks[TASKMON_MAX_TASKS];
+};
+
+// Register idle hooks and start the sampler task
+bool begin();
+
+// Copy the latest snapshot; returns false before the first sample
+bool latest(Snapshot& out);
+
+// Task with the smallest stack headroom in 'snap' (nullptr if empty)
+const TaskInfo* tightestStack(const Snapshot& snap);
+
+}  // namespace taskmon
@@ -0,0 +1,99 @@
+#pragma once
+
+// ============================================
+// Event tracer (Chrome trace-event export)
+// ============================================
+// Begin/end/instant events with esp_timer microsecond timestamps, recorded
+// into one PSRAM ring buffer per core. Recording is a slot reservation
+// (one atomic add) plus a 24-byte store, so it stays well under 1 us.
+// Old events are overwritten; /api/trace downloads whatever is in the rings
+// as Chrome trace-event JSON (open in chrome://tracing or ui.perfetto.dev).
+//
+// Build with -DTRACE_ENABLED=0 to compile every TRACE_* macro out.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+#ifndef TRACE_EVENTS_PER_CORE
+#define TRACE_EVENTS_PER_CORE 8192   // 192 KB of PSRAM per core
+#endif
+
+#define TRACE_MAX_CORES 2
+#define TRACE_BENCH_EVENTS 256              // Scratch ring for benchmark()
+#define TRACE_BENCH_MAX_ITERATIONS 100000   // ~50 ms of begin/end pairs
+
+namespace tracer {
+
+enum Phase : uint8_t {
+  PHASE_BEGIN = 'B',
+  PHASE_END = 'E',
+  PHASE_INSTANT = 'i'
+};
+
+struct Event {
+  int64_t ts;          // esp_timer_get_time() microseconds
+  const char* name;    // Must be a string literal (pointer is stored)
+  uint32_t task;       // Task handle, exported as the Chrome tid
+  uint8_t phase;
+  uint8_t core;
+};
+
+// Allocate the per-core rings. Returns false if PSRAM is exhausted, in which
+// case recording stays disabled and the macros are cheap no-ops.
+bool begin();
+
+// Runtime switch; /api/trace pauses recording while it exports
+void setEnabled(bool enabled);
+bool enabled();
+
+// Drop every recorded event
+void clear();
+
+void record(const char* name, Phase phase);
+
+// Number of events currently held across all cores
+size_t eventCount();
+
+// Incremental Chrome JSON export. Fill 'buf' with at most 'maxLen' bytes,
+// advancing 'cursor'; returns 0 once the document is complete.
+struct ExportCursor {
+  uint8_t stage;       // 0 = header, 1 = events, 2 = footer, 3 = done
+  uint8_t core;
+  uint32_t index;      // Events emitted for 'core'
+  bool needComma;
+};
+size_t exportChunk(ExportCursor& cursor, char* buf, size_t maxLen);
+
+// Record 'iterations' begin/end pairs (at most TRACE_BENCH_MAX_ITERATIONS)
+// into a small scratch ring and return the mean cost per event in
+// nanoseconds. The recorded trace is left alone.
+uint32_t benchmark(uint32_t iterations);
+
+class Scope {
+ public:
+  explicit Scope(const char* name) : name_(name) { record(name_, PHASE_BEGIN); }
+  ~Scope() { record(name_, PHASE_END); }
+
+ private:
+  const char* name_;
+};
+
+}  // namespace tracer
+
+#if TRACE_ENABLED
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_BEGIN(name)   tracer::record(name, tracer::PHASE_BEGIN)
+#define TRACE_END(name)     tracer::record(name, tracer::PHASE_END)
+#define TRACE_INSTANT(name) tracer::record(name, tracer::PHASE_INSTANT)
+#define TRACE_SCOPE(name)   tracer::Scope TRACE_CONCAT(traceScope_, __LINE__)(name)
+#else
+#define TRACE_BEGIN(name)   do {} while (0)
+#define TRACE_END(name)     do {} while (0)
+#define TRACE_INSTANT(name) do {} while (0)
+#define TRACE_SCOPE(name)   do {} while (0)
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+
+// ============================================
+// Wi-Fi connection manager
+// ============================================
+// Non-blocking station connect/reconnect, driven by poll() from loop().
+// The BSSID and channel of the last good association are cached in
+// Preferences so the next connect goes straight to one channel instead of
+// scanning all of them. If that fails the manager falls back to a normal
+// scanning connect; failed scans back off exponentially. After a link loss
+// it reconnects on its own, fast path first.
+
+#include <stdint.h>
+
+#define WIFI_FAST_TIMEOUT_MS 3000     // One-channel association to the cached BSSID
+#define WIFI_SCAN_TIMEOUT_MS 12000    // Full scan + association + DHCP
+#define WIFI_BACKOFF_MIN_MS 500
+#define WIFI_BACKOFF_MAX_MS 30000
+#define WIFI_INITIAL_ATTEMPTS 3       // Scanning attempts before giving up on the first connect
+
+// 1 = also cache the DHCP lease and reuse it as a static IP, skipping DHCP
+// on the fast path. Only safe when the router reserves the address.
+#ifndef WIFI_REUSE_LEASE
+#define WIFI_REUSE_LEASE 0
+#endif
+
+namespace wifimgr {
+
+enum State {
+  WM_IDLE,
+  WM_FAST_CONNECT,    // Cached BSSID/channel
+  WM_SCAN_CONNECT,    // Full scan
+  WM_CONNECTED,
+  WM_BACKOFF,         // Waiting to retry
+  WM_FAILED           // Never connected within WIFI_INITIAL_ATTEMPTS
+};
+
+// Start connecting; returns immediately
+void begin(const char* ssid, const char* password);
+void stop();
+
+// Advance the state machine; call every loop() pass. Cheap when nothing
+// happened.
+State poll();
+
+State state();
+bool connected();
+const char* stateName(State s);
+
+// begin() or link loss to IP of the most recent connection
+uint32_t lastConnectMs();
+
+// Drop the cached BSSID/channel/lease (e.g. after moving the router)
+void forgetCache();
+
+}  // namespace wifimgr
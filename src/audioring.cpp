@@ -0,0 +1,147 @@
+#include "audioring.h"
+
+#include <string.h>
+
+namespace audioring {
+
+// ============================================
+// Producer
+// ============================================
+void Ring::commit(uint16_t samples, int64_t timestampUs) {
+  uint32_t head = head_.load(std::memory_order_relaxed);
+  Block& b = blocks_[head & mask_];
+  b.seq = head;
+  b.samples = samples;
+  b.timestampUs = timestampUs;
+  head_.store(head + 1, std::memory_order_release);
+}
+
+bool Ring::attach(Reader& reader, uint32_t backlog) {
+  bool registered = false;
+  for (size_t i = 0; i < readerCount(); i++) {
+    registered |= readers_[i].load(std::memory_order_relaxed) == &reader;
+  }
+  if (!registered) {
+    size_t slot = readerCount_.load(std::memory_order_relaxed);
+    do {
+      if (slot >= AUDIORING_MAX_READERS) {
+        return false;
+      }
+    } while (!readerCount_.compare_exchange_weak(slot, slot + 1, std::memory_order_acq_rel));
+    readers_[slot].store(&reader, std::memory_order_release);
+  }
+  uint32_t head = head_.load(std::memory_order_acquire);
+  uint32_t maxBacklog = (mask_ + 1) / 2;
+  if (backlog > maxBacklog) backlog = maxBacklog;
+  if (backlog > head) backlog = head;
+  reader.cursor_.store(head - backlog, std::memory_order_relaxed);
+  reader.ring_ = this;
+  return true;
+}
+
+void Ring::detach(Reader& reader) {
+  reader.ring_ = nullptr;
+}
+
+// ============================================
+// Readers
+// ============================================
+const Block* Reader::peek() {
+  Ring* ring = ring_;
+  if (!ring) {
+    return nullptr;
+  }
+  uint32_t head = ring->head_.load(std::memory_order_acquire);
+  uint32_t cursor = cursor_.load(std::memory_order_relaxed);
+  if (head == cursor) {
+    return nullptr;
+  }
+  uint32_t size = ring->mask_ + 1;
+  if (head - cursor >= size) {
+    // The slot under the cursor has been reused. Skip to half a ring behind
+    // the producer so there is room to catch up before it laps us again.
+    uint32_t resume = head - size / 2;
+    overruns_.fetch_add(resume - cursor, std::memory_order_relaxed);
+    cursor = resume;
+    cursor_.store(cursor, std::memory_order_relaxed);
+  }
+  return &ring->blocks_[cursor & ring->mask_];
+}
+
+bool Reader::release() {
+  Ring* ring = ring_;
+  if (!ring) {
+    return false;
+  }
+  bool ok = intact();
+  cursor_.store(cursor_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  if (ok) {
+    blocksRead_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    torn_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return ok;
+}
+
+bool Reader::intact() const {
+  Ring* ring = ring_;
+  if (!ring) {
+    return false;
+  }
+  // Everything read from the block happens before this check (seqlock)
+  std::atomic_thread_fence(std::memory_order_acquire);
+  uint32_t head = ring->head_.load(std::memory_order_acquire);
+  return head - cursor_.load(std::memory_order_relaxed) <= ring->mask_;
+}
+
+uint32_t Reader::lag() const {
+  Ring* ring = ring_;
+  return ring ? ring->head_.load(std::memory_order_relaxed) - cursor_.load(std::memory_order_relaxed) : 0;
+}
+
+// ============================================
+// Microphone adapter
+// ============================================
+#define RING_MIC_WAIT_MS 100   // Longest read() blocks with nothing captured
+
+size_t RingMicrophone::read(int16_t* samples, size_t maxSamples) {
+  if (!reader_.attached()) {
+    wait_(RING_MIC_WAIT_MS);
+    return 0;
+  }
+  size_t count = 0;
+  while (count < maxSamples) {
+    const Block* b = reader_.peek();
+    if (!b) {
+      // Return what we have; wait only when there is nothing at all
+      if (count || !wait_(RING_MIC_WAIT_MS)) {
+        break;
+      }
+      continue;
+    }
+    if (b->seq != offsetSeq_) {
+      offset_ = 0;   // New block, or the reader skipped ahead after an overrun
+      offsetSeq_ = b->seq;
+    }
+    size_t n = b->samples - offset_;
+    if (n > maxSamples - count) {
+      n = maxSamples - count;
+    }
+    memcpy(samples + count, b->pcm + offset_, n * sizeof(int16_t));
+    // Validate after copying (seqlock). A torn copy is dropped, not
+    // returned, and the next peek() resumes wherever the reader landed.
+    if (offset_ + n < b->samples && reader_.intact()) {
+      count += n;
+      offset_ += n;
+      continue;
+    }
+    if (reader_.release()) {
+      count += n;
+    }
+    offset_ = 0;
+    offsetSeq_++;
+  }
+  return count;
+}
+
+}  // namespace audioring
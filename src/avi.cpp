@@ -0,0 +1,152 @@
+#include "avi.h"
+
+#include <string.h>
+
+namespace avi {
+
+// Field offsets in the fixed header
+static const size_t kRiffSize = 4;
+static const size_t kAvihData = 32;      // MainAVIHeader
+static const size_t kStrhData = 108;     // AVIStreamHeader
+static const size_t kStrfData = 172;     // BITMAPINFOHEADER
+static const size_t kMoviList = 212;
+
+static const uint32_t AVIF_HASINDEX = 0x10;
+static const uint32_t AVIIF_KEYFRAME = 0x10;
+
+static inline void put16(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint32_t get32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void fourcc(uint8_t* p, const char* id) {
+  memcpy(p, id, 4);
+}
+
+static inline bool isFourcc(const uint8_t* p, const char* id) {
+  return memcmp(p, id, 4) == 0;
+}
+
+// ============================================
+// Header
+// ============================================
+void encodeHeader(uint8_t* out, const Info& info) {
+  memset(out, 0, AVI_HEADER_BYTES);
+  uint32_t fps = info.fps ? info.fps : 1;
+
+  fourcc(out, "RIFF");
+  put32(out + kRiffSize, fileBytes(info) - 8);
+  fourcc(out + 8, "AVI ");
+  fourcc(out + 12, "LIST");
+  put32(out + 16, kMoviList - 20);
+  fourcc(out + 20, "hdrl");
+
+  fourcc(out + 24, "avih");
+  put32(out + 28, 56);
+  uint8_t* avih = out + kAvihData;
+  put32(avih, 1000000 / fps);                      // dwMicroSecPerFrame
+  put32(avih + 4, info.maxFrameBytes * fps);       // dwMaxBytesPerSec
+  put32(avih + 12, info.indexBytes ? AVIF_HASINDEX : 0);
+  put32(avih + 16, info.frames);                   // dwTotalFrames
+  put32(avih + 24, 1);                             // dwStreams
+  put32(avih + 28, info.maxFrameBytes);            // dwSuggestedBufferSize
+  put32(avih + 32, info.width);
+  put32(avih + 36, info.height);
+
+  fourcc(out + 88, "LIST");
+  put32(out + 92, kMoviList - 96);
+  fourcc(out + 96, "strl");
+
+  fourcc(out + 100, "strh");
+  put32(out + 104, 56);
+  uint8_t* strh = out + kStrhData;
+  fourcc(strh, "vids");
+  fourcc(strh + 4, "MJPG");
+  put32(strh + 20, 1);                             // dwScale
+  put32(strh + 24, fps);                           // dwRate
+  put32(strh + 32, info.frames);                   // dwLength
+  put32(strh + 36, info.maxFrameBytes);            // dwSuggestedBufferSize
+  put32(strh + 40, 0xFFFFFFFF);                    // dwQuality: driver default
+  put16(strh + 52, info.width);                    // rcFrame.right
+  put16(strh + 54, info.height);                   // rcFrame.bottom
+
+  fourcc(out + 164, "strf");
+  put32(out + 168, 40);
+  uint8_t* strf = out + kStrfData;
+  put32(strf, 40);                                 // biSize
+  put32(strf + 4, info.width);
+  put32(strf + 8, info.height);
+  put16(strf + 12, 1);                             // biPlanes
+  put16(strf + 14, 24);                            // biBitCount
+  fourcc(strf + 16, "MJPG");
+  put32(strf + 20, (uint32_t)info.width * info.height * 3);
+
+  fourcc(out + kMoviList, "LIST");
+  put32(out + kMoviList + 4, 4 + info.moviBytes);
+  fourcc(out + kMoviList + 8, "movi");
+}
+
+bool parseHeader(const uint8_t* in, size_t len, Info& out) {
+  if (len < AVI_HEADER_BYTES || !isFourcc(in, "RIFF") || !isFourcc(in + 8, "AVI ") ||
+      !isFourcc(in + 20, "hdrl") || !isFourcc(in + 24, "avih") ||
+      !isFourcc(in + kStrhData + 4, "MJPG") || !isFourcc(in + kMoviList + 8, "movi")) {
+    return false;
+  }
+  const uint8_t* avih = in + kAvihData;
+  out.frames = get32(avih + 16);
+  out.maxFrameBytes = get32(avih + 28);
+  out.width = (uint16_t)get32(avih + 32);
+  out.height = (uint16_t)get32(avih + 36);
+  out.fps = get32(in + kStrhData + 24);
+  out.moviBytes = get32(in + kMoviList + 4) - 4;
+  uint32_t riffBytes = get32(in + kRiffSize) + 8;
+  if (riffBytes < AVI_HEADER_BYTES + out.moviBytes) {
+    return false;
+  }
+  out.indexBytes = riffBytes - AVI_HEADER_BYTES - out.moviBytes;
+  return true;
+}
+
+// ============================================
+// Frames and index
+// ============================================
+void encodeFrameHeader(uint8_t* out, uint32_t jpegBytes) {
+  fourcc(out, "00dc");
+  put32(out + 4, jpegBytes);
+}
+
+uint32_t addFrame(Info& info, uint32_t jpegBytes) {
+  uint32_t offset = 4 + info.moviBytes;
+  info.moviBytes += AVI_CHUNK_HEADER_BYTES + jpegBytes + (uint32_t)framePadding(jpegBytes);
+  info.frames++;
+  if (jpegBytes > info.maxFrameBytes) {
+    info.maxFrameBytes = jpegBytes;
+  }
+  return offset;
+}
+
+void encodeIndexEntry(uint8_t* out, uint32_t offset, uint32_t jpegBytes) {
+  fourcc(out, "00dc");
+  put32(out + 4, AVIIF_KEYFRAME);
+  put32(out + 8, offset);
+  put32(out + 12, jpegBytes);
+}
+
+void encodeIndexHeader(uint8_t* out, Info& info, uint32_t entries) {
+  fourcc(out, "idx1");
+  put32(out + 4, entries * AVI_INDEX_ENTRY_BYTES);
+  info.indexBytes = AVI_CHUNK_HEADER_BYTES + entries * AVI_INDEX_ENTRY_BYTES;
+}
+
+}  // namespace avi
@@ -0,0 +1,261 @@
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+#include "metrics.h"
+#include "statusjson.h"
+
+#if defined(ESP_PLATFORM)
+#include <xtensa/hal.h>
+static inline uint32_t cycleCount() { return xthal_get_ccount(); }
+#define BENCH_HAS_CYCLES 1
+#else
+static inline uint32_t cycleCount() { return 0; }
+#define BENCH_HAS_CYCLES 0
+#endif
+
+namespace bench {
+
+// ============================================
+// Stand-ins for the hardware the kernels don't exercise
+// ============================================
+// Hands out the same in-memory JPEG every time, so the MJPEG kernel
+// measures framing and copying only
+class MemoryCamera : public hal::Camera {
+ public:
+  MemoryCamera() : buf_(nullptr), len_(0) {}
+  void set(const uint8_t* buf, size_t len) { buf_ = buf; len_ = len; }
+  bool grab(hal::Frame& out) override {
+    out.buf = buf_;
+    out.len = len_;
+    out.width = 800;
+    out.height = 600;
+    out.timestampUs = 0;
+    out.handle = nullptr;
+    return buf_ != nullptr;
+  }
+  void release(hal::Frame& frame) override {}
+
+ private:
+  const uint8_t* buf_;
+  size_t len_;
+};
+
+class NullMicrophone : public hal::Microphone {
+ public:
+  size_t read(int16_t* samples, size_t maxSamples) override { return 0; }
+  uint32_t sampleRate() const override { return SAMPLE_RATE; }
+};
+
+class NullStorage : public hal::Storage {
+ public:
+  bool beginWrite(const char* path, uint32_t lockTimeoutMs) override { return false; }
+  size_t append(const uint8_t* data, size_t len) override { return 0; }
+  void endWrite() override {}
+  bool lastBeginTimedOut() const override { return false; }
+  bool remove(const char* path) override { return false; }
+  bool exists(const char* path) override { return false; }
+  bool mkdir(const char* path) override { return false; }
+  uint64_t totalBytes() override { return 0; }
+  uint64_t usedBytes() override { return 0; }
+};
+
+static hal::Clock* clock_ = nullptr;
+static AllocCountFn allocCounter = nullptr;
+static uint8_t* pcm = nullptr;
+static uint8_t* jpeg = nullptr;
+static uint8_t* chunk = nullptr;
+static MemoryCamera memoryCamera;
+static NullMicrophone nullMicrophone;
+static NullStorage nullStorage;
+
+// Keeps results observable so the optimiser can't drop the work
+static volatile uint32_t sink;
+
+// ============================================
+// Kernels
+// ============================================
+static size_t benchWavHeader(uint32_t iterations) {
+  uint8_t header[WAV_HEADER_SIZE];
+  for (uint32_t i = 0; i < iterations; i++) {
+    generate_wav_header(header, BENCH_PCM_BYTES + i, SAMPLE_RATE);
+    sink = header[4];
+  }
+  return WAV_HEADER_SIZE;
+}
+
+static size_t benchGain(uint32_t iterations) {
+  for (uint32_t i = 0; i < iterations; i++) {
+    apply_gain(pcm, BENCH_PCM_BYTES, VOLUME_GAIN);
+    sink = pcm[i % BENCH_PCM_BYTES];
+  }
+  return BENCH_PCM_BYTES;
+}
+
+static size_t benchMjpegFrame(uint32_t iterations) {
+  pipeline::MjpegStreamer streamer(memoryCamera, *clock_);
+  size_t bytes = 0;
+  for (uint32_t i = 0; i < iterations; i++) {
+    uint32_t target = streamer.framesSent() + 1;
+    bytes = 0;
+    while (streamer.framesSent() < target) {
+      size_t n = streamer.fill(chunk, BENCH_CHUNK_BYTES);
+      if (n == 0) {
+        return 0;
+      }
+      bytes += n;
+    }
+    sink = chunk[0];
+  }
+  return bytes;
+}
+
+static size_t benchFrameFilename(uint32_t iterations) {
+  pipeline::Recorder recorder(memoryCamera, nullMicrophone, nullStorage, *clock_);
+  char path[64];
+  for (uint32_t i = 0; i < iterations; i++) {
+    recorder.frameFilename(path, sizeof(path), i);
+    sink = (uint8_t)path[8];
+  }
+  return strlen(path);
+}
+
+static size_t benchStatusJson(uint32_t iterations) {
+  StatusSnapshot snap;
+  snap.uptimeSeconds = 86400;
+  snap.freeHeap = 187432;
+  snap.sdFreeMB = 28012;
+  snap.sdTotalMB = 30436;
+  snap.frames = 123456;
+  snap.audioFiles = 789;
+  snap.batteryVoltage = 3.87f;
+  snap.rssi = -61;
+  snap.timestamp = "20240115_143022";
+  char json[320];
+  size_t len = 0;
+  for (uint32_t i = 0; i < iterations; i++) {
+    snap.frames++;
+    len = formatStatusJson(json, sizeof(json), snap);
+    sink = (uint8_t)json[len / 2];
+  }
+  return len;
+}
+
+static void countBytes(void* ctx, const char* data, size_t len) {
+  *(size_t*)ctx += len;
+  sink = (uint8_t)data[0];
+}
+
+static size_t benchMetricsRender(uint32_t iterations) {
+  size_t bytes = 0;
+  for (uint32_t i = 0; i < iterations; i++) {
+    bytes = 0;
+    metrics::writePrometheus(countBytes, &bytes);
+  }
+  return bytes;
+}
+
+static size_t logBytes = 0;
+
+static void countLogBytes(const char* line, size_t len) {
+  logBytes = len;
+  sink = (uint8_t)line[len / 2];
+}
+
+// One per-frame log line through the async ring and out of the drain side.
+// Output from other tasks is swallowed while this runs.
+static size_t benchLogLine(uint32_t iterations) {
+  logger::WriteFn previous = logger::setSink(countLogBytes);
+  for (uint32_t i = 0; i < iterations; i++) {
+    logger::log(logger::LEVEL_INFO, "✓ Frame %lu saved to %s (%u bytes)", (unsigned long)i,
+                "/video/20240115_143022_frame_000123.jpg", (unsigned)BENCH_FRAME_BYTES);
+    logger::drain();
+  }
+  logger::setSink(previous);
+  return logBytes;
+}
+
+static const Kernel kKernels[] = {
+  {"wav_header", benchWavHeader},
+  {"apply_gain_1s", benchGain},
+  {"mjpeg_frame_40k", benchMjpegFrame},
+  {"frame_filename", benchFrameFilename},
+  {"status_json", benchStatusJson},
+  {"metrics_render", benchMetricsRender},
+  {"log_line", benchLogLine},
+};
+
+// ============================================
+// Harness
+// ============================================
+void setAllocCounter(AllocCountFn fn) {
+  allocCounter = fn;
+}
+
+bool begin(hal::Clock& clock) {
+  clock_ = &clock;
+  pcm = (uint8_t*)malloc(BENCH_PCM_BYTES);
+  jpeg = (uint8_t*)malloc(BENCH_FRAME_BYTES);
+  chunk = (uint8_t*)malloc(BENCH_CHUNK_BYTES);
+  if (!pcm || !jpeg || !chunk) {
+    end();
+    return false;
+  }
+  for (size_t i = 0; i < BENCH_PCM_BYTES; i++) {
+    pcm[i] = (uint8_t)(i * 31);
+  }
+  memset(jpeg, 0x5A, BENCH_FRAME_BYTES);
+  jpeg[0] = 0xFF; jpeg[1] = 0xD8;
+  jpeg[BENCH_FRAME_BYTES - 2] = 0xFF; jpeg[BENCH_FRAME_BYTES - 1] = 0xD9;
+  memoryCamera.set(jpeg, BENCH_FRAME_BYTES);
+  return true;
+}
+
+void end() {
+  memoryCamera.set(nullptr, 0);
+  free(pcm);
+  free(jpeg);
+  free(chunk);
+  pcm = jpeg = chunk = nullptr;
+}
+
+size_t kernelCount() {
+  return sizeof(kKernels) / sizeof(kKernels[0]);
+}
+
+const Kernel& kernel(size_t index) {
+  return kKernels[index];
+}
+
+Result run(size_t index, uint32_t minTimeUs) {
+  const Kernel& k = kKernels[index];
+  Result r;
+  memset(&r, 0, sizeof(r));
+  r.name = k.name;
+  r.allocsCounted = allocCounter != nullptr;
+
+  k.run(1);  // Warm caches and any lazy initialisation
+  for (uint32_t iterations = 1;; iterations *= 2) {
+    uint64_t allocsBefore = allocCounter ? allocCounter() : 0;
+    uint32_t cyclesBefore = cycleCount();
+    int64_t start = clock_->micros();
+    size_t bytes = k.run(iterations);
+    int64_t elapsedUs = clock_->micros() - start;
+    uint32_t cycles = cycleCount() - cyclesBefore;
+    uint64_t allocsAfter = allocCounter ? allocCounter() : 0;
+
+    if (elapsedUs >= (int64_t)minTimeUs || iterations >= (1U << 30)) {
+      r.iterations = iterations;
+      r.elapsedNs = (uint64_t)elapsedUs * 1000;
+      // The 32-bit cycle counter wraps every ~18 s at 240 MHz; runs are far shorter
+      r.cycles = BENCH_HAS_CYCLES ? cycles : 0;
+      r.allocs = allocsAfter - allocsBefore;
+      r.bytesPerOp = bytes;
+      return r;
+    }
+  }
+}
+
+}  // namespace bench
@@ -0,0 +1,223 @@
+#include "bleproto.h"
+
+#include <string.h>
+
+namespace bleproto {
+
+static const size_t kHeaderBytes = 4;          // magic, version, type, count/seq
+static const size_t kStatusHeaderBytes = 5;    // + flags
+static const size_t kCommandHeaderBytes = 4;   // request id (2), opcode, length
+static const size_t kAckBytes = 4;             // request id (2), opcode, result
+
+static inline void put16(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint16_t get16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+bool isFrame(const uint8_t* data, size_t len) {
+  return len >= kHeaderBytes && data[0] == BLEPROTO_MAGIC;
+}
+
+// ============================================
+// Requests
+// ============================================
+Result parseRequest(const uint8_t* data, size_t len, Command* out, size_t max, size_t& count) {
+  count = 0;
+  if (!isFrame(data, len) || data[2] != FRAME_REQUEST) {
+    return RESULT_MALFORMED;
+  }
+  if (data[1] != BLEPROTO_VERSION) {
+    return RESULT_BAD_VERSION;
+  }
+  size_t n = data[3];
+  if (n == 0 || n > max) {
+    return RESULT_MALFORMED;
+  }
+  size_t pos = kHeaderBytes;
+  for (size_t i = 0; i < n; i++) {
+    if (pos + kCommandHeaderBytes > len) {
+      return RESULT_MALFORMED;
+    }
+    Command& c = out[i];
+    c.requestId = get16(data + pos);
+    c.opcode = data[pos + 2];
+    c.length = data[pos + 3];
+    pos += kCommandHeaderBytes;
+    if (pos + c.length > len) {
+      return RESULT_MALFORMED;
+    }
+    c.payload = data + pos;
+    pos += c.length;
+  }
+  if (pos != len) {
+    return RESULT_MALFORMED;   // Trailing bytes: count and payloads disagree
+  }
+  count = n;
+  return RESULT_OK;
+}
+
+RequestWriter::RequestWriter(uint8_t* buf, size_t cap) : buf_(buf), cap_(cap), len_(0) {
+  if (cap_ >= kHeaderBytes) {
+    buf_[0] = BLEPROTO_MAGIC;
+    buf_[1] = BLEPROTO_VERSION;
+    buf_[2] = FRAME_REQUEST;
+    buf_[3] = 0;
+    len_ = kHeaderBytes;
+  }
+}
+
+bool RequestWriter::add(uint16_t requestId, uint8_t opcode, const uint8_t* payload, uint8_t length) {
+  if (len_ == 0 || buf_[3] >= BLEPROTO_MAX_BATCH || len_ + kCommandHeaderBytes + length > cap_) {
+    return false;
+  }
+  put16(buf_ + len_, requestId);
+  buf_[len_ + 2] = opcode;
+  buf_[len_ + 3] = length;
+  if (length) {
+    memcpy(buf_ + len_ + kCommandHeaderBytes, payload, length);
+  }
+  len_ += kCommandHeaderBytes + length;
+  buf_[3]++;
+  return true;
+}
+
+// ============================================
+// Acks
+// ============================================
+size_t encodeAcks(uint8_t* out, size_t cap, const Ack* acks, size_t count, size_t& consumed) {
+  consumed = 0;
+  if (cap < kHeaderBytes + kAckBytes) {
+    return 0;
+  }
+  size_t n = (cap - kHeaderBytes) / kAckBytes;
+  if (n > count) {
+    n = count;
+  }
+  if (n > 255) {
+    n = 255;
+  }
+  out[0] = BLEPROTO_MAGIC;
+  out[1] = BLEPROTO_VERSION;
+  out[2] = FRAME_ACK;
+  out[3] = (uint8_t)n;
+  uint8_t* p = out + kHeaderBytes;
+  for (size_t i = 0; i < n; i++, p += kAckBytes) {
+    put16(p, acks[i].requestId);
+    p[2] = acks[i].opcode;
+    p[3] = acks[i].result;
+  }
+  consumed = n;
+  return kHeaderBytes + n * kAckBytes;
+}
+
+// ============================================
+// Status
+// ============================================
+uint32_t changedTags(const StatusRecord& a, const StatusRecord& b) {
+  uint32_t mask = 0;
+  if (a.recording != b.recording) mask |= BLEPROTO_TAG_BIT(TAG_RECORDING);
+  if (a.mode != b.mode) mask |= BLEPROTO_TAG_BIT(TAG_MODE);
+  if (a.state != b.state) mask |= BLEPROTO_TAG_BIT(TAG_STATE);
+  if (a.usb != b.usb) mask |= BLEPROTO_TAG_BIT(TAG_USB);
+  if (a.wifi != b.wifi) mask |= BLEPROTO_TAG_BIT(TAG_WIFI);
+  if (a.frames != b.frames) mask |= BLEPROTO_TAG_BIT(TAG_FRAMES);
+  if (a.audioFiles != b.audioFiles) mask |= BLEPROTO_TAG_BIT(TAG_AUDIO_FILES);
+  if (a.batteryMv != b.batteryMv) mask |= BLEPROTO_TAG_BIT(TAG_BATTERY_MV);
+  if (a.sdFreeMB != b.sdFreeMB) mask |= BLEPROTO_TAG_BIT(TAG_SD_FREE_MB);
+  if (a.mtu != b.mtu) mask |= BLEPROTO_TAG_BIT(TAG_MTU);
+  return mask;
+}
+
+void applyTags(StatusRecord& dst, const StatusRecord& src, uint32_t tags) {
+  if (tags & BLEPROTO_TAG_BIT(TAG_RECORDING)) dst.recording = src.recording;
+  if (tags & BLEPROTO_TAG_BIT(TAG_MODE)) dst.mode = src.mode;
+  if (tags & BLEPROTO_TAG_BIT(TAG_STATE)) dst.state = src.state;
+  if (tags & BLEPROTO_TAG_BIT(TAG_USB)) dst.usb = src.usb;
+  if (tags & BLEPROTO_TAG_BIT(TAG_WIFI)) dst.wifi = src.wifi;
+  if (tags & BLEPROTO_TAG_BIT(TAG_FRAMES)) dst.frames = src.frames;
+  if (tags & BLEPROTO_TAG_BIT(TAG_AUDIO_FILES)) dst.audioFiles = src.audioFiles;
+  if (tags & BLEPROTO_TAG_BIT(TAG_BATTERY_MV)) dst.batteryMv = src.batteryMv;
+  if (tags & BLEPROTO_TAG_BIT(TAG_SD_FREE_MB)) dst.sdFreeMB = src.sdFreeMB;
+  if (tags & BLEPROTO_TAG_BIT(TAG_UPTIME_S)) dst.uptimeSec = src.uptimeSec;
+  if (tags & BLEPROTO_TAG_BIT(TAG_MTU)) dst.mtu = src.mtu;
+}
+
+// Value width of each tag; 0 for unknown tags
+static uint8_t tagWidth(uint8_t tag) {
+  switch (tag) {
+    case TAG_RECORDING:
+    case TAG_MODE:
+    case TAG_STATE:
+    case TAG_USB:
+    case TAG_WIFI:
+      return 1;
+    case TAG_BATTERY_MV:
+    case TAG_MTU:
+      return 2;
+    case TAG_FRAMES:
+    case TAG_AUDIO_FILES:
+    case TAG_SD_FREE_MB:
+    case TAG_UPTIME_S:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+static void putTagValue(uint8_t* p, uint8_t tag, const StatusRecord& r) {
+  switch (tag) {
+    case TAG_RECORDING:   p[0] = r.recording; break;
+    case TAG_MODE:        p[0] = r.mode; break;
+    case TAG_STATE:       p[0] = r.state; break;
+    case TAG_USB:         p[0] = r.usb; break;
+    case TAG_WIFI:        p[0] = r.wifi; break;
+    case TAG_FRAMES:      put32(p, r.frames); break;
+    case TAG_AUDIO_FILES: put32(p, r.audioFiles); break;
+    case TAG_BATTERY_MV:  put16(p, r.batteryMv); break;
+    case TAG_SD_FREE_MB:  put32(p, r.sdFreeMB); break;
+    case TAG_UPTIME_S:    put32(p, r.uptimeSec); break;
+    case TAG_MTU:         put16(p, r.mtu); break;
+  }
+}
+
+size_t encodeStatus(uint8_t* out, size_t cap, const StatusRecord& record, uint32_t& tags,
+                    uint8_t seq, bool full) {
+  if (cap < kStatusHeaderBytes) {
+    return 0;
+  }
+  out[0] = BLEPROTO_MAGIC;
+  out[1] = BLEPROTO_VERSION;
+  out[2] = FRAME_STATUS;
+  out[3] = seq;
+  size_t pos = kStatusHeaderBytes;
+  for (uint8_t tag = 1; tag <= TAG_MAX; tag++) {
+    if (!(tags & BLEPROTO_TAG_BIT(tag))) {
+      continue;
+    }
+    uint8_t width = tagWidth(tag);
+    if (pos + 2 + width > cap) {
+      break;
+    }
+    out[pos] = tag;
+    out[pos + 1] = width;
+    putTagValue(out + pos + 2, tag, record);
+    pos += 2 + width;
+    tags &= ~BLEPROTO_TAG_BIT(tag);
+  }
+  tags &= BLEPROTO_ALL_TAGS;
+  out[4] = (full ? BLEPROTO_STATUS_FULL : 0) | (tags ? BLEPROTO_STATUS_MORE : 0);
+  return pos;
+}
+
+}  // namespace bleproto
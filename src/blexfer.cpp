@@ -0,0 +1,234 @@
+#include "blexfer.h"
+#include "bleproto.h"
+
+#include <string.h>
+
+namespace blexfer {
+
+static const size_t kHeaderBytes = 3;   // magic, version, op
+
+static inline void put16(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint32_t get32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static size_t header(uint8_t* out, uint8_t op) {
+  out[0] = BLEPROTO_MAGIC;
+  out[1] = BLEPROTO_VERSION;
+  out[2] = op;
+  return kHeaderBytes;
+}
+
+// ============================================
+// Control frames
+// ============================================
+bool parseRequest(const uint8_t* data, size_t len, Request& out) {
+  if (len < kHeaderBytes || data[0] != BLEPROTO_MAGIC || data[1] != BLEPROTO_VERSION) {
+    return false;
+  }
+  memset(&out, 0, sizeof(out));
+  out.op = data[2];
+  const uint8_t* body = data + kHeaderBytes;
+  size_t bodyLength = len - kHeaderBytes;
+  switch (out.op) {
+    case XOP_OPEN:
+      if (bodyLength < 6) {
+        return false;
+      }
+      out.offset = get32(body);
+      out.window = body[4];
+      out.path = (const char*)body + 5;
+      out.pathLength = bodyLength - 5;
+      return out.window > 0;
+    case XOP_ACK:
+      if (bodyLength != 4) {
+        return false;
+      }
+      out.offset = get32(body);
+      return true;
+    case XOP_NACK:
+      if (bodyLength == 0 || bodyLength % 4 || bodyLength / 4 > BLEXFER_MAX_NACKS) {
+        return false;
+      }
+      out.nacks = body;
+      out.nackCount = bodyLength / 4;
+      return true;
+    case XOP_CANCEL:
+      return bodyLength == 0;
+    default:
+      return false;
+  }
+}
+
+uint32_t nackOffset(const Request& r, size_t i) {
+  return get32(r.nacks + i * 4);
+}
+
+size_t encodeOpened(uint8_t* out, uint32_t size, uint32_t offset, uint16_t chunk, uint8_t window) {
+  size_t n = header(out, XEV_OPENED);
+  put32(out + n, size);
+  put32(out + n + 4, offset);
+  put16(out + n + 8, chunk);
+  out[n + 10] = window;
+  return n + 11;
+}
+
+size_t encodeDone(uint8_t* out, uint32_t bytes, uint32_t ms, uint32_t retransmits, uint32_t stalls) {
+  size_t n = header(out, XEV_DONE);
+  put32(out + n, bytes);
+  put32(out + n + 4, ms);
+  put32(out + n + 8, ms ? (uint32_t)((uint64_t)bytes * 1000 / ms) : 0);
+  put32(out + n + 12, retransmits);
+  put32(out + n + 16, stalls);
+  return n + 20;
+}
+
+size_t encodeError(uint8_t* out, Error error) {
+  size_t n = header(out, XEV_ERROR);
+  out[n] = error;
+  return n + 1;
+}
+
+static bool underDirectory(const char* path, const char* dir) {
+  size_t n = strlen(dir);
+  return strncmp(path, dir, n) == 0 && (path[n] == '\0' || path[n] == '/');
+}
+
+bool pathAllowed(const char* path) {
+  if (!underDirectory(path, "/video") && !underDirectory(path, "/audio")) {
+    return false;
+  }
+  // Only a ".." component climbs; names like "..hidden.jpg" are fine
+  for (const char* p = strstr(path, "/.."); p; p = strstr(p + 1, "/..")) {
+    if (p[3] == '/' || p[3] == '\0') {
+      return false;
+    }
+  }
+  return true;
+}
+
+// ============================================
+// Window
+// ============================================
+void Window::begin(uint32_t size, uint32_t start, uint16_t chunk, uint8_t window) {
+  size_ = size;
+  start_ = start;
+  acked_ = start;
+  next_ = start;
+  chunk_ = chunk;
+  windowBytes_ = (uint32_t)window * chunk;
+  queued_ = 0;
+  retransmits_ = 0;
+}
+
+bool Window::next(uint32_t& offset, uint16_t& length) {
+  while (queued_) {
+    uint32_t o = retransmitQueue_[0];
+    queued_--;
+    memmove(retransmitQueue_, retransmitQueue_ + 1, queued_ * sizeof(retransmitQueue_[0]));
+    if (o < acked_) {
+      continue;   // Acked since it was queued
+    }
+    offset = o;
+    length = (uint16_t)(size_ - o < chunk_ ? size_ - o : chunk_);
+    retransmits_++;
+    return true;
+  }
+  if (next_ >= size_ || next_ - acked_ >= windowBytes_) {
+    return false;
+  }
+  offset = next_;
+  length = (uint16_t)(size_ - next_ < chunk_ ? size_ - next_ : chunk_);
+  next_ += length;
+  return true;
+}
+
+void Window::ack(uint32_t offset) {
+  if (offset > next_) {
+    offset = next_;   // Can't hold what hasn't been sent
+  }
+  if (offset > acked_) {
+    acked_ = offset;
+  }
+}
+
+bool Window::nack(uint32_t offset) {
+  if (offset < acked_ || offset >= next_ || (offset - start_) % chunk_ != 0 ||
+      queued_ >= BLEXFER_MAX_NACKS) {
+    return false;
+  }
+  for (uint8_t i = 0; i < queued_; i++) {
+    if (retransmitQueue_[i] == offset) {
+      return true;
+    }
+  }
+  retransmitQueue_[queued_++] = offset;
+  return true;
+}
+
+void Window::timeout() {
+  if (acked_ < next_) {
+    nack(acked_);
+  }
+}
+
+// ============================================
+// ReadAhead
+// ============================================
+void ReadAhead::reset(uint8_t* buf, size_t capacity, uint32_t offset) {
+  buf_ = buf;
+  capacity_ = capacity;
+  head_.store(offset, std::memory_order_release);
+  tail_.store(offset, std::memory_order_release);
+}
+
+size_t ReadAhead::writable(uint32_t& offset, uint8_t*& ptr) const {
+  uint32_t t = tail_.load(std::memory_order_relaxed);
+  uint32_t h = head_.load(std::memory_order_acquire);
+  size_t free = capacity_ - (t - h);
+  size_t pos = t & (capacity_ - 1);
+  size_t contiguous = capacity_ - pos;
+  offset = t;
+  ptr = buf_ + pos;
+  return free < contiguous ? free : contiguous;
+}
+
+void ReadAhead::commit(size_t n) {
+  tail_.store(tail_.load(std::memory_order_relaxed) + (uint32_t)n, std::memory_order_release);
+}
+
+bool ReadAhead::copy(uint32_t offset, uint8_t* out, size_t len) const {
+  uint32_t h = head_.load(std::memory_order_relaxed);
+  uint32_t t = tail_.load(std::memory_order_acquire);
+  if (offset < h || offset + len > t) {
+    return false;
+  }
+  size_t pos = offset & (capacity_ - 1);
+  size_t first = capacity_ - pos < len ? capacity_ - pos : len;
+  memcpy(out, buf_ + pos, first);
+  memcpy(out + first, buf_, len - first);
+  return true;
+}
+
+void ReadAhead::release(uint32_t offset) {
+  uint32_t t = tail_.load(std::memory_order_acquire);
+  if (offset > t) {
+    offset = t;
+  }
+  if (offset > head_.load(std::memory_order_relaxed)) {
+    head_.store(offset, std::memory_order_release);
+  }
+}
+
+}  // namespace blexfer
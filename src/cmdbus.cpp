@@ -0,0 +1,106 @@
+#include "cmdbus.h"
+
+#include <atomic>
+
+#include "esp_timer.h"
+#include "metrics.h"
+
+namespace cmdbus {
+
+static std::atomic<uint16_t> nextSeq(1);
+
+static TickType_t toTicks(uint32_t timeoutMs) {
+  return timeoutMs == CMDBUS_FOREVER ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+}
+
+// Completion ring, newest at recentHead - 1
+static Completion recentRing[CMDBUS_RECENT];
+static size_t recentHead = 0;
+static size_t recentCount = 0;
+static portMUX_TYPE recentLock = portMUX_INITIALIZER_UNLOCKED;
+
+bool Bus::begin(size_t depth) {
+  if (!queue_) {
+    queue_ = xQueueCreate(depth, sizeof(Command));
+  }
+  return queue_ != nullptr;
+}
+
+bool Bus::post(Type type, uint32_t arg, uint32_t arg2) {
+  Command cmd;
+  cmd.type = type;
+  cmd.seq = nextSeq.fetch_add(1, std::memory_order_relaxed);
+  cmd.arg = arg;
+  cmd.arg2 = arg2;
+  cmd.postedUs = esp_timer_get_time();
+  cmd.startedUs = 0;
+  if (!queue_ || xQueueSend(queue_, &cmd, 0) != pdTRUE) {
+    metrics::commandsDropped.inc();
+    return false;
+  }
+  return true;
+}
+
+bool Bus::receive(Command& cmd, uint32_t timeoutMs) {
+  if (!queue_ || xQueueReceive(queue_, &cmd, toTicks(timeoutMs)) != pdTRUE) {
+    return false;
+  }
+  cmd.startedUs = esp_timer_get_time();
+  return true;
+}
+
+bool Bus::wait(uint32_t timeoutMs) {
+  Command head;
+  return queue_ && xQueuePeek(queue_, &head, toTicks(timeoutMs)) == pdTRUE;
+}
+
+size_t Bus::pending() const {
+  return queue_ ? uxQueueMessagesWaiting(queue_) : 0;
+}
+
+void complete(Command& cmd, bleproto::Result result) {
+  int64_t now = esp_timer_get_time();
+  Completion c;
+  c.type = cmd.type;
+  c.seq = cmd.seq;
+  c.result = result;
+  c.queuedUs = (uint32_t)((cmd.startedUs ? cmd.startedUs : now) - cmd.postedUs);
+  c.totalUs = (uint32_t)(now - cmd.postedUs);
+  c.completedMs = (uint32_t)(now / 1000);
+  metrics::commandLatency.observe(c.totalUs);
+  metrics::commandsCompleted.inc();
+
+  portENTER_CRITICAL(&recentLock);
+  recentRing[recentHead] = c;
+  recentHead = (recentHead + 1) % CMDBUS_RECENT;
+  if (recentCount < CMDBUS_RECENT) {
+    recentCount++;
+  }
+  portEXIT_CRITICAL(&recentLock);
+}
+
+const char* typeName(Type type) {
+  switch (type) {
+    case CMD_START:        return "start";
+    case CMD_STOP:         return "stop";
+    case CMD_LIST:         return "list";
+    case CMD_WIFI:         return "wifi";
+    case CMD_BENCH:        return "bench";
+    case CMD_DUTY_CYCLE:   return "duty_cycle";
+    case CMD_POWER_TARGET: return "power_target";
+    case CMD_USB:          return "usb";
+    default:               return "?";
+  }
+}
+
+size_t recent(Completion* out, size_t max) {
+  portENTER_CRITICAL(&recentLock);
+  size_t n = recentCount < max ? recentCount : max;
+  for (size_t i = 0; i < n; i++) {
+    out[i] = recentRing[(recentHead + CMDBUS_RECENT - 1 - i) % CMDBUS_RECENT];
+  }
+  portEXIT_CRITICAL(&recentLock);
+  return n;
+}
+
+}  // namespace cmdbus
@@ -0,0 +1,110 @@
+#include "fft.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(ESP_PLATFORM) && __has_include("esp_dsp.h")
+#include "esp_dsp.h"
+#define FFT_USE_ESP_DSP 1
+#else
+#define FFT_USE_ESP_DSP 0
+#endif
+
+namespace fft {
+
+static bool ready = false;
+
+#if FFT_USE_ESP_DSP
+
+bool begin() {
+  if (!ready) {
+    ready = dsps_fft2r_init_fc32(NULL, FFT_MAX_SIZE) == ESP_OK;
+  }
+  return ready;
+}
+
+bool accelerated() {
+  return true;
+}
+
+void windowReal(const float* x, const float* w, float* data, size_t n) {
+  memset(data, 0, n * 2 * sizeof(float));
+  dsps_mul_f32(x, w, data, (int)n, 1, 1, 2);
+}
+
+void forward(float* data, size_t n) {
+  dsps_fft2r_fc32(data, (int)n);
+  dsps_bit_rev_fc32(data, (int)n);
+}
+
+#else
+
+static float cosTable[FFT_MAX_SIZE / 2];
+static float sinTable[FFT_MAX_SIZE / 2];
+
+bool begin() {
+  if (!ready) {
+    for (int i = 0; i < FFT_MAX_SIZE / 2; i++) {
+      cosTable[i] = cosf(2.0f * (float)M_PI * i / FFT_MAX_SIZE);
+      sinTable[i] = -sinf(2.0f * (float)M_PI * i / FFT_MAX_SIZE);
+    }
+    ready = true;
+  }
+  return true;
+}
+
+bool accelerated() {
+  return false;
+}
+
+void windowReal(const float* x, const float* w, float* data, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    data[2 * i] = x[i] * w[i];
+    data[2 * i + 1] = 0.0f;
+  }
+}
+
+void forward(float* data, size_t n) {
+  for (size_t i = 1, j = 0; i < n; i++) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j |= bit;
+    if (i < j) {
+      float t = data[2 * i]; data[2 * i] = data[2 * j]; data[2 * j] = t;
+      t = data[2 * i + 1]; data[2 * i + 1] = data[2 * j + 1]; data[2 * j + 1] = t;
+    }
+  }
+  for (size_t len = 2; len <= n; len <<= 1) {
+    const size_t half = len >> 1;
+    const size_t step = FFT_MAX_SIZE / len;
+    for (size_t start = 0; start < n; start += len) {
+      for (size_t k = 0; k < half; k++) {
+        const float wr = cosTable[k * step];
+        const float wi = sinTable[k * step];
+        float* a = &data[2 * (start + k)];
+        float* b = &data[2 * (start + k + half)];
+        const float tr = b[0] * wr - b[1] * wi;
+        const float ti = b[0] * wi + b[1] * wr;
+        b[0] = a[0] - tr;
+        b[1] = a[1] - ti;
+        a[0] += tr;
+        a[1] += ti;
+      }
+    }
+  }
+}
+
+#endif
+
+float hann(float* w, size_t n) {
+  float power = 0;
+  for (size_t i = 0; i < n; i++) {
+    w[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / n);
+    power += w[i] * w[i];
+  }
+  return power;
+}
+
+}  // namespace fft
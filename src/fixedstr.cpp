@@ -0,0 +1,175 @@
+#include "fixedstr.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// ============================================
+// StringWriter
+// ============================================
+StringWriter& StringWriter::append(const char* s, size_t n) {
+  size_t room = cap_ - 1 - len_;
+  if (n > room) {
+    n = room;
+    truncated_ = true;
+  }
+  memcpy(buf_ + len_, s, n);
+  len_ += n;
+  buf_[len_] = '\0';
+  return *this;
+}
+
+StringWriter& StringWriter::append(const char* s) {
+  return append(s, strlen(s));
+}
+
+StringWriter& StringWriter::append(char c) {
+  return append(&c, 1);
+}
+
+StringWriter& StringWriter::appendUint(uint64_t v) {
+  char digits[20];
+  size_t n = 0;
+  do {
+    digits[sizeof(digits) - 1 - n++] = (char)('0' + v % 10);
+    v /= 10;
+  } while (v);
+  return append(digits + sizeof(digits) - n, n);
+}
+
+StringWriter& StringWriter::appendInt(int64_t v) {
+  if (v < 0) {
+    append('-');
+    return appendUint((uint64_t)0 - (uint64_t)v);
+  }
+  return appendUint((uint64_t)v);
+}
+
+StringWriter& StringWriter::appendf(const char* fmt, ...) {
+  size_t room = cap_ - len_;
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(buf_ + len_, room, fmt, args);
+  va_end(args);
+  if (n < 0) {
+    buf_[len_] = '\0';
+  } else if ((size_t)n >= room) {
+    len_ = cap_ - 1;
+    truncated_ = true;
+  } else {
+    len_ += n;
+  }
+  return *this;
+}
+
+// ============================================
+// JsonWriter
+// ============================================
+void JsonWriter::quoted(const char* s) {
+  out_.append('"');
+  for (; *s; s++) {
+    char c = *s;
+    if (c == '"' || c == '\\') {
+      out_.append('\\').append(c);
+    } else if ((unsigned char)c < 0x20) {
+      out_.appendf("\\u%04x", (unsigned)c);
+    } else {
+      out_.append(c);
+    }
+  }
+  out_.append('"');
+}
+
+void JsonWriter::prefix(const char* key) {
+  if (!first_[depth_]) {
+    out_.append(',');
+  }
+  first_[depth_] = false;
+  if (key) {
+    quoted(key);
+    out_.append(':');
+  }
+}
+
+JsonWriter& JsonWriter::beginObject(const char* key) {
+  prefix(key);
+  out_.append('{');
+  if (depth_ < JSON_MAX_DEPTH) {
+    first_[++depth_] = true;
+  }
+  return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+  out_.append('}');
+  if (depth_ > 0) {
+    depth_--;
+  }
+  return *this;
+}
+
+JsonWriter& JsonWriter::beginArray(const char* key) {
+  prefix(key);
+  out_.append('[');
+  if (depth_ < JSON_MAX_DEPTH) {
+    first_[++depth_] = true;
+  }
+  return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+  out_.append(']');
+  if (depth_ > 0) {
+    depth_--;
+  }
+  return *this;
+}
+
+JsonWriter& JsonWriter::str(const char* key, const char* value) {
+  prefix(key);
+  quoted(value ? value : "");
+  return *this;
+}
+
+JsonWriter& JsonWriter::num(const char* key, int64_t value) {
+  prefix(key);
+  out_.appendInt(value);
+  return *this;
+}
+
+JsonWriter& JsonWriter::boolean(const char* key, bool value) {
+  prefix(key);
+  out_.append(value ? "true" : "false");
+  return *this;
+}
+
+JsonWriter& JsonWriter::fixed(const char* key, int64_t value, uint8_t decimals) {
+  prefix(key);
+  uint64_t mag = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+  uint64_t scale = 1;
+  for (uint8_t i = 0; i < decimals; i++) {
+    scale *= 10;
+  }
+  if (value < 0) {
+    out_.append('-');
+  }
+  out_.appendUint(mag / scale);
+  if (decimals) {
+    out_.append('.');
+    for (uint64_t d = scale / 10; d; d /= 10) {
+      out_.append((char)('0' + mag % scale / d % 10));
+    }
+  }
+  return *this;
+}
+
+JsonWriter& JsonWriter::null(const char* key) {
+  prefix(key);
+  out_.append("null");
+  return *this;
+}
+
+JsonWriter& JsonWriter::raw(const char* key, const char* json, size_t len) {
+  prefix(key);
+  out_.append(json, len);
+  return *this;
+}
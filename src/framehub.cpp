@@ -0,0 +1,159 @@
+#include "framehub.h"
+
+#if defined(ESP_PLATFORM)
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace framehub {
+
+// ============================================
+// Lock and publish signal
+// ============================================
+// On the device the signal is an event bit: publish() sets it, waking every
+// waiter at once, and the next grab clears it before it starts. A waiter
+// that slips in between those two just rechecks after a short timeout.
+#if defined(ESP_PLATFORM)
+#define PUBLISHED_BIT 0x01
+#define WAIT_RECHECK_MS 20
+
+static bool createSync(void*& lock, void*& signal) {
+  lock = xSemaphoreCreateMutex();
+  signal = xEventGroupCreate();
+  return lock && signal;
+}
+
+static inline void takeLock(void* lock) { xSemaphoreTake((SemaphoreHandle_t)lock, portMAX_DELAY); }
+static inline void giveLock(void* lock) { xSemaphoreGive((SemaphoreHandle_t)lock); }
+
+static void waitPublished(void* lock, void* signal) {
+  giveLock(lock);
+  xEventGroupWaitBits((EventGroupHandle_t)signal, PUBLISHED_BIT, pdFALSE, pdTRUE, pdMS_TO_TICKS(WAIT_RECHECK_MS));
+  takeLock(lock);
+}
+
+static inline void clearPublished(void* signal) { xEventGroupClearBits((EventGroupHandle_t)signal, PUBLISHED_BIT); }
+static inline void signalPublished(void* signal) { xEventGroupSetBits((EventGroupHandle_t)signal, PUBLISHED_BIT); }
+#else
+static bool createSync(void*& lock, void*& signal) {
+  lock = new std::mutex();
+  signal = new std::condition_variable();
+  return true;
+}
+
+static inline void takeLock(void* lock) { ((std::mutex*)lock)->lock(); }
+static inline void giveLock(void* lock) { ((std::mutex*)lock)->unlock(); }
+
+static void waitPublished(void* lock, void* signal) {
+  std::unique_lock<std::mutex> guard(*(std::mutex*)lock, std::adopt_lock);
+  ((std::condition_variable*)signal)->wait(guard);
+  guard.release();
+}
+
+static inline void clearPublished(void*) {}
+static inline void signalPublished(void* signal) { ((std::condition_variable*)signal)->notify_all(); }
+#endif
+
+// ============================================
+// Hub
+// ============================================
+Hub::Hub(hal::Camera& camera)
+  : camera_(camera),
+    lock_(nullptr),
+    signal_(nullptr),
+    grabbing_(false),
+    published_(0),
+    waiting_(0),
+    captures_(0),
+    deliveries_(0) {
+  for (int i = 0; i < FRAMEHUB_SLOTS; i++) {
+    slots_[i].refs = 0;
+  }
+}
+
+bool Hub::begin() {
+  if (lock_ && signal_) {
+    return true;
+  }
+  return createSync(lock_, signal_);
+}
+
+bool Hub::grab(hal::Frame& out) {
+  takeLock(lock_);
+  // Everyone counted in waiting_ wants the same capture, published_ + 1
+  uint32_t want = published_ + 1;
+  waiting_++;
+  while ((int32_t)(published_ - want) < 0) {
+    if (grabbing_) {
+      waitPublished(lock_, signal_);
+      continue;
+    }
+    grabbing_ = true;
+    clearPublished(signal_);
+    giveLock(lock_);
+
+    hal::Frame frame;
+    bool ok = camera_.grab(frame);
+
+    takeLock(lock_);
+    grabbing_ = false;
+    captures_++;
+    publish(ok ? &frame : nullptr);
+    signalPublished(signal_);
+  }
+
+  // publish() took a reference for every waiter; find ours
+  for (int i = 0; i < FRAMEHUB_SLOTS; i++) {
+    Slot& slot = slots_[i];
+    if (slot.refs > 0 && slot.seq == want) {
+      out = slot.frame;
+      out.handle = &slot;
+      deliveries_++;
+      giveLock(lock_);
+      return true;
+    }
+  }
+  giveLock(lock_);
+  return false;
+}
+
+void Hub::release(hal::Frame& frame) {
+  Slot* slot = (Slot*)frame.handle;
+  if (!slot) {
+    return;
+  }
+  takeLock(lock_);
+  if (slot->refs > 0 && --slot->refs == 0) {
+    camera_.release(slot->frame);
+  }
+  giveLock(lock_);
+  frame.handle = nullptr;
+}
+
+// Called with the lock held. A failed capture (or, if FRAMEHUB_SLOTS is too
+// small, one with nowhere to go) gets no slot, so its waiters return false.
+void Hub::publish(hal::Frame* frame) {
+  published_++;
+  if (frame) {
+    Slot* spare = nullptr;
+    for (int i = 0; i < FRAMEHUB_SLOTS && !spare; i++) {
+      if (slots_[i].refs == 0) {
+        spare = &slots_[i];
+      }
+    }
+    if (spare) {
+      spare->frame = *frame;
+      spare->seq = published_;
+      spare->refs = waiting_;
+    } else {
+      camera_.release(*frame);
+    }
+  }
+  waiting_ = 0;
+}
+
+}  // namespace framehub
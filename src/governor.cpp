@@ -0,0 +1,215 @@
+#include "governor.h"
+
+namespace governor {
+
+// ============================================
+// Operating points
+// ============================================
+const OperatingPoint kOperatingPoints[] = {
+  // name        CPU  XCLK  frame        fps  Wi-Fi PS     mA
+  {"full",       240, 20,   FRAME_QVGA,  0,   WIFI_PS_MIN, 230},
+  {"balanced",   160, 20,   FRAME_QVGA,  10,  WIFI_PS_MIN, 160},
+  {"saver",      80,  10,   FRAME_HQVGA, 4,   WIFI_PS_MIN, 100},
+  {"critical",   80,  10,   FRAME_QQVGA, 1,   WIFI_PS_MAX, 65},
+};
+const size_t kOperatingPointCount = sizeof(kOperatingPoints) / sizeof(kOperatingPoints[0]);
+
+// State-of-charge floors (permille): below kFloorSoc[i] the governor runs
+// at level i + 1 or cheaper, whatever the target says
+static const uint16_t kFloorSoc[] = {300, 150, 50};
+// Load steps move the voltage by the cell's IR drop (tens of mV on an aged
+// cell), so leaving a floor needs a clear margin above it
+static const uint16_t kFloorHysteresis = 50;
+// Filtered voltage rising this much across the trend window means charging
+static const int32_t kChargingRiseMv = 25;
+// After a change, wait this long before the first trend sample so the
+// filter has settled on the new load's IR drop (about four filter time
+// constants at one reading every 10 s)
+static const uint32_t kSettleMs = 5UL * 60 * 1000;
+
+Config defaultConfig(uint32_t targetMinutes) {
+  Config c;
+  c.targetMinutes = targetMinutes;
+  c.trendWindowMs = 15UL * 60 * 1000;
+  c.minDwellMs = 15UL * 60 * 1000;
+  c.marginPct = 30;
+  return c;
+}
+
+// ============================================
+// LiPo open-circuit curve
+// ============================================
+struct CurvePoint {
+  uint16_t mv;
+  uint16_t soc;
+};
+
+// Typical single-cell LiPo at rest, 0.2C; flat between 3.75 and 3.85 V
+static const CurvePoint kLipoCurve[] = {
+  {3300, 0},   {3610, 50},  {3690, 100}, {3710, 150}, {3730, 200},
+  {3750, 250}, {3770, 300}, {3790, 350}, {3800, 400}, {3820, 450},
+  {3840, 500}, {3850, 550}, {3870, 600}, {3910, 650}, {3950, 700},
+  {3980, 750}, {4020, 800}, {4080, 850}, {4110, 900}, {4150, 950},
+  {4200, 1000},
+};
+static const size_t kLipoCurvePoints = sizeof(kLipoCurve) / sizeof(kLipoCurve[0]);
+
+uint16_t socFromMillivolts(uint16_t mv) {
+  if (mv <= kLipoCurve[0].mv) {
+    return 0;
+  }
+  for (size_t i = 1; i < kLipoCurvePoints; i++) {
+    const CurvePoint& hi = kLipoCurve[i];
+    if (mv < hi.mv) {
+      const CurvePoint& lo = kLipoCurve[i - 1];
+      return (uint16_t)(lo.soc + (uint32_t)(mv - lo.mv) * (hi.soc - lo.soc) / (hi.mv - lo.mv));
+    }
+  }
+  return 1000;
+}
+
+// ============================================
+// Governor
+// ============================================
+void Governor::begin(const Config& config, uint32_t nowMs) {
+  config_ = config;
+  startMs_ = nowMs;
+  lastChangeMs_ = nowMs;
+  primed_ = false;
+  level_ = 0;
+  transitions_ = 0;
+  resetTrend(nowMs);
+}
+
+void Governor::resetTrend(uint32_t nowMs) {
+  trendHead_ = 0;
+  trendCount_ = 0;
+  trendResetMs_ = nowMs;
+}
+
+// Least-squares drain over the trend window. Endpoints alone are too
+// noisy on the flat part of the curve, where 1 mV is several permille.
+void Governor::fitTrend() {
+  int64_t n = GOVERNOR_TREND_SLOTS;
+  int64_t sumT = 0, sumS = 0;
+  uint32_t t0 = trend_[trendHead_].ms;   // Oldest
+  for (const Sample& s : trend_) {
+    sumT += (int64_t)(s.ms - t0) / 1000;
+    sumS += s.soc;
+  }
+  int64_t cov = 0, var = 0;
+  for (const Sample& s : trend_) {
+    int64_t dt = (int64_t)(s.ms - t0) / 1000 * n - sumT;
+    int64_t ds = (int64_t)s.soc * n - sumS;
+    cov += dt * ds;
+    var += dt * dt;
+  }
+  // Slope in permille per second (scaled by n on both axes), negated and
+  // converted to per hour
+  drainPerHour_ = var ? (int32_t)(-cov * 3600 / var) : 0;
+  if (drainPerHour_ > 0) {
+    // Drain per amp of typical draw, averaged over many windows: a single
+    // window is skewed by where the voltage sits on the curve, and the
+    // per-amp form carries over when the operating point changes
+    int32_t perAmp = drainPerHour_ * 1000 / kOperatingPoints[level_].typicalMa;
+    drainPerAmp_ = drainPerAmp_ ? drainPerAmp_ + (perAmp - drainPerAmp_) / 32 : perAmp;
+  }
+  const Sample& newest = trend_[(trendHead_ + GOVERNOR_TREND_SLOTS - 1) % GOVERNOR_TREND_SLOTS];
+  riseMv_ = (int32_t)newest.mv - (int32_t)trend_[trendHead_].mv;
+}
+
+bool Governor::charging() const {
+  return trendValid() && riseMv_ >= kChargingRiseMv;
+}
+
+uint32_t Governor::projectedMinutes() const {
+  return projectedMinutesAt(level_);
+}
+
+uint32_t Governor::projectedMinutesAt(uint8_t level) const {
+  if (drainPerAmp_ <= 0 || charging()) {
+    return UINT32_MAX;
+  }
+  uint32_t drain = (uint32_t)drainPerAmp_ * kOperatingPoints[level].typicalMa / 1000;
+  return drain ? (uint32_t)socPermille() * 60 / drain : UINT32_MAX;
+}
+
+uint8_t Governor::floorLevel(uint16_t soc) const {
+  uint8_t floor = 0;
+  for (size_t i = 0; i < sizeof(kFloorSoc) / sizeof(kFloorSoc[0]) && i + 1 < kOperatingPointCount; i++) {
+    // Leaving a floor needs a little more charge than entering it
+    uint16_t threshold = kFloorSoc[i] + (level_ > i ? kFloorHysteresis : 0);
+    if (soc < threshold) {
+      floor = (uint8_t)(i + 1);
+    }
+  }
+  return floor;
+}
+
+uint8_t Governor::update(uint32_t nowMs, uint16_t millivolts) {
+  // EWMA (1/8) over readings; the ADC is noisy and load steps show up as dips
+  if (!primed_) {
+    filteredMv16_ = (uint32_t)millivolts << 4;
+    primed_ = true;
+  } else {
+    int32_t delta = ((int32_t)millivolts << 4) - (int32_t)filteredMv16_;
+    filteredMv16_ = (uint32_t)((int32_t)filteredMv16_ + delta / 8);
+  }
+  uint16_t soc = socPermille();
+
+  // Trend: GOVERNOR_TREND_SLOTS samples spread over the window, starting
+  // kSettleMs after a reset
+  uint32_t interval = config_.trendWindowMs / (GOVERNOR_TREND_SLOTS - 1);
+  bool due = trendCount_ ? nowMs - trend_[(trendHead_ + GOVERNOR_TREND_SLOTS - 1) % GOVERNOR_TREND_SLOTS].ms >= interval
+                         : nowMs - trendResetMs_ >= kSettleMs;
+  if (due) {
+    trend_[trendHead_] = {nowMs, soc, filteredMillivolts()};
+    trendHead_ = (trendHead_ + 1) % GOVERNOR_TREND_SLOTS;
+    if (trendCount_ < GOVERNOR_TREND_SLOTS) {
+      trendCount_++;
+    }
+    if (trendValid()) {
+      fitTrend();
+    }
+  }
+
+  uint8_t next = level_;
+  bool charging = this->charging();
+  if (charging || !config_.targetMinutes) {
+    next = 0;
+  } else if (trendValid()) {
+    uint32_t elapsed = (nowMs - startMs_) / 60000;
+    uint32_t left = config_.targetMinutes > elapsed ? config_.targetMinutes - elapsed : 0;
+    if (projectedMinutesAt(next) < left) {
+      if (next + 1 < (uint8_t)kOperatingPointCount) {
+        next++;
+      }
+    } else if (next > 0) {
+      uint64_t projectedUp = projectedMinutesAt(next - 1);
+      if (projectedUp * 100 > (uint64_t)left * (100 + config_.marginPct)) {
+        next--;
+      }
+    }
+  }
+  if (!charging) {
+    uint8_t floor = floorLevel(soc);
+    if (next < floor) {
+      next = floor;
+    }
+  }
+  // Stepping down is never delayed; stepping up waits out the dwell so a
+  // load change (and the voltage jump that comes with it) can't bounce back
+  if (next < level_ && !charging && nowMs - lastChangeMs_ < config_.minDwellMs) {
+    next = level_;
+  }
+
+  if (next != level_) {
+    level_ = next;
+    lastChangeMs_ = nowMs;
+    transitions_++;
+    resetTrend(nowMs);   // The old drain rate belongs to the old load
+  }
+  return level_;
+}
+
+}  // namespace governor
@@ -0,0 +1,98 @@
+#include "hal_esp32.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esp_camera.h"
+#include "memstats.h"
+
+namespace hal {
+
+// ============================================
+// Camera
+// ============================================
+bool Esp32Camera::grab(Frame& out) {
+  camera_fb_t *fb = esp_camera_fb_get();
+  if (!fb) {
+    return false;
+  }
+  out.buf = fb->buf;
+  out.len = fb->len;
+  out.width = (uint16_t)fb->width;
+  out.height = (uint16_t)fb->height;
+  out.timestampUs = (int64_t)fb->timestamp.tv_sec * 1000000LL + fb->timestamp.tv_usec;
+  out.handle = fb;
+  return true;
+}
+
+void Esp32Camera::release(Frame& frame) {
+  if (frame.handle) {
+    esp_camera_fb_return((camera_fb_t *)frame.handle);
+    frame.handle = nullptr;
+  }
+}
+
+// ============================================
+// SD storage
+// ============================================
+bool SdStorage::beginWrite(const char* path, uint32_t lockTimeoutMs) {
+  timedOut_ = false;
+  if (!lock_(lockTimeoutMs)) {
+    timedOut_ = true;
+    return false;
+  }
+  char fullPath[96];
+  snprintf(fullPath, sizeof(fullPath), SD_MOUNT_POINT "%s", path);
+  {
+    // FatFs may allocate its long-filename buffer inside open()
+    memstats::DriverScope driver;
+    fd_ = ::open(fullPath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  }
+  if (fd_ < 0) {
+    unlock_();
+    return false;
+  }
+  return true;
+}
+
+size_t SdStorage::append(const uint8_t* data, size_t len) {
+  if (fd_ < 0) {
+    return 0;
+  }
+  memstats::DriverScope driver;
+  size_t total = 0;
+  while (total < len) {
+    ssize_t n = ::write(fd_, data + total, len - total);
+    if (n <= 0) {
+      break;
+    }
+    total += (size_t)n;
+  }
+  return total;
+}
+
+void SdStorage::endWrite() {
+  if (fd_ >= 0) {
+    memstats::DriverScope driver;
+    ::close(fd_);
+    fd_ = -1;
+  }
+  unlock_();
+}
+
+// ============================================
+// Clock
+// ============================================
+bool ArduinoClock::timestamp(char* out, size_t cap) {
+  struct tm now;
+  // getLocalTime() fails until NTP has set the clock past 2016
+  if (!getLocalTime(&now, 0)) {
+    return false;
+  }
+  strftime(out, cap, "%Y%m%d_%H%M%S", &now);
+  return true;
+}
+
+}  // namespace hal
@@ -0,0 +1,173 @@
+// ============================================
+// Host micro-benchmarks ([env:bench])
+// ============================================
+// Runs every kernel in bench.cpp and prints ns/op, throughput and heap
+// allocations per op. With --baseline, each kernel is compared against a
+// saved run and the exit status is 2 if any regressed past --threshold.
+//
+//   pio run -e bench && .pio/build/bench/program --baseline bench/native_baseline.txt
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <map>
+#include <string>
+
+#include "bench.h"
+#include "hal_host.h"
+
+// ============================================
+// Allocation counting (glibc malloc interposer)
+// ============================================
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t n, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+static std::atomic<uint64_t> allocCount(0);
+
+extern "C" void* malloc(size_t size) {
+  allocCount.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size) {
+  allocCount.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+  allocCount.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(ptr, size);
+}
+
+static uint64_t readAllocCount() {
+  return allocCount.load(std::memory_order_relaxed);
+}
+
+// ============================================
+// Baseline file: "<kernel> <ns_per_op> <allocs_per_op>" per line, '#' comments
+// ============================================
+struct BaselineEntry {
+  double nsPerOp;
+  double allocsPerOp;
+};
+
+static bool loadBaseline(const char* path, std::map<std::string, BaselineEntry>& out) {
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    return false;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    char name[64];
+    BaselineEntry e;
+    if (line[0] == '#' || sscanf(line, "%63s %lf %lf", name, &e.nsPerOp, &e.allocsPerOp) != 3) {
+      continue;
+    }
+    out[name] = e;
+  }
+  fclose(f);
+  return true;
+}
+
+static void usage(const char* prog) {
+  printf("Usage: %s [options]\n"
+         "  --min-time-ms N       Minimum run time per kernel (default 200)\n"
+         "  --repeat N            Runs per kernel, fastest is reported (default 3)\n"
+         "  --filter TEXT         Only kernels whose name contains TEXT\n"
+         "  --baseline FILE       Compare against a saved run\n"
+         "  --threshold PCT       Regression threshold for ns/op (default 15)\n"
+         "  --write-baseline FILE Save this run as a baseline\n",
+         prog);
+}
+
+int main(int argc, char** argv) {
+  uint32_t minTimeMs = 200;
+  uint32_t repeat = 3;
+  const char* filter = nullptr;
+  const char* baselinePath = nullptr;
+  const char* writePath = nullptr;
+  double threshold = 15;
+
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!v || !strcmp(a, "--help") || !strcmp(a, "-h")) { usage(argv[0]); return 1; }
+    else if (!strcmp(a, "--min-time-ms")) minTimeMs = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--repeat")) repeat = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--filter")) filter = v;
+    else if (!strcmp(a, "--baseline")) baselinePath = v;
+    else if (!strcmp(a, "--threshold")) threshold = atof(v);
+    else if (!strcmp(a, "--write-baseline")) writePath = v;
+    else { fprintf(stderr, "Unknown option %s\n", a); usage(argv[0]); return 1; }
+    i++;
+  }
+
+  std::map<std::string, BaselineEntry> baseline;
+  if (baselinePath && !loadBaseline(baselinePath, baseline)) {
+    fprintf(stderr, "❌ Cannot read baseline %s\n", baselinePath);
+    return 1;
+  }
+
+  FILE* out = nullptr;
+  if (writePath) {
+    out = fopen(writePath, "w");
+    if (!out) {
+      fprintf(stderr, "❌ Cannot write %s\n", writePath);
+      return 1;
+    }
+    fprintf(out, "# kernel ns_per_op allocs_per_op\n");
+  }
+
+  hal::HostClock clock;
+  bench::setAllocCounter(readAllocCount);
+  if (!bench::begin(clock)) {
+    fprintf(stderr, "❌ Out of memory\n");
+    return 1;
+  }
+
+  printf("%-18s %12s %12s %12s %10s %10s\n", "kernel", "iterations", "ns/op", "MB/s", "allocs/op", "vs base");
+  int regressions = 0;
+  for (size_t i = 0; i < bench::kernelCount(); i++) {
+    const char* name = bench::kernel(i).name;
+    if (filter && !strstr(name, filter)) {
+      continue;
+    }
+    // Fastest of several runs filters out scheduler noise
+    bench::Result r = bench::run(i, minTimeMs * 1000);
+    for (uint32_t n = 1; n < repeat; n++) {
+      bench::Result again = bench::run(i, minTimeMs * 1000);
+      if (again.nsPerOp() < r.nsPerOp()) {
+        r = again;
+      }
+    }
+
+    char delta[24] = "-";
+    auto it = baseline.find(name);
+    if (it != baseline.end() && it->second.nsPerOp > 0) {
+      double pct = (r.nsPerOp() - it->second.nsPerOp) * 100.0 / it->second.nsPerOp;
+      bool slower = pct > threshold || r.allocsPerOp() > it->second.allocsPerOp + 0.01;
+      snprintf(delta, sizeof(delta), "%+.1f%%%s", pct, slower ? " ❌" : "");
+      if (slower) {
+        regressions++;
+      }
+    }
+    printf("%-18s %12u %12.1f %12.1f %10.2f %10s\n", name, r.iterations, r.nsPerOp(),
+           r.bytesPerSecond() / 1048576.0, r.allocsPerOp(), delta);
+    if (out) {
+      fprintf(out, "%s %.1f %.2f\n", name, r.nsPerOp(), r.allocsPerOp());
+    }
+  }
+  bench::end();
+
+  if (out) {
+    fclose(out);
+    printf("\n💾 Baseline written to %s\n", writePath);
+  }
+  if (regressions) {
+    printf("\n❌ %d kernel(s) regressed more than %.0f%% (or allocate more)\n", regressions, threshold);
+    return 2;
+  }
+  return 0;
+}
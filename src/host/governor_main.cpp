@@ -0,0 +1,214 @@
+// ============================================
+// Power governor replay ([env:governor])
+// ============================================
+// Drains a simulated cell through the governor in 10-second steps. Each
+// fixture gives the cell (capacity, internal resistance, open-circuit
+// curve), the runtime target, ADC noise and optional charging, plus
+// 'expect' lines checked at the end. The load follows the operating point
+// the governor picks, so the loop is closed the way it is on the device.
+// Exit status is 2 if any expectation fails.
+//
+//   pio run -e governor && .pio/build/governor/program bench/discharge/*.txt
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "governor.h"
+
+struct CurvePoint {
+  double mv;
+  double soc;    // permille
+};
+
+struct Charge {
+  double fromMin;
+  double toMin;
+  double ma;
+};
+
+struct Expect {
+  std::string key;
+  std::string arg;
+  double value;
+};
+
+struct Fixture {
+  double capacityMah = 500;
+  double targetHours = 0;
+  double resistanceMohm = 150;
+  double noiseMv = 10;
+  double startSoc = 1000;
+  double simHours = 48;
+  std::vector<Charge> charges;
+  std::vector<CurvePoint> curve;
+  std::vector<Expect> expects;
+};
+
+static bool loadFixture(const char* path, Fixture& f) {
+  FILE* in = fopen(path, "r");
+  if (!in) {
+    return false;
+  }
+  char line[256];
+  bool inCurve = false;
+  while (fgets(line, sizeof(line), in)) {
+    char key[32], arg[32];
+    double a, b, c;
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+    if (inCurve && sscanf(line, "%lf %lf", &a, &b) == 2) {
+      f.curve.push_back({a, b});
+    } else if (!strncmp(line, "curve", 5)) {
+      inCurve = true;
+    } else if (sscanf(line, "expect %31s %31s %lf", key, arg, &a) == 3) {
+      f.expects.push_back({key, arg, a});
+    } else if (sscanf(line, "expect %31s %31s", key, arg) == 2) {
+      f.expects.push_back({key, arg, atof(arg)});
+    } else if (sscanf(line, "charge %lf %lf %lf", &a, &b, &c) == 3) {
+      f.charges.push_back({a, b, c});
+    } else if (sscanf(line, "%31s %lf", key, &a) == 2) {
+      if (!strcmp(key, "capacity_mah")) f.capacityMah = a;
+      else if (!strcmp(key, "target_hours")) f.targetHours = a;
+      else if (!strcmp(key, "resistance_mohm")) f.resistanceMohm = a;
+      else if (!strcmp(key, "noise_mv")) f.noiseMv = a;
+      else if (!strcmp(key, "start_soc")) f.startSoc = a * 10;
+      else if (!strcmp(key, "sim_hours")) f.simHours = a;
+    }
+  }
+  fclose(in);
+  return f.curve.size() >= 2;
+}
+
+// Open-circuit voltage of the fixture's cell
+static double cellMv(const Fixture& f, double soc) {
+  if (soc <= f.curve.front().soc) return f.curve.front().mv;
+  for (size_t i = 1; i < f.curve.size(); i++) {
+    const CurvePoint& hi = f.curve[i];
+    if (soc < hi.soc) {
+      const CurvePoint& lo = f.curve[i - 1];
+      return lo.mv + (soc - lo.soc) * (hi.mv - lo.mv) / (hi.soc - lo.soc);
+    }
+  }
+  return f.curve.back().mv;
+}
+
+static int levelByName(const std::string& name) {
+  for (size_t i = 0; i < governor::kOperatingPointCount; i++) {
+    if (name == governor::kOperatingPoints[i].name) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+static int replay(const char* path) {
+  Fixture f;
+  if (!loadFixture(path, f)) {
+    fprintf(stderr, "❌ Cannot read fixture %s\n", path);
+    return 1;
+  }
+
+  const uint32_t stepMs = 10000;
+  governor::Governor gov;
+  gov.begin(governor::defaultConfig((uint32_t)(f.targetHours * 60)), 0);
+
+  double soc = f.startSoc;
+  uint32_t noise = 12345;
+  std::vector<uint8_t> levelAt;   // Level per simulated minute
+  std::vector<uint32_t> minutesAt(governor::kOperatingPointCount, 0);
+  uint32_t runtimeMs = 0;
+  uint8_t maxLevel = 0;
+
+  printf("== %s (%.0f mAh, target %.1f h)\n", path, f.capacityMah, f.targetHours);
+  for (uint32_t now = 0; now < f.simHours * 3600000.0; now += stepMs) {
+    const governor::OperatingPoint& op = gov.point();
+    double ma = op.typicalMa;
+    for (const Charge& c : f.charges) {
+      if (now >= c.fromMin * 60000 && now < c.toMin * 60000) {
+        ma -= c.ma;
+      }
+    }
+    soc -= ma * stepMs / 3600000.0 / f.capacityMah * 1000;
+    if (soc > 1000) soc = 1000;
+    if (soc <= 0) {
+      break;   // Brown-out
+    }
+    runtimeMs = now;
+
+    // Loaded terminal voltage plus a deterministic triangular ADC noise
+    noise = noise * 1103515245 + 12345;
+    double n1 = ((noise >> 16) & 0x7FFF) / 32767.0;
+    noise = noise * 1103515245 + 12345;
+    double n2 = ((noise >> 16) & 0x7FFF) / 32767.0;
+    double mv = cellMv(f, soc) - ma * f.resistanceMohm / 1000 + (n1 + n2 - 1) * f.noiseMv;
+
+    uint8_t before = gov.level();
+    uint8_t level = gov.update(now, (uint16_t)lround(mv));
+    if (level != before) {
+      printf("  %6.2f h  %-8s -> %-8s  soc %4.1f%%  filtered %u mV  drain %.1f%%/h\n",
+             now / 3600000.0, governor::kOperatingPoints[before].name, governor::kOperatingPoints[level].name,
+             soc / 10, gov.filteredMillivolts(), gov.drainPermillePerHour() / 10.0);
+    }
+    if (level > maxLevel) maxLevel = level;
+    if (now % 60000 == 0) {
+      levelAt.push_back(level);
+      minutesAt[level]++;
+    }
+  }
+
+  double runtimeHours = runtimeMs / 3600000.0;
+  printf("  runtime %.2f h, %u transitions;", runtimeHours, (unsigned)gov.transitions());
+  for (size_t i = 0; i < governor::kOperatingPointCount; i++) {
+    printf(" %s %.1f h", governor::kOperatingPoints[i].name, minutesAt[i] / 60.0);
+  }
+  printf("\n");
+
+  int failures = 0;
+  for (const Expect& e : f.expects) {
+    bool ok = true;
+    if (e.key == "min_runtime_hours") {
+      ok = runtimeHours >= e.value;
+    } else if (e.key == "max_transitions") {
+      ok = gov.transitions() <= e.value;
+    } else if (e.key == "never") {
+      int level = levelByName(e.arg);
+      ok = level >= 0 && maxLevel < level;
+    } else if (e.key == "level_at") {
+      // "expect level_at <minute>:<name>"
+      const char* colon = strchr(e.arg.c_str(), ':');
+      size_t minute = (size_t)atoi(e.arg.c_str());
+      ok = colon && minute < levelAt.size() && levelAt[minute] == levelByName(colon + 1);
+    } else {
+      fprintf(stderr, "  unknown expectation %s\n", e.key.c_str());
+      ok = false;
+    }
+    if (!ok) {
+      printf("  ❌ expect %s %s failed\n", e.key.c_str(), e.arg.c_str());
+      failures++;
+    }
+  }
+  if (!failures) {
+    printf("  ✓ %zu expectations met\n", f.expects.size());
+  }
+  return failures ? 2 : 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    printf("Usage: %s FIXTURE...\n", argv[0]);
+    return 1;
+  }
+  int status = 0;
+  for (int i = 1; i < argc; i++) {
+    int r = replay(argv[i]);
+    if (r > status) {
+      status = r;
+    }
+  }
+  return status;
+}
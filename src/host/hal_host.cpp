@@ -0,0 +1,407 @@
+#include "hal_host.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <time.h>
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+
+namespace hal {
+
+static int64_t steadyMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ============================================
+// Clock
+// ============================================
+HostClock::HostClock(bool wallTimeKnown) : startUs_(steadyMicros()), wallTimeKnown_(wallTimeKnown) {}
+
+uint32_t HostClock::millis() {
+  return (uint32_t)(micros() / 1000);
+}
+
+int64_t HostClock::micros() {
+  return steadyMicros() - startUs_;
+}
+
+void HostClock::delayMs(uint32_t ms) {
+  sleepUs((int64_t)ms * 1000);
+}
+
+void HostClock::sleepUs(int64_t us) {
+  if (us > 0) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+  }
+}
+
+bool HostClock::timestamp(char* out, size_t cap) {
+  if (!wallTimeKnown_) {
+    return false;
+  }
+  time_t now = time(nullptr);
+  struct tm local;
+  localtime_r(&now, &local);
+  strftime(out, cap, "%Y%m%d_%H%M%S", &local);
+  return true;
+}
+
+// ============================================
+// Synthetic camera
+// ============================================
+// Baseline greyscale JPEG at the configured resolution. Every 8x8 block is
+// DC diff 0 + EOB, which with one-symbol Huffman tables is two zero bits,
+// so the scan is (blocks / 4) zero bytes and the image decodes as flat
+// grey. COM segments carry the frame number and pad to the target size.
+static const size_t kInfoOffset = 6;   // SOI + COM marker/length
+static const size_t kInfoLen = 48;     // "frame=%010u us=%020lld" + padding
+
+static void put16(std::vector<uint8_t>& v, uint16_t x) {
+  v.push_back((uint8_t)(x >> 8));
+  v.push_back((uint8_t)x);
+}
+
+static void buildJpeg(std::vector<uint8_t>& out, uint16_t width, uint16_t height, size_t targetBytes) {
+  std::vector<uint8_t> tables;
+  // DQT: table 0, all ones
+  tables.push_back(0xFF); tables.push_back(0xDB); put16(tables, 67); tables.push_back(0x00);
+  for (int i = 0; i < 64; i++) tables.push_back(1);
+  // SOF0: 8-bit, one component, 1x1 sampling, table 0
+  tables.push_back(0xFF); tables.push_back(0xC0); put16(tables, 11); tables.push_back(8);
+  put16(tables, height); put16(tables, width);
+  tables.push_back(1); tables.push_back(1); tables.push_back(0x11); tables.push_back(0);
+  // DHT: DC table 0 and AC table 0, each a single 1-bit code for symbol 0x00
+  for (uint8_t tc = 0; tc < 2; tc++) {
+    tables.push_back(0xFF); tables.push_back(0xC4); put16(tables, 20);
+    tables.push_back((uint8_t)(tc << 4));
+    tables.push_back(1);
+    for (int i = 1; i < 16; i++) tables.push_back(0);
+    tables.push_back(0x00);
+  }
+  // SOS: one component, tables 0/0, full spectral range
+  tables.push_back(0xFF); tables.push_back(0xDA); put16(tables, 8);
+  tables.push_back(1); tables.push_back(1); tables.push_back(0x00);
+  tables.push_back(0); tables.push_back(63); tables.push_back(0);
+
+  size_t blocks = (size_t)((width + 7) / 8) * ((height + 7) / 8);
+  size_t scanBits = blocks * 2;
+  size_t scanBytes = (scanBits + 7) / 8;
+
+  out.clear();
+  out.push_back(0xFF); out.push_back(0xD8);
+  out.push_back(0xFF); out.push_back(0xFE); put16(out, (uint16_t)(kInfoLen + 2));
+  out.resize(out.size() + kInfoLen, ' ');
+
+  // Pad with COM segments (max 65533 payload each) up to the target size
+  size_t fixed = out.size() + tables.size() + scanBytes + 2;
+  size_t padding = targetBytes > fixed ? targetBytes - fixed : 0;
+  while (padding > 0) {
+    size_t seg = padding < 65537 ? padding : 65537;
+    if (seg < 4) {
+      break;  // Too small for a marker; a few bytes short is fine
+    }
+    out.push_back(0xFF); out.push_back(0xFE); put16(out, (uint16_t)(seg - 2));
+    out.resize(out.size() + seg - 4, 'x');
+    padding -= seg;
+  }
+
+  out.insert(out.end(), tables.begin(), tables.end());
+  out.resize(out.size() + scanBytes, 0x00);
+  if (scanBits % 8) {
+    out.back() = (uint8_t)(0xFF >> (scanBits % 8));  // Pad the last byte with 1 bits
+  }
+  out.push_back(0xFF); out.push_back(0xD9);
+}
+
+SyntheticCamera::SyntheticCamera(HostClock& clock, float fps, size_t frameBytes, uint16_t width, uint16_t height)
+  : clock_(clock),
+    periodUs_(fps > 0 ? (int64_t)(1000000.0f / fps) : 0),
+    nextDueUs_(0),
+    width_(width),
+    height_(height),
+    sequence_(0),
+    dropped_(0),
+    failureRate_(0),
+    rng_(12345) {
+  for (int i = 0; i < kBuffers; i++) {
+    buildJpeg(buffers_[i], width, height, frameBytes);
+    inUse_[i] = false;
+  }
+}
+
+bool SyntheticCamera::grab(Frame& out) {
+  // Wait for the next sensor frame, outside the lock like the DMA wait
+  int64_t now = clock_.micros();
+  int64_t due;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (nextDueUs_ == 0) {
+      nextDueUs_ = now;
+    }
+    due = nextDueUs_;
+    if (now > due + periodUs_ && periodUs_ > 0) {
+      // Caller fell behind: newer frames replaced the ones it missed
+      int64_t missed = (now - due) / periodUs_;
+      dropped_ += (uint32_t)missed;
+      due += missed * periodUs_;
+    }
+    nextDueUs_ = due + periodUs_;
+  }
+  clock_.sleepUs(due - now);
+
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (failureRate_ > 0 && std::uniform_real_distribution<double>(0, 1)(rng_) < failureRate_) {
+    return false;
+  }
+  int slot = -1;
+  for (int i = 0; i < kBuffers; i++) {
+    if (!inUse_[i]) {
+      slot = i;
+      break;
+    }
+  }
+  if (slot < 0) {
+    return false;  // Both buffers held, as fb_get would time out
+  }
+  inUse_[slot] = true;
+
+  int64_t ts = clock_.micros();
+  char info[kInfoLen + 1];
+  snprintf(info, sizeof(info), "frame=%010u us=%020lld", (unsigned)sequence_++, (long long)ts);
+  memcpy(&buffers_[slot][kInfoOffset], info, strlen(info));
+
+  out.buf = buffers_[slot].data();
+  out.len = buffers_[slot].size();
+  out.width = width_;
+  out.height = height_;
+  out.timestampUs = ts;
+  out.handle = &inUse_[slot];
+  return true;
+}
+
+void SyntheticCamera::release(Frame& frame) {
+  if (frame.handle) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    *(bool*)frame.handle = false;
+    frame.handle = nullptr;
+  }
+}
+
+// ============================================
+// WAV microphone
+// ============================================
+static uint32_t le32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t le16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+bool loadWav(const char* path, std::vector<int16_t>& pcm, uint32_t& rate) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    return false;
+  }
+  std::vector<uint8_t> data;
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+    data.insert(data.end(), chunk, chunk + n);
+  }
+  fclose(f);
+
+  if (data.size() < 12 || memcmp(&data[0], "RIFF", 4) != 0 || memcmp(&data[8], "WAVE", 4) != 0) {
+    return false;
+  }
+  uint16_t channels = 0;
+  uint16_t bits = 0;
+  size_t pos = 12;
+  while (pos + 8 <= data.size()) {
+    uint32_t size = le32(&data[pos + 4]);
+    const uint8_t* body = &data[pos + 8];
+    size_t avail = data.size() - pos - 8;
+    if (size > avail) size = (uint32_t)avail;
+
+    if (memcmp(&data[pos], "fmt ", 4) == 0 && size >= 16) {
+      if (le16(body) != 1) {
+        return false;  // Not PCM
+      }
+      channels = le16(body + 2);
+      rate = le32(body + 4);
+      bits = le16(body + 14);
+    } else if (memcmp(&data[pos], "data", 4) == 0) {
+      if (bits != 16 || channels == 0) {
+        return false;
+      }
+      size_t frames = size / (2 * channels);
+      pcm.resize(frames);
+      for (size_t i = 0; i < frames; i++) {
+        pcm[i] = (int16_t)le16(body + i * 2 * channels);
+      }
+      return !pcm.empty();
+    }
+    pos += 8 + size + (size & 1);
+  }
+  return false;
+}
+
+static const size_t kDmaBufferSamples = 512;
+
+WavMicrophone::WavMicrophone(HostClock& clock, const char* wavPath, uint32_t defaultRate)
+  : clock_(clock), sampleRate_(defaultRate), position_(0), startUs_(-1), delivered_(0), loadedFile_(false) {
+  if (wavPath && loadWav(wavPath, pcm_, sampleRate_)) {
+    loadedFile_ = true;
+    return;
+  }
+  if (wavPath) {
+    fprintf(stderr, "⚠️ %s is not a 16-bit PCM WAV, using a test tone\n", wavPath);
+  }
+  // One second of 440 Hz at -12 dBFS
+  sampleRate_ = defaultRate;
+  pcm_.resize(sampleRate_);
+  for (size_t i = 0; i < pcm_.size(); i++) {
+    pcm_[i] = (int16_t)(8192.0 * sin(2.0 * M_PI * 440.0 * (double)i / sampleRate_));
+  }
+}
+
+size_t WavMicrophone::read(int16_t* samples, size_t maxSamples) {
+  // Hand out at most one DMA buffer per call, blocking until it would have
+  // arrived, so concurrent readers interleave as they do on the I2S driver
+  if (maxSamples > kDmaBufferSamples) {
+    maxSamples = kDmaBufferSamples;
+  }
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (startUs_ < 0) {
+    startUs_ = clock_.micros();
+  }
+  int64_t readyAtUs = startUs_ + (int64_t)((delivered_ + maxSamples) * 1000000ULL / sampleRate_);
+  clock_.sleepUs(readyAtUs - clock_.micros());
+
+  for (size_t i = 0; i < maxSamples; i++) {
+    samples[i] = pcm_[position_];
+    if (++position_ >= pcm_.size()) {
+      position_ = 0;
+    }
+  }
+  delivered_ += maxSamples;
+  return maxSamples;
+}
+
+// ============================================
+// Directory-backed SD card
+// ============================================
+static bool makeDirs(const std::string& path) {
+  for (size_t i = 1; i <= path.size(); i++) {
+    if (i == path.size() || path[i] == '/') {
+      std::string part = path.substr(0, i);
+      if (::mkdir(part.c_str(), 0755) != 0 && errno != EEXIST) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+DirStorage::DirStorage(const std::string& root, HostClock& clock, const LatencyModel& latency)
+  : root_(root), clock_(clock), latency_(latency), file_(nullptr), timedOut_(false), rng_(54321) {
+  while (root_.size() > 1 && root_[root_.size() - 1] == '/') {
+    root_.erase(root_.size() - 1);
+  }
+  makeDirs(root_);
+}
+
+DirStorage::~DirStorage() {
+  if (file_) {
+    fclose(file_);
+  }
+}
+
+std::string DirStorage::hostPath(const char* path) const {
+  return root_ + (path[0] == '/' ? "" : "/") + path;
+}
+
+void DirStorage::injectLatency(uint32_t us) {
+  if (latency_.spikeProbability > 0 &&
+      std::uniform_real_distribution<double>(0, 1)(rng_) < latency_.spikeProbability) {
+    us += latency_.spikeUs;
+  }
+  clock_.sleepUs(us);
+}
+
+bool DirStorage::lock(uint32_t timeoutMs) {
+  return cardMutex_.try_lock_for(std::chrono::milliseconds(timeoutMs));
+}
+
+void DirStorage::unlock() {
+  cardMutex_.unlock();
+}
+
+bool DirStorage::beginWrite(const char* path, uint32_t lockTimeoutMs) {
+  timedOut_ = false;
+  if (!lock(lockTimeoutMs)) {
+    timedOut_ = true;
+    return false;
+  }
+  file_ = fopen(hostPath(path).c_str(), "wb");
+  if (!file_) {
+    unlock();
+    return false;
+  }
+  injectLatency(latency_.openUs);
+  return true;
+}
+
+size_t DirStorage::append(const uint8_t* data, size_t len) {
+  if (!file_) {
+    return 0;
+  }
+  size_t written = fwrite(data, 1, len, file_);
+  injectLatency((uint32_t)((uint64_t)latency_.perKBUs * len / 1024));
+  return written;
+}
+
+void DirStorage::endWrite() {
+  if (file_) {
+    fclose(file_);
+    file_ = nullptr;
+  }
+  unlock();
+}
+
+bool DirStorage::remove(const char* path) {
+  return ::remove(hostPath(path).c_str()) == 0;
+}
+
+bool DirStorage::exists(const char* path) {
+  struct stat st;
+  return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool DirStorage::mkdir(const char* path) {
+  return makeDirs(hostPath(path));
+}
+
+uint64_t DirStorage::totalBytes() {
+  struct statvfs vfs;
+  if (statvfs(root_.c_str(), &vfs) != 0) {
+    return 0;
+  }
+  return (uint64_t)vfs.f_blocks * vfs.f_frsize;
+}
+
+uint64_t DirStorage::usedBytes() {
+  struct statvfs vfs;
+  if (statvfs(root_.c_str(), &vfs) != 0) {
+    return 0;
+  }
+  return (uint64_t)(vfs.f_blocks - vfs.f_bfree) * vfs.f_frsize;
+}
+
+}  // namespace hal
@@ -0,0 +1,796 @@
+// ============================================
+// Multi-client load generator ([env:loadgen])
+// ============================================
+// Opens N /stream viewers, M /audio WebSocket listeners, L /live viewers
+// and K clients doing back-to-back Range downloads through
+// /api/files/download, against a device or the host simulation
+// (sim_main.cpp --serve). Reports per-client fps, inter-frame jitter,
+// audio gaps, /live capture-to-arrival latency and p50/p99 download
+// latency, and exits non-zero when a --min-*/--max-* limit is missed so it
+// can gate CI.
+//
+//   .pio/build/native/program --seconds 0 --streams 0 --serve 8080 &
+//   .pio/build/loadgen/program --port 8080 --streams 3 --audio 2 --downloads 2
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "live.h"
+#include "netutil.h"
+
+struct Options {
+  std::string host = "127.0.0.1";
+  uint16_t port = 80;
+  uint32_t seconds = 30;
+  uint32_t streams = 1;
+  uint32_t audio = 1;
+  uint32_t downloads = 0;
+  uint32_t live = 0;
+  uint32_t decodeMs = 0;        // /live viewer time per frame before it acks
+  std::string file;             // Download target; discovered when empty
+  uint32_t rangeKB = 64;
+  uint32_t gapMs = 50;          // Audio frames are 16 ms apart at 16 kHz
+  uint32_t rampMs = 100;        // Delay between client starts
+  uint32_t timeoutMs = 5000;
+  // CI limits (0 = not checked)
+  double minFps = 0;
+  double maxJitterMs = 0;
+  uint32_t maxGaps = UINT32_MAX;
+  double maxP99Ms = 0;
+  uint32_t maxErrors = UINT32_MAX;
+  double maxLiveMs = 0;
+};
+
+static void usage(const char* prog) {
+  printf("Usage: %s [options]\n"
+         "  --host H          Device or simulator address (default 127.0.0.1)\n"
+         "  --port N          HTTP port (default 80)\n"
+         "  --seconds N       Test length (default 30)\n"
+         "  --streams N       MJPEG /stream clients (default 1)\n"
+         "  --audio N         /audio WebSocket clients (default 1)\n"
+         "  --downloads N     Range download clients (default 0)\n"
+         "  --live N          /live WebSocket viewers, video and audio (default 0)\n"
+         "  --decode-ms N     Time a /live viewer takes per frame before it acks (default 0)\n"
+         "  --file PATH       File to download (default: largest in /video)\n"
+         "  --range-kb N      Bytes per Range request (default 64)\n"
+         "  --gap-ms N        Audio inter-frame time counted as a gap (default 50)\n"
+         "  --ramp-ms N       Delay between client starts (default 100)\n"
+         "  --timeout-ms N    Socket timeout (default 5000)\n"
+         "Limits (exit status 3 when missed):\n"
+         "  --min-fps F       Every stream client at least F fps\n"
+         "  --max-jitter-ms F Every stream client's jitter at most F ms\n"
+         "  --max-gaps N      Every audio client at most N gaps\n"
+         "  --max-p99-ms F    Download p99 latency at most F ms\n"
+         "  --max-errors N    Total errors at most N\n"
+         "  --max-live-ms F   Every /live viewer's video p99 capture-to-arrival at most F ms\n",
+         prog);
+}
+
+static bool parseArgs(int argc, char** argv, Options& o) {
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    if (!strcmp(a, "--help") || !strcmp(a, "-h")) {
+      return false;
+    }
+    if (i + 1 >= argc) {
+      fprintf(stderr, "Missing value for %s\n", a);
+      return false;
+    }
+    const char* v = argv[++i];
+    if (!strcmp(a, "--host")) o.host = v;
+    else if (!strcmp(a, "--port")) o.port = (uint16_t)atoi(v);
+    else if (!strcmp(a, "--seconds")) o.seconds = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--streams")) o.streams = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--audio")) o.audio = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--downloads")) o.downloads = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--live")) o.live = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--decode-ms")) o.decodeMs = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--file")) o.file = v;
+    else if (!strcmp(a, "--range-kb")) o.rangeKB = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--gap-ms")) o.gapMs = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--ramp-ms")) o.rampMs = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--timeout-ms")) o.timeoutMs = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--min-fps")) o.minFps = atof(v);
+    else if (!strcmp(a, "--max-jitter-ms")) o.maxJitterMs = atof(v);
+    else if (!strcmp(a, "--max-gaps")) o.maxGaps = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--max-p99-ms")) o.maxP99Ms = atof(v);
+    else if (!strcmp(a, "--max-errors")) o.maxErrors = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--max-live-ms")) o.maxLiveMs = atof(v);
+    else { fprintf(stderr, "Unknown option %s\n", a); return false; }
+  }
+  if (o.rangeKB == 0) {
+    fprintf(stderr, "--range-kb must be > 0\n");
+    return false;
+  }
+  return true;
+}
+
+// ============================================
+// Statistics
+// ============================================
+static double nowMs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count() / 1000.0;
+}
+
+static double percentile(std::vector<double> v, double q) {
+  if (v.empty()) {
+    return 0;
+  }
+  std::sort(v.begin(), v.end());
+  size_t idx = (size_t)(q * (v.size() - 1) + 0.5);
+  return v[idx];
+}
+
+static double stddev(const std::vector<double>& v) {
+  if (v.size() < 2) {
+    return 0;
+  }
+  double mean = 0;
+  for (double x : v) mean += x;
+  mean /= v.size();
+  double var = 0;
+  for (double x : v) var += (x - mean) * (x - mean);
+  return sqrt(var / (v.size() - 1));
+}
+
+struct StreamResult {
+  uint32_t frames = 0;
+  uint64_t bytes = 0;
+  uint32_t errors = 0;
+  double firstFrameMs = 0;     // Connect to first complete frame
+  double activeMs = 0;
+  std::vector<double> intervals;
+  std::string error;
+};
+
+struct AudioResult {
+  uint32_t messages = 0;
+  uint64_t bytes = 0;
+  uint32_t gaps = 0;
+  uint32_t errors = 0;
+  double maxGapMs = 0;
+  double activeMs = 0;
+  std::vector<double> intervals;
+  std::string error;
+};
+
+struct LiveResult {
+  uint32_t frames = 0;
+  uint32_t blocks = 0;
+  uint64_t bytes = 0;
+  uint32_t gaps = 0;             // Audio blocks missing from the sequence
+  uint32_t errors = 0;
+  uint32_t framesSkipped = 0;    // From the last stats message
+  uint32_t blocksDropped = 0;
+  double activeMs = 0;
+  double minRttMs = 1e9;
+  double offsetMs = 0;           // Device clock minus ours, from the best ping
+  std::vector<double> intervals;
+  // Arrival (our clock) and capture time of the newest sample (device clock)
+  std::vector<std::pair<double, int64_t>> video, audio;
+  std::string error;
+};
+
+struct DownloadResult {
+  uint32_t requests = 0;
+  uint64_t bytes = 0;
+  uint32_t errors = 0;
+  double activeMs = 0;
+  std::vector<double> latencies;     // Request sent to last byte
+  std::vector<double> firstByte;     // Request sent to response head
+  std::string error;
+};
+
+// ============================================
+// HTTP body decoding (chunked or plain)
+// ============================================
+class Body {
+ public:
+  Body(net::Reader& in, bool chunked) : in_(in), chunked_(chunked), left_(0), eof_(false) {}
+
+  bool read(uint8_t* out, size_t n) {
+    while (n > 0) {
+      if (!chunked_) {
+        return in_.readExact(n, out);
+      }
+      if (left_ == 0 && !nextChunk()) {
+        return false;
+      }
+      size_t take = n < left_ ? n : (size_t)left_;
+      if (!in_.readExact(take, out)) {
+        return false;
+      }
+      out += take;
+      n -= take;
+      left_ -= take;
+    }
+    return true;
+  }
+
+  bool skip(size_t n) {
+    uint8_t tmp[4096];
+    while (n > 0) {
+      size_t take = n < sizeof(tmp) ? n : sizeof(tmp);
+      if (!read(tmp, take)) {
+        return false;
+      }
+      n -= take;
+    }
+    return true;
+  }
+
+  bool readLine(std::string& line) {
+    line.clear();
+    uint8_t c;
+    while (read(&c, 1)) {
+      if (c == '\n') {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        return true;
+      }
+      line += (char)c;
+      if (line.size() > 1024) {
+        return false;
+      }
+    }
+    return false;
+  }
+
+ private:
+  bool nextChunk() {
+    std::string line;
+    if (eof_) {
+      return false;
+    }
+    if (consumedFirst_ && (!in_.readLine(line) || !line.empty())) {
+      return false;  // CRLF after the previous chunk's data
+    }
+    consumedFirst_ = true;
+    if (!in_.readLine(line)) {
+      return false;
+    }
+    left_ = strtoull(line.c_str(), nullptr, 16);
+    if (left_ == 0) {
+      eof_ = true;
+      return false;
+    }
+    return true;
+  }
+
+  net::Reader& in_;
+  bool chunked_;
+  uint64_t left_;
+  bool eof_;
+  bool consumedFirst_ = false;
+};
+
+static std::string request(const Options& o, const std::string& target, const std::string& extra = "") {
+  return "GET " + target + " HTTP/1.1\r\nHost: " + o.host + "\r\n" + extra + "Connection: close\r\n\r\n";
+}
+
+// Simple GET returning the body; used for file discovery
+static bool httpGet(const Options& o, const std::string& target, std::string& body) {
+  int fd = net::tcpConnect(o.host, o.port, o.timeoutMs);
+  if (fd < 0) {
+    return false;
+  }
+  net::Reader in(fd);
+  std::string head;
+  bool ok = net::sendAll(fd, request(o, target)) && in.readHead(head) && net::parseStatus(head) == 200;
+  if (ok) {
+    bool chunked = strcasestr(net::headerValue(head, "Transfer-Encoding").c_str(), "chunked") != nullptr;
+    std::string len = net::headerValue(head, "Content-Length");
+    if (!chunked && !len.empty()) {
+      ok = in.readExact((size_t)strtoull(len.c_str(), nullptr, 10), body);
+    } else {
+      Body b(in, chunked);
+      uint8_t c;
+      body.clear();
+      while (b.read(&c, 1)) body += (char)c;
+    }
+  }
+  net::closeSocket(fd);
+  return ok;
+}
+
+// ============================================
+// Clients
+// ============================================
+static void streamClient(const Options& o, const std::atomic<bool>& stop, StreamResult& r) {
+  double start = nowMs();
+  int fd = net::tcpConnect(o.host, o.port, o.timeoutMs);
+  if (fd < 0) {
+    r.errors++;
+    r.error = "connect failed";
+    return;
+  }
+  net::Reader in(fd);
+  std::string head;
+  if (!net::sendAll(fd, request(o, "/stream")) || !in.readHead(head) || net::parseStatus(head) != 200) {
+    r.errors++;
+    r.error = head.empty() ? "no response" : head.substr(0, head.find('\r'));
+    net::closeSocket(fd);
+    return;
+  }
+  bool chunked = strcasestr(net::headerValue(head, "Transfer-Encoding").c_str(), "chunked") != nullptr;
+  Body body(in, chunked);
+
+  double last = 0;
+  std::string line;
+  while (!stop) {
+    // --frame, part headers, blank line, JPEG, CRLF
+    if (!body.readLine(line)) {
+      r.errors++;
+      r.error = "stream ended";
+      break;
+    }
+    if (line.empty()) {
+      continue;
+    }
+    if (line.compare(0, 7, "--frame") != 0) {
+      r.errors++;
+      r.error = "bad boundary";
+      break;
+    }
+    size_t len = 0;
+    while (body.readLine(line) && !line.empty()) {
+      if (strncasecmp(line.c_str(), "Content-Length:", 15) == 0) {
+        len = (size_t)strtoull(line.c_str() + 15, nullptr, 10);
+      }
+    }
+    uint8_t soi[2];
+    if (len < 2 || !body.read(soi, 2) || !body.skip(len - 2)) {
+      r.errors++;
+      r.error = "short frame";
+      break;
+    }
+    if (soi[0] != 0xFF || soi[1] != 0xD8) {
+      r.errors++;  // Not a JPEG; count it but keep reading
+    }
+    double now = nowMs();
+    if (r.frames == 0) {
+      r.firstFrameMs = now - start;
+    } else {
+      r.intervals.push_back(now - last);
+    }
+    last = now;
+    r.frames++;
+    r.bytes += len;
+  }
+  r.activeMs = nowMs() - start;
+  net::closeSocket(fd);
+}
+
+// WebSocket upgrade for 'target'; 'in' keeps whatever the server sent
+// after the handshake
+static bool wsHandshake(const Options& o, int fd, net::Reader& in, const std::string& target, std::string& error) {
+  std::mt19937 rng(std::random_device{}());
+  uint8_t keyBytes[16];
+  for (uint8_t& b : keyBytes) b = (uint8_t)rng();
+  std::string key = net::base64(keyBytes, sizeof(keyBytes));
+
+  std::string head;
+  std::string extra = "Upgrade: websocket\r\nSec-WebSocket-Key: " + key + "\r\nSec-WebSocket-Version: 13\r\n";
+  std::string req = "GET " + target + " HTTP/1.1\r\nHost: " + o.host + "\r\nConnection: Upgrade\r\n" + extra + "\r\n";
+  if (!net::sendAll(fd, req) || !in.readHead(head) || net::parseStatus(head) != 101 ||
+      net::headerValue(head, "Sec-WebSocket-Accept") != net::websocketAccept(key)) {
+    error = head.empty() ? "no response" : "handshake failed";
+    return false;
+  }
+  return true;
+}
+
+static void audioClient(const Options& o, const std::atomic<bool>& stop, AudioResult& r) {
+  double start = nowMs();
+  int fd = net::tcpConnect(o.host, o.port, o.timeoutMs);
+  if (fd < 0) {
+    r.errors++;
+    r.error = "connect failed";
+    return;
+  }
+  net::Reader in(fd);
+  if (!wsHandshake(o, fd, in, "/audio", r.error)) {
+    r.errors++;
+    net::closeSocket(fd);
+    return;
+  }
+
+  double last = 0;
+  uint8_t opcode;
+  bool fin;
+  std::string payload;
+  while (!stop) {
+    if (!net::wsReadFrame(in, opcode, fin, payload)) {
+      r.errors++;
+      r.error = "socket closed";
+      break;
+    }
+    if (opcode == net::WS_PING) {
+      net::sendAll(fd, net::wsFrame(net::WS_PONG, (const uint8_t*)payload.data(), payload.size(), true));
+      continue;
+    }
+    if (opcode == net::WS_CLOSE) {
+      r.error = "server closed";
+      break;
+    }
+    if (opcode != net::WS_BINARY && opcode != net::WS_CONTINUATION) {
+      continue;
+    }
+    double now = nowMs();
+    if (r.messages > 0) {
+      double gap = now - last;
+      r.intervals.push_back(gap);
+      if (gap > o.gapMs) {
+        r.gaps++;
+      }
+      if (gap > r.maxGapMs) {
+        r.maxGapMs = gap;
+      }
+    }
+    last = now;
+    r.messages++;
+    r.bytes += payload.size();
+  }
+  r.activeMs = nowMs() - start;
+  uint8_t code[2] = {0x03, 0xE8};  // 1000 normal closure
+  net::sendAll(fd, net::wsFrame(net::WS_CLOSE, code, 2, true));
+  net::closeSocket(fd);
+}
+
+static double jsonNumber(const std::string& msg, const char* key) {
+  size_t at = msg.find(std::string("\"") + key + "\":");
+  return at == std::string::npos ? 0 : strtod(msg.c_str() + at + strlen(key) + 3, nullptr);
+}
+
+// /live viewer: acks each frame after --decode-ms like the page does after
+// decoding, pings twice a second to map device capture times onto our clock
+static void liveClient(const Options& o, const std::atomic<bool>& stop, LiveResult& r) {
+  double start = nowMs();
+  int fd = net::tcpConnect(o.host, o.port, o.timeoutMs);
+  if (fd < 0) {
+    r.errors++;
+    r.error = "connect failed";
+    return;
+  }
+  net::Reader in(fd);
+  if (!wsHandshake(o, fd, in, "/live", r.error)) {
+    r.errors++;
+    net::closeSocket(fd);
+    return;
+  }
+
+  auto sendText = [fd](const std::string& text) {
+    return net::sendAll(fd, net::wsFrame(net::WS_TEXT, (const uint8_t*)text.data(), text.size(), true));
+  };
+  std::vector<std::pair<double, uint32_t>> acks;   // Due time, frame seq
+  double nextPing = 0;
+  double lastFrame = 0;
+  int64_t nextSeq = -1;
+  uint8_t opcode;
+  bool fin;
+  std::string payload;
+  while (!stop) {
+    double now = nowMs();
+    if (now >= nextPing) {
+      char ping[64];
+      snprintf(ping, sizeof(ping), "{\"type\":\"ping\",\"t\":%.3f}", now);
+      sendText(ping);
+      nextPing = now + 500;
+    }
+    while (!acks.empty() && acks.front().first <= now) {
+      sendText("{\"type\":\"ack\",\"seq\":" + std::to_string(acks.front().second) + "}");
+      acks.erase(acks.begin());
+    }
+    if (!net::wsReadFrame(in, opcode, fin, payload)) {
+      r.errors++;
+      r.error = "socket closed";
+      break;
+    }
+    now = nowMs();
+    if (opcode == net::WS_PING) {
+      net::sendAll(fd, net::wsFrame(net::WS_PONG, (const uint8_t*)payload.data(), payload.size(), true));
+      continue;
+    }
+    if (opcode == net::WS_CLOSE) {
+      r.error = "server closed";
+      break;
+    }
+    if (opcode == net::WS_TEXT) {
+      if (payload.find("\"pong\"") != std::string::npos) {
+        double sent = jsonNumber(payload, "t");
+        double rtt = now - sent;
+        if (rtt < r.minRttMs) {
+          r.minRttMs = rtt;
+          r.offsetMs = jsonNumber(payload, "device") / 1000 - (sent + rtt / 2);
+        }
+      } else if (payload.find("\"stats\"") != std::string::npos) {
+        r.framesSkipped = (uint32_t)jsonNumber(payload, "framesSkipped");
+        r.blocksDropped = (uint32_t)jsonNumber(payload, "blocksDropped");
+      }
+      continue;
+    }
+    live::Header h;
+    if (opcode != net::WS_BINARY || !live::readHeader((const uint8_t*)payload.data(), payload.size(), h)) {
+      r.errors++;
+      continue;
+    }
+    r.bytes += payload.size();
+    if (h.type == live::LIVE_VIDEO) {
+      if (r.frames > 0) {
+        r.intervals.push_back(now - lastFrame);
+      }
+      lastFrame = now;
+      r.frames++;
+      r.video.push_back({now, h.captureUs});
+      acks.push_back({now + o.decodeMs, h.seq});
+    } else {
+      size_t samples = (payload.size() - LIVE_HEADER_SIZE) / 2;
+      if (nextSeq >= 0 && h.seq != (uint32_t)nextSeq) {
+        r.gaps += h.seq - (uint32_t)nextSeq;
+      }
+      nextSeq = h.seq + 1;
+      r.blocks++;
+      r.audio.push_back({now, h.captureUs + (int64_t)(samples * 1000000 / (h.rate ? h.rate : 16000))});
+    }
+  }
+  r.activeMs = nowMs() - start;
+  uint8_t code[2] = {0x03, 0xE8};
+  net::sendAll(fd, net::wsFrame(net::WS_CLOSE, code, 2, true));
+  net::closeSocket(fd);
+}
+
+// Capture-to-arrival times with the clock offset from the best ping
+static std::vector<double> liveLatencies(const LiveResult& r, const std::vector<std::pair<double, int64_t>>& v) {
+  std::vector<double> out;
+  for (const auto& a : v) {
+    out.push_back(a.first - (a.second / 1000.0 - r.offsetMs));
+  }
+  return out;
+}
+
+static void downloadClient(const Options& o, const std::string& path, uint64_t size,
+                           const std::atomic<bool>& stop, uint32_t seed, DownloadResult& r) {
+  std::mt19937 rng(seed);
+  uint64_t rangeBytes = (uint64_t)o.rangeKB * 1024;
+  std::string target = "/api/files/download?path=" + net::urlEncode(path);
+  double start = nowMs();
+
+  while (!stop) {
+    uint64_t offset = size > rangeBytes ? (rng() % (size - rangeBytes + 1)) : 0;
+    uint64_t end = std::min(size, offset + rangeBytes) - 1;
+    uint64_t expect = end - offset + 1;
+    char range[80];
+    snprintf(range, sizeof(range), "Range: bytes=%llu-%llu\r\n", (unsigned long long)offset, (unsigned long long)end);
+
+    double t0 = nowMs();
+    int fd = net::tcpConnect(o.host, o.port, o.timeoutMs);
+    if (fd < 0) {
+      r.errors++;
+      r.error = "connect failed";
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      continue;
+    }
+    net::Reader in(fd);
+    std::string head;
+    bool ok = net::sendAll(fd, request(o, target, range)) && in.readHead(head);
+    int status = ok ? net::parseStatus(head) : -1;
+    double t1 = nowMs();
+    uint64_t length = ok ? strtoull(net::headerValue(head, "Content-Length").c_str(), nullptr, 10) : 0;
+
+    if (status == 206 && length == expect && in.skip((size_t)length)) {
+      r.requests++;
+      r.bytes += length;
+      r.firstByte.push_back(t1 - t0);
+      r.latencies.push_back(nowMs() - t0);
+    } else {
+      r.errors++;
+      if (status == 200) {
+        r.error = "Range ignored (200)";
+      } else if (status > 0) {
+        r.error = "HTTP " + std::to_string(status);
+      } else {
+        r.error = "no response";
+      }
+    }
+    net::closeSocket(fd);
+  }
+  r.activeMs = nowMs() - start;
+}
+
+// Pick the largest file in /video (then /) from the listing JSON
+static bool discoverFile(const Options& o, std::string& path, uint64_t& size) {
+  const char* dirs[] = {"/video", "/"};
+  for (const char* dir : dirs) {
+    std::string body;
+    if (!httpGet(o, std::string("/api/files/list?path=") + net::urlEncode(dir), body)) {
+      continue;
+    }
+    size_t pos = 0;
+    size = 0;
+    while ((pos = body.find("\"name\":\"", pos)) != std::string::npos) {
+      pos += 8;
+      size_t endName = body.find('"', pos);
+      std::string name = body.substr(pos, endName - pos);
+      size_t sp = body.find("\"size\":", endName);
+      size_t dp = body.find("\"isDir\":", endName);
+      if (sp == std::string::npos || dp == std::string::npos) break;
+      uint64_t s = strtoull(body.c_str() + sp + 7, nullptr, 10);
+      bool isDir = body.compare(dp + 8, 4, "true") == 0;
+      if (!isDir && s > size) {
+        size = s;
+        // Devices return the bare name; some cores return the full path
+        path = name[0] == '/' ? name : (strcmp(dir, "/") == 0 ? "/" + name : std::string(dir) + "/" + name);
+      }
+      pos = endName;
+    }
+    if (size > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Size from a one-byte Range request
+static bool probeSize(const Options& o, const std::string& path, uint64_t& size) {
+  int fd = net::tcpConnect(o.host, o.port, o.timeoutMs);
+  if (fd < 0) {
+    return false;
+  }
+  net::Reader in(fd);
+  std::string head;
+  bool ok = net::sendAll(fd, request(o, "/api/files/download?path=" + net::urlEncode(path), "Range: bytes=0-0\r\n")) &&
+            in.readHead(head);
+  net::closeSocket(fd);
+  if (!ok) {
+    return false;
+  }
+  std::string cr = net::headerValue(head, "Content-Range");
+  size_t slash = cr.find('/');
+  if (net::parseStatus(head) == 206 && slash != std::string::npos) {
+    size = strtoull(cr.c_str() + slash + 1, nullptr, 10);
+    return size > 0;
+  }
+  return false;
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parseArgs(argc, argv, opt)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::string filePath = opt.file;
+  uint64_t fileSize = 0;
+  if (opt.downloads > 0) {
+    bool found = filePath.empty() ? discoverFile(opt, filePath, fileSize) : probeSize(opt, filePath, fileSize);
+    if (!found) {
+      fprintf(stderr, "❌ No file to download (use --file, or record something first)\n");
+      return 1;
+    }
+  }
+
+  printf("🔨 Load test %s:%u for %us: %u stream, %u audio, %u live, %u download client(s)\n",
+         opt.host.c_str(), opt.port, opt.seconds, opt.streams, opt.audio, opt.live, opt.downloads);
+  if (opt.downloads) {
+    printf("📁 Downloading %s (%llu bytes) in %u KB ranges\n", filePath.c_str(),
+           (unsigned long long)fileSize, opt.rangeKB);
+  }
+  fflush(stdout);
+
+  std::atomic<bool> stop(false);
+  std::vector<StreamResult> streams(opt.streams);
+  std::vector<AudioResult> audio(opt.audio);
+  std::vector<LiveResult> live(opt.live);
+  std::vector<DownloadResult> downloads(opt.downloads);
+  std::vector<std::thread> threads;
+
+  double start = nowMs();
+  for (uint32_t i = 0; i < opt.streams; i++) {
+    threads.emplace_back(streamClient, std::cref(opt), std::cref(stop), std::ref(streams[i]));
+    std::this_thread::sleep_for(std::chrono::milliseconds(opt.rampMs));
+  }
+  for (uint32_t i = 0; i < opt.audio; i++) {
+    threads.emplace_back(audioClient, std::cref(opt), std::cref(stop), std::ref(audio[i]));
+    std::this_thread::sleep_for(std::chrono::milliseconds(opt.rampMs));
+  }
+  for (uint32_t i = 0; i < opt.live; i++) {
+    threads.emplace_back(liveClient, std::cref(opt), std::cref(stop), std::ref(live[i]));
+    std::this_thread::sleep_for(std::chrono::milliseconds(opt.rampMs));
+  }
+  for (uint32_t i = 0; i < opt.downloads; i++) {
+    threads.emplace_back(downloadClient, std::cref(opt), std::cref(filePath), fileSize,
+                         std::cref(stop), 1000 + i, std::ref(downloads[i]));
+    std::this_thread::sleep_for(std::chrono::milliseconds(opt.rampMs));
+  }
+  double remaining = opt.seconds * 1000.0 - (nowMs() - start);
+  if (remaining > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds((int64_t)remaining));
+  }
+  stop = true;
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  // ============================================
+  // Report
+  // ============================================
+  uint32_t failures = 0;
+  uint32_t totalErrors = 0;
+  printf("\n📊 Results\n");
+  for (uint32_t i = 0; i < opt.streams; i++) {
+    const StreamResult& r = streams[i];
+    double secs = r.activeMs / 1000.0;
+    double fps = secs > 0 ? r.frames / secs : 0;
+    double jitter = stddev(r.intervals);
+    printf("  stream[%u]   %5u frames %6.2f fps %7.2f MB/s  interval p50 %6.1f p99 %6.1f ms  jitter %5.1f ms  first %6.0f ms%s%s\n",
+           i, r.frames, fps, secs > 0 ? r.bytes / 1048576.0 / secs : 0,
+           percentile(r.intervals, 0.5), percentile(r.intervals, 0.99), jitter, r.firstFrameMs,
+           r.error.empty() ? "" : "  ⚠️ ", r.error.c_str());
+    totalErrors += r.errors;
+    if ((opt.minFps > 0 && fps < opt.minFps) || (opt.maxJitterMs > 0 && jitter > opt.maxJitterMs)) {
+      failures++;
+    }
+  }
+  for (uint32_t i = 0; i < opt.audio; i++) {
+    const AudioResult& r = audio[i];
+    double secs = r.activeMs / 1000.0;
+    printf("  audio[%u]    %5u msgs  %7.0f samples/s  gaps %u (max %.0f ms)  interval p50 %5.1f p99 %6.1f ms%s%s\n",
+           i, r.messages, secs > 0 ? r.bytes / 2.0 / secs : 0, r.gaps, r.maxGapMs,
+           percentile(r.intervals, 0.5), percentile(r.intervals, 0.99),
+           r.error.empty() ? "" : "  ⚠️ ", r.error.c_str());
+    totalErrors += r.errors;
+    if (r.gaps > opt.maxGaps || r.messages == 0) {
+      failures++;
+    }
+  }
+  for (uint32_t i = 0; i < opt.live; i++) {
+    const LiveResult& r = live[i];
+    double secs = r.activeMs / 1000.0;
+    std::vector<double> video = liveLatencies(r, r.video);
+    std::vector<double> audio = liveLatencies(r, r.audio);
+    double p99 = percentile(video, 0.99);
+    printf("  live[%u]     %5u frames %6.2f fps  skipped %u  latency p50 %5.1f p99 %5.1f ms  audio %u blocks gaps %u "
+           "dropped %u  latency p50 %5.1f ms  rtt %.1f ms%s%s\n",
+           i, r.frames, secs > 0 ? r.frames / secs : 0, r.framesSkipped, percentile(video, 0.5), p99, r.blocks, r.gaps,
+           r.blocksDropped, percentile(audio, 0.5), r.minRttMs, r.error.empty() ? "" : "  ⚠️ ", r.error.c_str());
+    totalErrors += r.errors;
+    if ((opt.maxLiveMs > 0 && p99 > opt.maxLiveMs) || r.gaps > opt.maxGaps || r.frames == 0) {
+      failures++;
+    }
+  }
+  for (uint32_t i = 0; i < opt.downloads; i++) {
+    const DownloadResult& r = downloads[i];
+    double secs = r.activeMs / 1000.0;
+    double p99 = percentile(r.latencies, 0.99);
+    printf("  download[%u] %5u reqs  %7.2f MB/s  latency p50 %6.1f p99 %6.1f ms  first byte p50 %5.1f ms  errors %u%s%s\n",
+           i, r.requests, secs > 0 ? r.bytes / 1048576.0 / secs : 0,
+           percentile(r.latencies, 0.5), p99, percentile(r.firstByte, 0.5), r.errors,
+           r.error.empty() ? "" : "  ⚠️ ", r.error.c_str());
+    totalErrors += r.errors;
+    if ((opt.maxP99Ms > 0 && p99 > opt.maxP99Ms) || r.requests == 0) {
+      failures++;
+    }
+  }
+  if (totalErrors > opt.maxErrors) {
+    failures++;
+  }
+  printf("  errors total %u\n", totalErrors);
+
+  if (failures) {
+    printf("\n❌ %u limit(s) missed\n", failures);
+    return 3;
+  }
+  printf("\n✅ All clients within limits\n");
+  return 0;
+}
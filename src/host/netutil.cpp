@@ -0,0 +1,416 @@
+#include "netutil.h"
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <random>
+
+namespace net {
+
+// ============================================
+// Sockets
+// ============================================
+static void setTimeouts(int fd, uint32_t timeoutMs) {
+  struct timeval tv;
+  tv.tv_sec = timeoutMs / 1000;
+  tv.tv_usec = (timeoutMs % 1000) * 1000;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+int tcpConnect(const std::string& host, uint16_t port, uint32_t timeoutMs) {
+  // A peer closing mid-write should fail the write, not kill the process
+  signal(SIGPIPE, SIG_IGN);
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* res = nullptr;
+  char portStr[8];
+  snprintf(portStr, sizeof(portStr), "%u", port);
+  if (getaddrinfo(host.c_str(), portStr, &hints, &res) != 0 || !res) {
+    return -1;
+  }
+  int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  if (fd >= 0) {
+    setTimeouts(fd, timeoutMs);
+    if (connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+      close(fd);
+      fd = -1;
+    } else {
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+
+int tcpListen(uint16_t port) {
+  signal(SIGPIPE, SIG_IGN);
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+void closeSocket(int fd) {
+  if (fd >= 0) {
+    shutdown(fd, SHUT_RDWR);
+    close(fd);
+  }
+}
+
+bool sendAll(int fd, const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+  while (len > 0) {
+    ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+bool sendAll(int fd, const std::string& s) {
+  return sendAll(fd, s.data(), s.size());
+}
+
+// ============================================
+// Reader
+// ============================================
+bool Reader::fill() {
+  if (pos_ > 0 && pos_ == buf_.size()) {
+    buf_.clear();
+    pos_ = 0;
+  } else if (pos_ > 65536) {
+    buf_.erase(0, pos_);
+    pos_ = 0;
+  }
+  char tmp[16384];
+  ssize_t n;
+  do {
+    n = recv(fd_, tmp, sizeof(tmp), 0);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0) {
+    return false;
+  }
+  buf_.append(tmp, (size_t)n);
+  return true;
+}
+
+bool Reader::readLine(std::string& line) {
+  for (;;) {
+    size_t eol = buf_.find("\r\n", pos_);
+    if (eol != std::string::npos) {
+      line.assign(buf_, pos_, eol - pos_);
+      pos_ = eol + 2;
+      return true;
+    }
+    if (buf_.size() - pos_ > 8192 || !fill()) {
+      return false;
+    }
+  }
+}
+
+bool Reader::readHead(std::string& head) {
+  for (;;) {
+    size_t end = buf_.find("\r\n\r\n", pos_);
+    if (end != std::string::npos) {
+      head.assign(buf_, pos_, end + 2 - pos_);
+      pos_ = end + 4;
+      return true;
+    }
+    if (buf_.size() - pos_ > 16384 || !fill()) {
+      return false;
+    }
+  }
+}
+
+bool Reader::readExact(size_t n, std::string& out) {
+  out.clear();
+  while (out.size() < n) {
+    if (pos_ == buf_.size() && !fill()) {
+      return false;
+    }
+    size_t take = buf_.size() - pos_;
+    if (take > n - out.size()) take = n - out.size();
+    out.append(buf_, pos_, take);
+    pos_ += take;
+  }
+  return true;
+}
+
+bool Reader::readExact(size_t n, uint8_t* out) {
+  size_t got = 0;
+  while (got < n) {
+    if (pos_ == buf_.size() && !fill()) {
+      return false;
+    }
+    size_t take = buf_.size() - pos_;
+    if (take > n - got) take = n - got;
+    memcpy(out + got, buf_.data() + pos_, take);
+    pos_ += take;
+    got += take;
+  }
+  return true;
+}
+
+bool Reader::skip(size_t n) {
+  while (n > 0) {
+    if (pos_ == buf_.size() && !fill()) {
+      return false;
+    }
+    size_t take = buf_.size() - pos_;
+    if (take > n) take = n;
+    pos_ += take;
+    n -= take;
+  }
+  return true;
+}
+
+// ============================================
+// HTTP helpers
+// ============================================
+std::string headerValue(const std::string& head, const char* name) {
+  size_t nameLen = strlen(name);
+  size_t pos = head.find("\r\n");
+  while (pos != std::string::npos && pos + 2 < head.size()) {
+    size_t start = pos + 2;
+    size_t end = head.find("\r\n", start);
+    if (end == std::string::npos) end = head.size();
+    if (end - start > nameLen && head[start + nameLen] == ':' &&
+        strncasecmp(head.c_str() + start, name, nameLen) == 0) {
+      size_t v = start + nameLen + 1;
+      while (v < end && (head[v] == ' ' || head[v] == '\t')) v++;
+      return head.substr(v, end - v);
+    }
+    pos = end;
+  }
+  return "";
+}
+
+bool parseRequestLine(const std::string& head, std::string& method, std::string& target) {
+  size_t sp1 = head.find(' ');
+  size_t sp2 = sp1 == std::string::npos ? sp1 : head.find(' ', sp1 + 1);
+  if (sp2 == std::string::npos) {
+    return false;
+  }
+  method = head.substr(0, sp1);
+  target = head.substr(sp1 + 1, sp2 - sp1 - 1);
+  return true;
+}
+
+int parseStatus(const std::string& head) {
+  int code;
+  if (sscanf(head.c_str(), "HTTP/%*s %d", &code) != 1) {
+    return -1;
+  }
+  return code;
+}
+
+std::string urlDecode(const std::string& s) {
+  std::string out;
+  for (size_t i = 0; i < s.size(); i++) {
+    if (s[i] == '%' && i + 2 < s.size() && isxdigit((unsigned char)s[i + 1]) && isxdigit((unsigned char)s[i + 2])) {
+      char hex[3] = {s[i + 1], s[i + 2], 0};
+      out += (char)strtol(hex, nullptr, 16);
+      i += 2;
+    } else if (s[i] == '+') {
+      out += ' ';
+    } else {
+      out += s[i];
+    }
+  }
+  return out;
+}
+
+std::string urlEncode(const std::string& s) {
+  std::string out;
+  char hex[4];
+  for (unsigned char c : s) {
+    if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~' || c == '/') {
+      out += (char)c;
+    } else {
+      snprintf(hex, sizeof(hex), "%%%02X", c);
+      out += hex;
+    }
+  }
+  return out;
+}
+
+std::string queryParam(const std::string& target, const char* name) {
+  size_t q = target.find('?');
+  if (q == std::string::npos) {
+    return "";
+  }
+  size_t nameLen = strlen(name);
+  size_t pos = q + 1;
+  while (pos < target.size()) {
+    size_t amp = target.find('&', pos);
+    if (amp == std::string::npos) amp = target.size();
+    if (amp - pos > nameLen && target.compare(pos, nameLen, name) == 0 && target[pos + nameLen] == '=') {
+      return urlDecode(target.substr(pos + nameLen + 1, amp - pos - nameLen - 1));
+    }
+    pos = amp + 1;
+  }
+  return "";
+}
+
+// ============================================
+// WebSocket
+// ============================================
+// SHA-1 is only needed for the handshake accept value
+static void sha1(const uint8_t* data, size_t len, uint8_t out[20]) {
+  uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+  std::string msg((const char*)data, len);
+  uint64_t bitLen = (uint64_t)len * 8;
+  msg += (char)0x80;
+  while (msg.size() % 64 != 56) msg += (char)0;
+  for (int i = 7; i >= 0; i--) msg += (char)(bitLen >> (i * 8));
+
+  for (size_t off = 0; off < msg.size(); off += 64) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+      const uint8_t* p = (const uint8_t*)msg.data() + off + i * 4;
+      w[i] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+    for (int i = 16; i < 80; i++) {
+      uint32_t x = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+      w[i] = (x << 1) | (x >> 31);
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+      uint32_t f, k;
+      if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+      else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+      else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+      else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+      uint32_t t = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+      e = d; d = c; c = (b << 30) | (b >> 2); b = a; a = t;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+  }
+  for (int i = 0; i < 5; i++) {
+    out[i * 4] = (uint8_t)(h[i] >> 24);
+    out[i * 4 + 1] = (uint8_t)(h[i] >> 16);
+    out[i * 4 + 2] = (uint8_t)(h[i] >> 8);
+    out[i * 4 + 3] = (uint8_t)h[i];
+  }
+}
+
+std::string base64(const uint8_t* data, size_t len) {
+  static const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string out;
+  for (size_t i = 0; i < len; i += 3) {
+    uint32_t v = (uint32_t)data[i] << 16;
+    if (i + 1 < len) v |= (uint32_t)data[i + 1] << 8;
+    if (i + 2 < len) v |= data[i + 2];
+    out += kAlphabet[(v >> 18) & 63];
+    out += kAlphabet[(v >> 12) & 63];
+    out += i + 1 < len ? kAlphabet[(v >> 6) & 63] : '=';
+    out += i + 2 < len ? kAlphabet[v & 63] : '=';
+  }
+  return out;
+}
+
+std::string websocketAccept(const std::string& key) {
+  std::string s = key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+  uint8_t digest[20];
+  sha1((const uint8_t*)s.data(), s.size(), digest);
+  return base64(digest, sizeof(digest));
+}
+
+std::string wsFrame(WsOpcode opcode, const uint8_t* data, size_t len, bool mask) {
+  std::string f;
+  f += (char)(0x80 | opcode);
+  uint8_t maskBit = mask ? 0x80 : 0;
+  if (len < 126) {
+    f += (char)(maskBit | len);
+  } else if (len < 65536) {
+    f += (char)(maskBit | 126);
+    f += (char)(len >> 8);
+    f += (char)len;
+  } else {
+    f += (char)(maskBit | 127);
+    for (int i = 7; i >= 0; i--) f += (char)((uint64_t)len >> (i * 8));
+  }
+  if (!mask) {
+    f.append((const char*)data, len);
+    return f;
+  }
+  static thread_local std::mt19937 rng(std::random_device{}());
+  uint32_t key = rng();
+  uint8_t k[4] = {(uint8_t)(key >> 24), (uint8_t)(key >> 16), (uint8_t)(key >> 8), (uint8_t)key};
+  f.append((const char*)k, 4);
+  for (size_t i = 0; i < len; i++) {
+    f += (char)(data[i] ^ k[i & 3]);
+  }
+  return f;
+}
+
+bool wsReadFrame(Reader& in, uint8_t& opcode, bool& fin, std::string& payload) {
+  uint8_t hdr[2];
+  if (!in.readExact(2, hdr)) {
+    return false;
+  }
+  fin = (hdr[0] & 0x80) != 0;
+  opcode = hdr[0] & 0x0F;
+  bool masked = (hdr[1] & 0x80) != 0;
+  uint64_t len = hdr[1] & 0x7F;
+  if (len == 126) {
+    uint8_t ext[2];
+    if (!in.readExact(2, ext)) return false;
+    len = ((uint64_t)ext[0] << 8) | ext[1];
+  } else if (len == 127) {
+    uint8_t ext[8];
+    if (!in.readExact(8, ext)) return false;
+    len = 0;
+    for (int i = 0; i < 8; i++) len = (len << 8) | ext[i];
+  }
+  if (len > (16u << 20)) {
+    return false;  // Nothing here sends frames this large
+  }
+  uint8_t key[4] = {0, 0, 0, 0};
+  if (masked && !in.readExact(4, key)) {
+    return false;
+  }
+  if (!in.readExact((size_t)len, payload)) {
+    return false;
+  }
+  if (masked) {
+    for (size_t i = 0; i < payload.size(); i++) {
+      payload[i] ^= (char)key[i & 3];
+    }
+  }
+  return true;
+}
+
+}  // namespace net
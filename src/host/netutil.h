@@ -0,0 +1,76 @@
+#pragma once
+
+// ============================================
+// Minimal HTTP/1.1 and WebSocket plumbing for the host tools
+// ============================================
+// Blocking POSIX sockets, one thread per connection. Enough of HTTP for
+// the simulated server (sim_server.cpp) and the load generator to talk to
+// each other and to ESPAsyncWebServer on a real device.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace net {
+
+// Connect with send/receive timeouts; returns the socket or -1
+int tcpConnect(const std::string& host, uint16_t port, uint32_t timeoutMs);
+// Listening socket on all interfaces; returns the socket or -1
+int tcpListen(uint16_t port);
+void closeSocket(int fd);
+
+bool sendAll(int fd, const void* data, size_t len);
+bool sendAll(int fd, const std::string& s);
+
+// Buffered reader over a socket
+class Reader {
+ public:
+  explicit Reader(int fd) : fd_(fd), pos_(0) {}
+
+  // Line without the trailing CRLF
+  bool readLine(std::string& line);
+  // Request/status line plus headers, up to the blank line
+  bool readHead(std::string& head);
+  bool readExact(size_t n, std::string& out);
+  bool readExact(size_t n, uint8_t* out);
+  // Discard exactly 'n' bytes
+  bool skip(size_t n);
+
+ private:
+  bool fill();
+
+  int fd_;
+  std::string buf_;
+  size_t pos_;
+};
+
+// Case-insensitive header lookup in a head block; "" when absent
+std::string headerValue(const std::string& head, const char* name);
+// "GET /path?x HTTP/1.1" -> method, target
+bool parseRequestLine(const std::string& head, std::string& method, std::string& target);
+// "HTTP/1.1 206 Partial Content" -> 206, or -1
+int parseStatus(const std::string& head);
+// Value of 'name' in a query string, percent-decoded
+std::string queryParam(const std::string& target, const char* name);
+std::string urlDecode(const std::string& s);
+std::string urlEncode(const std::string& s);
+
+// Sec-WebSocket-Accept for a Sec-WebSocket-Key (RFC 6455 section 4.2.2)
+std::string websocketAccept(const std::string& key);
+std::string base64(const uint8_t* data, size_t len);
+
+enum WsOpcode : uint8_t {
+  WS_CONTINUATION = 0x0,
+  WS_TEXT = 0x1,
+  WS_BINARY = 0x2,
+  WS_CLOSE = 0x8,
+  WS_PING = 0x9,
+  WS_PONG = 0xA
+};
+
+// One unfragmented frame; clients must mask, servers must not
+std::string wsFrame(WsOpcode opcode, const uint8_t* data, size_t len, bool mask);
+// Read one frame (unmasking if needed); 'fin' false for fragments
+bool wsReadFrame(Reader& in, uint8_t& opcode, bool& fin, std::string& payload);
+
+}  // namespace net
@@ -0,0 +1,145 @@
+// ============================================
+// Resampler measurement ([env:resample])
+// ============================================
+// Runs every built-in filter against sine sweeps at 16 kHz and reports:
+//   - passband ripple: spread of the gain across tones up to the pass edge
+//   - stopband rejection: level of what comes out (the alias) for tones
+//     from the stop edge up to 8 kHz, relative to the input
+//   - throughput: input samples per second through 256-sample blocks, the
+//     size the capture ring hands the streaming task
+// Exit status is 2 if a filter misses the ripple or rejection limit.
+//
+//   pio run -e resample && .pio/build/resample/program
+//   .pio/build/resample/program --ripple 0.1 --reject 60 -v
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "resampler.h"
+
+static const uint32_t kInRate = 16000;
+static const double kAmplitude = 16384;   // -6 dBFS
+static const size_t kBlock = 256;
+
+static std::vector<int16_t> run(resample::Resampler& rs, const std::vector<int16_t>& in) {
+  std::vector<int16_t> out(rs.maxOutput(in.size()));
+  rs.reset();
+  out.resize(rs.process(in.data(), in.size(), out.data(), out.size()));
+  return out;
+}
+
+static std::vector<int16_t> tone(double hz, double seconds) {
+  std::vector<int16_t> pcm((size_t)(seconds * kInRate));
+  for (size_t i = 0; i < pcm.size(); i++) {
+    pcm[i] = (int16_t)lrint(kAmplitude * sin(2 * M_PI * hz * i / kInRate));
+  }
+  return pcm;
+}
+
+// Amplitude of the 'hz' component, by projection onto sin/cos
+static double amplitudeAt(const std::vector<int16_t>& pcm, size_t skip, double hz, uint32_t rate) {
+  double s = 0, c = 0;
+  size_t n = 0;
+  for (size_t i = skip; i < pcm.size(); i++, n++) {
+    double phase = 2 * M_PI * hz * i / rate;
+    s += pcm[i] * sin(phase);
+    c += pcm[i] * cos(phase);
+  }
+  return n ? 2 * sqrt(s * s + c * c) / n : 0;
+}
+
+static double rms(const std::vector<int16_t>& pcm, size_t skip) {
+  double sum = 0;
+  for (size_t i = skip; i < pcm.size(); i++) sum += (double)pcm[i] * pcm[i];
+  return pcm.size() > skip ? sqrt(sum / (pcm.size() - skip)) : 0;
+}
+
+int main(int argc, char** argv) {
+  double maxRippleDb = 0.5;
+  double minRejectDb = 55;
+  bool verbose = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--ripple") && i + 1 < argc) {
+      maxRippleDb = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--reject") && i + 1 < argc) {
+      minRejectDb = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "-v")) {
+      verbose = true;
+    } else {
+      printf("Usage: %s [--ripple DB] [--reject DB] [-v]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  bool failed = false;
+  for (size_t f = 0; f < resample::kFilterCount; f++) {
+    const resample::Filter& filter = resample::kFilters[f];
+    const uint32_t outRate = kInRate * filter.up / filter.down;
+    resample::Resampler rs;
+    if (!rs.begin(kInRate, outRate)) {
+      printf("❌ no filter for %u -> %u Hz\n", (unsigned)kInRate, (unsigned)outRate);
+      failed = true;
+      continue;
+    }
+    printf("== %u -> %u Hz (%u/%u, %u taps per phase)\n", (unsigned)kInRate, (unsigned)outRate,
+           filter.up, filter.down, filter.taps);
+    const size_t skip = filter.taps;   // Filter start-up
+
+    // Passband
+    double minGain = 1e9, maxGain = -1e9;
+    for (double hz = 50; hz <= filter.passbandHz; hz += 50) {
+      std::vector<int16_t> out = run(rs, tone(hz, 0.5));
+      double gainDb = 20 * log10(amplitudeAt(out, skip, hz, outRate) / kAmplitude);
+      minGain = gainDb < minGain ? gainDb : minGain;
+      maxGain = gainDb > maxGain ? gainDb : maxGain;
+      if (verbose) printf("  pass %6.0f Hz  %+6.3f dB\n", hz, gainDb);
+    }
+    const double ripple = maxGain - minGain;
+
+    // Stopband: any output is alias
+    double worstDb = -200, worstHz = 0;
+    for (double hz = filter.stopbandHz; hz < kInRate / 2; hz += 50) {
+      std::vector<int16_t> out = run(rs, tone(hz, 0.5));
+      double levelDb = 20 * log10((rms(out, skip) + 1e-9) / (kAmplitude / M_SQRT2));
+      if (levelDb > worstDb) {
+        worstDb = levelDb;
+        worstHz = hz;
+      }
+      if (verbose) printf("  stop %6.0f Hz  %+6.1f dB\n", hz, levelDb);
+    }
+    const double reject = -worstDb;
+
+    // Throughput on noise, in capture-sized blocks
+    std::vector<int16_t> noise(kInRate * 60);
+    uint32_t seed = 1;
+    for (auto& s : noise) {
+      seed = seed * 1664525u + 1013904223u;
+      s = (int16_t)(seed >> 16);
+    }
+    std::vector<int16_t> out(rs.maxOutput(kBlock));
+    rs.reset();
+    size_t produced = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t at = 0; at + kBlock <= noise.size(); at += kBlock) {
+      produced += rs.process(&noise[at], kBlock, out.data(), out.size());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    const double msps = noise.size() / seconds / 1e6;
+    const double blockUs = seconds * 1e6 * kBlock / noise.size();
+
+    const bool rippleOk = ripple <= maxRippleDb;
+    const bool rejectOk = reject >= minRejectDb;
+    printf("  %s passband ripple %.3f dB (0-%.0f Hz, gain %+.3f..%+.3f dB, limit %.2f)\n",
+           rippleOk ? "✓" : "❌", ripple, filter.passbandHz, minGain, maxGain, maxRippleDb);
+    printf("  %s stopband rejection %.1f dB (%.0f-%u Hz, worst at %.0f Hz, limit %.0f)\n",
+           rejectOk ? "✓" : "❌", reject, filter.stopbandHz, (unsigned)kInRate / 2, worstHz, minRejectDb);
+    printf("  throughput %.1f Msamples/s (%.0fx real time), %.2f us per %zu-sample block, %zu out\n",
+           msps, msps * 1e6 / kInRate, blockUs, kBlock, produced);
+    failed |= !rippleOk || !rejectOk;
+  }
+  return failed ? 2 : 0;
+}
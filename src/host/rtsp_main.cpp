@@ -0,0 +1,835 @@
+// ============================================
+// RTSP/RTP host test ([env:rtsp])
+// ============================================
+// Serves JPEG fixtures and a test tone through rtsp::Session on host
+// sockets, the same session code the firmware runs, and checks it with a
+// built-in RTSP client over interleaved TCP and over UDP, for each audio
+// codec:
+//   - RTSP: status codes, SDP, Transport, Session and RTP-Info headers
+//   - Video: every RFC 2435 frame reassembles, rebuilds into a JPEG that
+//     parses to the same size, type, quantization tables and scan bytes
+//   - Audio: no sequence or timestamp gaps, tone level survives the codec
+//   - RTCP: sender reports on both streams that put audio and video on
+//     the same wall clock
+// Exits 2 when a check fails. --serve keeps the server up for a real
+// player (ffplay, VLC, GStreamer); --dump writes the rebuilt JPEGs.
+//
+//   .pio/build/rtsp/program --serve 8554 bench/rtsp/*.jpg &
+//   ffplay -rtsp_transport tcp rtsp://127.0.0.1:8554/live
+
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "netutil.h"
+#include "rtp.h"
+#include "rtsp.h"
+
+#define TONE_HZ 440
+#define TONE_AMPLITUDE 8000
+#define AUDIO_BLOCK 256
+#define MAX_SKEW_MS 20
+
+struct Options {
+  std::vector<std::string> files;
+  uint32_t fps = 15;
+  uint32_t rate = 16000;
+  double seconds = 2;
+  uint16_t serve = 0;
+  uint16_t udpPort = 6970;
+  std::string dump;
+};
+
+static void usage(const char* prog) {
+  printf("Usage: %s [options] frame.jpg...\n"
+         "  --fps N           Video frame rate (default 15)\n"
+         "  --rate HZ         Capture rate for L16 audio (default 16000)\n"
+         "  --seconds N       Playback per self-test run (default 2)\n"
+         "  --serve PORT      Serve rtsp://127.0.0.1:PORT/live until killed\n"
+         "  --udp-port N      Server RTP port with --serve (default 6970)\n"
+         "  --dump DIR        Write the JPEGs rebuilt from RTP\n",
+         prog);
+}
+
+static int64_t monotonicUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static int64_t unixUs() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static bool readFile(const std::string& path, std::vector<uint8_t>& out) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) {
+    return false;
+  }
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    out.insert(out.end(), buf, buf + n);
+  }
+  fclose(f);
+  return true;
+}
+
+// Two UDP sockets on consecutive ports (RTP, RTCP); 'port' 0 picks any
+static bool udpPair(uint16_t port, int fds[2], uint16_t& bound) {
+  for (int attempt = 0; attempt < 32; attempt++) {
+    uint16_t base = port;
+    fds[0] = fds[1] = -1;
+    for (int i = 0; i < 2; i++) {
+      fds[i] = socket(AF_INET, SOCK_DGRAM, 0);
+      int size = 1 << 20;
+      setsockopt(fds[i], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+      struct sockaddr_in addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_ANY);
+      addr.sin_port = htons(i == 0 ? base : (uint16_t)(base + 1));
+      if (bind(fds[i], (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        break;
+      }
+      if (i == 0 && base == 0) {
+        socklen_t len = sizeof(addr);
+        getsockname(fds[0], (struct sockaddr*)&addr, &len);
+        base = ntohs(addr.sin_port);
+        if (base & 1) {
+          break;   // RTP on an even port
+        }
+      }
+      if (i == 1) {
+        bound = base;
+        return true;
+      }
+    }
+    for (int i = 0; i < 2; i++) {
+      if (fds[i] >= 0) {
+        close(fds[i]);
+      }
+    }
+    if (port) {
+      return false;
+    }
+  }
+  return false;
+}
+
+// ============================================
+// Server
+// ============================================
+struct Media {
+  std::vector<std::vector<uint8_t>> frames;
+  uint32_t fps;
+  uint32_t rate;
+};
+
+class SocketLink : public rtsp::Link {
+ public:
+  SocketLink(int fd, const int udp[2]) : fd_(fd), udp_{udp[0], udp[1]} {
+    socklen_t len = sizeof(peer_);
+    getpeername(fd, (struct sockaddr*)&peer_, &len);
+  }
+
+  bool sendTcp(const uint8_t* data, size_t len) override { return net::sendAll(fd_, data, len); }
+
+  bool sendUdp(uint16_t port, bool rtcp, const uint8_t* data, size_t len) override {
+    struct sockaddr_in to = peer_;
+    to.sin_port = htons(port);
+    return sendto(udp_[rtcp ? 1 : 0], data, len, 0, (struct sockaddr*)&to, sizeof(to)) == (ssize_t)len;
+  }
+
+ private:
+  int fd_;
+  int udp_[2];
+  struct sockaddr_in peer_;
+};
+
+// One client until it disconnects or tears down; same pacing as rtspTask
+static void serveClient(int fd, const Media& media, const int udp[2], uint16_t udpPort, uint32_t seed) {
+  SocketLink link(fd, udp);
+  rtsp::Session session;
+  session.begin({"Video-Streamer", rtsp::AUDIO_L16, media.rate, udpPort}, seed);
+
+  size_t frameIndex = 0;
+  int64_t nextFrameUs = 0;
+  int64_t audioStartUs = 0;
+  uint64_t audioSamples = 0;
+  int16_t pcm[AUDIO_BLOCK];
+  uint8_t buf[2048];
+  for (;;) {
+    struct pollfd p = {fd, POLLIN, 0};
+    if (poll(&p, 1, 2) > 0) {
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+      if (n <= 0 || !session.receive(buf, (size_t)n, monotonicUs(), link)) {
+        break;
+      }
+    }
+    const int64_t now = monotonicUs();
+
+    if (!session.playing(rtsp::VIDEO)) {
+      nextFrameUs = now;
+    } else if (now >= nextFrameUs) {
+      const std::vector<uint8_t>& frame = media.frames[frameIndex++ % media.frames.size()];
+      if (!session.sendFrame(frame.data(), frame.size(), nextFrameUs, link)) {
+        break;
+      }
+      nextFrameUs += 1000000 / media.fps;
+    }
+
+    const uint32_t rate = session.audioRate();
+    if (!session.playing(rtsp::AUDIO)) {
+      audioStartUs = now;
+      audioSamples = 0;
+    } else {
+      bool ok = true;
+      while (ok && now >= audioStartUs + (int64_t)((audioSamples + AUDIO_BLOCK) * 1000000 / rate)) {
+        for (int i = 0; i < AUDIO_BLOCK; i++) {
+          pcm[i] = (int16_t)lrint(TONE_AMPLITUDE * sin(2 * M_PI * TONE_HZ * (double)(audioSamples + i) / rate));
+        }
+        ok = session.sendAudio(pcm, AUDIO_BLOCK, audioStartUs + (int64_t)(audioSamples * 1000000 / rate), link);
+        audioSamples += AUDIO_BLOCK;
+      }
+      if (!ok) {
+        break;
+      }
+    }
+
+    if (!session.sendReports(now, unixUs(), link)) {
+      break;
+    }
+  }
+  if (session.framesSkipped()) {
+    printf("  server skipped %u frames: %s\n", (unsigned)session.framesSkipped(), session.lastError());
+  }
+  net::closeSocket(fd);
+}
+
+static int listenAny(uint16_t port, uint16_t& bound) {
+  int fd = net::tcpListen(port);
+  if (fd < 0) {
+    return -1;
+  }
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  getsockname(fd, (struct sockaddr*)&addr, &len);
+  bound = ntohs(addr.sin_port);
+  return fd;
+}
+
+// ============================================
+// Client
+// ============================================
+// JPEG headers for a reassembled RFC 2435 frame (RFC 2435 appendix A)
+static std::vector<uint8_t> rebuildJpeg(uint8_t type, uint16_t width, uint16_t height, uint16_t restartInterval,
+                                        const uint8_t* qtables, const std::vector<uint8_t>& scan) {
+  std::vector<uint8_t> out = {0xFF, 0xD8};
+  auto marker = [&](uint8_t code, size_t len) {
+    out.insert(out.end(), {0xFF, code, (uint8_t)((len + 2) >> 8), (uint8_t)(len + 2)});
+  };
+  for (int t = 0; t < 2; t++) {
+    marker(0xDB, 65);
+    out.push_back((uint8_t)t);
+    out.insert(out.end(), qtables + 64 * t, qtables + 64 * (t + 1));
+  }
+  marker(0xC0, 15);
+  out.insert(out.end(), {8, (uint8_t)(height >> 8), (uint8_t)height, (uint8_t)(width >> 8), (uint8_t)width, 3,
+                         1, (uint8_t)((type & 63) == 0 ? 0x21 : 0x22), 0, 2, 0x11, 1, 3, 0x11, 1});
+  for (const uint8_t* table : {rtp::kStdDcLuma, rtp::kStdAcLuma, rtp::kStdDcChroma, rtp::kStdAcChroma}) {
+    size_t len = 17;
+    for (int i = 1; i <= 16; i++) {
+      len += table[i];
+    }
+    marker(0xC4, len);
+    out.insert(out.end(), table, table + len);
+  }
+  if (type >= 64) {
+    marker(0xDD, 2);
+    out.insert(out.end(), {(uint8_t)(restartInterval >> 8), (uint8_t)restartInterval});
+  }
+  marker(0xDA, 10);
+  out.insert(out.end(), {3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0});
+  out.insert(out.end(), scan.begin(), scan.end());
+  out.insert(out.end(), {0xFF, 0xD9});
+  return out;
+}
+
+struct Expected {
+  rtp::JpegInfo info;
+};
+
+struct Received {
+  // Reassembly
+  bool inFrame = false;
+  bool broken = false;
+  uint32_t frameTs = 0;
+  uint8_t type = 0, q = 0;
+  uint16_t width = 0, height = 0, restartInterval = 0;
+  uint8_t qtables[128];
+  bool haveTables = false;
+  std::vector<uint8_t> scan;
+  // Results
+  uint32_t framesOk = 0, framesBad = 0, videoPackets = 0;
+  uint32_t audioPackets = 0, audioGaps = 0, audioSamples = 0;
+  double audioSquares = 0;
+  int32_t nextSeq[2] = {-1, -1};
+  uint32_t seqGaps[2] = {0, 0};
+  int64_t audioNextTs = -1;
+  uint32_t srCount[2] = {0, 0};
+  bool cname[2] = {false, false};
+  uint32_t ssrc[2] = {0, 0};
+  // Last sender report, and (rtp timestamp, arrival) of each packet
+  int64_t srUnixUs[2] = {0, 0};
+  uint32_t srTs[2] = {0, 0};
+  std::vector<std::pair<uint32_t, int64_t>> arrivals[2];
+  std::vector<std::string> errors;
+};
+
+class Client {
+ public:
+  Client(const Options& opt, const std::vector<Expected>& expected, Received& r)
+      : opt_(opt), expected_(expected), r_(r) {}
+
+  int fd = -1;
+  int udp[2][2] = {{-1, -1}, {-1, -1}};
+  std::string session;
+  uint8_t audioPt = RTP_PT_L16;
+  uint32_t audioClock = 16000;
+  bool pcmu = false;
+
+  void fail(const char* fmt, const std::string& detail = "") {
+    char msg[256];
+    snprintf(msg, sizeof(msg), fmt, detail.c_str());
+    r_.errors.push_back(msg);
+  }
+
+  bool sendRaw(const std::string& s) { return net::sendAll(fd, s); }
+
+  // Send a request and read until its response, handling interleaved
+  // packets in between; returns the status or -1
+  int request(const std::string& method, const std::string& url, const std::string& headers, std::string& head,
+              std::string& body) {
+    char req[1024];
+    snprintf(req, sizeof(req), "%s %s RTSP/1.0\r\nCSeq: %d\r\nUser-Agent: rtsp-selftest\r\n%s%s\r\n",
+             method.c_str(), url.c_str(), ++cseq_, session.empty() ? "" : ("Session: " + session + "\r\n").c_str(),
+             headers.c_str());
+    if (!sendRaw(req)) {
+      return -1;
+    }
+    int64_t deadline = monotonicUs() + 3000000;
+    while (monotonicUs() < deadline) {
+      if (!readMessage(head, body, true)) {
+        return -1;
+      }
+      if (!head.empty()) {
+        if (atoi(net::headerValue(head, "CSeq").c_str()) != cseq_) {
+          fail("CSeq mismatch");
+        }
+        return net::parseStatus(head.replace(0, 4, "HTTP"));
+      }
+    }
+    return -1;
+  }
+
+  // One RTSP response (into head/body) or interleaved packet (handled);
+  // false when the connection closed
+  bool readMessage(std::string& head, std::string& body, bool block) {
+    head.clear();
+    for (;;) {
+      if (!buf_.empty() && buf_[0] == '$') {
+        if (buf_.size() >= 4) {
+          size_t len = ((uint8_t)buf_[2] << 8) | (uint8_t)buf_[3];
+          if (buf_.size() >= 4 + len) {
+            onPacket((uint8_t)buf_[1], (const uint8_t*)buf_.data() + 4, len);
+            buf_.erase(0, 4 + len);
+            return true;
+          }
+        }
+      } else {
+        size_t end = buf_.find("\r\n\r\n");
+        if (end != std::string::npos) {
+          std::string h = buf_.substr(0, end + 4);
+          size_t len = (size_t)atoi(net::headerValue(h, "Content-Length").c_str());
+          if (buf_.size() >= end + 4 + len) {
+            head = h;
+            body = buf_.substr(end + 4, len);
+            buf_.erase(0, end + 4 + len);
+            return true;
+          }
+        }
+      }
+      struct pollfd p = {fd, POLLIN, 0};
+      if (poll(&p, 1, block ? 3000 : 0) <= 0) {
+        return !block;
+      }
+      char tmp[4096];
+      ssize_t n = recv(fd, tmp, sizeof(tmp), 0);
+      if (n <= 0) {
+        return false;
+      }
+      buf_.append(tmp, (size_t)n);
+    }
+  }
+
+  // Channels as in the interleaved case: 0/1 video RTP/RTCP, 2/3 audio
+  void pollUdp(int timeoutMs) {
+    struct pollfd p[4];
+    for (int i = 0; i < 4; i++) {
+      p[i] = {udp[i / 2][i % 2], POLLIN, 0};
+    }
+    if (poll(p, 4, timeoutMs) <= 0) {
+      return;
+    }
+    for (int i = 0; i < 4; i++) {
+      if (p[i].revents & POLLIN) {
+        uint8_t pkt[2048];
+        ssize_t n = recv(p[i].fd, pkt, sizeof(pkt), 0);
+        if (n > 0) {
+          onPacket((uint8_t)i, pkt, (size_t)n);
+        }
+      }
+    }
+  }
+
+  void onPacket(uint8_t channel, const uint8_t* p, size_t len) {
+    const int track = channel / 2;
+    if (track > 1) {
+      fail("packet on unknown channel");
+      return;
+    }
+    if (channel & 1) {
+      onRtcp(track, p, len);
+    } else {
+      onRtp(track, p, len);
+    }
+  }
+
+  void onRtcp(int track, const uint8_t* p, size_t len) {
+    if (len < 28 || (p[0] >> 6) != 2 || p[1] != 200) {
+      fail("RTCP packet is not a sender report");
+      return;
+    }
+    const size_t srLen = 4 * (size_t)(((p[2] << 8) | p[3]) + 1);
+    uint64_t ntpSeconds = ((uint64_t)p[8] << 24) | (p[9] << 16) | (p[10] << 8) | p[11];
+    uint64_t ntpFraction = ((uint64_t)p[12] << 24) | (p[13] << 16) | (p[14] << 8) | p[15];
+    r_.srUnixUs[track] = (int64_t)(ntpSeconds - 2208988800ULL) * 1000000 + (int64_t)((ntpFraction * 1000000) >> 32);
+    r_.srTs[track] = ((uint32_t)p[16] << 24) | (p[17] << 16) | (p[18] << 8) | p[19];
+    r_.ssrc[track] = ((uint32_t)p[4] << 24) | (p[5] << 16) | (p[6] << 8) | p[7];
+    r_.srCount[track]++;
+    if (len >= srLen + 10 && p[srLen + 1] == 202 && p[srLen + 8] == 1) {
+      r_.cname[track] = true;
+    }
+  }
+
+  void onRtp(int track, const uint8_t* p, size_t len) {
+    if (len < RTP_HEADER_SIZE || (p[0] >> 6) != 2) {
+      fail("bad RTP header");
+      return;
+    }
+    const uint8_t pt = p[1] & 0x7F;
+    const bool marker = p[1] & 0x80;
+    const uint16_t seq = (uint16_t)((p[2] << 8) | p[3]);
+    const uint32_t ts = ((uint32_t)p[4] << 24) | (p[5] << 16) | (p[6] << 8) | p[7];
+    if (r_.nextSeq[track] >= 0 && seq != (uint16_t)r_.nextSeq[track]) {
+      r_.seqGaps[track]++;
+    }
+    r_.nextSeq[track] = (uint16_t)(seq + 1);
+    p += RTP_HEADER_SIZE;
+    len -= RTP_HEADER_SIZE;
+    if (track == rtsp::VIDEO) {
+      if (pt != RTP_PT_JPEG) {
+        fail("video payload type");
+        return;
+      }
+      r_.videoPackets++;
+      r_.arrivals[track].push_back({ts, unixUs()});
+      onJpeg(p, len, ts, marker);
+    } else {
+      if (pt != audioPt) {
+        fail("audio payload type");
+        return;
+      }
+      r_.audioPackets++;
+      onAudio(p, len, ts);
+    }
+  }
+
+  void onJpeg(const uint8_t* p, size_t len, uint32_t ts, bool marker) {
+    if (len < 8) {
+      fail("short JPEG packet");
+      return;
+    }
+    const uint32_t offset = ((uint32_t)p[1] << 16) | (p[2] << 8) | p[3];
+    const uint8_t type = p[4], q = p[5];
+    const uint16_t width = (uint16_t)(p[6] * 8), height = (uint16_t)(p[7] * 8);
+    size_t at = 8;
+    uint16_t restartInterval = 0;
+    if (type >= 64) {
+      restartInterval = (uint16_t)((p[at] << 8) | p[at + 1]);
+      at += 4;
+    }
+    if (offset == 0) {
+      r_.inFrame = true;
+      r_.broken = false;
+      r_.frameTs = ts;
+      r_.type = type;
+      r_.q = q;
+      r_.width = width;
+      r_.height = height;
+      r_.restartInterval = restartInterval;
+      r_.scan.clear();
+      r_.haveTables = false;
+      if (q >= 128 && at + 4 <= len) {
+        size_t tableLen = (size_t)((p[at + 2] << 8) | p[at + 3]);
+        if (tableLen == 128 && at + 4 + tableLen <= len) {
+          memcpy(r_.qtables, p + at + 4, 128);
+          r_.haveTables = true;
+        }
+        at += 4 + tableLen;
+      }
+    } else if (!r_.inFrame || ts != r_.frameTs || offset != r_.scan.size()) {
+      r_.broken = true;
+    }
+    if (at > len) {
+      fail("JPEG headers overrun the packet");
+      return;
+    }
+    r_.scan.insert(r_.scan.end(), p + at, p + len);
+    if (marker && r_.inFrame) {
+      r_.inFrame = false;
+      checkFrame();
+    }
+  }
+
+  void checkFrame() {
+    if (r_.broken || !r_.haveTables || r_.q != 255) {
+      r_.framesBad++;
+      return;
+    }
+    std::vector<uint8_t> jpeg = rebuildJpeg(r_.type, r_.width, r_.height, r_.restartInterval, r_.qtables, r_.scan);
+    rtp::JpegInfo info;
+    const char* error = rtp::parseJpeg(jpeg.data(), jpeg.size(), info);
+    bool match = false;
+    for (const Expected& e : expected_) {
+      match = match || (!error && e.info.width == info.width && e.info.height == info.height &&
+                        e.info.type == info.type && e.info.restartInterval == info.restartInterval &&
+                        memcmp(e.info.qtables[0], info.qtables[0], 64) == 0 &&
+                        memcmp(e.info.qtables[1], info.qtables[1], 64) == 0 && e.info.scanLen == info.scanLen &&
+                        memcmp(e.info.scan, info.scan, info.scanLen) == 0);
+    }
+    if (!match) {
+      r_.framesBad++;
+      return;
+    }
+    if (!opt_.dump.empty() && r_.framesOk < expected_.size()) {
+      char path[512];
+      snprintf(path, sizeof(path), "%s/frame%02u_%ux%u_type%u.jpg", opt_.dump.c_str(), (unsigned)r_.framesOk,
+               info.width, info.height, info.type);
+      FILE* f = fopen(path, "wb");
+      if (f) {
+        fwrite(jpeg.data(), 1, jpeg.size(), f);
+        fclose(f);
+      }
+    }
+    r_.framesOk++;
+  }
+
+  void onAudio(const uint8_t* p, size_t len, uint32_t ts) {
+    const size_t samples = pcmu ? len : len / 2;
+    if (r_.audioNextTs >= 0 && ts != (uint32_t)r_.audioNextTs) {
+      r_.audioGaps++;
+    }
+    r_.audioNextTs = (uint32_t)(ts + samples);
+    // Audio leaves once its last sample is captured
+    r_.arrivals[rtsp::AUDIO].push_back({(uint32_t)(ts + samples), unixUs()});
+    for (size_t i = 0; i < samples; i++) {
+      int16_t s = pcmu ? rtp::ulawToLinear(p[i]) : (int16_t)((p[2 * i] << 8) | p[2 * i + 1]);
+      r_.audioSquares += (double)s * s;
+    }
+    r_.audioSamples += (uint32_t)samples;
+  }
+
+ private:
+  const Options& opt_;
+  const std::vector<Expected>& expected_;
+  Received& r_;
+  std::string buf_;
+  int cseq_ = 0;
+};
+
+// Latest arrival minus the wall-clock time the sender report assigns to
+// the packet's timestamp; the smallest value is the path delay
+static double minOffsetMs(const Received& r, int track, uint32_t clock) {
+  double best = 1e18;
+  for (const auto& a : r.arrivals[track]) {
+    int64_t mediaUs = r.srUnixUs[track] + (int64_t)(int32_t)(a.first - r.srTs[track]) * 1000000 / clock;
+    best = std::min(best, (a.second - mediaUs) / 1000.0);
+  }
+  return best;
+}
+
+static bool runCase(const Options& opt, const Media& media, const std::vector<Expected>& expected, bool tcp,
+                    const char* audio, uint32_t seed) {
+  uint16_t port = 0;
+  int listenFd = listenAny(0, port);
+  int serverUdp[2];
+  uint16_t serverUdpPort = 0;
+  if (listenFd < 0 || !udpPair(0, serverUdp, serverUdpPort)) {
+    printf("  cannot open server sockets\n");
+    return false;
+  }
+  std::thread server([&] {
+    int fd = accept(listenFd, nullptr, nullptr);
+    if (fd >= 0) {
+      serveClient(fd, media, serverUdp, serverUdpPort, seed);
+    }
+  });
+
+  Received r;
+  Client c(opt, expected, r);
+  c.fd = net::tcpConnect("127.0.0.1", port, 3000);
+  std::string head, body;
+  char url[128];
+  snprintf(url, sizeof(url), "rtsp://127.0.0.1:%u/live", port);
+  const bool withAudio = strcmp(audio, "none") != 0;
+  c.pcmu = strcmp(audio, "pcmu") == 0;
+  c.audioPt = c.pcmu ? RTP_PT_PCMU : RTP_PT_L16;
+  c.audioClock = c.pcmu ? 8000 : media.rate;
+
+  if (c.request("OPTIONS", url, "", head, body) != 200 || net::headerValue(head, "Public").find("PLAY") == std::string::npos) {
+    c.fail("OPTIONS");
+  }
+  if (c.request("DESCRIBE", std::string(url) + "?audio=" + audio, "Accept: application/sdp\r\n", head, body) != 200) {
+    c.fail("DESCRIBE");
+  }
+  const std::string base = net::headerValue(head, "Content-Base");
+  char rtpmap[64];
+  snprintf(rtpmap, sizeof(rtpmap), c.pcmu ? "a=rtpmap:0 PCMU/8000/1" : "a=rtpmap:97 L16/%u/1", media.rate);
+  if (base != std::string(url) + "/" || body.find("m=video 0 RTP/AVP 26") == std::string::npos ||
+      (body.find(rtpmap) != std::string::npos) != withAudio || (body.find("m=audio") != std::string::npos) != withAudio) {
+    c.fail("SDP: %s", body);
+  }
+  if (c.request("SETUP", base + "track3", "Transport: RTP/AVP/TCP;unicast;interleaved=4-5\r\n", head, body) != 404) {
+    c.fail("SETUP of an unknown track");
+  }
+
+  for (int track = 0; track < (withAudio ? 2 : 1); track++) {
+    char transport[160];
+    if (tcp) {
+      snprintf(transport, sizeof(transport), "Transport: RTP/AVP/TCP;unicast;interleaved=%d-%d\r\n", 2 * track,
+               2 * track + 1);
+    } else {
+      uint16_t clientPort = 0;
+      udpPair(0, c.udp[track], clientPort);
+      snprintf(transport, sizeof(transport), "Transport: RTP/AVP;unicast;client_port=%u-%u\r\n", clientPort,
+               clientPort + 1);
+    }
+    if (c.request("SETUP", base + "track" + std::to_string(track + 1), transport, head, body) != 200) {
+      c.fail("SETUP");
+      continue;
+    }
+    const std::string value = net::headerValue(head, "Transport");
+    if (value.find(tcp ? "interleaved=" : "server_port=") == std::string::npos || value.find("ssrc=") == std::string::npos) {
+      c.fail("Transport reply: %s", value);
+    }
+    if (c.session.empty()) {
+      c.session = net::headerValue(head, "Session");
+      c.session = c.session.substr(0, c.session.find(';'));
+    }
+  }
+
+  std::string real = c.session;
+  c.session = "DEADBEEF";
+  if (c.request("PLAY", base, "", head, body) != 454) {
+    c.fail("PLAY with a wrong session");
+  }
+  c.session = real;
+  if (c.request("PLAY", base, "Range: npt=0.000-\r\n", head, body) != 200 ||
+      net::headerValue(head, "RTP-Info").find("rtptime=") == std::string::npos) {
+    c.fail("PLAY");
+  }
+
+  // Receive; halfway, a keepalive preceded (over TCP) by a receiver report
+  // the server must skip
+  const int64_t end = monotonicUs() + (int64_t)(opt.seconds * 1e6);
+  bool keepalive = false;
+  while (monotonicUs() < end) {
+    if (!keepalive && monotonicUs() > end - (int64_t)(opt.seconds * 5e5)) {
+      keepalive = true;
+      if (tcp) {
+        c.sendRaw(std::string("$\x01\x00\x08", 4) + std::string("\x80\xc9\x00\x01\x00\x00\x00\x01", 8));
+      }
+      if (c.request("GET_PARAMETER", base, "", head, body) != 200) {
+        c.fail("GET_PARAMETER keepalive");
+      }
+    }
+    if (tcp) {
+      if (!c.readMessage(head, body, false)) {
+        c.fail("connection closed while playing");
+        break;
+      }
+      usleep(500);
+    } else {
+      c.pollUdp(5);
+    }
+  }
+  if (c.request("TEARDOWN", base, "", head, body) != 200) {
+    c.fail("TEARDOWN");
+  }
+  bool closed = !c.readMessage(head, body, true);
+  while (!closed && head.empty()) {
+    closed = !c.readMessage(head, body, true);   // Packets already in flight
+  }
+  if (!closed) {
+    c.fail("connection still open after TEARDOWN");
+  }
+  server.join();
+  net::closeSocket(c.fd);
+  close(listenFd);
+  for (int i = 0; i < 2; i++) {
+    close(serverUdp[i]);
+    for (int j = 0; j < 2; j++) {
+      if (c.udp[i][j] >= 0) {
+        close(c.udp[i][j]);
+      }
+    }
+  }
+
+  // Verdict
+  const uint32_t expectedFrames = (uint32_t)(opt.seconds * media.fps * expected.size() / media.frames.size());
+  if (r.framesOk < expectedFrames * 8 / 10 || r.framesBad) {
+    c.fail("video frames");
+  }
+  if (r.seqGaps[0] || r.seqGaps[1]) {
+    c.fail("RTP sequence gaps");
+  }
+  if (r.srCount[0] == 0 || !r.cname[0]) {
+    c.fail("no video sender report with CNAME");
+  }
+  double rms = r.audioSamples ? sqrt(r.audioSquares / r.audioSamples) : 0;
+  double skewMs = 0;
+  if (withAudio) {
+    const double wantRms = TONE_AMPLITUDE / sqrt(2.0);
+    const uint32_t expectedSamples = (uint32_t)(opt.seconds * c.audioClock);
+    if (r.audioSamples < expectedSamples * 8 / 10 || r.audioGaps || fabs(rms - wantRms) > wantRms * 0.02) {
+      c.fail("audio");
+    }
+    if (r.srCount[1] == 0 || !r.cname[1] || r.ssrc[0] == r.ssrc[1]) {
+      c.fail("no audio sender report with CNAME");
+    } else if (r.srCount[0]) {
+      skewMs = minOffsetMs(r, 0, RTP_VIDEO_CLOCK) - minOffsetMs(r, 1, c.audioClock);
+      if (fabs(skewMs) > MAX_SKEW_MS) {
+        c.fail("A/V skew");
+      }
+    }
+  }
+
+  printf("  %-4s %-5s %3u frames (%u bad, %u packets)  audio %6u samples rms %6.0f gaps %u  SR %u/%u  skew %+.1f ms  %s\n",
+         tcp ? "tcp" : "udp", audio, (unsigned)r.framesOk, (unsigned)r.framesBad, (unsigned)r.videoPackets,
+         (unsigned)r.audioSamples, rms, (unsigned)r.audioGaps, (unsigned)r.srCount[0], (unsigned)r.srCount[1], skewMs,
+         r.errors.empty() ? "ok" : "FAIL");
+  for (const std::string& e : r.errors) {
+    printf("    %s\n", e.c_str());
+  }
+  return r.errors.empty();
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    bool more = i + 1 < argc;
+    if (a == "--fps" && more) {
+      opt.fps = (uint32_t)atoi(argv[++i]);
+    } else if (a == "--rate" && more) {
+      opt.rate = (uint32_t)atoi(argv[++i]);
+    } else if (a == "--seconds" && more) {
+      opt.seconds = atof(argv[++i]);
+    } else if (a == "--serve" && more) {
+      opt.serve = (uint16_t)atoi(argv[++i]);
+    } else if (a == "--udp-port" && more) {
+      opt.udpPort = (uint16_t)atoi(argv[++i]);
+    } else if (a == "--dump" && more) {
+      opt.dump = argv[++i];
+    } else if (a == "--help" || a[0] == '-') {
+      usage(argv[0]);
+      return a == "--help" ? 0 : 1;
+    } else {
+      opt.files.push_back(a);
+    }
+  }
+  if (opt.files.empty() || opt.fps == 0 || opt.rate == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  Media media;
+  media.fps = opt.fps;
+  media.rate = opt.rate;
+  std::vector<Expected> expected;
+  media.frames.resize(opt.files.size());
+  for (size_t i = 0; i < opt.files.size(); i++) {
+    if (!readFile(opt.files[i], media.frames[i])) {
+      printf("Cannot read %s\n", opt.files[i].c_str());
+      return 1;
+    }
+    Expected e;
+    const char* error = rtp::parseJpeg(media.frames[i].data(), media.frames[i].size(), e.info);
+    if (error) {
+      printf("%-32s not sendable: %s\n", opt.files[i].c_str(), error);
+    } else {
+      printf("%-32s %ux%u type %u, %u-byte scan\n", opt.files[i].c_str(), e.info.width, e.info.height, e.info.type,
+             (unsigned)e.info.scanLen);
+      expected.push_back(e);
+    }
+  }
+  if (expected.empty()) {
+    printf("No fixture RFC 2435 can carry\n");
+    return 2;
+  }
+  if (!opt.dump.empty()) {
+    mkdir(opt.dump.c_str(), 0755);
+  }
+
+  if (opt.serve) {
+    int udp[2];
+    uint16_t udpPort = 0;
+    int listenFd = net::tcpListen(opt.serve);
+    if (listenFd < 0 || !udpPair(opt.udpPort, udp, udpPort)) {
+      printf("Cannot listen on %u / %u\n", opt.serve, opt.udpPort);
+      return 1;
+    }
+    printf("Serving rtsp://127.0.0.1:%u/live (RTP/UDP from %u)\n", opt.serve, udpPort);
+    for (uint32_t seed = 1;; seed++) {
+      int fd = accept(listenFd, nullptr, nullptr);
+      if (fd >= 0) {
+        std::thread(serveClient, fd, std::cref(media), udp, udpPort, seed * 2654435761u).detach();
+      }
+    }
+  }
+
+  bool ok = true;
+  uint32_t seed = 1;
+  for (bool tcp : {true, false}) {
+    for (const char* audio : {"l16", "pcmu", "none"}) {
+      ok = runCase(opt, media, expected, tcp, audio, seed++ * 2654435761u) && ok;
+    }
+  }
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 2;
+}
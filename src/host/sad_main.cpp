@@ -0,0 +1,329 @@
+// ============================================
+// Sound activity detector replay ([env:sad])
+// ============================================
+// Runs labeled audio through sad::Detector frame by frame and scores it.
+// A fixture either names a WAV recording and labels its sound spans, or
+// describes a synthetic scene: background noise plus timed sources. Voice,
+// tone and knock sources are labeled as sound; fan sources (steady noise
+// that starts and stays) are labeled as background the detector must learn
+// to ignore. 'expect' lines are checked at the end and the exit status is
+// 2 if any fails.
+//
+// Scoring is per 16 ms frame. Recall is the share of labeled frames the
+// detector reports active. False alarms are active frames outside any
+// label, not counting the hangover tail after a label ends.
+//
+//   pio run -e sad && .pio/build/sad/program bench/sad/*.txt
+//   .pio/build/sad/program --dump /tmp/sad bench/sad/*.txt   (write WAVs)
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "hal_host.h"
+#include "sad.h"
+
+struct Source {
+  std::string kind;   // voice | tone | knock | fan | sound (label only, for WAVs)
+  double startS;
+  double endS;
+  double dbfs;
+  double hz;
+};
+
+struct Expect {
+  std::string key;
+  double value;
+};
+
+struct Fixture {
+  std::string wav;
+  uint32_t sampleRate = 16000;
+  double durationS = 10;
+  double noiseDbfs = -65;
+  uint32_t seed = 1;
+  std::vector<Source> sources;
+  std::vector<Expect> expects;
+};
+
+static bool labeled(const Source& s) {
+  return s.kind != "fan";
+}
+
+static bool loadFixture(const char* path, Fixture& f) {
+  FILE* in = fopen(path, "r");
+  if (!in) {
+    return false;
+  }
+  std::string dir(path);
+  size_t slash = dir.rfind('/');
+  dir = slash == std::string::npos ? "" : dir.substr(0, slash + 1);
+
+  char line[256];
+  while (fgets(line, sizeof(line), in)) {
+    char key[32], arg[128];
+    double a, b, c, d = 0;
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+    if (sscanf(line, "expect %31s %lf", key, &a) == 2) {
+      f.expects.push_back({key, a});
+    } else if (sscanf(line, "wav %127s", arg) == 1) {
+      f.wav = arg[0] == '/' ? arg : dir + arg;
+    } else if (sscanf(line, "sound %lf %lf", &a, &b) == 2) {
+      f.sources.push_back({"sound", a, b, 0, 0});
+    } else if (sscanf(line, "%31s %lf %lf %lf %lf", key, &a, &b, &c, &d) >= 4) {
+      f.sources.push_back({key, a, b, c, d});
+    } else if (sscanf(line, "%31s %lf", key, &a) == 2) {
+      if (!strcmp(key, "duration_s")) f.durationS = a;
+      else if (!strcmp(key, "noise_dbfs")) f.noiseDbfs = a;
+      else if (!strcmp(key, "seed")) f.seed = (uint32_t)a;
+    }
+  }
+  fclose(in);
+  return true;
+}
+
+// ============================================
+// Scene synthesis
+// ============================================
+struct Rng {
+  uint32_t state;
+  double uniform() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state + 0.5) / 4294967296.0;
+  }
+  double gauss() {
+    return sqrt(-2.0 * log(uniform())) * cos(2.0 * M_PI * uniform());
+  }
+};
+
+// RMS of a sine at 'dbfs' (0 dBFS = full-scale sine)
+static double rmsFor(double dbfs) {
+  return 32767.0 / sqrt(2.0) * pow(10.0, dbfs / 20.0);
+}
+
+// Voiced syllables: a harmonic series on a wandering pitch, shaped by three
+// fixed formants, in 120-260 ms bursts with short gaps
+static void addVoice(std::vector<double>& out, const Source& s, uint32_t rate, Rng& rng) {
+  size_t from = (size_t)(s.startS * rate), to = (size_t)(s.endS * rate);
+  if (to > out.size()) to = out.size();
+  double f0Base = s.hz > 0 ? s.hz : 140;
+  std::vector<double> voice(to - from, 0.0);
+  double phase = 0;
+  size_t pos = 0;
+  while (pos < voice.size()) {
+    size_t len = (size_t)((0.12 + 0.14 * rng.uniform()) * rate);
+    double f0 = f0Base * (0.85 + 0.3 * rng.uniform());
+    for (size_t i = 0; i < len && pos + i < voice.size(); i++) {
+      double t = (double)i / rate;
+      double env = sin(M_PI * i / len);
+      double f = f0 * (1.0 + 0.04 * sin(2.0 * M_PI * 5.0 * t));
+      phase += 2.0 * M_PI * f / rate;
+      double v = 0;
+      for (int k = 1; k * f < 3800; k++) {
+        double hk = k * f;
+        double formants = exp(-pow((hk - 500) / 250, 2)) + 0.6 * exp(-pow((hk - 1500) / 300, 2)) +
+                          0.3 * exp(-pow((hk - 2500) / 350, 2));
+        v += (0.15 + formants) / k * sin(k * phase);
+      }
+      voice[pos + i] = env * v;
+    }
+    pos += len + (size_t)((0.04 + 0.08 * rng.uniform()) * rate);
+  }
+  double sum = 0;
+  for (double v : voice) sum += v * v;
+  double scale = sum > 0 ? rmsFor(s.dbfs) / sqrt(sum / voice.size() * 2.0) : 0;   // Level while voiced
+  for (size_t i = 0; i < voice.size(); i++) out[from + i] += voice[i] * scale;
+}
+
+static void addSource(std::vector<double>& out, const Source& s, uint32_t rate, Rng& rng) {
+  size_t from = (size_t)(s.startS * rate), to = (size_t)(s.endS * rate);
+  if (to > out.size()) to = out.size();
+  double rms = rmsFor(s.dbfs);
+  if (s.kind == "voice") {
+    addVoice(out, s, rate, rng);
+  } else if (s.kind == "tone") {
+    for (size_t i = from; i < to; i++) {
+      out[i] += rms * sqrt(2.0) * sin(2.0 * M_PI * s.hz * (i - from) / rate);
+    }
+  } else if (s.kind == "knock") {
+    // Decaying noise bursts every 400 ms; 'dbfs' is the level of the first 16 ms
+    size_t period = (size_t)(0.4 * rate);
+    for (size_t i = from; i < to; i++) {
+      double t = (double)((i - from) % period) / rate;
+      out[i] += rms * 1.6 * exp(-t / 0.015) * rng.gauss();
+    }
+  } else if (s.kind == "fan") {
+    for (size_t i = from; i < to; i++) {
+      out[i] += rms * rng.gauss();
+    }
+  }
+}
+
+static bool buildAudio(const Fixture& f, std::vector<int16_t>& pcm, uint32_t& rate) {
+  if (!f.wav.empty()) {
+    return hal::loadWav(f.wav.c_str(), pcm, rate);
+  }
+  rate = f.sampleRate;
+  Rng rng = {f.seed * 2654435761u + 1};
+  std::vector<double> mix((size_t)(f.durationS * rate), 0.0);
+  double noise = rmsFor(f.noiseDbfs);
+  for (double& v : mix) v = noise * rng.gauss();
+  for (const Source& s : f.sources) addSource(mix, s, rate, rng);
+  pcm.resize(mix.size());
+  for (size_t i = 0; i < mix.size(); i++) {
+    double v = mix[i] < -32768 ? -32768 : mix[i] > 32767 ? 32767 : mix[i];
+    pcm[i] = (int16_t)lrint(v);
+  }
+  return true;
+}
+
+static void writeWav(const std::string& path, const std::vector<int16_t>& pcm, uint32_t rate) {
+  FILE* out = fopen(path.c_str(), "wb");
+  if (!out) {
+    fprintf(stderr, "❌ Cannot write %s\n", path.c_str());
+    return;
+  }
+  uint32_t dataBytes = (uint32_t)(pcm.size() * 2);
+  uint32_t riff = 36 + dataBytes, fmtLen = 16, byteRate = rate * 2;
+  uint16_t pcmFormat = 1, channels = 1, align = 2, bits = 16;
+  fwrite("RIFF", 1, 4, out); fwrite(&riff, 4, 1, out); fwrite("WAVEfmt ", 1, 8, out);
+  fwrite(&fmtLen, 4, 1, out); fwrite(&pcmFormat, 2, 1, out); fwrite(&channels, 2, 1, out);
+  fwrite(&rate, 4, 1, out); fwrite(&byteRate, 4, 1, out); fwrite(&align, 2, 1, out);
+  fwrite(&bits, 2, 1, out); fwrite("data", 1, 4, out); fwrite(&dataBytes, 4, 1, out);
+  fwrite(pcm.data(), 2, pcm.size(), out);
+  fclose(out);
+}
+
+// ============================================
+// Replay
+// ============================================
+static int replay(const char* path, const char* dumpDir, bool verbose) {
+  Fixture f;
+  std::vector<int16_t> pcm;
+  uint32_t rate = 0;
+  if (!loadFixture(path, f) || !buildAudio(f, pcm, rate)) {
+    fprintf(stderr, "❌ Cannot read fixture %s\n", path);
+    return 1;
+  }
+  if (dumpDir) {
+    std::string name(path);
+    size_t slash = name.rfind('/');
+    name = name.substr(slash == std::string::npos ? 0 : slash + 1);
+    writeWav(std::string(dumpDir) + "/" + name.substr(0, name.rfind('.')) + ".wav", pcm, rate);
+  }
+
+  sad::Config config = sad::defaultConfig();
+  sad::Detector detector;
+  detector.begin(config, rate);
+
+  const double frameS = (double)SAD_FRAME_SAMPLES / rate;
+  const double tailS = config.hangoverMs / 1000.0 + 0.1;
+  uint32_t labeledFrames = 0, hits = 0, otherFrames = 0, falseFrames = 0;
+  std::vector<bool> spanHit(f.sources.size(), false);
+  double busyUs = 0;
+
+  printf("== %s (%.1f s)\n", path, (double)pcm.size() / rate);
+  for (size_t pos = 0; pos + SAD_FRAME_SAMPLES <= pcm.size(); pos += SAD_FRAME_SAMPLES) {
+    int64_t tsUs = (int64_t)pos * 1000000 / rate;
+    auto t0 = std::chrono::steady_clock::now();
+    sad::Transition t = detector.process(&pcm[pos], SAD_FRAME_SAMPLES, tsUs);
+    busyUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    if (verbose && t == sad::ONSET) {
+      printf("  %7.2f s  onset   snr %.1f dB\n", detector.event().startUs / 1e6, detector.event().peakSnrDb);
+    } else if (verbose && t == sad::OFFSET) {
+      printf("  %7.2f s  offset  %.2f s long, peak %.1f dB\n", detector.event().endUs / 1e6,
+             (detector.event().endUs - detector.event().startUs) / 1e6, detector.event().peakSnrDb);
+    }
+
+    double mid = tsUs / 1e6 + frameS / 2;
+    bool inLabel = false, inTail = false;
+    for (size_t i = 0; i < f.sources.size(); i++) {
+      const Source& s = f.sources[i];
+      if (!labeled(s)) continue;
+      if (mid >= s.startS && mid < s.endS) {
+        inLabel = true;
+        spanHit[i] = spanHit[i] || detector.active();
+      } else if (mid >= s.endS && mid < s.endS + tailS) {
+        inTail = true;
+      }
+    }
+    if (inLabel) {
+      labeledFrames++;
+      hits += detector.active();
+    } else if (!inTail) {
+      otherFrames++;
+      falseFrames += detector.active();
+    }
+  }
+
+  uint32_t spans = 0, missed = 0;
+  for (size_t i = 0; i < f.sources.size(); i++) {
+    if (labeled(f.sources[i])) {
+      spans++;
+      missed += !spanHit[i];
+    }
+  }
+  double recall = labeledFrames ? (double)hits / labeledFrames : 1.0;
+  double falseAlarm = otherFrames ? (double)falseFrames / otherFrames : 0.0;
+  double usPerFrame = detector.frames() ? busyUs / detector.frames() : 0;
+  printf("  events %u, labeled spans %u (%u missed), recall %.1f%%, false alarm %.2f%%\n",
+         detector.events(), spans, missed, recall * 100, falseAlarm * 100);
+  printf("  %.1f us/frame (%.3f%% of real time on this host)\n", usPerFrame, usPerFrame / (frameS * 1e4));
+
+  int failures = 0;
+  for (const Expect& e : f.expects) {
+    bool ok = true;
+    if (e.key == "recall_min") ok = recall >= e.value;
+    else if (e.key == "false_alarm_max") ok = falseAlarm <= e.value;
+    else if (e.key == "missed_max") ok = missed <= e.value;
+    else if (e.key == "events_min") ok = detector.events() >= e.value;
+    else if (e.key == "events_max") ok = detector.events() <= e.value;
+    else {
+      fprintf(stderr, "  unknown expectation %s\n", e.key.c_str());
+      ok = false;
+    }
+    if (!ok) {
+      printf("  ❌ expect %s %g failed\n", e.key.c_str(), e.value);
+      failures++;
+    }
+  }
+  if (!failures) {
+    printf("  ✓ %zu expectations met\n", f.expects.size());
+  }
+  return failures ? 2 : 0;
+}
+
+int main(int argc, char** argv) {
+  const char* dumpDir = nullptr;
+  bool verbose = false;
+  int first = 1;
+  for (; first < argc && argv[first][0] == '-'; first++) {
+    if (!strcmp(argv[first], "--dump") && first + 1 < argc) {
+      dumpDir = argv[++first];
+    } else if (!strcmp(argv[first], "-v")) {
+      verbose = true;
+    } else {
+      break;
+    }
+  }
+  if (first >= argc) {
+    printf("Usage: %s [-v] [--dump DIR] FIXTURE...\n", argv[0]);
+    return 1;
+  }
+  int status = 0;
+  for (int i = first; i < argc; i++) {
+    int r = replay(argv[i], dumpDir, verbose);
+    if (r > status) {
+      status = r;
+    }
+  }
+  return status;
+}
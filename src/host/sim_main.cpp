@@ -0,0 +1,387 @@
+// ============================================
+// Native host simulation ([env:native])
+// ============================================
+// Runs the real recording and MJPEG pipelines against the host HAL: a
+// synthetic camera at a fixed rate, a WAV-file microphone and a directory
+// standing in for the SD card, with configurable card latency. Prints
+// achieved throughput and the /metrics output so buffering and locking
+// changes can be measured before flashing.
+//
+// With --serve, the same pipelines are also exposed over HTTP (/stream,
+// /audio, /api/files/*) for the load generator (loadgen_main.cpp).
+//
+//   pio run -e native && .pio/build/native/program --seconds 30 --streams 2
+//   .pio/build/native/program --seconds 0 --streams 0 --serve 8080
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "audioring.h"
+#include "framehub.h"
+#include "hal_host.h"
+#include "metrics.h"
+#include "pipeline.h"
+#include "sim_server.h"
+#include "tracer.h"
+
+struct Options {
+  uint32_t seconds = 30;
+  float fps = 15;
+  uint32_t frameKB = 40;
+  uint16_t width = 800;    // SVGA, as configured in initCamera()
+  uint16_t height = 600;
+  std::string sdDir = "sim_sd";
+  const char* wavPath = nullptr;
+  std::string mode = "both";  // video | audio | both (like the BLE MODE command)
+  uint32_t clipMs = 10000;
+  uint32_t audioSeconds = RECORD_TIME;
+  uint32_t streams = 1;
+  uint32_t chunkBytes = 1436;  // One TCP segment, what AsyncWebServer asks for
+  uint32_t linkKbps = 0;       // 0 = unthrottled
+  double captureFailRate = 0;
+  hal::LatencyModel latency = {2000, 250, 0.01, 150000};
+  bool dumpMetrics = false;
+  const char* traceFile = nullptr;
+  uint16_t servePort = 0;      // 0 = no HTTP server
+};
+
+static void usage(const char* prog) {
+  printf("Usage: %s [options]\n"
+         "  --seconds N          Run time (default 30, 0 = until Ctrl-C)\n"
+         "  --mode M             video | audio | both (default both)\n"
+         "  --fps F              Camera frame rate (default 15)\n"
+         "  --frame-kb N         JPEG size (default 40)\n"
+         "  --size WxH           Frame dimensions (default 800x600)\n"
+         "  --clip-ms N          Video clip length (default 10000)\n"
+         "  --audio-seconds N    Audio clip length (default %d)\n"
+         "  --wav FILE           16-bit PCM microphone input (default 440 Hz tone)\n"
+         "  --sd-dir DIR         Directory standing in for the SD card (default sim_sd)\n"
+         "  --sd-open-us N       Latency per file open (default 2000)\n"
+         "  --sd-kb-us N         Latency per KB written (default 250)\n"
+         "  --sd-spike-prob P    Chance of a latency spike per operation (default 0.01)\n"
+         "  --sd-spike-us N      Spike length (default 150000)\n"
+         "  --streams N          Concurrent /stream clients (default 1, 0 = none)\n"
+         "  --chunk N            Bytes per stream chunk (default 1436)\n"
+         "  --link-kbps N        Per-client link throttle (default unthrottled)\n"
+         "  --capture-fail P     Chance a grab fails (default 0)\n"
+         "  --serve PORT         Serve /stream, /audio and the file API on PORT\n"
+         "  --metrics            Print Prometheus metrics at the end\n"
+         "  --trace FILE         Write a Chrome trace of the run\n",
+         prog, RECORD_TIME);
+}
+
+static bool parseArgs(int argc, char** argv, Options& o) {
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+    bool takesValue = true;
+    if (!strcmp(a, "--metrics")) { o.dumpMetrics = true; takesValue = false; }
+    else if (!strcmp(a, "--help") || !strcmp(a, "-h")) { return false; }
+    else if (!v) { fprintf(stderr, "Missing value for %s\n", a); return false; }
+    else if (!strcmp(a, "--seconds")) o.seconds = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--mode")) o.mode = v;
+    else if (!strcmp(a, "--fps")) o.fps = (float)atof(v);
+    else if (!strcmp(a, "--frame-kb")) o.frameKB = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--size")) {
+      unsigned w, h;
+      if (sscanf(v, "%ux%u", &w, &h) != 2) { fprintf(stderr, "Bad --size %s\n", v); return false; }
+      o.width = (uint16_t)w;
+      o.height = (uint16_t)h;
+    }
+    else if (!strcmp(a, "--clip-ms")) o.clipMs = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--audio-seconds")) o.audioSeconds = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--wav")) o.wavPath = v;
+    else if (!strcmp(a, "--sd-dir")) o.sdDir = v;
+    else if (!strcmp(a, "--sd-open-us")) o.latency.openUs = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--sd-kb-us")) o.latency.perKBUs = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--sd-spike-prob")) o.latency.spikeProbability = atof(v);
+    else if (!strcmp(a, "--sd-spike-us")) o.latency.spikeUs = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--streams")) o.streams = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--chunk")) o.chunkBytes = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--link-kbps")) o.linkKbps = (uint32_t)atoi(v);
+    else if (!strcmp(a, "--capture-fail")) o.captureFailRate = atof(v);
+    else if (!strcmp(a, "--trace")) o.traceFile = v;
+    else if (!strcmp(a, "--serve")) o.servePort = (uint16_t)atoi(v);
+    else { fprintf(stderr, "Unknown option %s\n", a); return false; }
+    if (takesValue) i++;
+  }
+  if (o.mode != "video" && o.mode != "audio" && o.mode != "both") {
+    fprintf(stderr, "--mode must be video, audio or both\n");
+    return false;
+  }
+  if (o.chunkBytes == 0) {
+    fprintf(stderr, "--chunk must be > 0\n");
+    return false;
+  }
+  return true;
+}
+
+// Counts save failures by cause; frame-by-frame logging would swamp stdout
+class SimListener : public pipeline::Listener {
+ public:
+  std::atomic<uint32_t> lockTimeouts{0};
+  std::atomic<uint32_t> openFailures{0};
+  std::atomic<uint32_t> shortWrites{0};
+
+  void onFrameSaved(uint32_t frameNo, const char* path, size_t len, pipeline::SaveResult result) override {
+    switch (result) {
+      case pipeline::SAVE_LOCK_TIMEOUT: lockTimeouts++; break;
+      case pipeline::SAVE_OPEN_FAILED: openFailures++; break;
+      case pipeline::SAVE_SHORT_WRITE: shortWrites++; break;
+      default: break;
+    }
+  }
+};
+
+struct StreamStats {
+  uint32_t frames = 0;
+  uint64_t bytes = 0;
+  uint32_t stalls = 0;
+};
+
+static void printMetric(void* ctx, const char* data, size_t len) {
+  fwrite(data, 1, len, (FILE*)ctx);
+}
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void onSignal(int) {
+  interrupted = 1;
+}
+
+static double ms(uint32_t us) {
+  return us / 1000.0;
+}
+
+// Audio capture ring, as on the device: one thread reads the microphone,
+// the recorder and /audio each follow it with their own reader
+static audioring::Block audioBlocks[AUDIORING_BLOCKS];
+static audioring::Ring audioRing(audioBlocks, AUDIORING_BLOCKS);
+static std::mutex audioMutex;
+static std::condition_variable audioPublished;
+
+static bool waitAudioBlock(uint32_t timeoutMs) {
+  std::unique_lock<std::mutex> lock(audioMutex);
+  uint32_t seen = audioRing.published();
+  return audioPublished.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                                 [seen] { return audioRing.published() != seen; });
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parseArgs(argc, argv, opt)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (opt.traceFile) {
+    tracer::begin();
+  }
+
+  hal::HostClock clock;
+  hal::SyntheticCamera camera(clock, opt.fps, (size_t)opt.frameKB * 1024, opt.width, opt.height);
+  camera.setFailureRate(opt.captureFailRate);
+  // Recorder, streams and the server share captures, as on the device
+  framehub::Hub frameHub(camera);
+  frameHub.begin();
+  hal::WavMicrophone microphone(clock, opt.wavPath, SAMPLE_RATE);
+  audioring::RingMicrophone recorderMic(audioRing, waitAudioBlock, SAMPLE_RATE, "recorder");
+  audioring::RingMicrophone wsMic(audioRing, waitAudioBlock, SAMPLE_RATE, "websocket");
+  hal::DirStorage storage(opt.sdDir, clock, opt.latency);
+  storage.mkdir("/video");
+
+  pipeline::Recorder recorder(frameHub, recorderMic, storage, clock);
+  SimListener listener;
+  recorder.setListener(&listener);
+
+  printf("🎬 Simulating %us: mode=%s, %.1f fps, %u KB frames, %u stream client(s)\n",
+         opt.seconds, opt.mode.c_str(), opt.fps, opt.frameKB, opt.streams);
+  printf("💾 SD: %s (open %u us, %u us/KB, spikes %.1f%% x %u us)\n",
+         opt.sdDir.c_str(), opt.latency.openUs, opt.latency.perKBUs,
+         opt.latency.spikeProbability * 100.0, opt.latency.spikeUs);
+  printf("🎤 Microphone: %s @ %u Hz\n",
+         microphone.loadedFile() ? opt.wavPath : "440 Hz tone", microphone.sampleRate());
+
+  volatile bool recording = true;
+  std::atomic<bool> streaming(true);
+  std::atomic<bool> capturing(true);
+
+  // Same shape as audioCaptureTask(): fill a ring slot, publish it
+  std::thread captureThread([&]() {
+    while (capturing) {
+      audioring::Block* block = audioRing.beginWrite();
+      size_t n = 0;
+      while (n < AUDIORING_BLOCK_SAMPLES && capturing) {
+        n += microphone.read(block->pcm + n, AUDIORING_BLOCK_SAMPLES - n);
+      }
+      {
+        std::lock_guard<std::mutex> guard(audioMutex);
+        audioRing.commit((uint16_t)n, clock.micros() - (int64_t)n * 1000000 / microphone.sampleRate());
+      }
+      audioPublished.notify_all();
+    }
+  });
+  recorderMic.start();
+  if (opt.servePort) {
+    wsMic.start();
+  }
+
+  // Same loop as recordingTask(): a video clip, then an audio clip
+  volatile unsigned long frameCount = 0;
+  uint32_t audioClips = 0;
+  uint32_t audioErrors = 0;
+  std::thread recorderThread([&]() {
+    size_t audioBytes = (size_t)microphone.sampleRate() * SAMPLE_BITS / 8 * opt.audioSeconds;
+    std::vector<uint8_t> audioBuffer(audioBytes);
+    uint32_t clipNo = 0;
+    char path[64];
+    while (recording) {
+      if (opt.mode != "audio") {
+        recorder.recordVideoClip(opt.clipMs, &recording, frameCount);
+      }
+      if (recording && opt.mode != "video" && audioBytes > 0) {
+        pipeline::SaveResult r = recorder.recordAudioClip(audioBuffer.data(), audioBuffer.size(),
+                                                          clipNo++, path, sizeof(path));
+        if (r == pipeline::SAVE_OK) {
+          audioClips++;
+        } else {
+          audioErrors++;
+        }
+      }
+    }
+  });
+
+  std::vector<StreamStats> streamStats(opt.streams);
+  std::vector<std::thread> streamThreads;
+  for (uint32_t s = 0; s < opt.streams; s++) {
+    streamThreads.emplace_back([&, s]() {
+      pipeline::MjpegStreamer streamer(frameHub, clock);
+      std::vector<uint8_t> chunk(opt.chunkBytes);
+      StreamStats& st = streamStats[s];
+      while (streaming) {
+        size_t n = streamer.fill(chunk.data(), chunk.size());
+        if (n == 0) {
+          st.stalls++;  // The device would end the response here; keep going
+          clock.delayMs(10);
+          continue;
+        }
+        st.bytes += n;
+        if (opt.linkKbps) {
+          clock.sleepUs((int64_t)n * 8000 / opt.linkKbps);
+        }
+      }
+      st.frames = streamer.framesSent();
+    });
+  }
+
+  SimServer server(frameHub, wsMic, storage, clock);
+  if (opt.servePort) {
+    if (!server.start(opt.servePort)) {
+      fprintf(stderr, "❌ Cannot listen on port %u\n", opt.servePort);
+      recording = false;
+      streaming = false;
+      for (auto& t : streamThreads) t.join();
+      recorderThread.join();
+      capturing = false;
+      captureThread.join();
+      return 1;
+    }
+    printf("🌐 Serving on http://localhost:%u (/stream, /audio, /live, /api/files/*, /metrics)\n", opt.servePort);
+  }
+  fflush(stdout);
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  uint32_t start = clock.millis();
+  while (!interrupted && (opt.seconds == 0 || clock.millis() - start < opt.seconds * 1000U)) {
+    clock.delayMs(100);
+  }
+  server.stop();
+  streaming = false;
+  recording = false;
+  for (auto& t : streamThreads) {
+    t.join();
+  }
+  recorderThread.join();
+  capturing = false;
+  captureThread.join();
+  double elapsed = (clock.millis() - start) / 1000.0;
+
+  if (opt.traceFile) {
+    tracer::setEnabled(false);
+  }
+
+  // ============================================
+  // Report
+  // ============================================
+  printf("\n📊 Results over %.1fs\n", elapsed);
+  if (opt.mode != "audio") {
+    uint32_t saved = metrics::framesSaved.value();
+    printf("  Recorded frames:   %u (%.2f fps), %u save errors (lock timeout %u, open %u, short write %u)\n",
+           saved, saved / elapsed, metrics::frameSaveErrors.value(),
+           listener.lockTimeouts.load(), listener.openFailures.load(), listener.shortWrites.load());
+    printf("  Recorder MB/s:     %.2f\n", saved * (double)opt.frameKB / 1024.0 / elapsed);
+  }
+  if (opt.mode != "video") {
+    printf("  Audio clips:       %u saved, %u failed\n", audioClips, audioErrors);
+  }
+  printf("  Audio ring:        %u blocks;", audioRing.published());
+  for (size_t i = 0; i < audioRing.readerCount(); i++) {
+    const audioring::Reader* r = audioRing.reader(i);
+    if (r) {
+      printf(" %s %u overruns", r->name(), r->overruns() + r->torn());
+    }
+  }
+  printf("\n");
+  printf("  Capture errors:    %u, camera drops %u\n", metrics::captureErrors.value(), camera.framesDropped());
+  printf("  Frame hub:         %u captures, %u frames delivered\n", frameHub.captures(), frameHub.deliveries());
+  if (opt.servePort) {
+    printf("  HTTP connections:  %u, audio frames dropped %u, /live frames skipped %u\n",
+           server.connectionsServed(), server.audioFramesDropped(), server.liveFramesSkipped());
+  }
+  printf("  Capture latency:   p50 <= %.1f ms, p99 <= %.1f ms\n",
+         ms(metrics::captureLatency.quantile(0.5f)), ms(metrics::captureLatency.quantile(0.99f)));
+  printf("  SD write latency:  p50 <= %.1f ms, p99 <= %.1f ms (%u writes)\n",
+         ms(metrics::sdWriteLatency.quantile(0.5f)), ms(metrics::sdWriteLatency.quantile(0.99f)),
+         metrics::sdWriteLatency.count());
+  for (uint32_t s = 0; s < opt.streams; s++) {
+    printf("  Stream %u:          %u frames (%.2f fps), %.2f MB/s, %u stalls\n", s,
+           streamStats[s].frames, streamStats[s].frames / elapsed,
+           streamStats[s].bytes / 1048576.0 / elapsed, streamStats[s].stalls);
+  }
+  if (opt.streams) {
+    printf("  Stream frame time: p50 <= %.1f ms, p99 <= %.1f ms\n",
+           ms(metrics::streamSendTime.quantile(0.5f)), ms(metrics::streamSendTime.quantile(0.99f)));
+  }
+
+  if (opt.dumpMetrics) {
+    printf("\n");
+    metrics::writePrometheus(printMetric, stdout);
+  }
+
+  if (opt.traceFile) {
+    FILE* f = fopen(opt.traceFile, "w");
+    if (!f) {
+      fprintf(stderr, "❌ Cannot write %s\n", opt.traceFile);
+      return 1;
+    }
+    tracer::ExportCursor cursor = {0, 0, 0, false};
+    char buf[4096];
+    size_t n;
+    while ((n = tracer::exportChunk(cursor, buf, sizeof(buf))) > 0) {
+      fwrite(buf, 1, n, f);
+    }
+    fclose(f);
+    printf("\n🧭 Trace written to %s (%u events)\n", opt.traceFile, (unsigned)tracer::eventCount());
+  }
+  return 0;
+}
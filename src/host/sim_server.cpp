@@ -0,0 +1,560 @@
+#include "sim_server.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+
+#include "metrics.h"
+#include "netutil.h"
+#include "pipeline.h"
+#include "resampler.h"
+#include "statusjson.h"
+
+// Same limits as the device build
+#define SIM_STREAM_CHUNK_BYTES 1436      // One TCP segment per chunk callback
+#define SIM_AUDIO_SAMPLES 256            // audioTask() buffer: 256 samples = 512 bytes
+#define SIM_WS_MAX_QUEUED_MESSAGES 32    // AsyncWebSocket default
+#define SIM_DOWNLOAD_CHUNK_BYTES 4096
+#define SIM_LIVE_MAX_FPS 15              // LIVE_MAX_FPS
+
+SimServer::SimServer(hal::Camera& camera, hal::Microphone& mic, hal::DirStorage& storage, hal::HostClock& clock)
+  : camera_(camera), mic_(mic), storage_(storage), clock_(clock),
+    running_(false), listenFd_(-1), activeConnections_(0),
+    audioDropped_(0), liveSkipped_(0), connections_(0) {}
+
+SimServer::~SimServer() {
+  stop();
+}
+
+bool SimServer::start(uint16_t port) {
+  listenFd_ = net::tcpListen(port);
+  if (listenFd_ < 0) {
+    return false;
+  }
+  running_ = true;
+  acceptThread_ = std::thread(&SimServer::acceptLoop, this);
+  audioThread_ = std::thread(&SimServer::audioLoop, this);
+  liveThread_ = std::thread(&SimServer::liveLoop, this);
+  return true;
+}
+
+void SimServer::stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  net::closeSocket(listenFd_);
+  listenFd_ = -1;
+  {
+    std::lock_guard<std::mutex> guard(wsMutex_);
+    for (auto& c : wsClients_) {
+      std::lock_guard<std::mutex> cg(c->mutex);
+      c->closed = true;
+      c->ready.notify_all();
+    }
+  }
+  // Unblock every connection thread, then wait for them to unwind
+  std::unique_lock<std::mutex> lock(connMutex_);
+  for (int fd : openFds_) {
+    shutdown(fd, SHUT_RDWR);
+  }
+  connDone_.wait_for(lock, std::chrono::seconds(5), [this] { return activeConnections_ == 0; });
+  lock.unlock();
+
+  if (acceptThread_.joinable()) acceptThread_.join();
+  if (audioThread_.joinable()) audioThread_.join();
+  if (liveThread_.joinable()) liveThread_.join();
+}
+
+void SimServer::acceptLoop() {
+  while (running_) {
+    int fd = accept(listenFd_, nullptr, nullptr);
+    if (fd < 0) {
+      continue;  // Listening socket closed by stop(), or EINTR
+    }
+    {
+      std::lock_guard<std::mutex> guard(connMutex_);
+      openFds_.insert(fd);
+      activeConnections_++;
+    }
+    connections_++;
+    std::thread([this, fd]() {
+      handle(fd);
+      std::lock_guard<std::mutex> guard(connMutex_);
+      openFds_.erase(fd);
+      close(fd);
+      activeConnections_--;
+      connDone_.notify_all();
+    }).detach();
+  }
+}
+
+static void sendSimple(int fd, int code, const char* reason, const char* type, const std::string& body) {
+  char head[256];
+  snprintf(head, sizeof(head),
+           "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+           code, reason, type, body.size());
+  net::sendAll(fd, head, strlen(head)) && net::sendAll(fd, body);
+}
+
+void SimServer::handle(int fd) {
+  net::Reader in(fd);
+  std::string head, method, target;
+  if (!in.readHead(head) || !net::parseRequestLine(head, method, target)) {
+    return;
+  }
+  std::string path = target.substr(0, target.find('?'));
+
+  if (method != "GET") {
+    sendSimple(fd, 405, "Method Not Allowed", "application/json", "{\"error\":\"GET only\"}");
+  } else if (path == "/stream") {
+    serveStream(fd);
+  } else if (path == "/audio" || path == "/live") {
+    serveWebSocket(fd, head, target, path == "/live");
+  } else if (path == "/api/files/list") {
+    serveList(fd, target);
+  } else if (path == "/api/files/download") {
+    serveDownload(fd, target, head);
+  } else if (path == "/api/status") {
+    serveStatus(fd);
+  } else if (path == "/metrics") {
+    serveMetrics(fd);
+  } else if (path == "/") {
+    sendSimple(fd, 200, "OK", "text/plain", "Video-Streamer host simulation\n");
+  } else {
+    sendSimple(fd, 404, "Not Found", "text/plain", "Not found");
+  }
+}
+
+// ============================================
+// /stream
+// ============================================
+void SimServer::serveStream(int fd) {
+  // beginChunkedResponse() on the device: HTTP chunked encoding around the
+  // multipart body, one chunk per callback
+  static const char kHead[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: multipart/x-mixed-replace; boundary=frame\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "Connection: close\r\n\r\n";
+  if (!net::sendAll(fd, kHead, sizeof(kHead) - 1)) {
+    return;
+  }
+  pipeline::MjpegStreamer streamer(camera_, clock_);
+  uint8_t buf[SIM_STREAM_CHUNK_BYTES];
+  while (running_) {
+    size_t n = streamer.fill(buf, sizeof(buf));
+    if (n == 0) {
+      break;  // Capture failed: the device ends the response here too
+    }
+    char size[16];
+    int len = snprintf(size, sizeof(size), "%zx\r\n", n);
+    if (!net::sendAll(fd, size, (size_t)len) || !net::sendAll(fd, buf, n) || !net::sendAll(fd, "\r\n", 2)) {
+      return;
+    }
+  }
+  net::sendAll(fd, "0\r\n\r\n", 5);
+}
+
+// ============================================
+// /audio and /live WebSockets
+// ============================================
+void SimServer::serveWebSocket(int fd, const std::string& head, const std::string& target, bool live) {
+  std::string key = net::headerValue(head, "Sec-WebSocket-Key");
+  if (key.empty()) {
+    sendSimple(fd, 400, "Bad Request", "text/plain", "WebSocket upgrade required");
+    return;
+  }
+  std::string rate = net::queryParam(target, "rate");
+  uint32_t hz = rate.empty() ? SAMPLE_RATE : (uint32_t)atoi(rate.c_str());
+  if (hz != 16000 && hz != 12000 && hz != 8000) {
+    sendSimple(fd, 400, "Bad Request", "text/plain", "rate must be 16000, 12000 or 8000");
+    return;
+  }
+  std::string resp = "HTTP/1.1 101 Switching Protocols\r\n"
+                     "Upgrade: websocket\r\n"
+                     "Connection: Upgrade\r\n"
+                     "Sec-WebSocket-Accept: " + net::websocketAccept(key) + "\r\n\r\n";
+  if (!net::sendAll(fd, resp)) {
+    return;
+  }
+
+  std::shared_ptr<WsClient> client(new WsClient);
+  client->fd = fd;
+  client->rate = hz;
+  client->header = net::queryParam(target, "seq") == "1";
+  client->live = live;
+  client->flow.begin(net::queryParam(target, "video") != "0", net::queryParam(target, "audio") != "0");
+  client->closed = false;
+  if (live) {
+    char hello[160];
+    size_t n = live::formatHello(hello, sizeof(hello), clock_.micros(), SIM_LIVE_MAX_FPS, hz);
+    client->queue.push_back(net::wsFrame(net::WS_TEXT, (const uint8_t*)hello, n, false));
+  }
+  {
+    std::lock_guard<std::mutex> guard(wsMutex_);
+    wsClients_.push_back(client);
+  }
+
+  // Reader side: answer pings and /live control, notice close; the writer
+  // below owns sends
+  std::thread reader([this, client]() {
+    net::Reader in(client->fd);
+    uint8_t opcode;
+    bool fin;
+    std::string payload;
+    while (net::wsReadFrame(in, opcode, fin, payload)) {
+      if (opcode == net::WS_CLOSE) {
+        break;
+      }
+      if (opcode == net::WS_PING) {
+        std::lock_guard<std::mutex> guard(client->mutex);
+        client->queue.push_front(net::wsFrame(net::WS_PONG, (const uint8_t*)payload.data(), payload.size(), false));
+        client->ready.notify_all();
+      } else if (opcode == net::WS_TEXT && client->live) {
+        onLiveControl(*client, payload);
+      }
+    }
+    std::lock_guard<std::mutex> guard(client->mutex);
+    client->closed = true;
+    client->ready.notify_all();
+  });
+
+  for (;;) {
+    std::string frame;
+    {
+      std::unique_lock<std::mutex> lock(client->mutex);
+      client->ready.wait(lock, [&] { return client->closed || !client->queue.empty(); });
+      if (client->closed) {
+        break;
+      }
+      frame.swap(client->queue.front());
+      client->queue.pop_front();
+    }
+    if (!net::sendAll(fd, frame)) {
+      break;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(wsMutex_);
+    for (size_t i = 0; i < wsClients_.size(); i++) {
+      if (wsClients_[i] == client) {
+        wsClients_.erase(wsClients_.begin() + i);
+        break;
+      }
+    }
+  }
+  shutdown(fd, SHUT_RDWR);
+  reader.join();
+}
+
+void SimServer::onLiveControl(WsClient& client, const std::string& text) {
+  live::Control c;
+  if (!live::parseControl(text.data(), text.size(), c)) {
+    return;
+  }
+  if (c.kind == live::Control::ACK) {
+    client.flow.acked();
+  } else if (c.kind == live::Control::PING) {
+    char pong[96];
+    size_t n = live::formatPong(pong, sizeof(pong), c.t, clock_.micros());
+    std::lock_guard<std::mutex> guard(client.mutex);
+    client.queue.push_front(net::wsFrame(net::WS_TEXT, (const uint8_t*)pong, n, false));
+    client.ready.notify_all();
+  } else if (c.kind == live::Control::CONFIG) {
+    client.flow.configure(c.video, c.audio);
+    if (c.rate == 16000 || c.rate == 12000 || c.rate == 8000) {
+      std::lock_guard<std::mutex> guard(wsMutex_);   // audioLoop groups clients by rate under it
+      client.rate = c.rate;
+    }
+  }
+}
+
+// Same shape as liveTask(): grab a frame only when some viewer has credit
+// for it, send it to those that do, and a stats message once a second
+void SimServer::liveLoop() {
+  std::vector<uint8_t> message;
+  uint32_t seq = 0;
+  auto nextStats = std::chrono::steady_clock::now();
+  while (running_) {
+    auto frameStart = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<WsClient>> viewers;
+    {
+      std::lock_guard<std::mutex> guard(wsMutex_);
+      for (auto& c : wsClients_) {
+        if (c->live) viewers.push_back(c);
+      }
+    }
+    bool ready = false;
+    for (auto& c : viewers) {
+      std::lock_guard<std::mutex> cg(c->mutex);
+      ready = ready || c->flow.videoReady(c->queue.size());
+    }
+    hal::Frame frame;
+    if (ready && camera_.grab(frame)) {
+      message.resize(LIVE_HEADER_SIZE + frame.len);
+      live::writeHeader(message.data(), live::LIVE_VIDEO, 0, seq++, frame.timestampUs);
+      memcpy(message.data() + LIVE_HEADER_SIZE, frame.buf, frame.len);
+      camera_.release(frame);
+      std::string ws = net::wsFrame(net::WS_BINARY, message.data(), message.size(), false);
+      for (auto& c : viewers) {
+        std::lock_guard<std::mutex> cg(c->mutex);
+        if (!c->flow.video()) {
+          continue;
+        }
+        if (c->flow.videoReady(c->queue.size())) {
+          c->queue.push_back(ws);
+          c->flow.videoSent();
+          c->ready.notify_all();
+        } else {
+          c->flow.videoSkipped();
+          liveSkipped_++;
+        }
+      }
+    }
+    if (std::chrono::steady_clock::now() >= nextStats) {
+      nextStats += std::chrono::seconds(1);
+      for (auto& c : viewers) {
+        char stats[192];
+        std::lock_guard<std::mutex> cg(c->mutex);
+        size_t n = live::formatStats(stats, sizeof(stats), c->flow, c->queue.size());
+        c->queue.push_back(net::wsFrame(net::WS_TEXT, (const uint8_t*)stats, n, false));
+        c->ready.notify_all();
+      }
+    }
+    // Frame pacing when sending, a short poll for credit otherwise
+    std::this_thread::sleep_until(frameStart + std::chrono::microseconds(ready ? 1000000 / SIM_LIVE_MAX_FPS : 5000));
+  }
+}
+
+void SimServer::audioLoop() {
+  // Same shape as audioTask(): read one block, send it to each client at
+  // its rate, resampling once per rate
+  static const uint32_t kRates[] = {16000, 12000, 8000};
+  resample::Resampler resamplers[3];
+  for (int k = 0; k < 3; k++) {
+    resamplers[k].begin(SAMPLE_RATE, kRates[k]);
+  }
+  int16_t samples[SIM_AUDIO_SAMPLES];
+  uint8_t frame[AUDIO_FRAME_HEADER_SIZE + (SIM_AUDIO_SAMPLES + 1) * 2];
+  uint8_t liveFrame[LIVE_HEADER_SIZE + (SIM_AUDIO_SAMPLES + 1) * 2];
+  int16_t* resampled = (int16_t*)(frame + AUDIO_FRAME_HEADER_SIZE);
+  uint32_t seq = 0;
+  while (running_) {
+    size_t n = mic_.read(samples, SIM_AUDIO_SAMPLES);
+    if (n == 0) {
+      clock_.delayMs(1);
+      continue;
+    }
+    // Capture time of the first sample, as the device stamps ring blocks
+    int64_t captureUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::system_clock::now().time_since_epoch()).count() -
+                        (int64_t)n * 1000000 / SAMPLE_RATE;
+    int64_t liveCaptureUs = clock_.micros() - (int64_t)n * 1000000 / SAMPLE_RATE;
+    std::lock_guard<std::mutex> guard(wsMutex_);
+    size_t deepest = 0;
+    for (int k = 0; k < 3; k++) {
+      std::string raw, framed, live;
+      for (auto& c : wsClients_) {
+        if (c->rate != kRates[k] || (c->live && !c->flow.audio())) {
+          continue;
+        }
+        if (raw.empty()) {
+          size_t out = resamplers[k].process(samples, n, resampled, SIM_AUDIO_SAMPLES + 1);
+          generate_audio_frame_header(frame, seq, kRates[k], captureUs);
+          raw = net::wsFrame(net::WS_BINARY, (const uint8_t*)resampled, out * 2, false);
+          framed = net::wsFrame(net::WS_BINARY, frame, AUDIO_FRAME_HEADER_SIZE + out * 2, false);
+          live::writeHeader(liveFrame, live::LIVE_AUDIO, (uint16_t)kRates[k], seq, liveCaptureUs);
+          memcpy(liveFrame + LIVE_HEADER_SIZE, resampled, out * 2);
+          live = net::wsFrame(net::WS_BINARY, liveFrame, LIVE_HEADER_SIZE + out * 2, false);
+        }
+        std::lock_guard<std::mutex> cg(c->mutex);
+        if (c->live) {
+          if (c->flow.audioReady(c->queue.size())) {
+            c->queue.push_back(live);
+            c->flow.audioSent();
+            c->ready.notify_all();
+          } else {
+            c->flow.audioDropped();
+          }
+        } else if (c->queue.size() >= SIM_WS_MAX_QUEUED_MESSAGES) {
+          audioDropped_++;
+        } else {
+          c->queue.push_back(c->header ? framed : raw);
+          c->ready.notify_all();
+        }
+        if (c->queue.size() > deepest) {
+          deepest = c->queue.size();
+        }
+      }
+    }
+    metrics::wsQueueDepth.set((int32_t)deepest);
+    metrics::wsClients.set((int32_t)wsClients_.size());
+    seq++;
+  }
+}
+
+// ============================================
+// File API
+// ============================================
+void SimServer::serveList(int fd, const std::string& target) {
+  std::string path = net::queryParam(target, "path");
+  if (path.empty()) {
+    path = "/";
+  }
+  DIR* dir = opendir(storage_.hostPath(path.c_str()).c_str());
+  if (!dir) {
+    sendSimple(fd, 404, "Not Found", "application/json", "{\"error\":\"Directory not found\"}");
+    return;
+  }
+  std::string json = "{\"path\":\"" + path + "\",\"files\":[";
+  bool first = true;
+  while (struct dirent* e = readdir(dir)) {
+    if (e->d_name[0] == '.') {
+      continue;
+    }
+    std::string full = storage_.hostPath(path.c_str()) + "/" + e->d_name;
+    struct stat st;
+    if (stat(full.c_str(), &st) != 0) {
+      continue;
+    }
+    if (!first) json += ",";
+    first = false;
+    json += "{\"name\":\"" + std::string(e->d_name) + "\",";
+    json += "\"size\":" + std::to_string(S_ISDIR(st.st_mode) ? 0 : (long long)st.st_size) + ",";
+    json += std::string("\"isDir\":") + (S_ISDIR(st.st_mode) ? "true" : "false") + "}";
+  }
+  closedir(dir);
+  json += "]}";
+  sendSimple(fd, 200, "OK", "application/json", json);
+}
+
+// "bytes=a-b", "bytes=a-" or "bytes=-n" against 'size'; false if unsatisfiable
+static bool parseRange(const std::string& value, uint64_t size, uint64_t& start, uint64_t& end) {
+  unsigned long long a = 0, b = 0;
+  if (size == 0 || value.compare(0, 6, "bytes=") != 0) {
+    return false;
+  }
+  const char* spec = value.c_str() + 6;
+  if (spec[0] == '-') {
+    if (sscanf(spec + 1, "%llu", &b) != 1 || b == 0) return false;
+    start = b >= size ? 0 : size - b;
+    end = size - 1;
+    return true;
+  }
+  int fields = sscanf(spec, "%llu-%llu", &a, &b);
+  if (fields < 1 || a >= size) return false;
+  start = a;
+  end = (fields == 2 && b < size) ? b : size - 1;
+  return end >= start;
+}
+
+void SimServer::serveDownload(int fd, const std::string& target, const std::string& head) {
+  std::string path = net::queryParam(target, "path");
+  if (path.empty()) {
+    sendSimple(fd, 400, "Bad Request", "application/json", "{\"error\":\"Missing path parameter\"}");
+    return;
+  }
+  if (!storage_.lock(1000)) {
+    sendSimple(fd, 503, "Service Unavailable", "application/json", "{\"error\":\"SD card busy\"}");
+    return;
+  }
+  std::string hostPath = storage_.hostPath(path.c_str());
+  struct stat st;
+  FILE* f = nullptr;
+  if (stat(hostPath.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+    f = fopen(hostPath.c_str(), "rb");
+  }
+  storage_.unlock();
+  if (!f) {
+    sendSimple(fd, 404, "Not Found", "application/json", "{\"error\":\"File not found\"}");
+    return;
+  }
+
+  uint64_t size = (uint64_t)st.st_size;
+  uint64_t start = 0, end = size ? size - 1 : 0;
+  std::string range = net::headerValue(head, "Range");
+  bool partial = !range.empty();
+  if (partial && !parseRange(range, size, start, end)) {
+    fclose(f);
+    char h[160];
+    snprintf(h, sizeof(h), "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%llu\r\n"
+             "Content-Length: 0\r\nConnection: close\r\n\r\n", (unsigned long long)size);
+    net::sendAll(fd, h, strlen(h));
+    return;
+  }
+  uint64_t length = size ? end - start + 1 : 0;
+
+  std::string name = path.substr(path.rfind('/') + 1);
+  char h[512];
+  int n = snprintf(h, sizeof(h),
+                   "HTTP/1.1 %s\r\nContent-Type: application/octet-stream\r\nContent-Length: %llu\r\n"
+                   "Accept-Ranges: bytes\r\nContent-Disposition: attachment; filename=\"%s\"\r\n",
+                   partial ? "206 Partial Content" : "200 OK", (unsigned long long)length, name.c_str());
+  if (partial) {
+    n += snprintf(h + n, sizeof(h) - n, "Content-Range: bytes %llu-%llu/%llu\r\n",
+                  (unsigned long long)start, (unsigned long long)end, (unsigned long long)size);
+  }
+  n += snprintf(h + n, sizeof(h) - n, "Connection: close\r\n\r\n");
+  if (!net::sendAll(fd, h, (size_t)n)) {
+    fclose(f);
+    return;
+  }
+
+  // Each read takes the card lock, as the device's download callback does
+  fseek(f, (long)start, SEEK_SET);
+  uint8_t buf[SIM_DOWNLOAD_CHUNK_BYTES];
+  uint64_t remaining = length;
+  while (remaining > 0 && running_) {
+    if (!storage_.lock(50)) {
+      continue;  // RESPONSE_TRY_AGAIN
+    }
+    size_t want = remaining < sizeof(buf) ? (size_t)remaining : sizeof(buf);
+    size_t got = fread(buf, 1, want, f);
+    storage_.unlock();
+    if (got == 0 || !net::sendAll(fd, buf, got)) {
+      break;
+    }
+    remaining -= got;
+  }
+  fclose(f);
+}
+
+// ============================================
+// /api/status, /metrics
+// ============================================
+void SimServer::serveStatus(int fd) {
+  char ts[32];
+  if (!clock_.timestamp(ts, sizeof(ts))) {
+    snprintf(ts, sizeof(ts), "%u", (unsigned)clock_.millis());
+  }
+  StatusSnapshot snap;
+  snap.uptimeSeconds = clock_.millis() / 1000;
+  snap.freeHeap = 0;
+  snap.sdFreeMB = (uint32_t)((storage_.totalBytes() - storage_.usedBytes()) / (1024 * 1024));
+  snap.sdTotalMB = (uint32_t)(storage_.totalBytes() / (1024 * 1024));
+  snap.frames = metrics::framesSaved.value();
+  snap.audioFiles = metrics::audioClipsSaved.value();
+  snap.batteryVoltage = 0;
+  snap.rssi = 0;
+  snap.timestamp = ts;
+  char json[320];
+  formatStatusJson(json, sizeof(json), snap);
+  sendSimple(fd, 200, "OK", "application/json", json);
+}
+
+static void appendMetric(void* ctx, const char* data, size_t len) {
+  ((std::string*)ctx)->append(data, len);
+}
+
+void SimServer::serveMetrics(int fd) {
+  metrics::uptimeSeconds.set((int32_t)(clock_.millis() / 1000));
+  std::string body;
+  metrics::writePrometheus(appendMetric, &body);
+  sendSimple(fd, 200, "OK", "text/plain; version=0.0.4", body);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+// ============================================
+// HTTP server for the host simulation
+// ============================================
+// Serves the device's load-bearing endpoints over the host HAL so the load
+// generator can be pointed at it instead of a board:
+//   /stream              chunked multipart MJPEG (pipeline::MjpegStreamer)
+//   /audio               WebSocket, one PCM frame per 256-sample block like
+//                        audioTask(), resampled for ?rate=12000 or 8000,
+//                        with the sequence/capture-time header for ?seq=1
+//   /live                WebSocket multiplexing JPEG frames, audio blocks
+//                        and control (live.h), with the device's flow control
+//   /api/files/list      directory listing (device JSON format)
+//   /api/files/download  file download with Range support
+//   /api/status, /metrics
+// Slow WebSocket clients get a bounded queue and lose frames when it is
+// full, as with AsyncWebSocket's WS_MAX_QUEUED_MESSAGES.
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hal_host.h"
+#include "live.h"
+
+class SimServer {
+ public:
+  SimServer(hal::Camera& camera, hal::Microphone& mic, hal::DirStorage& storage, hal::HostClock& clock);
+  ~SimServer();
+
+  bool start(uint16_t port);
+  void stop();
+
+  uint32_t audioFramesDropped() const { return audioDropped_; }
+  uint32_t liveFramesSkipped() const { return liveSkipped_; }
+  uint32_t connectionsServed() const { return connections_; }
+
+ private:
+  struct WsClient {
+    int fd;
+    uint32_t rate;   // Output sample rate
+    bool header;     // Frames start with generate_audio_frame_header()
+    bool live;       // /live viewer: media behind live::writeHeader(), 'flow' decides
+    live::Flow flow;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::string> queue;
+    bool closed;
+  };
+
+  void acceptLoop();
+  void audioLoop();
+  void liveLoop();
+  void handle(int fd);
+  void serveStream(int fd);
+  void serveWebSocket(int fd, const std::string& head, const std::string& target, bool live);
+  void onLiveControl(WsClient& client, const std::string& text);
+  void serveList(int fd, const std::string& target);
+  void serveDownload(int fd, const std::string& target, const std::string& head);
+  void serveStatus(int fd);
+  void serveMetrics(int fd);
+
+  hal::Camera& camera_;
+  hal::Microphone& mic_;
+  hal::DirStorage& storage_;
+  hal::HostClock& clock_;
+
+  std::atomic<bool> running_;
+  int listenFd_;
+  std::thread acceptThread_;
+  std::thread audioThread_;
+  std::thread liveThread_;
+
+  std::mutex connMutex_;
+  std::condition_variable connDone_;
+  std::set<int> openFds_;
+  int activeConnections_;
+
+  std::mutex wsMutex_;
+  std::vector<std::shared_ptr<WsClient>> wsClients_;
+
+  std::atomic<uint32_t> audioDropped_;
+  std::atomic<uint32_t> liveSkipped_;
+  std::atomic<uint32_t> connections_;
+};
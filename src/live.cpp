@@ -0,0 +1,149 @@
+#include "live.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace live {
+
+void writeHeader(uint8_t* out, Type type, uint16_t rate, uint32_t seq, int64_t captureUs) {
+  out[0] = type;
+  out[1] = 0;
+  out[2] = (uint8_t)rate;
+  out[3] = (uint8_t)(rate >> 8);
+  for (int i = 0; i < 4; i++) {
+    out[4 + i] = (uint8_t)(seq >> (8 * i));
+  }
+  for (int i = 0; i < 8; i++) {
+    out[8 + i] = (uint8_t)((uint64_t)captureUs >> (8 * i));
+  }
+}
+
+bool readHeader(const uint8_t* data, size_t len, Header& out) {
+  if (len < LIVE_HEADER_SIZE || (data[0] != LIVE_VIDEO && data[0] != LIVE_AUDIO)) {
+    return false;
+  }
+  out.type = (Type)data[0];
+  out.rate = (uint16_t)(data[2] | (data[3] << 8));
+  out.seq = 0;
+  for (int i = 0; i < 4; i++) {
+    out.seq |= (uint32_t)data[4 + i] << (8 * i);
+  }
+  uint64_t us = 0;
+  for (int i = 0; i < 8; i++) {
+    us |= (uint64_t)data[8 + i] << (8 * i);
+  }
+  out.captureUs = (int64_t)us;
+  return true;
+}
+
+// Value after "key": in a flat JSON object, or nullptr
+static const char* findKey(const char* msg, const char* key) {
+  char quoted[24];
+  int n = snprintf(quoted, sizeof(quoted), "\"%s\"", key);
+  if (n <= 0 || (size_t)n >= sizeof(quoted)) {
+    return nullptr;
+  }
+  const char* p = strstr(msg, quoted);
+  if (!p) {
+    return nullptr;
+  }
+  p += n;
+  while (*p == ' ') p++;
+  if (*p != ':') {
+    return nullptr;
+  }
+  p++;
+  while (*p == ' ') p++;
+  return p;
+}
+
+static bool findNumber(const char* msg, const char* key, double& out) {
+  const char* p = findKey(msg, key);
+  if (!p) {
+    return false;
+  }
+  char* end;
+  out = strtod(p, &end);
+  return end != p;
+}
+
+bool parseControl(const char* msg, size_t len, Control& out) {
+  out = Control{Control::NONE, 0, 0, -1, -1, 0};
+  if (len == 0 || len > LIVE_CONTROL_MAX) {
+    return false;
+  }
+  char text[LIVE_CONTROL_MAX + 1];
+  memcpy(text, msg, len);
+  text[len] = '\0';
+
+  const char* type = findKey(text, "type");
+  double v;
+  if (!type) {
+    return false;
+  } else if (strncmp(type, "\"ack\"", 5) == 0) {
+    out.kind = Control::ACK;
+    out.seq = findNumber(text, "seq", v) ? (uint32_t)v : 0;
+  } else if (strncmp(type, "\"ping\"", 6) == 0) {
+    out.kind = Control::PING;
+    out.t = findNumber(text, "t", v) ? v : 0;
+  } else if (strncmp(type, "\"config\"", 8) == 0) {
+    out.kind = Control::CONFIG;
+    if (findNumber(text, "video", v)) out.video = v != 0;
+    if (findNumber(text, "audio", v)) out.audio = v != 0;
+    if (findNumber(text, "rate", v) && v > 0) out.rate = (uint32_t)v;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void Flow::begin(bool video, bool audio) {
+  video_ = video;
+  audio_ = audio;
+  videoSent_ = videoAcked_ = videoSkipped_ = 0;
+  audioSent_ = audioDropped_ = 0;
+}
+
+void Flow::configure(int video, int audio) {
+  if (video >= 0) video_ = video != 0;
+  if (audio >= 0) audio_ = audio != 0;
+}
+
+bool Flow::videoReady(size_t queued) const {
+  return video_ && videoSent_ - videoAcked_ < LIVE_VIDEO_WINDOW && queued <= LIVE_VIDEO_QUEUE;
+}
+
+bool Flow::audioReady(size_t queued) const {
+  return audio_ && queued <= LIVE_AUDIO_QUEUE;
+}
+
+void Flow::acked() {
+  // Stray acks must not turn into extra credit
+  if (videoAcked_ != videoSent_) {
+    videoAcked_++;
+  }
+}
+
+size_t formatHello(char* out, size_t cap, int64_t deviceUs, uint32_t maxFps, uint32_t audioRate) {
+  int n = snprintf(out, cap,
+                   "{\"type\":\"hello\",\"device\":%lld,\"maxFps\":%u,\"audioRate\":%u,\"window\":%d}",
+                   (long long)deviceUs, (unsigned)maxFps, (unsigned)audioRate, LIVE_VIDEO_WINDOW);
+  return n > 0 && (size_t)n < cap ? (size_t)n : 0;
+}
+
+size_t formatPong(char* out, size_t cap, double t, int64_t deviceUs) {
+  int n = snprintf(out, cap, "{\"type\":\"pong\",\"t\":%.3f,\"device\":%lld}", t, (long long)deviceUs);
+  return n > 0 && (size_t)n < cap ? (size_t)n : 0;
+}
+
+size_t formatStats(char* out, size_t cap, const Flow& flow, size_t queued) {
+  int n = snprintf(out, cap,
+                   "{\"type\":\"stats\",\"frames\":%u,\"framesSkipped\":%u,\"inFlight\":%u,"
+                   "\"blocks\":%u,\"blocksDropped\":%u,\"queued\":%u}",
+                   (unsigned)flow.framesSent(), (unsigned)flow.framesSkipped(), (unsigned)flow.framesInFlight(),
+                   (unsigned)flow.blocksSent(), (unsigned)flow.blocksDropped(), (unsigned)queued);
+  return n > 0 && (size_t)n < cap ? (size_t)n : 0;
+}
+
+}  // namespace live
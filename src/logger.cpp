@@ -0,0 +1,248 @@
+#include "logger.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "metrics.h"
+
+#if defined(ESP_PLATFORM)
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#else
+#include <chrono>
+#include <thread>
+#endif
+
+namespace logger {
+
+static_assert((LOG_RING_SLOTS & (LOG_RING_SLOTS - 1)) == 0, "LOG_RING_SLOTS must be a power of two");
+static_assert(LOG_LINE_MAX <= 255, "LOG_LINE_MAX must fit the 8-bit slot length");
+
+// ============================================
+// Platform hooks
+// ============================================
+#if defined(ESP_PLATFORM)
+static inline uint32_t nowMs() { return (uint32_t)(esp_timer_get_time() / 1000); }
+
+static void defaultSink(const char* line, size_t len) {
+  Serial.write((const uint8_t*)line, len);
+  Serial.println();
+}
+#else
+static inline uint32_t nowMs() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void defaultSink(const char* line, size_t len) {
+  fwrite(line, 1, len, stdout);
+  fputc('\n', stdout);
+}
+#endif
+
+// ============================================
+// Ring (bounded multi-producer sequence queue)
+// ============================================
+// Each slot carries a sequence number telling producers and consumers whose
+// turn it is, so claiming a slot is a single CAS on head/tail and nobody
+// ever waits on a lock. Sequences are stored relative to the slot index so
+// the zero-initialised ring is valid before begin() runs.
+struct Slot {
+  std::atomic<uint32_t> seq;
+  uint32_t ms;
+  uint8_t level;
+  uint8_t len;
+  char text[LOG_LINE_MAX];
+};
+
+static const uint32_t kMask = LOG_RING_SLOTS - 1;
+
+static Slot ring[LOG_RING_SLOTS];
+static std::atomic<uint32_t> head(0);
+static std::atomic<uint32_t> tail(0);
+static std::atomic<uint32_t> highWater(0);
+static std::atomic<WriteFn> sink(defaultSink);
+static std::atomic<uint32_t> dropsReported(0);
+
+static inline uint32_t slotSeq(uint32_t index) {
+  return ring[index].seq.load(std::memory_order_acquire) + index;
+}
+
+static inline void setSlotSeq(uint32_t index, uint32_t seq) {
+  ring[index].seq.store(seq - index, std::memory_order_release);
+}
+
+static Slot* claim(uint32_t& posOut) {
+  uint32_t pos = head.load(std::memory_order_relaxed);
+  for (;;) {
+    int32_t diff = (int32_t)(slotSeq(pos & kMask) - pos);
+    if (diff == 0) {
+      if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        posOut = pos;
+        return &ring[pos & kMask];
+      }
+    } else if (diff < 0) {
+      return nullptr;   // Full: the drain task hasn't caught up
+    } else {
+      pos = head.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+static void noteDepth(uint32_t pos) {
+  uint32_t depth = pos + 1 - tail.load(std::memory_order_relaxed);
+  uint32_t seen = highWater.load(std::memory_order_relaxed);
+  while (depth > seen && !highWater.compare_exchange_weak(seen, depth, std::memory_order_relaxed)) {
+  }
+  if (depth > seen) {
+    metrics::logRingHighWater.set((int32_t)depth);
+  }
+}
+
+static void enqueue(Level level, uint32_t suppressed, const char* fmt, va_list args) {
+  uint32_t pos;
+  Slot* slot = claim(pos);
+  if (!slot) {
+    metrics::logDropped.inc();
+    return;
+  }
+  int n = vsnprintf(slot->text, LOG_LINE_MAX, fmt, args);
+  if (n < 0) {
+    n = 0;
+  } else if (n > LOG_LINE_MAX - 1) {
+    n = LOG_LINE_MAX - 1;
+  }
+  if (suppressed > 0 && n < LOG_LINE_MAX - 1) {
+    int extra = snprintf(slot->text + n, LOG_LINE_MAX - n, " (+%lu suppressed)", (unsigned long)suppressed);
+    n = extra > 0 && n + extra < LOG_LINE_MAX ? n + extra : LOG_LINE_MAX - 1;
+  }
+  slot->ms = nowMs();
+  slot->level = level;
+  slot->len = (uint8_t)n;
+  noteDepth(pos);
+  setSlotSeq(pos & kMask, pos + 1);
+}
+
+// ============================================
+// Public API
+// ============================================
+WriteFn setSink(WriteFn fn) {
+  return sink.exchange(fn ? fn : defaultSink);
+}
+
+void logv(Level level, const char* fmt, va_list args) {
+  enqueue(level, 0, fmt, args);
+}
+
+void log(Level level, const char* fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  enqueue(level, 0, fmt, args);
+  va_end(args);
+}
+
+void logEvery(Site& site, uint32_t intervalMs, Level level, const char* fmt, ...) {
+  uint32_t now = nowMs();
+  if (site.primed.load(std::memory_order_relaxed)) {
+    uint32_t last = site.lastMs.load(std::memory_order_relaxed);
+    if (now - last < intervalMs ||
+        !site.lastMs.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+      site.suppressed.fetch_add(1, std::memory_order_relaxed);
+      metrics::logSuppressed.inc();
+      return;
+    }
+  } else {
+    site.lastMs.store(now, std::memory_order_relaxed);
+    site.primed.store(true, std::memory_order_relaxed);
+  }
+  va_list args;
+  va_start(args, fmt);
+  enqueue(level, site.suppressed.exchange(0, std::memory_order_relaxed), fmt, args);
+  va_end(args);
+}
+
+size_t drain() {
+  // "[ssssss.mmm] " prefix plus the line
+  char line[16 + LOG_LINE_MAX];
+  size_t written = 0;
+  uint32_t pos = tail.load(std::memory_order_relaxed);
+  for (;;) {
+    uint32_t index = pos & kMask;
+    int32_t diff = (int32_t)(slotSeq(index) - (pos + 1));
+    if (diff < 0) {
+      break;   // Empty
+    }
+    if (diff > 0 || !tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+      pos = tail.load(std::memory_order_relaxed);
+      continue;
+    }
+    // Copy out and hand the slot back before the (slow) sink runs
+    const Slot& slot = ring[index];
+    int prefix = snprintf(line, sizeof(line), "[%6lu.%03lu] ",
+                          (unsigned long)(slot.ms / 1000), (unsigned long)(slot.ms % 1000));
+    memcpy(line + prefix, slot.text, slot.len);
+    size_t len = prefix + slot.len;
+    setSlotSeq(index, pos + LOG_RING_SLOTS);
+    sink.load()(line, len);
+    metrics::logWritten.inc();
+    written++;
+    pos = tail.load(std::memory_order_relaxed);
+  }
+
+  uint32_t drops = metrics::logDropped.value();
+  uint32_t reported = dropsReported.exchange(drops, std::memory_order_relaxed);
+  if (drops != reported) {
+    int len = snprintf(line, sizeof(line), "⚠️  %lu log line(s) dropped - ring full",
+                       (unsigned long)(drops - reported));
+    sink.load()(line, (size_t)len);
+  }
+  return written;
+}
+
+void stats(Stats& out) {
+  out.written = metrics::logWritten.value();
+  out.dropped = metrics::logDropped.value();
+  out.suppressed = metrics::logSuppressed.value();
+  out.highWater = highWater.load(std::memory_order_relaxed);
+}
+
+// ============================================
+// Drain task
+// ============================================
+#if defined(ESP_PLATFORM)
+static void drainTask(void* parameter) {
+  for (;;) {
+    drain();
+    vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_INTERVAL_MS));
+  }
+}
+
+bool begin() {
+  static bool started = false;
+  if (started) {
+    return true;
+  }
+  // Priority 1: only the idle task ranks lower, so output never preempts
+  // capture, recording or the network stack
+  started = xTaskCreatePinnedToCore(drainTask, "LogDrain", 3072, NULL, 1, NULL, tskNO_AFFINITY) == pdPASS;
+  return started;
+}
+#else
+bool begin() {
+  static bool started = false;
+  if (!started) {
+    std::thread([] {
+      for (;;) {
+        drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(LOG_DRAIN_INTERVAL_MS));
+      }
+    }).detach();
+    started = true;
+  }
+  return true;
+}
+#endif
+
+}  // namespace logger
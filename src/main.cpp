@@ -1,5 +1,6 @@
 #include <Arduino.h>
 #include <WiFi.h>
+#include <WiFiUdp.h>
 #include <ESPAsyncWebServer.h>
 #include <AsyncWebSocket.h>
 #include <ESP_I2S.h>
@@ -8,6 +9,9 @@
 #include <SPI.h>
 #include <ArduinoOTA.h>
 #include <time.h>
+#include <sys/time.h>
+#include <memory>
+#include <atomic>
 #include <Preferences.h>
 #include <BLEDevice.h>
 #include <BLEServer.h>
@@ -22,6 +26,36 @@
 // #include <Adafruit_SSD1306.h>
 #include "esp_camera.h"
 #include "esp_sleep.h"
+#include "driver/rtc_io.h"
+#include "driver/ledc.h"
+#include "esp_pm.h"
+#include "freertos/event_groups.h"
+#include "esp_gap_ble_api.h"
+#include "esp_idf_version.h"
+#include "metrics.h"
+#include "tracer.h"
+#include "taskmon.h"
+#include "memstats.h"
+#include "hal_esp32.h"
+#include "pipeline.h"
+#include "framehub.h"
+#include "statusjson.h"
+#include "bench.h"
+#include "logger.h"
+#include "fixedstr.h"
+#include "bleproto.h"
+#include "blexfer.h"
+#include "wifimgr.h"
+#include "avi.h"
+#include "governor.h"
+#include "pmlock.h"
+#include "cmdbus.h"
+#include "audioring.h"
+#include "sad.h"
+#include "spectrum.h"
+#include "resampler.h"
+#include "rtsp.h"
+#include "live.h"
 
 // I2S instance for PDM microphone
 I2SClass I2S;
@@ -49,14 +83,50 @@ const char* wifi_password = "mastashake08";  // Change to your WiFi password
 #define BLE_CONTROL_CHAR_UUID   "beb5483e-36e1-4688-b7f5-ea07361b26a8"
 #define BLE_STATUS_CHAR_UUID    "1c95d5e3-d8f7-413a-bf3d-7a2e5d7be87e"
 #define BLE_WIFI_CHAR_UUID      "d8de624e-140f-4a23-8b85-726f9d55da18"
+#define BLE_BINARY_CHAR_UUID    "6e4a1f3c-2b7d-4c8e-9a15-3f0d8b2c7e91"  // Binary protocol (bleproto.h)
+
+// File transfer service (blexfer.h)
+#define BLE_XFER_SERVICE_UUID   "6e4a1f3c-2b7d-4c8e-9a15-3f0d8b2c7ea0"
+#define BLE_XFER_CONTROL_UUID   "6e4a1f3c-2b7d-4c8e-9a15-3f0d8b2c7ea1"
+#define BLE_XFER_DATA_UUID      "6e4a1f3c-2b7d-4c8e-9a15-3f0d8b2c7ea2"
+#define XFER_RING_BYTES         (32 * 1024)   // PSRAM read-ahead (power of two)
+#define XFER_READ_BLOCK         4096          // SD read size
+#define XFER_ACK_TIMEOUT_MS     300           // Window stuck this long: resend oldest chunk
+#define XFER_ABORT_MS           10000         // No ack progress this long: give up
+
+#define BLE_STATUS_POLL_MS      250     // How often loop() diffs the binary status record
+#define BLE_COUNTER_NOTIFY_MS   5000    // Counter tags (frames, files, battery, SD) at most this often
 
 BLEServer* pServer = nullptr;
 BLECharacteristic* pControlCharacteristic = nullptr;
 BLECharacteristic* pStatusCharacteristic = nullptr;
 BLECharacteristic* pWiFiCharacteristic = nullptr;
+BLECharacteristic* pBinaryCharacteristic = nullptr;
+BLECharacteristic* pXferControlCharacteristic = nullptr;
+BLECharacteristic* pXferDataCharacteristic = nullptr;
+esp_bd_addr_t bleRemoteBda;                        // Current client (PHY / data length requests)
 bool deviceConnected = false;
 bool bleEnabled = true;
-bool wifiRequested = false;
+bool wifiRequested = false;   // ENABLE_WIFI queued, not yet acted on
+
+volatile uint16_t bleMtu = BLEPROTO_DEFAULT_MTU;   // Negotiated ATT MTU; notifications carry MTU - 3
+volatile bool bleFullStatusPending = false;        // Client subscribed; send a full binary record
+SemaphoreHandle_t bleNotifyMutex = NULL;           // setValue()+notify() from BLE callbacks and loop()
+
+// Text notification on the legacy status characteristic
+void bleNotifyText(const char* text) {
+  if (!bleEnabled || !deviceConnected || !pStatusCharacteristic) {
+    return;
+  }
+  if (bleNotifyMutex && xSemaphoreTake(bleNotifyMutex, pdMS_TO_TICKS(200)) != pdTRUE) {
+    return;
+  }
+  pStatusCharacteristic->setValue(text);
+  pStatusCharacteristic->notify();
+  if (bleNotifyMutex) {
+    xSemaphoreGive(bleNotifyMutex);
+  }
+}
 
 // ============================================
 // Recording Mode Configuration
@@ -70,15 +140,147 @@ unsigned long audioFileCount = 0;
 bool audioOnlyMode = false;   // Record only audio
 bool videoOnlyMode = false;   // Record only video (motion-triggered)
 bool bothMode = true;         // Record both audio and video (default)
+bool timelapseMode = false;   // One frame every timelapseIntervalSec into a daily AVI
 
-// File listing flags
-volatile bool listVideoRequested = false;
-volatile bool listAudioRequested = false;
-volatile bool listAllRequested = false;
+// Command bus (cmdbus.h): BLE and HTTP post, long-lived tasks consume.
+// loop() runs the control commands (listings, benchmark, Wi-Fi, duty
+// cycle, power target); recorderTask() owns START/STOP, so only one
+// recording or timelapse session can ever run.
+#define CMDBUS_DEPTH 8
+cmdbus::Bus controlBus;
+cmdbus::Bus recorderBus;
 
 // SD Card mutex for thread-safe access
 SemaphoreHandle_t sdMutex = NULL;
 
+// Cached SD usage - SD.usedBytes() walks the FAT, so it is refreshed from
+// loop() rather than on every /api/status request
+uint64_t sdTotalBytesCached = 0;
+uint64_t sdUsedBytesCached = 0;
+unsigned long lastSdUsageRefresh = 0;
+#define SD_USAGE_REFRESH_INTERVAL 60000
+
+// Acquire sdMutex, recording how long the caller waited
+bool sdLock(uint32_t timeoutMs) {
+  if (!sdMutex) {
+    return false;
+  }
+  TRACE_SCOPE("sd.mutex_wait");
+  unsigned long waitStart = micros();
+  bool locked = xSemaphoreTake(sdMutex, pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
+  metrics::sdMutexWait.observe(micros() - waitStart);
+  if (!locked) {
+    metrics::sdMutexTimeouts.inc();
+  } else {
+    pmlock::acquire(pmlock::SD_IO);
+  }
+  return locked;
+}
+
+void sdUnlock() {
+  pmlock::release(pmlock::SD_IO);
+  xSemaphoreGive(sdMutex);
+}
+
+// ============================================
+// Hardware abstraction & pipelines
+// ============================================
+hal::Esp32Camera camera;
+// Every consumer (recorder, /stream, RTSP, /live, timelapse) grabs through
+// the hub so concurrent viewers share captures instead of splitting them.
+// Only the duty-cycle wake, which runs before setup(), uses the camera
+// directly.
+framehub::Hub frameHub(camera);
+
+// Audio capture ring (audioring.h): audioCaptureTask() is the only reader
+// of the I2S channel; the WebSocket streamer, the SD recorder and any
+// analyzers each follow it with their own cursor
+#define AUDIO_BLOCK_READY BIT0
+audioring::Block audioBlocks[AUDIORING_BLOCKS];   // .bss, internal RAM
+audioring::Ring audioRing(audioBlocks, AUDIORING_BLOCKS);
+EventGroupHandle_t audioEvents = NULL;           // AUDIO_BLOCK_READY pulses once per block
+
+// Wait for the capture task to publish the next block
+bool audioWaitBlock(uint32_t timeoutMs) {
+  if (!audioEvents) {
+    vTaskDelay(pdMS_TO_TICKS(timeoutMs));
+    return false;
+  }
+  return xEventGroupWaitBits(audioEvents, AUDIO_BLOCK_READY, pdFALSE, pdFALSE,
+                             pdMS_TO_TICKS(timeoutMs)) & AUDIO_BLOCK_READY;
+}
+
+audioring::RingMicrophone microphone(audioRing, audioWaitBlock, SAMPLE_RATE, "recorder");
+
+// Sound activity detector (sad.h), run by soundTask() on its own ring
+// reader whenever the microphone is on. Recording sessions keep the
+// microphone on to listen and record audio only while there is sound.
+#define SAD_GATE_AUDIO 1          // Audio clips only while sound is active
+#define SAD_TRIGGER_VIDEO 0       // Video clips only while sound is active
+#define SAD_PREROLL_BLOCKS 20     // Audio kept from before an onset (~320 ms)
+#define SAD_EVENT_LOG 8           // Recent events in /api/audio
+bool sadGateAudio = SAD_GATE_AUDIO;
+bool sadTriggerVideo = SAD_TRIGGER_VIDEO;
+volatile bool soundActive = false;
+sad::Detector soundDetector;
+audioring::Reader soundReader("sad");
+
+struct SoundEventLog {
+  sad::Event events[SAD_EVENT_LOG];   // Finished events, newest at head - 1
+  size_t head;
+  size_t count;
+  uint64_t busyUs;                    // Time in Detector::process()
+  uint32_t frames;
+};
+SoundEventLog soundLog = {};
+portMUX_TYPE soundMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Level and spectrum telemetry (spectrum.h): levelsTask() condenses the ring
+// into one summary per period for /levels clients, /api/audio and /metrics
+#define LEVELS_PERIOD_MS 1000
+#define LEVELS_ALWAYS_ON 0        // Keep the mic on for /metrics with no /levels client (rules out light sleep)
+spectrum::Analyzer levelAnalyzer;   // ~18 KB of FFT buffers, kept in internal RAM
+audioring::Reader levelsReader("levels");
+spectrum::Summary lastLevels = {};
+bool haveLevels = false;
+portMUX_TYPE levelsMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Streaming output rates (resampler.h): each /audio client picks one with
+// ?rate= on the WebSocket URL, e.g. 8000 for voice at half the bandwidth.
+// Capture and recording stay at SAMPLE_RATE.
+#define WS_AUDIO_RATE 16000       // For clients that do not ask
+const uint32_t kStreamRates[] = {16000, 12000, 8000};
+#define STREAM_RATES (sizeof(kStreamRates) / sizeof(kStreamRates[0]))
+uint8_t wsRateClients[STREAM_RATES] = {0};   // Per rate, refreshed by audioTask
+uint64_t streamResampleUs = 0;               // Time in Resampler::process()
+uint32_t streamResampleBlocks = 0;
+
+// Index into kStreamRates, or -1 if the rate is not offered
+int streamRateIndex(uint32_t hz) {
+  for (size_t k = 0; k < STREAM_RATES; k++) {
+    if (kStreamRates[k] == hz) {
+      return (int)k;
+    }
+  }
+  return -1;
+}
+hal::SdStorage sdStorage(sdLock, sdUnlock);
+hal::ArduinoClock systemClock;
+pipeline::Recorder recorder(frameHub, microphone, sdStorage, systemClock);
+
+// Refresh cached SD usage. Deliberately without sdMutex: the recorder and
+// every SD writer queue behind that, and SD.usedBytes() (f_getfree) may walk
+// the whole FAT. FATFS serialises the call with file I/O on its own volume
+// lock, and once it has counted it keeps the free-cluster count current, so
+// only the first call, from initSDCard() before any recording, pays for the
+// walk.
+void refreshSdUsage() {
+  sdTotalBytesCached = SD.totalBytes();
+  sdUsedBytesCached = SD.usedBytes();
+  metrics::sdFreeBytesMB.set((int32_t)((sdTotalBytesCached - sdUsedBytesCached) / (1024 * 1024)));
+  lastSdUsageRefresh = millis();
+}
+
 // ============================================
 // Motion Detection Configuration (DISABLED)
 // ============================================
@@ -113,6 +315,67 @@ unsigned long lastCleanupTime = 0;
 #define IDLE_SLEEP_TIMEOUT 300000 // Sleep after 5 min idle (ms)
 unsigned long lastActivityTime = 0;
 bool batteryLow = false;
+uint16_t batteryMillivolts = 0;  // Last checkBatteryStatus() reading
+
+// Power governor (governor.h): battery trend + runtime target -> operating point
+#define GOVERNOR_TARGET_HOURS 0   // Runtime to plan for on battery; 0 = SoC floors only
+#define GOVERNOR_UPDATE_MS 10000  // Battery reading cadence the governor's filter is tuned for
+#define GOVERNOR_MAX_TARGET_MIN (48 * 60)
+#define PM_MIN_CPU_MHZ 80         // DFS floor; keeps APB (UART, SPI, LEDC) at 80 MHz
+#define PM_LIGHT_SLEEP 1          // Idle task may light-sleep when no pipeline holds a PM lock (pmlock.h)
+#define CAMERA_IDLE_STANDBY_MS 30000  // Sensor standby after this long with nothing capturing
+governor::Governor powerGovernor;
+volatile uint8_t powerLevel = 0;              // Operating point in force
+bool pmLightSleep = false;                    // Light sleep as last configured (not just PM_LIGHT_SLEEP)
+uint32_t powerTargetMinutes = GOVERNOR_TARGET_HOURS * 60;
+uint8_t cameraPowerLevel = 0;                 // Operating point the sensor is configured for
+bool cameraInStandby = false;                 // Sensor in register standby, XCLK stopped
+SemaphoreHandle_t cameraPowerMutex = NULL;    // Serialises standby changes between tasks
+std::atomic<uint8_t> streamClients{0};        // /stream, RTSP and live viewers (keep the sensor awake)
+volatile unsigned long lastCameraUse = 0;     // millis() of the last capture activity
+
+// ============================================
+// Deep Sleep Duty Cycle Configuration
+// ============================================
+// In duty-cycle mode a timer wake skips the full boot: only the camera and
+// SD come up, a few frames are saved and the chip goes straight back to
+// sleep. The storage cursor, sensor registers and wake latencies live in
+// RTC slow memory, which survives deep sleep. The system clock keeps
+// running through deep sleep too, so filenames stay timestamped.
+#define DUTY_DEFAULT_INTERVAL_S 60   // Wake period
+#define DUTY_DEFAULT_FRAMES 1        // Frames saved per wake
+#define DUTY_MAX_FRAMES 16
+#define DUTY_WARMUP_FRAMES 1         // Discarded while AEC/AWB settle on the restored registers
+#define DUTY_EXIT_PIN GPIO_NUM_0     // BOOT button: press during sleep to leave duty-cycle mode
+#define RTC_STATE_MAGIC 0x56534454   // "VSDT"
+#define RTC_LATENCY_SLOTS 32         // Wake-to-frame samples held for the next full boot
+
+struct RtcState {
+  uint32_t magic;
+  bool dutyCycle;
+  uint32_t intervalSec;
+  uint8_t framesPerWake;
+  uint32_t frameCount;               // Storage cursor: next frame / clip numbers
+  uint32_t audioFileCount;
+  camera_status_t sensor;            // Sensor settings when the cycle started
+  uint32_t wakes;                    // Duty-cycle wakes not yet exported to metrics
+  uint32_t failedWakes;              // Wakes where the camera or SD did not come up
+  uint32_t latencyUs[RTC_LATENCY_SLOTS];   // Wake-to-first-frame ring, newest overwrites oldest
+  uint8_t latencyCount;
+  uint8_t latencyHead;
+};
+RTC_DATA_ATTR RtcState rtcState;     // Zeroed on power-on, kept across deep sleep
+
+// ============================================
+// Timelapse Configuration
+// ============================================
+#define TIMELAPSE_DEFAULT_INTERVAL_S 10
+#define TIMELAPSE_MIN_INTERVAL_S 2
+#define TIMELAPSE_MAX_INTERVAL_S 3600
+#define TIMELAPSE_WARMUP_FRAMES 2            // Discarded after standby while AEC/AWB settle
+#define TIMELAPSE_PLAYBACK_FPS 10
+#define TIMELAPSE_MAX_FILE_BYTES (1024UL * 1024 * 1024)   // Roll to a new part past 1 GB (AVI 1.0 RIFF)
+volatile uint32_t timelapseIntervalSec = TIMELAPSE_DEFAULT_INTERVAL_S;
 
 // ============================================
 // Status LED Configuration
@@ -131,7 +394,8 @@ enum SystemState {
   STATE_RECORDING,
   STATE_STREAMING,
   STATE_ERROR,
-  STATE_LOW_BATTERY
+  STATE_LOW_BATTERY,
+  STATE_TIMELAPSE
 };
 SystemState currentState = STATE_INIT;
 
@@ -150,16 +414,12 @@ SystemState currentState = STATE_INIT;
 // Web server on port 80
 AsyncWebServer server(80);
 AsyncWebSocket ws("/audio");
+AsyncWebSocket levelsWs("/levels");   // Level/spectrum summaries (levelsTask)
 
 // Audio configuration for PDM microphone (per Seeed documentation)
 #define PDM_DATA_PIN 41  // GPIO 41: PDM Microphone DATA
 #define PDM_CLK_PIN 42   // GPIO 42: PDM Microphone CLK
-#define SAMPLE_RATE 16000U
-#define SAMPLE_BITS 16
-#define WAV_HEADER_SIZE 44
-#define VOLUME_GAIN 2
-#define RECORD_TIME 10  // seconds per file
-#define WAV_FILE_NAME "recording"
+// SAMPLE_RATE, SAMPLE_BITS, RECORD_TIME etc. live in pipeline.h
 
 // ============================================
 // USB MASS STORAGE CALLBACKS
@@ -226,25 +486,25 @@ static bool onStartStop(uint8_t power_condition, bool start, bool load_eject) {
 // Initialize USB Mass Storage
 bool initUSBMSC() {
   if (usbMscEnabled) {
-    Serial.println("USB MSC already enabled");
+    LOG_I("USB MSC already enabled");
     return true;
   }
   
-  Serial.println("Initializing USB Mass Storage...");
-  Serial.println("========================================");
+  LOG_I("Initializing USB Mass Storage...");
+  LOG_I("========================================");
   
   // Report PSRAM status before allocation
   if (psramFound()) {
     uint32_t psramTotal = ESP.getPsramSize();
     uint32_t psramFree = ESP.getFreePsram();
     uint32_t psramUsed = psramTotal - psramFree;
-    Serial.printf("PSRAM Status BEFORE allocation:\n");
-    Serial.printf("  Total: %u KB (%u bytes)\n", psramTotal / 1024, psramTotal);
-    Serial.printf("  Used:  %u KB (%u bytes)\n", psramUsed / 1024, psramUsed);
-    Serial.printf("  Free:  %u KB (%u bytes)\n", psramFree / 1024, psramFree);
-    Serial.println("----------------------------------------");
+    LOG_I("PSRAM Status BEFORE allocation:");
+    LOG_I("  Total: %u KB (%u bytes)", psramTotal / 1024, psramTotal);
+    LOG_I("  Used:  %u KB (%u bytes)", psramUsed / 1024, psramUsed);
+    LOG_I("  Free:  %u KB (%u bytes)", psramFree / 1024, psramFree);
+    LOG_I("----------------------------------------");
   } else {
-    Serial.println("❌ PSRAM not found - USB MSC requires PSRAM!");
+    LOG_E("❌ PSRAM not found - USB MSC requires PSRAM!");
     return false;
   }
   
@@ -261,58 +521,52 @@ bool initUSBMSC() {
     };
     const size_t nc = sizeof(candidates) / sizeof(candidates[0]);
 
-    Serial.println("Attempting progressive RAM disk allocation...");
+    LOG_I("Attempting progressive RAM disk allocation...");
     for (size_t i = 0; i < nc; ++i) {
       uint32_t bytes = candidates[i];
       uint32_t sectors = bytes / disk_sector_size;
-      Serial.printf("[%d/%d] Trying %u KB...", (int)(i+1), (int)nc, bytes / 1024UL);
       
-      msc_disk = (uint8_t*)ps_malloc(bytes);
+      msc_disk = (uint8_t*)memstats::alloc(memstats::TAG_RAMDISK, bytes, MALLOC_CAP_SPIRAM);
       if (msc_disk) {
         disk_sector_count = sectors;
         memset(msc_disk, 0, bytes);
-        Serial.printf(" ✓ SUCCESS\n");
-        Serial.println("----------------------------------------");
-        Serial.printf("✓ RAM disk allocated: %u KB\n", bytes / 1024UL);
-        Serial.printf("  Sectors: %u x %u bytes\n", disk_sector_count, disk_sector_size);
+        LOG_I("[%d/%d] Trying %u KB... ✓ SUCCESS", (int)(i+1), (int)nc, bytes / 1024UL);
+        LOG_I("----------------------------------------");
+        LOG_I("✓ RAM disk allocated: %u KB", bytes / 1024UL);
+        LOG_I("  Sectors: %u x %u bytes", disk_sector_count, disk_sector_size);
         
         // Report PSRAM status after allocation
         uint32_t psramFreeAfter = ESP.getFreePsram();
         uint32_t psramUsedAfter = ESP.getPsramSize() - psramFreeAfter;
-        Serial.println("----------------------------------------");
-        Serial.printf("PSRAM Status AFTER allocation:\n");
-        Serial.printf("  Used:  %u KB (%u bytes)\n", psramUsedAfter / 1024, psramUsedAfter);
-        Serial.printf("  Free:  %u KB (%u bytes)\n", psramFreeAfter / 1024, psramFreeAfter);
-        Serial.printf("  Delta: +%u KB allocated\n", bytes / 1024UL);
+        LOG_I("----------------------------------------");
+        LOG_I("PSRAM Status AFTER allocation:");
+        LOG_I("  Used:  %u KB (%u bytes)", psramUsedAfter / 1024, psramUsedAfter);
+        LOG_I("  Free:  %u KB (%u bytes)", psramFreeAfter / 1024, psramFreeAfter);
+        LOG_I("  Delta: +%u KB allocated", bytes / 1024UL);
         
         // Send status via BLE if connected
-        if (deviceConnected && pStatusCharacteristic) {
-          String status = "USB:Enabled|RAMDisk:" + String(bytes / 1024) + "KB";
-          pStatusCharacteristic->setValue(status.c_str());
-          pStatusCharacteristic->notify();
-        }
+        FixedString<48> status;
+        status.append("USB:Enabled|RAMDisk:").appendUint(bytes / 1024).append("KB");
+        bleNotifyText(status.c_str());
         
         break;
       } else {
-        Serial.printf(" ❌ FAILED\n");
+        LOG_W("[%d/%d] Trying %u KB... ❌ FAILED", (int)(i+1), (int)nc, (unsigned)(bytes / 1024UL));
       }
     }
 
     if (!msc_disk) {
-      Serial.println("========================================");
-      Serial.println("❌ Failed to allocate any RAM disk size");
-      Serial.println("Not enough PSRAM available!");
-      Serial.println("----------------------------------------");
-      Serial.println("💡 Recommendation: Use Web File Browser instead");
-      Serial.println("   Access files via WiFi at http://<IP>/files");
-      Serial.println("   No PSRAM required, unlimited file size support");
-      Serial.println("========================================");
+      LOG_I("========================================");
+      LOG_E("❌ Failed to allocate any RAM disk size");
+      LOG_E("Not enough PSRAM available!");
+      LOG_I("----------------------------------------");
+      LOG_I("💡 Recommendation: Use Web File Browser instead");
+      LOG_I("   Access files via WiFi at http://<IP>/files");
+      LOG_I("   No PSRAM required, unlimited file size support");
+      LOG_I("========================================");
       
       // Send failure notification via BLE
-      if (deviceConnected && pStatusCharacteristic) {
-        pStatusCharacteristic->setValue("USB:Failed|UseBrowser");
-        pStatusCharacteristic->notify();
-      }
+      bleNotifyText("USB:Failed|UseBrowser");
       
       return false;
     }
@@ -328,18 +582,19 @@ bool initUSBMSC() {
   msc.mediaPresent(true);
   
   if (!msc.begin(disk_sector_count, disk_sector_size)) {
-    Serial.println("❌ Failed to start USB MSC");
+    LOG_E("❌ Failed to start USB MSC");
     return false;
   }
 
   USB.begin();
 
   usbMscEnabled = true;
-  Serial.println("✓ USB Mass Storage enabled");
-  Serial.printf("  %u KB RAM disk exposed as USB drive\n", (disk_sector_count * disk_sector_size) / 1024U);
-  Serial.println("  ⚠️  This is a virtual disk for file transfers");
-  Serial.println("  ⚠️  Format as FAT32 first, then copy files to/from SD card manually");
-  Serial.println("  Safely eject the drive before sending DISABLE_USB command");
+  pmlock::acquire(pmlock::USB_MSC);
+  LOG_I("✓ USB Mass Storage enabled");
+  LOG_I("  %u KB RAM disk exposed as USB drive", (disk_sector_count * disk_sector_size) / 1024U);
+  LOG_W("  ⚠️  This is a virtual disk for file transfers");
+  LOG_W("  ⚠️  Format as FAT32 first, then copy files to/from SD card manually");
+  LOG_I("  Safely eject the drive before sending DISABLE_USB command");
   
   return true;
 }
@@ -350,12 +605,12 @@ void disableUSBMSC() {
     return;
   }
   
-  Serial.println("Disabling USB Mass Storage...");
+  LOG_I("Disabling USB Mass Storage...");
   
   // Wait for unmount
   if (usbMscMounted) {
-    Serial.println("⚠️  Please eject the USB drive from your computer first!");
-    Serial.println("Waiting for unmount...");
+    LOG_W("⚠️  Please eject the USB drive from your computer first!");
+    LOG_I("Waiting for unmount...");
     
     unsigned long timeout = millis() + 30000; // 30 second timeout
     while (usbMscMounted && millis() < timeout) {
@@ -363,7 +618,7 @@ void disableUSBMSC() {
     }
     
     if (usbMscMounted) {
-      Serial.println("⚠️  Timeout - force disabling USB MSC");
+      LOG_W("⚠️  Timeout - force disabling USB MSC");
     }
   }
   
@@ -372,23 +627,23 @@ void disableUSBMSC() {
   
   // Free RAM disk (optional - keep it allocated for next time)
   // if (msc_disk) {
-  //   free(msc_disk);
+  //   memstats::release(memstats::TAG_RAMDISK, msc_disk);
   //   msc_disk = nullptr;
   // }
   
   usbMscEnabled = false;
   usbMscMounted = false;
+  pmlock::release(pmlock::USB_MSC);
   
-  Serial.println("✓ USB Mass Storage disabled");
-  Serial.println("  Recording can now be resumed");
+  LOG_I("✓ USB Mass Storage disabled");
+  LOG_I("  Recording can now be resumed");
   
   // Small delay
   delay(500);
 }
 
-// Initialize camera - following official XIAO ESP32S3 example pattern
-bool initCamera() {
-  camera_config_t config;
+// XIAO ESP32S3 Sense pinout and the UXGA/PSRAM defaults from the official example
+void fillCameraConfig(camera_config_t& config) {
   config.ledc_channel = LEDC_CHANNEL_0;
   config.ledc_timer = LEDC_TIMER_0;
   config.pin_d0 = 15;
@@ -428,6 +683,12 @@ bool initCamera() {
       config.fb_location = CAMERA_FB_IN_DRAM;
     }
   }
+}
+
+// Initialize camera - following official XIAO ESP32S3 example pattern
+bool initCamera() {
+  camera_config_t config;
+  fillCameraConfig(config);
 
   // Camera init
   esp_err_t err = esp_camera_init(&config);
@@ -452,6 +713,13 @@ bool initCamera() {
     }
   }
   
+  // The sensor now streams into its frame buffers (see cameraStandby())
+  if (!cameraPowerMutex) {
+    cameraPowerMutex = xSemaphoreCreateMutex();
+  }
+  pmlock::acquire(pmlock::CAMERA);
+  lastCameraUse = millis();
+  
   Serial.println("Camera initialized successfully");
   return true;
 }
@@ -473,36 +741,43 @@ void updateLastFrame(camera_fb_t *frame) {
 // ============================================
 // TIME & TIMESTAMP FUNCTIONS
 // ============================================
-bool initTime() {
+bool timeSyncStarted = false;
+
+// Start SNTP in the background; pollTimeSync() picks up the result
+void startTimeSync() {
   Serial.println("Initializing time from NTP...");
   configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
-  
-  int retries = 0;
-  while (!getLocalTime(&timeinfo) && retries < 10) {
-    Serial.print(".");
-    delay(1000);
-    retries++;
-  }
-  Serial.println();
-  
-  if (retries >= 10) {
-    Serial.println("Failed to obtain time");
-    return false;
+  timeSyncStarted = true;
+}
+
+// Called from loop(); never waits (getLocalTime() blocks 5 s by default)
+void pollTimeSync() {
+  if (!timeSyncStarted || timeInitialized || !getLocalTime(&timeinfo, 0)) {
+    return;
   }
-  
   Serial.println(&timeinfo, "Time initialized: %A, %B %d %Y %H:%M:%S");
   timeInitialized = true;
-  return true;
 }
 
-String getTimestamp() {
+// "YYYYMMDD_HHMMSS" into 'out', or millis() before NTP sync
+const char* formatTimestamp(char* out, size_t cap) {
   if (!timeInitialized || !getLocalTime(&timeinfo)) {
-    return String(millis()); // Fallback to millis
+    snprintf(out, cap, "%lu", millis()); // Fallback to millis
+    return out;
   }
   
-  char timestamp[32];
-  strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", &timeinfo);
-  return String(timestamp);
+  strftime(out, cap, "%Y%m%d_%H%M%S", &timeinfo);
+  return out;
+}
+
+// Unix time of an esp_timer timestamp, or 0 before NTP sync
+int64_t unixTimeUs(int64_t timerUs) {
+  if (!timeInitialized) {
+    return 0;
+  }
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (int64_t)now.tv_sec * 1000000 + now.tv_usec - (esp_timer_get_time() - timerUs);
 }
 
 String getDateString() {
@@ -564,6 +839,225 @@ void cleanupOldFiles() {
   Serial.printf("Free space after cleanup: %lluMB\n", freeSpace);
 }
 
+// ============================================
+// BACKGROUND BATCH DELETE JOBS
+// ============================================
+// One job runs at a time. The worker walks a single directory, holding
+// sdMutex only for a small batch of entries and backing off between
+// batches so the recorder never waits long for the card.
+#define DELETE_JOB_BATCH_SIZE 8          // Directory entries handled per sdMutex hold
+#define DELETE_JOB_BATCH_PAUSE_MS 50     // Pause between batches (lets recording in)
+#define DELETE_JOB_MUTEX_WAIT_MS 20      // Give up quickly if the recorder holds the card
+#define DELETE_JOB_PRIORITY 0            // Below recorderTask/audioTask (priority 1)
+
+enum DeleteJobState {
+  JOB_IDLE,
+  JOB_RUNNING,
+  JOB_DONE,
+  JOB_CANCELLED,
+  JOB_FAILED
+};
+
+struct DeleteJob {
+  uint32_t id;
+  volatile DeleteJobState state;
+  volatile bool cancelRequested;
+  char dir[64];          // Directory to scan, e.g. "/video"
+  char pattern[48];      // Filename glob, e.g. "20240101_*.jpg"
+  time_t fromTime;       // Last-write lower bound (0 = unbounded)
+  time_t toTime;         // Last-write upper bound (0 = unbounded)
+  volatile uint32_t scanned;
+  volatile uint32_t matched;
+  volatile uint32_t deleted;
+  volatile uint32_t failed;
+  volatile uint64_t bytesFreed;
+  unsigned long startedAt;
+  unsigned long finishedAt;
+};
+
+DeleteJob deleteJob = {};
+uint32_t nextDeleteJobId = 1;
+
+const char* deleteJobStateName(DeleteJobState state) {
+  switch (state) {
+    case JOB_RUNNING:   return "running";
+    case JOB_DONE:      return "done";
+    case JOB_CANCELLED: return "cancelled";
+    case JOB_FAILED:    return "failed";
+    default:            return "idle";
+  }
+}
+
+// Match a filename against a glob supporting '*' and '?'
+bool globMatch(const char* pattern, const char* str) {
+  const char* starP = nullptr;
+  const char* starS = nullptr;
+  while (*str) {
+    if (*pattern == '?' || *pattern == *str) {
+      pattern++;
+      str++;
+    } else if (*pattern == '*') {
+      starP = pattern++;
+      starS = str;
+    } else if (starP) {
+      pattern = starP + 1;
+      str = ++starS;
+    } else {
+      return false;
+    }
+  }
+  while (*pattern == '*') {
+    pattern++;
+  }
+  return *pattern == '\0';
+}
+
+bool deleteJobMatches(const DeleteJob& job, const char* name, time_t lastWrite) {
+  if (!globMatch(job.pattern, name)) {
+    return false;
+  }
+  if (job.fromTime && lastWrite < job.fromTime) {
+    return false;
+  }
+  if (job.toTime && lastWrite > job.toTime) {
+    return false;
+  }
+  return true;
+}
+
+void deleteJobTask(void *parameter) {
+  DeleteJob& job = deleteJob;
+  Serial.printf("🧹 Delete job %u started: %s/%s\n", job.id, job.dir, job.pattern);
+
+  File dir;
+  bool exhausted = false;
+
+  while (!exhausted && !job.cancelRequested) {
+    if (!sdLock(DELETE_JOB_MUTEX_WAIT_MS)) {
+      // Card busy (recording) - back off and try again
+      vTaskDelay(pdMS_TO_TICKS(DELETE_JOB_BATCH_PAUSE_MS));
+      continue;
+    }
+
+    if (!dir) {
+      dir = SD.open(job.dir);
+      if (!dir || !dir.isDirectory()) {
+        sdUnlock();
+        Serial.printf("❌ Delete job %u: cannot open %s\n", job.id, job.dir);
+        job.state = JOB_FAILED;
+        job.finishedAt = millis();
+        vTaskDelete(NULL);
+        return;
+      }
+    }
+
+    for (int i = 0; i < DELETE_JOB_BATCH_SIZE; i++) {
+      File file = dir.openNextFile();
+      if (!file) {
+        exhausted = true;
+        break;
+      }
+      if (file.isDirectory()) {
+        file.close();
+        continue;
+      }
+
+      job.scanned++;
+      char path[128];
+      snprintf(path, sizeof(path), "%s/%s", strcmp(job.dir, "/") == 0 ? "" : job.dir, file.name());
+      size_t fileSize = file.size();
+      bool match = deleteJobMatches(job, file.name(), file.getLastWrite());
+      file.close();
+
+      if (match) {
+        job.matched++;
+        if (SD.remove(path)) {
+          job.deleted++;
+          job.bytesFreed += fileSize;
+        } else {
+          job.failed++;
+        }
+      }
+    }
+
+    sdUnlock();
+    vTaskDelay(pdMS_TO_TICKS(DELETE_JOB_BATCH_PAUSE_MS));
+  }
+
+  if (dir && sdLock(portMAX_DELAY)) {
+    dir.close();
+    sdUnlock();
+  }
+
+  job.state = job.cancelRequested ? JOB_CANCELLED : JOB_DONE;
+  job.finishedAt = millis();
+  Serial.printf("✓ Delete job %u %s: %u deleted, %u failed, %llu bytes freed\n",
+                job.id, deleteJobStateName(job.state), job.deleted, job.failed, job.bytesFreed);
+  vTaskDelete(NULL);
+}
+
+// Start a delete job. 'glob' is a full path whose last component may hold
+// wildcards ("/video/*.jpg"); a trailing directory deletes everything in it.
+uint32_t startDeleteJob(const String& glob, time_t fromTime, time_t toTime) {
+  if (deleteJob.state == JOB_RUNNING) {
+    return 0;
+  }
+
+  int lastSlash = glob.lastIndexOf('/');
+  if (lastSlash < 0) {
+    return 0;
+  }
+  String dirPart = lastSlash == 0 ? String("/") : glob.substring(0, lastSlash);
+  String patternPart = glob.substring(lastSlash + 1);
+  if (patternPart.length() == 0) {
+    patternPart = "*";
+  }
+  if (dirPart.length() >= sizeof(deleteJob.dir) || patternPart.length() >= sizeof(deleteJob.pattern)) {
+    return 0;
+  }
+
+  memset(&deleteJob, 0, sizeof(deleteJob));
+  deleteJob.id = nextDeleteJobId++;
+  strcpy(deleteJob.dir, dirPart.c_str());
+  strcpy(deleteJob.pattern, patternPart.c_str());
+  deleteJob.fromTime = fromTime;
+  deleteJob.toTime = toTime;
+  deleteJob.startedAt = millis();
+  deleteJob.state = JOB_RUNNING;
+
+  if (xTaskCreatePinnedToCore(deleteJobTask, "DeleteJob", 4096, NULL,
+                              DELETE_JOB_PRIORITY, NULL, tskNO_AFFINITY) != pdPASS) {
+    deleteJob.state = JOB_FAILED;
+    return 0;
+  }
+  return deleteJob.id;
+}
+
+// Handlers run one at a time on the async_tcp task, so the buffer is shared.
+// dir and pattern come from the request and may hold quotes or backslashes.
+const StringWriter& deleteJobStatusJson() {
+  const DeleteJob& job = deleteJob;
+  unsigned long end = job.state == JOB_RUNNING ? millis() : job.finishedAt;
+  static FixedString<1024> json;
+  json.clear();
+  JsonWriter w(json);
+  w.beginObject();
+  w.num("id", job.id);
+  w.str("state", deleteJobStateName(job.state));
+  w.str("dir", job.dir);
+  w.str("pattern", job.pattern);
+  w.num("from", (int64_t)job.fromTime);
+  w.num("to", (int64_t)job.toTime);
+  w.num("scanned", job.scanned);
+  w.num("matched", job.matched);
+  w.num("deleted", job.deleted);
+  w.num("failed", job.failed);
+  w.num("bytesFreed", (int64_t)job.bytesFreed);
+  w.num("elapsedMs", job.id ? end - job.startedAt : 0);
+  w.endObject();
+  return json;
+}
+
 // ============================================
 // POWER MANAGEMENT
 // ============================================
@@ -577,6 +1071,7 @@ float getBatteryVoltage() {
 
 void checkBatteryStatus() {
   float voltage = getBatteryVoltage();
+  batteryMillivolts = (uint16_t)(voltage * 1000.0f);
   
   if (voltage < LOW_BATTERY_VOLTAGE && voltage > 0.5) {
     if (!batteryLow) {
@@ -589,21 +1084,297 @@ void checkBatteryStatus() {
   }
 }
 
+// CPU ceiling from the governor's operating point with an 80 MHz floor and
+// automatic light sleep. Each pipeline holds its pmlock only while it works
+// (capture and Wi-Fi TX at the ceiling; camera, SD, audio and USB just keep
+// the chip out of light sleep), so an idle device drops to the floor and
+// sleeps between ticks. Light sleep needs tickless idle in the SDK build and
+// is held off by the BT controller unless that runs in modem-sleep mode.
+// Without PM support the CPU is just clocked at the ceiling.
+void applyPmConfig() {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+  esp_pm_config_t pm = {};
+#else
+  esp_pm_config_esp32s3_t pm = {};
+#endif
+  pm.max_freq_mhz = governor::kOperatingPoints[powerLevel].cpuMhz;
+  pm.min_freq_mhz = PM_MIN_CPU_MHZ;
+  pm.light_sleep_enable = PM_LIGHT_SLEEP;
+  esp_err_t err = esp_pm_configure(&pm);
+  if (err == ESP_ERR_NOT_SUPPORTED && pm.light_sleep_enable) {
+    pm.light_sleep_enable = false;
+    err = esp_pm_configure(&pm);
+    LOG_W_EVERY(3600000, "⚠️  Automatic light sleep not available in this build - DFS only");
+  }
+  if (err != ESP_OK) {
+    LOG_W_EVERY(3600000, "⚠️  Power management unavailable (0x%x) - fixed %d MHz clock", err, pm.max_freq_mhz);
+    setCpuFrequencyMhz(pm.max_freq_mhz);
+    pmLightSleep = false;
+    return;
+  }
+  pmLightSleep = pm.light_sleep_enable;
+  pmlock::begin();
+}
+
+// Register-level sensor standby (the Sense board has no PWDN line) plus
+// gating the 20 MHz XCLK. SCCB needs XCLK, so it runs while registers change.
+// The camera pmlock is held whenever the sensor streams: its DMA and XCLK
+// don't survive light sleep. Caller holds cameraPowerMutex.
+static void setCameraStandby(sensor_t* s, bool standby) {
+  if (standby == cameraInStandby) {
+    return;
+  }
+  if (!standby) {
+    pmlock::acquire(pmlock::CAMERA);
+    ledc_timer_resume(LEDC_LOW_SPEED_MODE, LEDC_TIMER_0);
+  }
+  switch (s->id.PID) {
+    case OV2640_PID:
+      s->set_reg(s, 0x109, 0x10, standby ? 0x10 : 0);   // COM2 standby (sensor bank)
+      break;
+    case OV3660_PID:
+    case OV5640_PID:
+      s->set_reg(s, 0x3008, 0x40, standby ? 0x40 : 0);  // SYSTEM CTROL0 software power down
+      break;
+  }
+  if (standby) {
+    ledc_timer_pause(LEDC_LOW_SPEED_MODE, LEDC_TIMER_0);
+    pmlock::release(pmlock::CAMERA);
+  }
+  cameraInStandby = standby;
+}
+
+void cameraStandby(bool standby) {
+  sensor_t* s = esp_camera_sensor_get();
+  if (!s || !cameraPowerMutex) {
+    return;
+  }
+  xSemaphoreTake(cameraPowerMutex, portMAX_DELAY);
+  setCameraStandby(s, standby);
+  if (!standby) {
+    lastCameraUse = millis();
+  }
+  xSemaphoreGive(cameraPowerMutex);
+}
+
+// Put an unused sensor to sleep (from loop(), outside recording/timelapse).
+// /stream and the recorder wake it with cameraStandby(false); a stream
+// counts itself in streamClients before waking, so checking under the
+// mutex can't race it.
+void cameraIdleStandby() {
+  sensor_t* s = esp_camera_sensor_get();
+  if (!s || !cameraPowerMutex || cameraInStandby || millis() - lastCameraUse < CAMERA_IDLE_STANDBY_MS) {
+    return;
+  }
+  xSemaphoreTake(cameraPowerMutex, portMAX_DELAY);
+  if (!streamClients && millis() - lastCameraUse >= CAMERA_IDLE_STANDBY_MS) {
+    setCameraStandby(s, true);
+    LOG_I("📷 Camera idle - sensor standby");
+  }
+  xSemaphoreGive(cameraPowerMutex);
+}
+
+static framesize_t governorFrameSize(governor::FrameSize size) {
+  switch (size) {
+    case governor::FRAME_QQVGA: return FRAMESIZE_QQVGA;
+    case governor::FRAME_HQVGA: return FRAMESIZE_HQVGA;
+    default:                    return FRAMESIZE_QVGA;
+  }
+}
+
+static wifi_ps_type_t governorWifiPs(governor::WifiPowerSave ps) {
+  switch (ps) {
+    case governor::WIFI_PS_OFF: return WIFI_PS_NONE;
+    case governor::WIFI_PS_MAX: return WIFI_PS_MAX_MODEM;
+    default:                    return WIFI_PS_MIN_MODEM;
+  }
+}
+
+// Reconfigure the sensor (XCLK, frame size) for the operating point. Only
+// from the task that owns the camera, between clips or shots, so a change
+// never lands in the middle of a recording.
+void applyCameraPowerLevel() {
+  uint8_t level = powerLevel;
+  sensor_t* s = esp_camera_sensor_get();
+  if (level == cameraPowerLevel || !s || cameraInStandby) {
+    return;   // A sensor in standby picks the change up after it wakes
+  }
+  const governor::OperatingPoint& op = governor::kOperatingPoints[level];
+  if (s->set_xclk) {
+    s->set_xclk(s, LEDC_TIMER_0, op.xclkMhz);
+  }
+  s->set_framesize(s, governorFrameSize(op.frameSize));
+  cameraPowerLevel = level;
+  LOG_I("🔋 Camera: %u MHz XCLK, frame size %d", op.xclkMhz, (int)governorFrameSize(op.frameSize));
+}
+
+// Switch to an operating point. CPU, Wi-Fi power save and the recorder's
+// frame rate change right away; the sensor follows via applyCameraPowerLevel().
+void applyPowerLevel(uint8_t level) {
+  const governor::OperatingPoint& op = governor::kOperatingPoints[level];
+  uint32_t projected = powerGovernor.projectedMinutes();
+  if (projected == UINT32_MAX) {
+    LOG_I("🔋 Power: %s -> %s (battery %u mV, %u%%)", governor::kOperatingPoints[powerLevel].name, op.name,
+          powerGovernor.filteredMillivolts(), powerGovernor.socPermille() / 10);
+  } else {
+    LOG_I("🔋 Power: %s -> %s (battery %u mV, %u%%, ~%lu min left)", governor::kOperatingPoints[powerLevel].name,
+          op.name, powerGovernor.filteredMillivolts(), powerGovernor.socPermille() / 10, (unsigned long)projected);
+  }
+  powerLevel = level;
+  metrics::powerLevel.set(level);
+  metrics::powerTransitions.inc();
+  applyPmConfig();
+  recorder.setMaxFps(op.maxFps);
+  if (WiFi.getMode() != WIFI_OFF) {
+    WiFi.setSleep(governorWifiPs(op.wifiPs));
+  }
+}
+
+// New runtime target (CMD_POWER_TARGET, run from loop()); the trend restarts
+void setPowerTarget(uint32_t minutes) {
+  powerTargetMinutes = minutes;
+  powerGovernor.begin(governor::defaultConfig(powerTargetMinutes), millis());
+  LOG_I("🔋 Runtime target: %lu min", (unsigned long)powerTargetMinutes);
+}
+
+// Feed the governor one battery reading (every GOVERNOR_UPDATE_MS from loop())
+void updatePowerGovernor() {
+  // Wi-Fi comes up with the driver's default power save; apply the point's
+  static bool wifiWasUp = false;
+  bool wifiUp = WiFi.status() == WL_CONNECTED;
+  if (wifiUp && !wifiWasUp) {
+    WiFi.setSleep(governorWifiPs(governor::kOperatingPoints[powerLevel].wifiPs));
+  }
+  wifiWasUp = wifiUp;
+
+  // Below 0.5 V there is no battery on the divider (USB power): stay put
+  uint8_t level = batteryMillivolts > 500 ? powerGovernor.update(millis(), batteryMillivolts) : powerGovernor.level();
+  metrics::batteryMv.set(powerGovernor.filteredMillivolts());
+  if (level != powerLevel) {
+    applyPowerLevel(level);
+  }
+}
+
+// Handlers run one at a time on the async_tcp task, so the buffer is shared
+const StringWriter& powerStatusJson() {
+  const governor::OperatingPoint& op = governor::kOperatingPoints[powerLevel];
+  uint32_t projected = powerGovernor.projectedMinutes();
+  static FixedString<512> json;
+  json.clear();
+  JsonWriter w(json);
+  w.beginObject();
+  w.num("level", powerLevel);
+  w.str("point", op.name);
+  w.num("cpuMhz", getCpuFrequencyMhz());
+  w.num("maxCpuMhz", op.cpuMhz);
+  w.num("xclkMhz", op.xclkMhz);
+  w.num("maxFps", op.maxFps);
+  w.num("batteryMv", powerGovernor.filteredMillivolts());
+  w.tenths("socPercent", powerGovernor.socPermille());   // Permille is tenths of a percent
+  w.tenths("drainPercentPerHour", powerGovernor.drainPermillePerHour());
+  w.boolean("charging", powerGovernor.charging());
+  if (projected == UINT32_MAX) {
+    w.null("projectedMinutes");
+  } else {
+    w.num("projectedMinutes", projected);
+  }
+  w.num("targetMinutes", powerTargetMinutes);
+  w.num("transitions", powerGovernor.transitions());
+  w.endObject();
+  return json;
+}
+
+// Residency per requested power state and per pipeline lock since boot or
+// the last reset (pmlock.h). Handlers run one at a time on the async_tcp
+// task, so the buffer is shared.
+const StringWriter& pmStatusJson() {
+  pmlock::Residency r;
+  pmlock::LockStats locks[pmlock::LOCK_COUNT];
+  pmlock::snapshot(r, locks);
+  uint64_t windowUs = (uint64_t)esp_timer_get_time() - r.sinceUs;
+  // Both rounded to tenths for JsonWriter::tenths()
+  auto seconds = [](uint64_t us) { return (int64_t)((us + 50000) / 100000); };
+  auto percent = [windowUs](uint64_t us) {
+    return windowUs ? (int64_t)((us * 1000 + windowUs / 2) / windowUs) : 0;
+  };
+
+  static FixedString<1536> json;
+  json.clear();
+  JsonWriter w(json);
+  w.beginObject();
+  w.boolean("enabled", r.pmEnabled);
+  w.boolean("lightSleepEnabled", pmLightSleep);
+  w.num("cpuMhz", getCpuFrequencyMhz());
+  w.num("minCpuMhz", PM_MIN_CPU_MHZ);
+  w.num("maxCpuMhz", governor::kOperatingPoints[powerLevel].cpuMhz);
+  w.tenths("windowSeconds", seconds(windowUs));
+  w.beginObject("states");
+  for (int i = 0; i < pmlock::STATE_COUNT; i++) {
+    w.beginObject(pmlock::stateName((pmlock::State)i));
+    w.tenths("seconds", seconds(r.stateUs[i]));
+    w.tenths("percent", percent(r.stateUs[i]));
+    w.endObject();
+  }
+  w.endObject();
+  w.beginObject("lightSleep");
+  if (r.lightSleepUs >= 0) {
+    w.tenths("seconds", seconds((uint64_t)r.lightSleepUs));
+    w.tenths("percent", percent((uint64_t)r.lightSleepUs));
+  } else {
+    w.null("seconds");
+    w.null("percent");
+  }
+  w.num("entries", r.lightSleeps);
+  w.endObject();
+  w.beginArray("locks");
+  for (int i = 0; i < pmlock::LOCK_COUNT; i++) {
+    w.beginObject();
+    w.str("name", locks[i].name);
+    w.str("type", locks[i].cpuMax ? "cpu_freq_max" : "no_light_sleep");
+    w.num("holders", locks[i].holders);
+    w.num("acquisitions", locks[i].acquisitions);
+    w.tenths("heldSeconds", seconds(locks[i].heldUs));
+    w.tenths("percent", percent(locks[i].heldUs));
+    w.endObject();
+  }
+  w.endArray();
+  w.endObject();
+  return json;
+}
+
+// Copy the storage cursor into RTC memory (call before any deep sleep)
+void saveRtcCounters() {
+  if (rtcState.magic != RTC_STATE_MAGIC) {
+    memset(&rtcState, 0, sizeof(rtcState));
+    rtcState.magic = RTC_STATE_MAGIC;
+  }
+  rtcState.frameCount = frameCount;
+  rtcState.audioFileCount = audioFileCount;
+}
+
 void enterDeepSleep(uint64_t sleepTimeSeconds) {
   Serial.printf("Entering deep sleep for %llu seconds\n", sleepTimeSeconds);
   
   // Close all files
   SD.end();
   
+  // Keep the storage cursor so the next boot doesn't reuse file numbers
+  saveRtcCounters();
+  
   // Configure wakeup
   esp_sleep_enable_timer_wakeup(sleepTimeSeconds * 1000000ULL);
   
+  // Flush queued log lines; RAM (and the log ring) is lost in deep sleep
+  logger::drain();
+  Serial.flush();
+  
   // Enter deep sleep
   esp_deep_sleep_start();
 }
 
 void checkIdleTimeout() {
-  if (currentState == STATE_STREAMING || currentState == STATE_RECORDING) {
+  if (currentState == STATE_STREAMING || currentState == STATE_RECORDING ||
+      currentState == STATE_TIMELAPSE) {
     lastActivityTime = millis();
     return;
   }
@@ -615,56 +1386,223 @@ void checkIdleTimeout() {
 }
 
 // ============================================
-// STATUS LED CONTROL
+// DEEP SLEEP DUTY CYCLE
 // ============================================
-void updateStatusLED() {
-  unsigned long currentMillis = millis();
-  unsigned int blinkInterval;
-  
-  switch (currentState) {
-    case STATE_RECORDING:
-      blinkInterval = LED_BLINK_RECORDING;
-      break;
-    case STATE_WIFI_CONNECTING:
-      blinkInterval = LED_BLINK_WIFI;
-      break;
-    case STATE_WIFI_CONNECTED:
-    case STATE_STREAMING:
-      blinkInterval = LED_BLINK_WIFI;
-      break;
-    case STATE_ERROR:
-    case STATE_LOW_BATTERY:
-      blinkInterval = LED_BLINK_ERROR;
-      break;
-    default:
-      digitalWrite(LED_BUILTIN, LOW);
-      return;
+// Sleep until the next duty-cycle wake. 'awakeUs' is how long this wake
+// has run, so the period stays close to the interval.
+void dutyCycleSleep(int64_t awakeUs) {
+  uint64_t periodUs = (uint64_t)rtcState.intervalSec * 1000000ULL;
+  uint64_t sleepUs = (uint64_t)awakeUs < periodUs ? periodUs - awakeUs : 1000000ULL;
+  esp_sleep_enable_timer_wakeup(sleepUs);
+  rtc_gpio_pullup_en(DUTY_EXIT_PIN);
+  esp_sleep_enable_ext0_wakeup(DUTY_EXIT_PIN, 0);
+  Serial.flush();
+  esp_deep_sleep_start();
+}
+
+// Put back the settings the sensor had when the cycle started
+void applySensorStatus(sensor_t* s, const camera_status_t& st) {
+  s->set_brightness(s, st.brightness);
+  s->set_contrast(s, st.contrast);
+  s->set_saturation(s, st.saturation);
+  s->set_special_effect(s, st.special_effect);
+  s->set_whitebal(s, st.awb);
+  s->set_awb_gain(s, st.awb_gain);
+  s->set_wb_mode(s, st.wb_mode);
+  s->set_exposure_ctrl(s, st.aec);
+  s->set_aec2(s, st.aec2);
+  s->set_ae_level(s, st.ae_level);
+  s->set_gain_ctrl(s, st.agc);
+  s->set_gainceiling(s, (gainceiling_t)st.gainceiling);
+  if (!st.aec) {
+    s->set_aec_value(s, st.aec_value);
   }
-  
-  if (currentMillis - lastLedBlink >= blinkInterval) {
-    lastLedBlink = currentMillis;
-    ledState = !ledState;
-    digitalWrite(LED_BUILTIN, ledState ? HIGH : LOW);
+  if (!st.agc) {
+    s->set_agc_gain(s, st.agc_gain);
   }
+  s->set_bpc(s, st.bpc);
+  s->set_wpc(s, st.wpc);
+  s->set_raw_gma(s, st.raw_gma);
+  s->set_lenc(s, st.lenc);
+  s->set_hmirror(s, st.hmirror);
+  s->set_vflip(s, st.vflip);
+  s->set_dcw(s, st.dcw);
 }
 
-// ============================================
-// FORWARD DECLARATIONS
-// ============================================
-void recordingTask(void *parameter);
+// Timer wake in duty-cycle mode, called first thing in setup(). Brings up
+// only the camera (at the saved frame size, one frame buffer) and the SD
+// mount, saves rtcState.framesPerWake frames and sleeps again. Never
+// returns.
+void dutyCycleWake() {
+  Serial.begin(115200);
+  frameCount = rtcState.frameCount;
+  audioFileCount = rtcState.audioFileCount;
+  rtcState.wakes++;
 
-// ============================================
-// FILE LISTING FUNCTIONS
-// ============================================
-void listVideoFiles() {
-  Serial.println("\n========================================");
-  Serial.println("VIDEO FILES:");
-  Serial.println("========================================");
-  File videoDir = SD.open("/video");
-  if (videoDir && videoDir.isDirectory()) {
-    int count = 0;
-    File file = videoDir.openNextFile();
-    while (file) {
+  camera_config_t config;
+  fillCameraConfig(config);
+  config.frame_size = (framesize_t)rtcState.sensor.framesize;
+  config.jpeg_quality = rtcState.sensor.quality;
+  config.fb_count = 1;
+  config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
+  bool cameraReady = esp_camera_init(&config) == ESP_OK;
+  if (cameraReady) {
+    applySensorStatus(esp_camera_sensor_get(), rtcState.sensor);
+  }
+
+  // No usage scan or mkdir: a full boot already did both
+  bool sdReady = SD.begin(SD_CS_PIN);
+  if (sdReady) {
+    sdMutex = xSemaphoreCreateMutex();
+  }
+
+  uint8_t saved = 0;
+  uint32_t firstFrameUs = 0;
+  if (cameraReady && sdReady && sdMutex) {
+    hal::Frame frame;
+    for (int i = 0; i < DUTY_WARMUP_FRAMES; i++) {
+      if (camera.grab(frame)) {
+        camera.release(frame);
+      }
+    }
+    char path[64];
+    for (uint8_t i = 0; i < rtcState.framesPerWake; i++) {
+      if (!camera.grab(frame)) {
+        break;
+      }
+      if (i == 0) {
+        // esp_timer starts with the app, so ROM and bootloader time is not included
+        firstFrameUs = (uint32_t)esp_timer_get_time();
+      }
+      if (recorder.saveFrame(frame, frameCount, path, sizeof(path)) == pipeline::SAVE_OK) {
+        frameCount++;
+        saved++;
+      }
+      camera.release(frame);
+    }
+  }
+
+  if (firstFrameUs) {
+    rtcState.latencyUs[rtcState.latencyHead] = firstFrameUs;
+    rtcState.latencyHead = (rtcState.latencyHead + 1) % RTC_LATENCY_SLOTS;
+    if (rtcState.latencyCount < RTC_LATENCY_SLOTS) {
+      rtcState.latencyCount++;
+    }
+  }
+  if (saved == 0) {
+    rtcState.failedWakes++;
+  }
+  rtcState.frameCount = frameCount;
+  Serial.printf("⏰ Duty wake %lu: %u frame(s), first after %lu ms%s\n",
+                (unsigned long)rtcState.wakes, saved, (unsigned long)(firstFrameUs / 1000),
+                cameraReady ? (sdReady ? "" : " (SD failed)") : " (camera failed)");
+
+  SD.end();
+  if (cameraReady) {
+    esp_camera_deinit();   // Stops XCLK so the sensor idles while we sleep
+  }
+  dutyCycleSleep(esp_timer_get_time());
+}
+
+// Full boot: pick up the storage cursor and whatever a duty cycle left in
+// RTC memory, and end the cycle (a full boot after one means the exit
+// button or a reset)
+void restoreRtcState() {
+  if (rtcState.magic != RTC_STATE_MAGIC) {
+    return;
+  }
+  frameCount = rtcState.frameCount;
+  audioFileCount = rtcState.audioFileCount;
+  if (rtcState.dutyCycle) {
+    Serial.printf("⏰ Duty cycle ended after %lu wakes (%lu failed)\n",
+                  (unsigned long)rtcState.wakes, (unsigned long)rtcState.failedWakes);
+  }
+  uint8_t oldest = (rtcState.latencyHead + RTC_LATENCY_SLOTS - rtcState.latencyCount) % RTC_LATENCY_SLOTS;
+  for (uint8_t i = 0; i < rtcState.latencyCount; i++) {
+    metrics::wakeToFrame.observe(rtcState.latencyUs[(oldest + i) % RTC_LATENCY_SLOTS]);
+  }
+  metrics::dutyCycleWakes.inc(rtcState.wakes);
+  metrics::dutyCycleFailedWakes.inc(rtcState.failedWakes);
+  rtcState.dutyCycle = false;
+  rtcState.wakes = 0;
+  rtcState.failedWakes = 0;
+  rtcState.latencyCount = 0;
+}
+
+// Enter duty-cycle mode from loop(): snapshot the sensor and counters into
+// RTC memory and sleep. The first capture happens one interval from now.
+void startDutyCycle(uint32_t intervalSec, uint8_t frames) {
+  sensor_t* s = esp_camera_sensor_get();
+  if (!s) {
+    LOG_E("❌ Duty cycle needs the camera");
+    return;
+  }
+  saveRtcCounters();
+  rtcState.sensor = s->status;
+  rtcState.intervalSec = intervalSec;
+  rtcState.framesPerWake = frames;
+  rtcState.dutyCycle = true;
+
+  Serial.printf("⏰ Duty cycle: %u frame(s) every %lu s - press BOOT to exit\n",
+                frames, (unsigned long)intervalSec);
+  bleNotifyText("Duty:Sleeping");
+  delay(100);   // Let the notification go out
+
+  SD.end();
+  esp_camera_deinit();
+  logger::drain();
+  dutyCycleSleep(0);
+}
+
+// ============================================
+// STATUS LED CONTROL
+// ============================================
+void updateStatusLED() {
+  unsigned long currentMillis = millis();
+  unsigned int blinkInterval;
+  
+  switch (currentState) {
+    case STATE_RECORDING:
+      blinkInterval = LED_BLINK_RECORDING;
+      break;
+    case STATE_WIFI_CONNECTING:
+      blinkInterval = LED_BLINK_WIFI;
+      break;
+    case STATE_WIFI_CONNECTED:
+    case STATE_STREAMING:
+      blinkInterval = LED_BLINK_WIFI;
+      break;
+    case STATE_ERROR:
+    case STATE_LOW_BATTERY:
+      blinkInterval = LED_BLINK_ERROR;
+      break;
+    case STATE_TIMELAPSE:
+      // Leave the pin alone between shots: GPIO 21 is also the SD chip select
+      return;
+    default:
+      digitalWrite(LED_BUILTIN, LOW);
+      return;
+  }
+  
+  if (currentMillis - lastLedBlink >= blinkInterval) {
+    lastLedBlink = currentMillis;
+    ledState = !ledState;
+    digitalWrite(LED_BUILTIN, ledState ? HIGH : LOW);
+  }
+}
+
+// ============================================
+// FILE LISTING FUNCTIONS
+// ============================================
+void listVideoFiles() {
+  Serial.println("\n========================================");
+  Serial.println("VIDEO FILES:");
+  Serial.println("========================================");
+  File videoDir = SD.open("/video");
+  if (videoDir && videoDir.isDirectory()) {
+    int count = 0;
+    File file = videoDir.openNextFile();
+    while (file) {
       if (!file.isDirectory()) {
         count++;
         Serial.printf("%d. %s (%u bytes)\n", count, file.name(), file.size());
@@ -766,6 +1704,47 @@ void listAllFiles() {
   Serial.println("========================================\n");
 }
 
+// ============================================
+// DATA-PATH BENCHMARKS
+// ============================================
+// Same kernels as the host [env:bench] target; compare cycles/op here with
+// ns/op there. Tracing is paused so the rings aren't filled with bench noise.
+#define BENCH_MIN_TIME_US 50000
+
+void runBenchmarks() {
+  bool wasTracing = tracer::enabled();
+  tracer::setEnabled(false);
+
+  Serial.println("\n========================================");
+  Serial.printf("DATA-PATH BENCHMARKS (%u MHz)\n", getCpuFrequencyMhz());
+  Serial.println("========================================");
+  if (!bench::begin(systemClock)) {
+    Serial.println("❌ Not enough memory for benchmark buffers");
+    tracer::setEnabled(wasTracing);
+    return;
+  }
+
+  Serial.printf("%-18s %10s %12s %10s %10s\n", "kernel", "iterations", "cycles/op", "ns/op", "MB/s");
+  for (size_t i = 0; i < bench::kernelCount(); i++) {
+    bench::Result r = bench::run(i, BENCH_MIN_TIME_US);
+    Serial.printf("%-18s %10u %12.0f %10.0f %10.2f\n", r.name, r.iterations, r.cyclesPerOp(),
+                  r.nsPerOp(), r.bytesPerSecond() / 1048576.0);
+
+    // One short notification per kernel rather than one long status string
+    if (bleEnabled && deviceConnected) {
+      FixedString<64> status;
+      status.append("Bench:").append(r.name).append('=').appendUint((uint32_t)r.cyclesPerOp()).append("cyc");
+      bleNotifyText(status.c_str());
+      delay(20);
+    }
+    delay(1);  // Let the idle task feed the watchdog between kernels
+  }
+  bench::end();
+  Serial.println("========================================\n");
+
+  tracer::setEnabled(wasTracing);
+}
+
 // ============================================
 // OTA UPDATE FUNCTIONS
 // ============================================
@@ -805,203 +1784,860 @@ void initOTA() {
 // ============================================
 // BLE CALLBACKS & FUNCTIONS
 // ============================================
+// Commands shared by the ASCII control characteristic and the binary
+// protocol. Each keeps the legacy text notification and returns a
+// bleproto::Result for the binary ack.
+// START/STOP go to the recorder task, which is always there waiting, so
+// they are acked as done. bleRecordingActive is the requested state;
+// recordingMode is what the recorder is actually doing.
+bleproto::Result cmdStart() {
+  if (bleRecordingActive) {
+    LOG_W("⚠️  Recording already active");
+    return bleproto::RESULT_NO_CHANGE;
+  }
+  if (usbMscEnabled) {
+    LOG_W("⚠️  Cannot record - USB Mass Storage is active");
+    return bleproto::RESULT_BUSY;
+  }
+  bleRecordingActive = true;
+  if (!recorderBus.post(cmdbus::CMD_START)) {
+    bleRecordingActive = false;
+    LOG_E("❌ Recorder queue full");
+    return bleproto::RESULT_BUSY;
+  }
+  LOG_I("📹 BLE: Recording STARTED");
+  bleNotifyText("Recording:ON");
+  return bleproto::RESULT_OK;
+}
+
+bleproto::Result cmdStop() {
+  if (!bleRecordingActive) {
+    return bleproto::RESULT_NO_CHANGE;
+  }
+  bleRecordingActive = false;
+  recordingMode = false;   // Cuts the clip in progress short
+  recorderBus.post(cmdbus::CMD_STOP);
+  LOG_I("⏹️  BLE: Recording STOPPED");
+  bleNotifyText("Recording:OFF");
+  return bleproto::RESULT_OK;
+}
+
+bleproto::Result cmdSetMode(uint8_t mode) {
+  // Timelapse runs in its own task; switch to or from it only while stopped
+  if (bleRecordingActive && (timelapseMode != (mode == bleproto::MODE_TIMELAPSE))) {
+    return bleproto::RESULT_BUSY;
+  }
+  switch (mode) {
+    case bleproto::MODE_AUDIO_ONLY:
+      timelapseMode = false;
+      audioOnlyMode = true;
+      videoOnlyMode = false;
+      bothMode = false;
+      LOG_I("🎙️  Mode: AUDIO ONLY");
+      bleNotifyText("Mode:AudioOnly");
+      return bleproto::RESULT_OK;
+    case bleproto::MODE_VIDEO_ONLY:
+      timelapseMode = false;
+      audioOnlyMode = false;
+      videoOnlyMode = true;
+      bothMode = false;
+      LOG_I("📹 Mode: VIDEO ONLY");
+      bleNotifyText("Mode:VideoOnly");
+      return bleproto::RESULT_OK;
+    case bleproto::MODE_BOTH:
+      timelapseMode = false;
+      audioOnlyMode = false;
+      videoOnlyMode = false;
+      bothMode = true;
+      LOG_I("🎥 Mode: AUDIO + VIDEO");
+      bleNotifyText("Mode:Both");
+      return bleproto::RESULT_OK;
+    case bleproto::MODE_TIMELAPSE:
+      timelapseMode = true;
+      audioOnlyMode = false;
+      videoOnlyMode = false;
+      bothMode = false;
+      LOG_I("⏱️  Mode: TIMELAPSE (one frame every %lu s)", (unsigned long)timelapseIntervalSec);
+      bleNotifyText("Mode:Timelapse");
+      return bleproto::RESULT_OK;
+    default:
+      return bleproto::RESULT_BAD_VALUE;
+  }
+}
+
+// Queue a command for loop(); ACCEPTED, or BUSY when the queue is full
+bleproto::Result postControl(cmdbus::Type type, uint32_t arg = 0, uint32_t arg2 = 0) {
+  return controlBus.post(type, arg, arg2) ? bleproto::RESULT_ACCEPTED : bleproto::RESULT_BUSY;
+}
+
+// File listings run from loop() (they need more stack than the BLE task has)
+bleproto::Result cmdList(uint8_t which) {
+  static const char* const kNames[] = {"Video", "Audio", "All"};
+  if (which > 2) {
+    return bleproto::RESULT_BAD_VALUE;
+  }
+  LOG_I("📋 %s file list requested...", kNames[which]);
+  return postControl(cmdbus::CMD_LIST, which);
+}
+
+// USB MSC setup and teardown run from loop(): disabling waits up to 30 s for
+// the host to eject the drive, which would stall the BLE stack
+bleproto::Result cmdUsb(bool enable) {
+  if (enable && usbMscEnabled) {
+    LOG_W("⚠️  USB MSC already enabled");
+    return bleproto::RESULT_NO_CHANGE;
+  }
+  if (!enable && !usbMscEnabled) {
+    LOG_W("⚠️  USB MSC not enabled");
+    return bleproto::RESULT_NO_CHANGE;
+  }
+  return postControl(cmdbus::CMD_USB, enable);
+}
+
+bleproto::Result cmdWiFi() {
+  if (wifiRequested) {
+    return bleproto::RESULT_NO_CHANGE;
+  }
+  bleproto::Result r = postControl(cmdbus::CMD_WIFI);
+  if (r == bleproto::RESULT_ACCEPTED) {
+    wifiRequested = true;
+    LOG_I("📡 WiFi mode requested via BLE");
+    bleNotifyText("WiFi:Connecting...");
+  }
+  return r;
+}
+
+bleproto::Result cmdBench() {
+  LOG_I("⏱️  Benchmark requested...");
+  return postControl(cmdbus::CMD_BENCH);
+}
+
+bleproto::Result cmdTimelapseInterval(uint32_t seconds) {
+  if (seconds < TIMELAPSE_MIN_INTERVAL_S || seconds > TIMELAPSE_MAX_INTERVAL_S) {
+    return bleproto::RESULT_BAD_VALUE;
+  }
+  timelapseIntervalSec = seconds;   // Picked up at the next shot
+  return bleproto::RESULT_OK;
+}
+
+// Runtime to plan for from now on; 0 leaves only the state-of-charge floors
+bleproto::Result cmdPowerTarget(uint32_t minutes) {
+  if (minutes > GOVERNOR_MAX_TARGET_MIN) {
+    return bleproto::RESULT_BAD_VALUE;
+  }
+  return postControl(cmdbus::CMD_POWER_TARGET, minutes);
+}
+
+bleproto::Result cmdDutyCycle(uint32_t intervalSec, uint8_t frames) {
+  if (intervalSec == 0 || frames == 0 || frames > DUTY_MAX_FRAMES) {
+    return bleproto::RESULT_BAD_VALUE;
+  }
+  if (bleRecordingActive || usbMscEnabled) {
+    return bleproto::RESULT_BUSY;
+  }
+  return postControl(cmdbus::CMD_DUTY_CYCLE, intervalSec, frames);
+}
+
+// Recent command completions for /api/commands (result codes as in
+// BLE_PROTOCOL.md). Handlers run one at a time, so the buffer is shared.
+const StringWriter& commandsJson() {
+  cmdbus::Completion recent[CMDBUS_RECENT];
+  size_t n = cmdbus::recent(recent, CMDBUS_RECENT);
+  auto msTenths = [](uint32_t us) { return (int64_t)(((uint64_t)us + 50) / 100); };
+
+  static FixedString<2560> json;
+  json.clear();
+  JsonWriter w(json);
+  w.beginObject();
+  w.num("completed", metrics::commandsCompleted.value());
+  w.num("dropped", metrics::commandsDropped.value());
+  w.beginObject("pending");
+  w.num("control", controlBus.pending());
+  w.num("recorder", recorderBus.pending());
+  w.endObject();
+  w.beginArray("recent");
+  for (size_t i = 0; i < n; i++) {
+    const cmdbus::Completion& c = recent[i];
+    w.beginObject();
+    w.num("seq", c.seq);
+    w.str("type", cmdbus::typeName(c.type));
+    w.num("result", c.result);
+    w.tenths("queuedMs", msTenths(c.queuedUs));
+    w.tenths("totalMs", msTenths(c.totalUs));
+    w.num("completedAtMs", c.completedMs);
+    w.endObject();
+  }
+  w.endArray();
+  w.endObject();
+  return json;
+}
+
+void cmdStatusText() {
+  FixedString<48> status;
+  status.append("Frames:").appendUint(frameCount).append("|Audio:").appendUint(audioFileCount);
+  bleNotifyText(status.c_str());
+}
+
+void cmdTasksText() {
+  // Compact task health summary: core load, tightest stack, WDT near-misses
+  taskmon::Snapshot snap;
+  FixedString<80> status;
+  if (taskmon::latest(snap)) {
+    const taskmon::TaskInfo* tight = taskmon::tightestStack(snap);
+    status.append("CPU:").appendInt(snap.coreLoad[0]).append('/').appendInt(snap.coreLoad[1])
+          .append("|Stk:").append(tight ? tight->name : "-").append('=').appendUint(tight ? tight->stackFreeBytes : 0)
+          .append("|WDT:").appendUint(snap.watchdogNearMisses);
+  } else {
+    status.append("Tasks:NoData");
+  }
+  bleNotifyText(status.c_str());
+}
+
+// ASCII commands on the control characteristic
+struct TextCommand {
+  const char* name;
+  void (*run)();
+};
+
+static const TextCommand kTextCommands[] = {
+  {"START",       [] { cmdStart(); }},
+  {"STOP",        [] { cmdStop(); }},
+  {"STATUS",      cmdStatusText},
+  {"TASKS",       cmdTasksText},
+  {"BENCH",       [] { cmdBench(); }},
+  {"DUTY_CYCLE",  [] { cmdDutyCycle(DUTY_DEFAULT_INTERVAL_S, DUTY_DEFAULT_FRAMES); }},
+  {"LIST_VIDEO",  [] { cmdList(0); }},
+  {"LIST_AUDIO",  [] { cmdList(1); }},
+  {"LIST_ALL",    [] { cmdList(2); }},
+  {"AUDIO_ONLY",  [] { cmdSetMode(bleproto::MODE_AUDIO_ONLY); }},
+  {"VIDEO_ONLY",  [] { cmdSetMode(bleproto::MODE_VIDEO_ONLY); }},
+  {"BOTH",        [] { cmdSetMode(bleproto::MODE_BOTH); }},
+  {"TIMELAPSE",   [] { cmdSetMode(bleproto::MODE_TIMELAPSE); }},
+  {"ENABLE_USB",  [] { cmdUsb(true); }},
+  {"DISABLE_USB", [] { cmdUsb(false); }},
+};
+
+// Copy a characteristic write into 'out' without surrounding whitespace
+const char* trimCommand(const std::string& value, char* out, size_t cap) {
+  size_t begin = 0, end = value.length();
+  while (begin < end && isspace((unsigned char)value[begin])) begin++;
+  while (end > begin && isspace((unsigned char)value[end - 1])) end--;
+  size_t n = end - begin < cap - 1 ? end - begin : cap - 1;
+  memcpy(out, value.data() + begin, n);
+  out[n] = '\0';
+  return out;
+}
+
+// Largest notification payload for the current connection
+size_t bleFrameCap() {
+  size_t cap = bleMtu - 3;
+  return cap < BLEPROTO_MAX_FRAME ? cap : BLEPROTO_MAX_FRAME;
+}
+
+bleproto::StatusRecord bleStatusSent;   // What subscribed clients have been told
+
+void bleFillStatus(bleproto::StatusRecord& r) {
+  r.recording = bleRecordingActive;
+  r.mode = timelapseMode ? bleproto::MODE_TIMELAPSE : audioOnlyMode ? bleproto::MODE_AUDIO_ONLY :
+           videoOnlyMode ? bleproto::MODE_VIDEO_ONLY : bleproto::MODE_BOTH;
+  r.state = (uint8_t)currentState;
+  r.usb = usbMscEnabled;
+  r.wifi = wifiRequested || WiFi.status() == WL_CONNECTED;
+  r.frames = frameCount;
+  r.audioFiles = audioFileCount;
+  r.batteryMv = batteryMillivolts;
+  r.sdFreeMB = (uint32_t)((sdTotalBytesCached - sdUsedBytesCached) / (1024 * 1024));
+  r.uptimeSec = millis() / 1000;
+  r.mtu = bleMtu;
+}
+
+// Notify the status tags in 'mask' that changed since the last
+// notification, or every tag when 'full'. Split across frames as the MTU
+// requires; all frames of one update share a sequence number.
+void blePublishStatus(uint32_t mask, bool full) {
+  if (!bleEnabled || !deviceConnected || !pBinaryCharacteristic) {
+    return;
+  }
+  if (xSemaphoreTake(bleNotifyMutex, pdMS_TO_TICKS(200)) != pdTRUE) {
+    return;
+  }
+  static uint8_t seq = 0;
+  bleproto::StatusRecord current;
+  bleFillStatus(current);
+  uint32_t tags = full ? BLEPROTO_ALL_TAGS : bleproto::changedTags(bleStatusSent, current) & mask;
+  if (tags) {
+    bleproto::applyTags(bleStatusSent, current, tags);
+    seq++;
+    uint8_t frame[BLEPROTO_MAX_FRAME];
+    size_t cap = bleFrameCap();
+    while (tags) {
+      size_t len = bleproto::encodeStatus(frame, cap, current, tags, seq, full);
+      pBinaryCharacteristic->setValue(frame, len);
+      pBinaryCharacteristic->notify();
+    }
+  }
+  xSemaphoreGive(bleNotifyMutex);
+}
+
+void bleSendAcks(const bleproto::Ack* acks, size_t count) {
+  if (xSemaphoreTake(bleNotifyMutex, pdMS_TO_TICKS(200)) != pdTRUE) {
+    return;
+  }
+  uint8_t frame[BLEPROTO_MAX_FRAME];
+  size_t cap = bleFrameCap();
+  while (count) {
+    size_t consumed = 0;
+    size_t len = bleproto::encodeAcks(frame, cap, acks, count, consumed);
+    if (consumed == 0) {
+      break;
+    }
+    pBinaryCharacteristic->setValue(frame, len);
+    pBinaryCharacteristic->notify();
+    acks += consumed;
+    count -= consumed;
+  }
+  xSemaphoreGive(bleNotifyMutex);
+}
+
+bleproto::Result runBinaryCommand(const bleproto::Command& c) {
+  switch (c.opcode) {
+    case bleproto::OP_PING:
+    case bleproto::OP_GET_STATUS:
+      return bleproto::RESULT_OK;
+    case bleproto::OP_START:
+      return cmdStart();
+    case bleproto::OP_STOP:
+      return cmdStop();
+    case bleproto::OP_SET_MODE:
+      if (c.length == 3 && c.payload[0] == bleproto::MODE_TIMELAPSE) {
+        bleproto::Result r = cmdTimelapseInterval((uint32_t)c.payload[1] | ((uint32_t)c.payload[2] << 8));
+        return r == bleproto::RESULT_OK ? cmdSetMode(c.payload[0]) : r;
+      }
+      return c.length == 1 ? cmdSetMode(c.payload[0]) : bleproto::RESULT_BAD_LENGTH;
+    case bleproto::OP_LIST:
+      return c.length == 1 ? cmdList(c.payload[0]) : bleproto::RESULT_BAD_LENGTH;
+    case bleproto::OP_USB:
+      if (c.length != 1) {
+        return bleproto::RESULT_BAD_LENGTH;
+      }
+      return c.payload[0] <= 1 ? cmdUsb(c.payload[0]) : bleproto::RESULT_BAD_VALUE;
+    case bleproto::OP_WIFI:
+      return cmdWiFi();
+    case bleproto::OP_BENCH:
+      return cmdBench();
+    case bleproto::OP_DUTY_CYCLE:
+      if (c.length == 0) {
+        return cmdDutyCycle(DUTY_DEFAULT_INTERVAL_S, DUTY_DEFAULT_FRAMES);
+      }
+      if (c.length != 5) {
+        return bleproto::RESULT_BAD_LENGTH;
+      }
+      return cmdDutyCycle((uint32_t)c.payload[0] | ((uint32_t)c.payload[1] << 8) |
+                          ((uint32_t)c.payload[2] << 16) | ((uint32_t)c.payload[3] << 24),
+                          c.payload[4]);
+    default:
+      return bleproto::RESULT_UNKNOWN_OP;
+  }
+}
+
 class ServerCallbacks: public BLEServerCallbacks {
-  void onConnect(BLEServer* pServer) {
+  void onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) {
     deviceConnected = true;
-    Serial.println("BLE Client Connected");
-    if (pStatusCharacteristic) {
-      String status = "Connected|Recording:" + String(bleRecordingActive ? "ON" : "OFF");
-      pStatusCharacteristic->setValue(status.c_str());
-      pStatusCharacteristic->notify();
-    }
+    memcpy(bleRemoteBda, param->connect.remote_bda, sizeof(bleRemoteBda));
+    LOG_I("BLE Client Connected");
+    // Ask for a 7.5-15 ms connection interval so command round trips stay
+    // well under 100 ms (the central may still pick something slower)
+    pServer->updateConnParams(param->connect.remote_bda, 6, 12, 0, 400);
+    FixedString<32> status;
+    status.append("Connected|Recording:").append(bleRecordingActive ? "ON" : "OFF");
+    bleNotifyText(status.c_str());
   }
 
   void onDisconnect(BLEServer* pServer) {
     deviceConnected = false;
-    Serial.println("BLE Client Disconnected");
+    bleMtu = BLEPROTO_DEFAULT_MTU;
+    LOG_I("BLE Client Disconnected");
     // Restart advertising
     BLEDevice::startAdvertising();
   }
+
+  void onMtuChanged(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) {
+    bleMtu = param->mtu.mtu;
+    LOG_I("BLE MTU: %u", bleMtu);
+  }
 };
 
 class ControlCallbacks: public BLECharacteristicCallbacks {
   void onWrite(BLECharacteristic *pCharacteristic) {
     std::string value = pCharacteristic->getValue();
+    char command[24];
+    if (trimCommand(value, command, sizeof(command))[0] == '\0') {
+      return;
+    }
+    LOG_I("BLE Command: %s", command);
     
-    if (value.length() > 0) {
-      String command = String(value.c_str());
-      command.trim();
-      Serial.println("BLE Command: " + command);
-      
-      if (command == "START") {
-        if (!bleRecordingActive) {
-          bleRecordingActive = true;
-          recordingMode = true;
-          Serial.println("📹 BLE: Recording STARTED");
-          
-          if (pStatusCharacteristic) {
-            pStatusCharacteristic->setValue("Recording:ON");
-            pStatusCharacteristic->notify();
-          }
-          
-          // Start recording task
-          xTaskCreatePinnedToCore(
-            recordingTask,
-            "SDRecording",
-            8192,
-            NULL,
-            1,
-            NULL,
-            0
-          );
-        } else {
-          Serial.println("⚠️  Recording already active");
-        }
-      }
-      else if (command == "STOP") {
-        bleRecordingActive = false;
-        recordingMode = false;
-        Serial.println("⏹️  BLE: Recording STOPPED");
-        
-        if (pStatusCharacteristic) {
-          pStatusCharacteristic->setValue("Recording:OFF");
-          pStatusCharacteristic->notify();
-        }
-      }
-      else if (command == "STATUS") {
-        String status = "Frames:" + String(frameCount) + "|Audio:" + String(audioFileCount);
-        if (pStatusCharacteristic) {
-          pStatusCharacteristic->setValue(status.c_str());
-          pStatusCharacteristic->notify();
-        }
-      }
-      else if (command == "LIST_VIDEO") {
-        listVideoRequested = true;
-        Serial.println("📋 Video file list requested...");
-      }
-      else if (command == "LIST_AUDIO") {
-        listAudioRequested = true;
-        Serial.println("📋 Audio file list requested...");
-      }
-      else if (command == "LIST_ALL") {
-        listAllRequested = true;
-        Serial.println("📋 All files list requested...");
-      }
-      else if (command == "AUDIO_ONLY") {
-        audioOnlyMode = true;
-        videoOnlyMode = false;
-        bothMode = false;
-        Serial.println("🎙️  Mode: AUDIO ONLY");
-        
-        if (pStatusCharacteristic) {
-          pStatusCharacteristic->setValue("Mode:AudioOnly");
-          pStatusCharacteristic->notify();
-        }
-      }
-      else if (command == "VIDEO_ONLY") {
-        audioOnlyMode = false;
-        videoOnlyMode = true;
-        bothMode = false;
-        Serial.println("📹 Mode: VIDEO ONLY");
-        
-        if (pStatusCharacteristic) {
-          pStatusCharacteristic->setValue("Mode:VideoOnly");
-          pStatusCharacteristic->notify();
-        }
-      }
-      else if (command == "BOTH") {
-        audioOnlyMode = false;
-        videoOnlyMode = false;
-        bothMode = true;
-        Serial.println("🎥 Mode: AUDIO + VIDEO");
-        
-        if (pStatusCharacteristic) {
-          pStatusCharacteristic->setValue("Mode:Both");
-          pStatusCharacteristic->notify();
-        }
-      }
-      else if (command == "ENABLE_USB") {
-        if (!usbMscEnabled) {
-          if (initUSBMSC()) {
-            if (pStatusCharacteristic) {
-              pStatusCharacteristic->setValue("USB:Enabled");
-              pStatusCharacteristic->notify();
-            }
-            Serial.println("💾 USB Mass Storage ENABLED");
-            Serial.println("   Connect USB cable to access SD card files");
-          } else {
-            if (pStatusCharacteristic) {
-              pStatusCharacteristic->setValue("USB:Failed");
-              pStatusCharacteristic->notify();
-            }
-          }
-        } else {
-          Serial.println("⚠️  USB MSC already enabled");
-        }
-      }
-      else if (command == "DISABLE_USB") {
-        if (usbMscEnabled) {
-          disableUSBMSC();
-          if (pStatusCharacteristic) {
-            pStatusCharacteristic->setValue("USB:Disabled");
-            pStatusCharacteristic->notify();
-          }
-          Serial.println("💾 USB Mass Storage DISABLED");
-        } else {
-          Serial.println("⚠️  USB MSC not enabled");
-        }
+    for (const TextCommand& c : kTextCommands) {
+      if (strcmp(command, c.name) == 0) {
+        c.run();
+        return;
       }
     }
   }
 };
 
-class WiFiCallbacks: public BLECharacteristicCallbacks {
+class BinaryCallbacks: public BLECharacteristicCallbacks {
   void onWrite(BLECharacteristic *pCharacteristic) {
     std::string value = pCharacteristic->getValue();
+    bleproto::Command commands[BLEPROTO_MAX_BATCH];
+    bleproto::Ack acks[BLEPROTO_MAX_BATCH];
+    size_t count = 0;
+    bleproto::Result rc = bleproto::parseRequest((const uint8_t*)value.data(), value.length(),
+                                                 commands, BLEPROTO_MAX_BATCH, count);
+    if (rc != bleproto::RESULT_OK) {
+      acks[0] = {0, 0, rc};
+      bleSendAcks(acks, 1);
+      return;
+    }
     
-    if (value.length() > 0) {
-      String command = String(value.c_str());
-      command.trim();
-      Serial.println("BLE WiFi Command: " + command);
-      
-      if (command == "ENABLE_WIFI") {
-        wifiRequested = true;
-        Serial.println("📡 WiFi mode requested via BLE");
-        
-        if (pStatusCharacteristic) {
-          pStatusCharacteristic->setValue("WiFi:Connecting...");
-          pStatusCharacteristic->notify();
-        }
-        
-        // Will be handled in loop()
-      }
+    bool fullStatus = false;
+    for (size_t i = 0; i < count; i++) {
+      const bleproto::Command& c = commands[i];
+      acks[i] = {c.requestId, c.opcode, runBinaryCommand(c)};
+      fullStatus |= c.opcode == bleproto::OP_GET_STATUS;
     }
+    bleSendAcks(acks, count);
+    // State changes caused by the batch go out right behind the acks
+    blePublishStatus(BLEPROTO_STATE_TAGS, fullStatus);
+  }
+
+  void onRead(BLECharacteristic *pCharacteristic) {
+    bleproto::StatusRecord current;
+    bleFillStatus(current);
+    uint8_t frame[BLEPROTO_MAX_FRAME];
+    uint32_t tags = BLEPROTO_ALL_TAGS;
+    size_t len = bleproto::encodeStatus(frame, sizeof(frame), current, tags, 0, true);
+    pCharacteristic->setValue(frame, len);
   }
 };
 
-// Initialize BLE Server
-bool initBLE() {
-  Serial.println("Initializing BLE...");
-  
-  BLEDevice::init("ESP32-CAM-BLE");
-  
-  // Create BLE Server
-  pServer = BLEDevice::createServer();
-  pServer->setCallbacks(new ServerCallbacks());
-  
-  // Create BLE Service
-  BLEService *pService = pServer->createService(BLE_SERVICE_UUID);
-  
-  // Control Characteristic (Write)
-  pControlCharacteristic = pService->createCharacteristic(
-    BLE_CONTROL_CHAR_UUID,
-    BLECharacteristic::PROPERTY_WRITE
-  );
-  pControlCharacteristic->setCallbacks(new ControlCallbacks());
-  
-  // Status Characteristic (Read + Notify)
-  pStatusCharacteristic = pService->createCharacteristic(
-    BLE_STATUS_CHAR_UUID,
+// Full binary status record as soon as a client enables notifications
+class BinarySubscribeCallbacks: public BLEDescriptorCallbacks {
+  void onWrite(BLEDescriptor* pDescriptor) {
+    if (((BLE2902*)pDescriptor)->getNotifications()) {
+      bleFullStatusPending = true;
+    }
+  }
+};
+
+// ============================================
+// BLE FILE TRANSFER
+// ============================================
+// One transfer at a time. XferSend opens the file, sends XEV_OPENED and
+// streams chunks from the read-ahead ring; XferRead keeps the ring filled
+// from SD so the radio never waits on the card. Acks and NACKs arrive in
+// XferCallbacks (BLE task) and update the window under xferMutex.
+struct XferSession {
+  volatile bool active;
+  volatile bool cancel;
+  volatile bool readerRunning;
+  volatile blexfer::Error readerError;
+  char path[64];
+  uint32_t offset;
+  uint8_t window;
+  bool directory;
+  uint32_t size;
+  uint32_t lastProgressMs;   // Last ack that moved the window
+};
+
+XferSession xfer;
+SemaphoreHandle_t xferMutex = NULL;
+blexfer::Window xferWindow;        // Guarded by xferMutex
+blexfer::ReadAhead xferRing;
+uint8_t* xferRingBuffer = nullptr;
+File xferFile;
+
+// Event on the transfer control characteristic
+void xferNotify(const uint8_t* data, size_t len) {
+  if (!bleEnabled || !deviceConnected || !pXferControlCharacteristic) {
+    return;
+  }
+  if (xSemaphoreTake(bleNotifyMutex, pdMS_TO_TICKS(200)) != pdTRUE) {
+    return;
+  }
+  pXferControlCharacteristic->setValue((uint8_t*)data, len);
+  pXferControlCharacteristic->notify();
+  xSemaphoreGive(bleNotifyMutex);
+}
+
+void xferNotifyError(blexfer::Error error) {
+  uint8_t frame[8];
+  xferNotify(frame, blexfer::encodeError(frame, error));
+}
+
+// Directory listings are streamed as "name\tsize\n" lines
+size_t xferListingLine(File& entry, char* line, size_t cap) {
+  int n = snprintf(line, cap, "%s\t%u\n", entry.name(), (unsigned)entry.size());
+  return n < 0 ? 0 : ((size_t)n < cap ? (size_t)n : cap - 1);
+}
+
+// Next file entry of xferFile (a directory), taken under the SD lock
+bool xferNextEntry(File& entry) {
+  if (!sdLock(1000)) {
+    return false;
+  }
+  entry = xferFile.openNextFile();
+  while (entry && entry.isDirectory()) {
+    entry = xferFile.openNextFile();
+  }
+  sdUnlock();
+  return (bool)entry;
+}
+
+// Copy 'n' bytes into the ring as space frees up
+bool xferRingWrite(const uint8_t* data, size_t n) {
+  while (n && !xfer.cancel) {
+    uint32_t offset;
+    uint8_t* ptr;
+    size_t room = xferRing.writable(offset, ptr);
+    if (room == 0) {
+      vTaskDelay(pdMS_TO_TICKS(2));
+      continue;
+    }
+    size_t step = n < room ? n : room;
+    memcpy(ptr, data, step);
+    xferRing.commit(step);
+    data += step;
+    n -= step;
+  }
+  return n == 0;
+}
+
+void xferReadTask(void *parameter) {
+  if (xfer.directory) {
+    // Regenerate the listing, skipping what a resumed client already has
+    char line[96];
+    uint32_t pos = 0;
+    File entry;
+    while (pos < xfer.size && !xfer.cancel && xferNextEntry(entry)) {
+      size_t n = xferListingLine(entry, line, sizeof(line));
+      entry.close();
+      if (pos + n > xfer.size) {
+        n = xfer.size - pos;   // Files added since XEV_OPENED are cut off
+      }
+      size_t skip = pos < xfer.offset ? (xfer.offset - pos < n ? xfer.offset - pos : n) : 0;
+      if (!xferRingWrite((const uint8_t*)line + skip, n - skip)) {
+        break;
+      }
+      pos += n;
+    }
+    if (pos < xfer.size && !xfer.cancel) {
+      xfer.readerError = blexfer::XERR_IO;   // Directory shrank under us
+    }
+  } else {
+    while (!xfer.cancel) {
+      uint32_t offset;
+      uint8_t* ptr;
+      size_t n = xferRing.writable(offset, ptr);
+      if (offset >= xfer.size) {
+        break;
+      }
+      size_t free = XFER_RING_BYTES - (offset - xferRing.head());
+      if (n == 0 || (free < XFER_READ_BLOCK && offset + free < xfer.size)) {
+        vTaskDelay(pdMS_TO_TICKS(2));   // Wait for a whole block of room
+        continue;
+      }
+      if (n > XFER_READ_BLOCK) n = XFER_READ_BLOCK;
+      if (n > xfer.size - offset) n = xfer.size - offset;
+      
+      if (!sdLock(1000)) {
+        continue;
+      }
+      int got = (xferFile.position() == offset || xferFile.seek(offset)) ? xferFile.read(ptr, n) : -1;
+      sdUnlock();
+      if (got != (int)n) {
+        xfer.readerError = blexfer::XERR_IO;
+        break;
+      }
+      xferRing.commit(n);
+    }
+  }
+  xfer.readerRunning = false;
+  vTaskDelete(NULL);
+}
+
+// Open the file or directory and work out the transfer size
+blexfer::Error xferOpen() {
+  if (!sdLock(1000)) {
+    return blexfer::XERR_BUSY;
+  }
+  xferFile = SD.open(xfer.path);
+  bool ok = (bool)xferFile;
+  xfer.directory = ok && xferFile.isDirectory();
+  xfer.size = ok && !xfer.directory ? xferFile.size() : 0;
+  sdUnlock();
+  if (!ok) {
+    return blexfer::XERR_NOT_FOUND;
+  }
+  
+  if (xfer.directory) {
+    char line[96];
+    File entry;
+    while (xferNextEntry(entry)) {
+      xfer.size += xferListingLine(entry, line, sizeof(line));
+      entry.close();
+    }
+    if (sdLock(1000)) {
+      xferFile.rewindDirectory();
+      sdUnlock();
+    }
+  }
+  return xfer.offset > xfer.size ? blexfer::XERR_BAD_OFFSET : blexfer::XERR_NONE;
+}
+
+void xferSendTask(void *parameter) {
+  uint8_t frame[BLEPROTO_MAX_FRAME];
+  blexfer::Error error = xferOpen();
+  
+  if (error == blexfer::XERR_NONE && !xferRingBuffer) {
+    xferRingBuffer = (uint8_t*)memstats::alloc(memstats::TAG_BLE_XFER, XFER_RING_BYTES, MALLOC_CAP_SPIRAM);
+    if (!xferRingBuffer) {
+      error = blexfer::XERR_BUSY;
+    }
+  }
+  if (error != blexfer::XERR_NONE) {
+    Serial.printf("❌ BLE transfer %s: error %u\n", xfer.path, error);
+    xferNotifyError(error);
+    if (xferFile) xferFile.close();
+    xfer.active = false;
+    vTaskDelete(NULL);
+    return;
+  }
+  
+  // Bulk data: ask for 2M PHY and 251-byte link-layer packets, so a
+  // 244-byte notification goes out as one packet
+  esp_ble_gap_set_pkt_data_len(bleRemoteBda, 251);
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+#if ESP_IDF_VERSION_MAJOR >= 5
+  esp_ble_gap_set_preferred_phy(bleRemoteBda, 0, ESP_BLE_GAP_PHY_2M_PREF_MASK, ESP_BLE_GAP_PHY_2M_PREF_MASK, ESP_BLE_GAP_PHY_OPTIONS_NO_PREF);
+#else
+  esp_ble_gap_set_prefered_phy(bleRemoteBda, 0, ESP_BLE_GAP_PHY_2M_PREF_MASK, ESP_BLE_GAP_PHY_2M_PREF_MASK, ESP_BLE_GAP_PHY_OPTIONS_NO_PREF);
+#endif
+#endif
+  
+  uint16_t chunk = bleFrameCap() - BLEXFER_DATA_HEADER;
+  uint32_t maxWindow = (XFER_RING_BYTES - XFER_READ_BLOCK) / chunk;
+  uint8_t window = xfer.window < maxWindow ? xfer.window : (uint8_t)(maxWindow < 255 ? maxWindow : 255);
+  xSemaphoreTake(xferMutex, portMAX_DELAY);
+  xferWindow.begin(xfer.size, xfer.offset, chunk, window);
+  xSemaphoreGive(xferMutex);
+  xferRing.reset(xferRingBuffer, XFER_RING_BYTES, xfer.offset);
+  xfer.readerError = blexfer::XERR_NONE;
+  xfer.readerRunning = true;
+  xTaskCreatePinnedToCore(xferReadTask, "XferRead", 4096, NULL, 1, NULL, 1);
+  
+  xferNotify(frame, blexfer::encodeOpened(frame, xfer.size, xfer.offset, chunk, window));
+  Serial.printf("📤 BLE transfer %s from %lu/%lu (chunk %u, window %u)\n", xfer.path,
+                (unsigned long)xfer.offset, (unsigned long)xfer.size, chunk, window);
+  
+  uint32_t startMs = millis();
+  uint32_t lastRetryMs = startMs;
+  uint32_t bytesSent = 0;
+  uint32_t stalls = 0;
+  uint16_t connId = pServer->getConnId();
+  xfer.lastProgressMs = startMs;
+  
+  while (error == blexfer::XERR_NONE) {
+    if (xfer.cancel || !bleEnabled || !deviceConnected) {
+      error = blexfer::XERR_CANCELLED;
+      break;
+    }
+    if (xfer.readerError != blexfer::XERR_NONE) {
+      error = xfer.readerError;
+      break;
+    }
+    
+    uint32_t offset;
+    uint16_t length;
+    xSemaphoreTake(xferMutex, portMAX_DELAY);
+    xferRing.release(xferWindow.acked());
+    bool done = xferWindow.done();
+    bool ready = !done && xferWindow.next(offset, length);
+    if (!done && !ready && millis() - xfer.lastProgressMs > XFER_ACK_TIMEOUT_MS &&
+        millis() - lastRetryMs > XFER_ACK_TIMEOUT_MS) {
+      xferWindow.timeout();
+      lastRetryMs = millis();
+    }
+    xSemaphoreGive(xferMutex);
+    
+    if (done) {
+      break;
+    }
+    if (!ready) {
+      if (millis() - xfer.lastProgressMs > XFER_ABORT_MS) {
+        error = blexfer::XERR_TIMEOUT;
+      }
+      vTaskDelay(pdMS_TO_TICKS(2));
+      continue;
+    }
+    
+    // Data should already be in the ring; count it when the sender had to wait
+    if (!xferRing.copy(offset, frame + BLEXFER_DATA_HEADER, length)) {
+      stalls++;
+      while (!xferRing.copy(offset, frame + BLEXFER_DATA_HEADER, length) &&
+             !xfer.cancel && xfer.readerRunning) {
+        vTaskDelay(1);
+      }
+      // The reader stopped (error or cancel) without producing the data:
+      // never send what happens to be in the frame buffer
+      if (!xferRing.copy(offset, frame + BLEXFER_DATA_HEADER, length)) {
+        error = xfer.cancel ? blexfer::XERR_CANCELLED
+              : xfer.readerError != blexfer::XERR_NONE ? (blexfer::Error)xfer.readerError : blexfer::XERR_IO;
+        break;
+      }
+    }
+    frame[0] = (uint8_t)offset;
+    frame[1] = (uint8_t)(offset >> 8);
+    frame[2] = (uint8_t)(offset >> 16);
+    frame[3] = (uint8_t)(offset >> 24);
+    
+    // Keep the controller's TX buffers from overflowing
+    while (esp_ble_get_cur_sendable_packets_num(connId) == 0 && deviceConnected) {
+      vTaskDelay(1);
+    }
+    pXferDataCharacteristic->setValue(frame, BLEXFER_DATA_HEADER + length);
+    pXferDataCharacteristic->notify();
+    bytesSent += length;
+  }
+  
+  xfer.cancel = true;   // Stops the reader if it is still going
+  while (xfer.readerRunning) {
+    vTaskDelay(pdMS_TO_TICKS(5));
+  }
+  if (sdLock(1000)) {
+    xferFile.close();
+    sdUnlock();
+  }
+  memstats::release(memstats::TAG_BLE_XFER, xferRingBuffer);
+  xferRingBuffer = nullptr;
+  
+  uint32_t elapsed = millis() - startMs;
+  if (error == blexfer::XERR_NONE) {
+    xferNotify(frame, blexfer::encodeDone(frame, bytesSent, elapsed, xferWindow.retransmits(), stalls));
+    Serial.printf("✓ BLE transfer %s: %lu bytes in %lu ms (%.1f KB/s, %lu retransmits, %lu stalls)\n",
+                  xfer.path, (unsigned long)bytesSent, (unsigned long)elapsed,
+                  elapsed ? bytesSent / 1.024 / elapsed : 0.0,
+                  (unsigned long)xferWindow.retransmits(), (unsigned long)stalls);
+  } else {
+    xferNotifyError(error);
+    Serial.printf("❌ BLE transfer %s stopped: error %u\n", xfer.path, error);
+  }
+  xfer.active = false;
+  vTaskDelete(NULL);
+}
+
+class XferCallbacks: public BLECharacteristicCallbacks {
+  void onWrite(BLECharacteristic *pCharacteristic) {
+    std::string value = pCharacteristic->getValue();
+    blexfer::Request req;
+    if (!blexfer::parseRequest((const uint8_t*)value.data(), value.length(), req)) {
+      xferNotifyError(blexfer::XERR_MALFORMED);
+      return;
+    }
+    
+    switch (req.op) {
+      case blexfer::XOP_OPEN: {
+        if (xfer.active || usbMscEnabled) {
+          xferNotifyError(blexfer::XERR_BUSY);
+          return;
+        }
+        if (req.pathLength >= sizeof(xfer.path)) {
+          xferNotifyError(blexfer::XERR_MALFORMED);
+          return;
+        }
+        memcpy(xfer.path, req.path, req.pathLength);
+        xfer.path[req.pathLength] = '\0';
+        if (!blexfer::pathAllowed(xfer.path)) {
+          xferNotifyError(blexfer::XERR_DENIED);
+          return;
+        }
+        xfer.offset = req.offset;
+        xfer.window = req.window;
+        xfer.cancel = false;
+        xfer.active = true;
+        // Opening and sizing touch the SD card; keep that off the BLE task
+        if (xTaskCreatePinnedToCore(xferSendTask, "XferSend", 6144, NULL, 2, NULL, 0) != pdPASS) {
+          xfer.active = false;
+          xferNotifyError(blexfer::XERR_BUSY);
+        }
+        break;
+      }
+      case blexfer::XOP_ACK:
+        xSemaphoreTake(xferMutex, portMAX_DELAY);
+        if (req.offset > xferWindow.acked()) {
+          xferWindow.ack(req.offset);
+          xfer.lastProgressMs = millis();
+        }
+        xSemaphoreGive(xferMutex);
+        break;
+      case blexfer::XOP_NACK:
+        xSemaphoreTake(xferMutex, portMAX_DELAY);
+        for (size_t i = 0; i < req.nackCount; i++) {
+          xferWindow.nack(blexfer::nackOffset(req, i));
+        }
+        xSemaphoreGive(xferMutex);
+        break;
+      case blexfer::XOP_CANCEL:
+        xfer.cancel = true;
+        break;
+    }
+  }
+};
+
+class WiFiCallbacks: public BLECharacteristicCallbacks {
+  void onWrite(BLECharacteristic *pCharacteristic) {
+    std::string value = pCharacteristic->getValue();
+    char command[24];
+    if (trimCommand(value, command, sizeof(command))[0] == '\0') {
+      return;
+    }
+    LOG_I("BLE WiFi Command: %s", command);
+    
+    if (strcmp(command, "ENABLE_WIFI") == 0) {
+      cmdWiFi();
+    }
+  }
+};
+
+// Initialize BLE Server
+bool initBLE() {
+  LOG_I("Initializing BLE...");
+  
+  if (!bleNotifyMutex) {
+    bleNotifyMutex = xSemaphoreCreateMutex();
+    xferMutex = xSemaphoreCreateMutex();
+  }
+  
+  BLEDevice::init("ESP32-CAM-BLE");
+  // Offer a large MTU so a whole status record or ack batch fits one notification
+  BLEDevice::setMTU(BLEPROTO_PREFERRED_MTU);
+  
+  // Create BLE Server
+  pServer = BLEDevice::createServer();
+  pServer->setCallbacks(new ServerCallbacks());
+  
+  // Create BLE Service
+  BLEService *pService = pServer->createService(BLE_SERVICE_UUID);
+  
+  // Control Characteristic (Write)
+  pControlCharacteristic = pService->createCharacteristic(
+    BLE_CONTROL_CHAR_UUID,
+    BLECharacteristic::PROPERTY_WRITE
+  );
+  pControlCharacteristic->setCallbacks(new ControlCallbacks());
+  
+  // Status Characteristic (Read + Notify)
+  pStatusCharacteristic = pService->createCharacteristic(
+    BLE_STATUS_CHAR_UUID,
     BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY
   );
   pStatusCharacteristic->addDescriptor(new BLE2902());
@@ -1014,9 +2650,35 @@ bool initBLE() {
   );
   pWiFiCharacteristic->setCallbacks(new WiFiCallbacks());
   
+  // Binary protocol (Write / Write Without Response + Read + Notify)
+  pBinaryCharacteristic = pService->createCharacteristic(
+    BLE_BINARY_CHAR_UUID,
+    BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_WRITE_NR |
+    BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY
+  );
+  BLE2902* binaryCccd = new BLE2902();
+  binaryCccd->setCallbacks(new BinarySubscribeCallbacks());
+  pBinaryCharacteristic->addDescriptor(binaryCccd);
+  pBinaryCharacteristic->setCallbacks(new BinaryCallbacks());
+  
   // Start the service
   pService->start();
   
+  // File transfer service: control (Write + Notify), data (Notify)
+  BLEService *pXferService = pServer->createService(BLE_XFER_SERVICE_UUID);
+  pXferControlCharacteristic = pXferService->createCharacteristic(
+    BLE_XFER_CONTROL_UUID,
+    BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_WRITE_NR | BLECharacteristic::PROPERTY_NOTIFY
+  );
+  pXferControlCharacteristic->addDescriptor(new BLE2902());
+  pXferControlCharacteristic->setCallbacks(new XferCallbacks());
+  pXferDataCharacteristic = pXferService->createCharacteristic(
+    BLE_XFER_DATA_UUID,
+    BLECharacteristic::PROPERTY_NOTIFY
+  );
+  pXferDataCharacteristic->addDescriptor(new BLE2902());
+  pXferService->start();
+  
   // Start advertising
   BLEAdvertising *pAdvertising = BLEDevice::getAdvertising();
   pAdvertising->addServiceUUID(BLE_SERVICE_UUID);
@@ -1025,15 +2687,25 @@ bool initBLE() {
   pAdvertising->setMinPreferred(0x12);
   BLEDevice::startAdvertising();
   
-  Serial.println("✓ BLE Server started");
-  Serial.println("  Device Name: ESP32-CAM-BLE");
-  Serial.println("  Commands: START, STOP, STATUS");
-  Serial.println("  WiFi: Send ENABLE_WIFI to WiFi characteristic");
+  LOG_I("✓ BLE Server started");
+  LOG_I("  Device Name: ESP32-CAM-BLE");
+  LOG_I("  Commands: START, STOP, STATUS");
+  LOG_I("  WiFi: Send ENABLE_WIFI to WiFi characteristic");
+  LOG_I("  Binary protocol and file transfer: see BLE_PROTOCOL.md");
   
   return true;
 }
 
 // Initialize PDM microphone (using ESP_I2S 3.0 library)
+#define AUDIO_READ_TIMEOUT_MS 100
+bool micReady = false;                        // I2S configured and audioCaptureTask running
+volatile uint32_t micUsers = 0;
+portMUX_TYPE micMux = portMUX_INITIALIZER_UNLOCKED;
+TaskHandle_t audioCaptureHandle = NULL;
+
+void audioCaptureTask(void *parameter);
+void soundTask(void *parameter);
+
 bool initMicrophone() {
   // Setup PDM pins: clock=42, data=41
   I2S.setPinsPdmRx(PDM_CLK_PIN, PDM_DATA_PIN);
@@ -1044,10 +2716,246 @@ bool initMicrophone() {
     return false;
   }
 
+  // Idle until a consumer enables it: a running I2S channel holds the
+  // driver's APB lock, which rules out light sleep
+  i2s_channel_disable(I2S.rxChan());
+  
+  audioEvents = xEventGroupCreate();
+  if (!audioEvents ||
+      xTaskCreatePinnedToCore(audioCaptureTask, "AudioCapture", 4096, NULL, 3, &audioCaptureHandle, 0) != pdPASS) {
+    Serial.println("Failed to start audio capture task!");
+    return false;
+  }
+  soundDetector.begin(sad::defaultConfig(), SAMPLE_RATE);
+  levelAnalyzer.begin(SAMPLE_RATE, LEVELS_PERIOD_MS);
+  // Silence until the first summary rather than 0 dBFS (full scale)
+  metrics::audioRmsDbfs.set((int32_t)(SPECTRUM_MIN_DB * 10));
+  metrics::audioPeakDbfs.set((int32_t)(SPECTRUM_MIN_DB * 10));
+  for (size_t b = 0; b < metrics::audioBandDbfs.size(); b++) {
+    metrics::audioBandDbfs.set(b, (int32_t)(SPECTRUM_MIN_DB * 10));
+  }
+  if (xTaskCreatePinnedToCore(soundTask, "SoundDetect", 4096, NULL, 2, NULL, 0) != pdPASS) {
+    Serial.println("⚠️  Sound activity detector not started");
+  }
+  micReady = true;
+  
   Serial.println("✓ Microphone initialized (16kHz 16-bit PDM)");
   return true;
 }
 
+// Counted microphone users (audio clips, /audio streaming). The capture
+// task runs the I2S channel while there is at least one.
+void micAcquire() {
+  portENTER_CRITICAL(&micMux);
+  bool first = micUsers++ == 0;
+  portEXIT_CRITICAL(&micMux);
+  if (first && micReady) {
+    xTaskNotifyGive(audioCaptureHandle);
+  }
+}
+
+// The capture task stops the channel after its current block
+void micRelease() {
+  portENTER_CRITICAL(&micMux);
+  if (micUsers > 0) {
+    micUsers--;
+  }
+  portEXIT_CRITICAL(&micMux);
+}
+
+// The single producer for audioRing. Reads whole blocks from the I2S DMA
+// buffers straight into the ring slot and publishes them stamped with the
+// capture time of their first sample.
+void audioCaptureTask(void *parameter) {
+  bool running = false;
+  for (;;) {
+    bool wanted = micUsers > 0;
+    if (wanted != running) {
+      if (wanted) {
+        pmlock::acquire(pmlock::AUDIO);
+        i2s_channel_enable(I2S.rxChan());
+      } else {
+        i2s_channel_disable(I2S.rxChan());
+        pmlock::release(pmlock::AUDIO);
+      }
+      running = wanted;
+    }
+    if (!running) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      continue;
+    }
+    
+    audioring::Block* block = audioRing.beginWrite();
+    size_t bytes = 0;
+    TRACE_BEGIN("audio.capture");
+    i2s_channel_read(I2S.rxChan(), block->pcm, sizeof(block->pcm), &bytes, pdMS_TO_TICKS(AUDIO_READ_TIMEOUT_MS));
+    TRACE_END("audio.capture");
+    uint16_t samples = (uint16_t)(bytes / sizeof(int16_t));
+    if (samples == 0) {
+      metrics::audioReadErrors.inc();
+      LOG_W_EVERY(10000, "⚠️  No audio from the microphone");
+      continue;
+    }
+    int64_t firstSampleUs = esp_timer_get_time() - (int64_t)samples * 1000000 / SAMPLE_RATE;
+    audioRing.commit(samples, firstSampleUs);
+    metrics::audioBlocks.inc();
+    xEventGroupSetBits(audioEvents, AUDIO_BLOCK_READY);     // Wakes every waiting reader
+    xEventGroupClearBits(audioEvents, AUDIO_BLOCK_READY);
+  }
+}
+
+void logSoundEvent(const sad::Event& event) {
+  portENTER_CRITICAL(&soundMux);
+  soundLog.events[soundLog.head] = event;
+  soundLog.head = (soundLog.head + 1) % SAD_EVENT_LOG;
+  if (soundLog.count < SAD_EVENT_LOG) {
+    soundLog.count++;
+  }
+  portEXIT_CRITICAL(&soundMux);
+  LOG_I("🔇 Sound ended after %.1f s (peak %.1f dB over the floor)",
+        (event.endUs - event.startUs) / 1e6, event.peakSnrDb);
+}
+
+// Runs the sound activity detector on every captured block while the
+// microphone is on, and sleeps on the ring while it is off
+void soundTask(void *parameter) {
+  for (;;) {
+    if (!soundReader.attached()) {
+      xEventGroupWaitBits(audioEvents, AUDIO_BLOCK_READY, pdFALSE, pdFALSE, portMAX_DELAY);
+      soundDetector.reset();
+      audioRing.attach(soundReader);
+      continue;
+    }
+    
+    const audioring::Block* block = soundReader.peek();
+    if (!block) {
+      if (micUsers == 0) {
+        // Microphone off: close any running event where the audio stopped
+        if (soundDetector.active()) {
+          sad::Event event = soundDetector.event();
+          event.endUs = esp_timer_get_time();
+          logSoundEvent(event);
+        }
+        soundActive = false;
+        audioRing.detach(soundReader);
+        continue;
+      }
+      audioWaitBlock(AUDIO_READ_TIMEOUT_MS);
+      continue;
+    }
+    
+    int64_t start = esp_timer_get_time();
+    sad::Transition t = soundDetector.process(block->pcm, block->samples, block->timestampUs);
+    uint32_t busy = (uint32_t)(esp_timer_get_time() - start);
+    soundReader.release();
+    portENTER_CRITICAL(&soundMux);
+    soundLog.busyUs += busy;
+    soundLog.frames++;
+    portEXIT_CRITICAL(&soundMux);
+    
+    if (t == sad::ONSET) {
+      soundActive = true;
+      metrics::soundEvents.inc();
+      LOG_I("🔊 Sound detected (%.1f dB over the floor)", soundDetector.event().peakSnrDb);
+    } else if (t == sad::OFFSET) {
+      soundActive = false;
+      logSoundEvent(soundDetector.event());
+    }
+  }
+}
+
+bool levelsJson(char* out, size_t cap, size_t& len);
+
+// Audio ring, per-consumer stats, sound detector and levels for /api/audio.
+// Handlers run one at a time on the async_tcp task, so the buffer is shared.
+const StringWriter& audioStatusJson() {
+  // Floats go out as fixed point with the given number of decimals
+  auto scaled = [](float v, float scale) { return (int64_t)llroundf(v * scale); };
+  static FixedString<3072> json;
+  json.clear();
+  JsonWriter w(json);
+  w.beginObject();
+  w.boolean("running", micUsers > 0);
+  w.num("sampleRate", SAMPLE_RATE);
+  w.num("blockSamples", AUDIORING_BLOCK_SAMPLES);
+  w.num("ringBlocks", audioRing.capacity());
+  w.num("published", audioRing.published());
+  w.num("readErrors", metrics::audioReadErrors.value());
+  w.beginArray("readers");
+  for (size_t i = 0; i < audioRing.readerCount(); i++) {
+    const audioring::Reader* r = audioRing.reader(i);
+    if (!r) {
+      continue;
+    }
+    w.beginObject();
+    w.str("name", r->name());
+    w.boolean("attached", r->attached());
+    w.num("lag", r->lag());
+    w.num("blocks", r->blocksRead());
+    w.num("overruns", r->overruns());
+    w.num("torn", r->torn());
+    w.endObject();
+  }
+  w.endArray();
+  
+  // Sound activity detector: live features and recent events
+  SoundEventLog sounds;
+  portENTER_CRITICAL(&soundMux);
+  sounds = soundLog;
+  portEXIT_CRITICAL(&soundMux);
+  const sad::Features& f = soundDetector.features();
+  w.beginObject("sound");
+  w.boolean("gateAudio", sadGateAudio);
+  w.boolean("triggerVideo", sadTriggerVideo);
+  w.boolean("active", soundActive);
+  w.num("events", metrics::soundEvents.value());
+  w.tenths("energyDb", scaled(f.energyDb, 10));
+  w.tenths("floorDb", scaled(f.floorDb, 10));
+  w.fixed("flatness", scaled(f.flatness, 100), 2);
+  w.fixed("zcr", scaled(f.zcr, 100), 2);
+  // Share of one core: busy time over the audio it covered (16 ms a frame)
+  float cpuPct = sounds.frames ? sounds.busyUs * 100.0f / ((float)sounds.frames * AUDIORING_BLOCK_SAMPLES * 1000000 / SAMPLE_RATE) : 0;
+  w.fixed("cpuPct", scaled(cpuPct, 100), 2);
+  w.beginArray("recent");
+  int64_t nowUs = esp_timer_get_time();
+  for (size_t i = 0; i < sounds.count; i++) {
+    const sad::Event& e = sounds.events[(sounds.head + SAD_EVENT_LOG - 1 - i) % SAD_EVENT_LOG];
+    w.beginObject();
+    w.num("agoMs", (nowUs - e.startUs) / 1000);
+    w.num("durationMs", (e.endUs - e.startUs) / 1000);
+    w.tenths("peakDb", scaled(e.peakSnrDb, 10));
+    w.endObject();
+  }
+  w.endArray();
+  w.endObject();
+  
+  // WebSocket clients per output rate and what the resampling costs
+  w.beginObject("stream");
+  w.num("defaultRate", WS_AUDIO_RATE);
+  w.beginArray("rates");
+  for (size_t k = 0; k < STREAM_RATES; k++) {
+    w.beginObject();
+    w.num("hz", kStreamRates[k]);
+    w.num("clients", wsRateClients[k]);
+    w.endObject();
+  }
+  w.endArray();
+  float resampleUs = streamResampleBlocks ? (float)streamResampleUs / streamResampleBlocks : 0;
+  w.tenths("resampleUsPerBlock", scaled(resampleUs, 10));
+  w.endObject();
+  
+  // Last level/spectrum summary, as sent on /levels
+  char levels[384];
+  size_t levelsLen;
+  if (levelsJson(levels, sizeof(levels), levelsLen)) {
+    w.raw("levels", levels, levelsLen);
+  } else {
+    w.null("levels");
+  }
+  w.endObject();
+  return json;
+}
+
 // Initialize SD Card (using SPI mode per Seeed example)
 bool initSDCard() {
   Serial.println("Initializing SD Card...");
@@ -1111,388 +3019,1584 @@ bool initSDCard() {
     Serial.println("✓ SD mutex created");
   }
   
+  refreshSdUsage();
+  
   return true;
 }
 
-// Save JPEG frame to SD card with timestamp
-bool saveFrameToSD(camera_fb_t *fb) {
-  if (!fb) {
-    Serial.println("❌ saveFrameToSD: No frame buffer provided");
-    return false;
-  }
-  
-  // Acquire SD mutex
-  if (sdMutex && xSemaphoreTake(sdMutex, pdMS_TO_TICKS(1000)) == pdTRUE) {
-    // Use timestamp in filename if available
-    char filename[64];
-    if (timeInitialized) {
-      String timestamp = getTimestamp();
-      sprintf(filename, "/video/%s_frame_%06lu.jpg", timestamp.c_str(), frameCount);
-    } else {
-      sprintf(filename, "/video/frame_%06lu.jpg", frameCount);
-    }
-    
-    Serial.printf("📹 Saving frame %lu to: %s (%d bytes)...\n", frameCount, filename, fb->len);
-    
-    File file = SD.open(filename, FILE_WRITE);
-    if (!file) {
-      Serial.printf("❌ Failed to open file for writing: %s\n", filename);
-      currentState = STATE_ERROR;
-      xSemaphoreGive(sdMutex);
-      return false;
-    }
-    
-    size_t written = file.write(fb->buf, fb->len);
-    file.close();
-    
-    // Release SD mutex
-    xSemaphoreGive(sdMutex);
-    
-    if (written != fb->len) {
-      Serial.printf("❌ Write error: wrote %d of %d bytes\n", written, fb->len);
-      return false;
+// Per-frame logging for the recording pipeline. Every site is rate-limited:
+// at the recording frame rate these fire several times a second.
+class RecorderLog : public pipeline::Listener {
+  void onFrameSaved(uint32_t frameNo, const char* path, size_t len, pipeline::SaveResult result) override {
+    switch (result) {
+      case pipeline::SAVE_OK:
+        LOG_I_EVERY(1000, "✓ Frame %lu saved to %s (%u bytes)", (unsigned long)frameNo, path, (unsigned)len);
+        break;
+      case pipeline::SAVE_LOCK_TIMEOUT:
+        LOG_W_EVERY(1000, "⚠️  Failed to acquire SD mutex for video");
+        break;
+      case pipeline::SAVE_OPEN_FAILED:
+        LOG_E_EVERY(1000, "❌ Failed to open file for writing: %s", path);
+        currentState = STATE_ERROR;
+        break;
+      default:
+        LOG_E_EVERY(1000, "❌ Write error on %s (%u bytes)", path, (unsigned)len);
+        break;
     }
-    
-    Serial.printf("✓ Frame %lu saved successfully\n", frameCount);
-    frameCount++;
-    
-    return true;
-  } else {
-    Serial.println("⚠️  Failed to acquire SD mutex for video");
-    return false;
   }
-}
 
-// Generate WAV file header (per Seeed example)
-void generate_wav_header(uint8_t *wav_header, uint32_t wav_size, uint32_t sample_rate) {
-  // See this for reference: http://soundfile.sapp.org/doc/WaveFormat/
-  uint32_t file_size = wav_size + WAV_HEADER_SIZE - 8;
-  uint32_t byte_rate = sample_rate * SAMPLE_BITS / 8;
-  const uint8_t set_wav_header[] = {
-    'R', 'I', 'F', 'F', // ChunkID
-    file_size, file_size >> 8, file_size >> 16, file_size >> 24, // ChunkSize
-    'W', 'A', 'V', 'E', // Format
-    'f', 'm', 't', ' ', // Subchunk1ID
-    0x10, 0x00, 0x00, 0x00, // Subchunk1Size (16 for PCM)
-    0x01, 0x00, // AudioFormat (1 for PCM)
-    0x01, 0x00, // NumChannels (1 channel)
-    sample_rate, sample_rate >> 8, sample_rate >> 16, sample_rate >> 24, // SampleRate
-    byte_rate, byte_rate >> 8, byte_rate >> 16, byte_rate >> 24, // ByteRate
-    0x02, 0x00, // BlockAlign
-    0x10, 0x00, // BitsPerSample (16 bits)
-    'd', 'a', 't', 'a', // Subchunk2ID
-    wav_size, wav_size >> 8, wav_size >> 16, wav_size >> 24, // Subchunk2Size
-  };
-  memcpy(wav_header, set_wav_header, sizeof(set_wav_header));
+  void onCaptureError() override {
+    LOG_E_EVERY(1000, "❌ Error getting framebuffer!");
+  }
+};
+RecorderLog recorderLog;
+
+// Clip buffer for record_wav(), allocated once and kept: a 320 KB PSRAM
+// malloc/free per clip slowly fragments PSRAM on long-running units
+uint8_t *wavClipBuffer = NULL;
+#define WAV_CLIP_BYTES ((SAMPLE_RATE * SAMPLE_BITS / 8) * RECORD_TIME)
+
+bool allocWavClipBuffer() {
+  if (!wavClipBuffer) {
+    wavClipBuffer = (uint8_t *)memstats::alloc(memstats::TAG_WAV, WAV_CLIP_BYTES, MALLOC_CAP_SPIRAM);
+  }
+  return wavClipBuffer != NULL;
 }
 
-// Record WAV file (based on Seeed example)
-void record_wav() {
-  uint32_t sample_size = 0;
-  uint32_t record_size = (SAMPLE_RATE * SAMPLE_BITS / 8) * RECORD_TIME;
-  uint8_t *rec_buffer = NULL;
-  
-  Serial.printf("Ready to start recording %d seconds...\n", RECORD_TIME);
+// Record WAV file (based on Seeed example). A sound-gated clip starts with
+// the pre-roll kept in the ring and ends when the sound does.
+void record_wav(bool gated) {
+  LOG_I("Ready to start recording %d seconds...", RECORD_TIME);
   
-  // PSRAM malloc for recording
-  rec_buffer = (uint8_t *)ps_malloc(record_size);
-  if (rec_buffer == NULL) {
-    Serial.printf("malloc failed!\n");
+  if (!allocWavClipBuffer()) {
+    memstats::RegionStats psram;
+    memstats::readRegion(memstats::REGION_PSRAM, psram);
+    LOG_E("malloc failed! PSRAM free %u, largest block %u (%u%% fragmented)",
+          psram.freeBytes, psram.largestFreeBlock, psram.fragmentationPct);
     return;
   }
-  Serial.printf("Buffer: %d bytes\n", ESP.getPsramSize() - ESP.getFreePsram());
   
-  // Start recording - read from I2S (do this BEFORE acquiring SD mutex to avoid blocking)
-  uint32_t bytes_read = 0;
-  while (bytes_read < record_size) {
-    int sample = I2S.read();
-    if (sample != -1 && sample != 0 && sample != 1) {
-      // Store sample as 16-bit value
-      rec_buffer[bytes_read++] = sample & 0xFF;
-      rec_buffer[bytes_read++] = (sample >> 8) & 0xFF;
-    }
+  // Capture, apply gain and write - the SD mutex is only taken for the write
+  char filename[64];
+  static uint32_t lastGatedEvent = 0;
+  uint32_t preroll = 0;
+  if (gated && lastGatedEvent != metrics::soundEvents.value()) {
+    preroll = SAD_PREROLL_BLOCKS;   // First clip of this event; later ones continue it
+    lastGatedEvent = metrics::soundEvents.value();
   }
-  sample_size = bytes_read;
-  
-  if (sample_size == 0) {
-    Serial.printf("Record Failed!\n");
-    free(rec_buffer);
+  micAcquire();
+  microphone.start(preroll);
+  pipeline::SaveResult result = recorder.recordAudioClip(wavClipBuffer, WAV_CLIP_BYTES, audioFileCount++,
+                                                         filename, sizeof(filename),
+                                                         gated ? &soundActive : NULL);
+  microphone.stop();
+  micRelease();
+  switch (result) {
+    case pipeline::SAVE_OK:
+      LOG_I("Recording saved: %s", filename);
+      break;
+    case pipeline::SAVE_NO_DATA:
+      LOG_E("Record Failed!");
+      break;
+    case pipeline::SAVE_LOCK_TIMEOUT:
+      LOG_W("⚠️  Failed to acquire SD mutex for audio");
+      break;
+    case pipeline::SAVE_OPEN_FAILED:
+      LOG_E("Failed to open file for writing");
+      break;
+    default:
+      LOG_E("Write file Failed! %s", filename);
+      break;
+  }
+}
+
+// A session runs until STOP (or USB / low battery) clears recordingMode,
+// or another command is queued behind it
+bool recordingSessionActive() {
+  return recordingMode && !usbMscEnabled && !recorderBus.pending();
+}
+
+// Continuous clip recording to SD (run by recorderTask())
+void runRecordingSession(cmdbus::Command& start) {
+  // Check if USB MSC is active
+  if (usbMscEnabled) {
+    LOG_E("❌ Cannot start recording - USB Mass Storage is active");
+    LOG_I("   Send DISABLE_USB command first");
+    cmdbus::complete(start, bleproto::RESULT_BUSY);
     return;
-  } else {
-    Serial.printf("Record %d bytes\n", sample_size);
   }
   
-  // Increase volume
-  for (uint32_t i = 0; i < sample_size; i += SAMPLE_BITS/8) {
-    (*(uint16_t *)(rec_buffer+i)) <<= VOLUME_GAIN;
-  }
+  LOG_I("Starting 10-second interval recording...");
+  LOG_I("========================================");
   
-  // Now acquire SD mutex for writing
-  if (sdMutex && xSemaphoreTake(sdMutex, pdMS_TO_TICKS(2000)) == pdTRUE) {
-    // Use timestamp in filename if available
-    char filename[64];
-    if (timeInitialized) {
-      String timestamp = getTimestamp();
-      sprintf(filename, "/%s_%s_%06lu.wav", WAV_FILE_NAME, timestamp.c_str(), audioFileCount++);
-    } else {
-      sprintf(filename, "/%s_%06lu.wav", WAV_FILE_NAME, audioFileCount++);
+  // Display recording mode
+  if (audioOnlyMode) {
+    LOG_I("Mode: AUDIO ONLY - Recording audio files every 10 seconds");
+  } else if (videoOnlyMode) {
+    LOG_I("Mode: VIDEO ONLY - Recording 10-second video clips");
+  } else {
+    LOG_I("Mode: AUDIO + VIDEO - Recording 10-second clips of both");
+  }
+  if (sadGateAudio && !videoOnlyMode) {
+    LOG_I("Audio clips only while sound is detected");
+  }
+  if (sadTriggerVideo && !audioOnlyMode) {
+    LOG_I("Video clips only while sound is detected");
+  }
+  LOG_I("========================================");
+  
+  unsigned long lastAudioTime = 0;
+  unsigned long lastVideoTime = 0;
+  const unsigned long clipInterval = 10000; // Record clips every 10 seconds
+  bool listening = false;                   // Holding the microphone for the detector
+  
+  // Allocate the clip buffer before the audited loop
+  if (!videoOnlyMode) {
+    allocWavClipBuffer();
+  }
+  
+  currentState = STATE_RECORDING;
+  cmdbus::complete(start, bleproto::RESULT_OK);
+  
+  while (recordingSessionActive()) {
+    unsigned long currentTime = millis();
+    
+    // Check battery status periodically
+    static unsigned long lastBatteryCheck = 0;
+    if (currentTime - lastBatteryCheck > 60000) {
+      checkBatteryStatus();
+      lastBatteryCheck = currentTime;
+      if (batteryLow) {
+        LOG_W("Battery low - stopping recording");
+        break;
+      }
+    }
+    
+    // Run cleanup periodically
+    if (currentTime - lastCleanupTime > CLEANUP_INTERVAL) {
+      cleanupOldFiles();
+      lastCleanupTime = currentTime;
+    }
+    
+    // Keep the microphone on while the detector gates anything; follows
+    // changes made through /api/audio/sad mid-session
+    bool gateAudio = sadGateAudio && !videoOnlyMode;
+    bool gateVideo = sadTriggerVideo && !audioOnlyMode;
+    if ((gateAudio || gateVideo) != listening) {
+      listening = !listening;
+      if (listening) {
+        micAcquire();
+      } else {
+        micRelease();
+      }
+    }
+    
+    // VIDEO RECORDING (only if not audio-only mode) - 10-second clips
+    bool videoDue = gateVideo ? soundActive : currentTime - lastVideoTime >= clipInterval;
+    if (!audioOnlyMode && videoDue) {
+      cameraStandby(false);
+      applyCameraPowerLevel();   // Governor changes land between clips
+      LOG_I("📹 Recording 10-second video clip...");
+      
+      // Capture frames for 10 seconds
+      pipeline::Recorder::ClipStats clip;
+      {
+        pmlock::Hold hold(pmlock::CAPTURE);
+        memstats::AllocWindow window(memstats::HOT_RECORD);
+        clip = recorder.recordVideoClip(10000, &recordingMode, frameCount);
+      }
+      
+      LOG_I("✓ Video clip complete: %lu frames captured (%lu save errors)",
+            (unsigned long)clip.saved, (unsigned long)clip.saveErrors);
+      lastActivityTime = currentTime;
+      lastVideoTime = currentTime;
+    }
+    
+    // AUDIO RECORDING (only if not video-only mode)
+    bool audioDue = gateAudio ? soundActive : currentTime - lastAudioTime >= clipInterval;
+    if (!videoOnlyMode && audioDue) {
+      LOG_I("🎙️  Recording audio clip...");
+      TRACE_BEGIN("recordingTask.audio_clip");
+      {
+        memstats::AllocWindow window(memstats::HOT_RECORD);
+        record_wav(gateAudio);
+      }
+      TRACE_END("recordingTask.audio_clip");
+      lastActivityTime = currentTime;
+      lastAudioTime = currentTime;
+    }
+    
+    // Sleep between clips; a queued STOP wakes us
+    recorderBus.wait(100);
+  }
+  if (listening) {
+    micRelease();
+  }
+  
+  LOG_I("========================================");
+  LOG_I("Recording stopped");
+  LOG_I("Total frames captured: %lu", frameCount);
+  LOG_I("Total audio files: %lu", audioFileCount);
+  LOG_I("========================================");
+}
+
+// ============================================
+// TIMELAPSE
+// ============================================
+// One frame every timelapseIntervalSec, appended to a single MJPEG AVI per
+// day (/video/timelapse_<YYYYMMDD>.avi). Each frame goes on the end of the
+// movi list, its idx1 entry goes to a .idx sidecar, and the header is
+// rewritten, so the file is playable after every shot. The sidecar becomes
+// the idx1 chunk when the day rolls over. Between shots the sensor is in
+// standby with XCLK gated and the idle task may light-sleep.
+struct TimelapseFile {
+  bool open;                 // 'info' describes 'path'
+  char day[9];               // YYYYMMDD, or "undated" before NTP
+  uint8_t part;              // _<n> suffix once a day passes TIMELAPSE_MAX_FILE_BYTES
+  char path[48];
+  char indexPath[48];
+  avi::Info info;
+};
+TimelapseFile timelapseFile;
+
+void timelapsePaths(TimelapseFile& f) {
+  if (f.part == 0) {
+    snprintf(f.path, sizeof(f.path), "/video/timelapse_%s.avi", f.day);
+    snprintf(f.indexPath, sizeof(f.indexPath), "/video/timelapse_%s.idx", f.day);
+  } else {
+    snprintf(f.path, sizeof(f.path), "/video/timelapse_%s_%u.avi", f.day, f.part);
+    snprintf(f.indexPath, sizeof(f.indexPath), "/video/timelapse_%s_%u.idx", f.day, f.part);
+  }
+}
+
+// Pick up an unfinished file from before a stop or reset. Anything that
+// doesn't line up exactly (torn append, finished file, other resolution)
+// is left alone and the caller moves on to the next part.
+bool timelapseResume(TimelapseFile& f, uint16_t width, uint16_t height) {
+  File aviFile = SD.open(f.path, FILE_READ);
+  if (!aviFile) {
+    return false;
+  }
+  uint8_t header[AVI_HEADER_BYTES];
+  bool ok = aviFile.read(header, sizeof(header)) == sizeof(header) &&
+            avi::parseHeader(header, sizeof(header), f.info) &&
+            f.info.indexBytes == 0 && aviFile.size() == avi::fileBytes(f.info) &&
+            f.info.width == width && f.info.height == height;
+  aviFile.close();
+  if (ok) {
+    File index = SD.open(f.indexPath, FILE_READ);
+    ok = index && index.size() == (size_t)f.info.frames * AVI_INDEX_ENTRY_BYTES;
+    index.close();
+  }
+  return ok;
+}
+
+// Open today's file for appending: resume it, or create the first free part
+bool timelapseOpen(TimelapseFile& f, const char* day, uint16_t width, uint16_t height) {
+  strlcpy(f.day, day, sizeof(f.day));
+  for (f.part = 0; f.part < 100; f.part++) {
+    timelapsePaths(f);
+    if (SD.exists(f.path)) {
+      if (timelapseResume(f, width, height)) {
+        LOG_I("⏱️  Timelapse: appending to %s (%lu frames)", f.path, (unsigned long)f.info.frames);
+        f.open = true;
+        return true;
+      }
+      continue;
+    }
+    memset(&f.info, 0, sizeof(f.info));
+    f.info.width = width;
+    f.info.height = height;
+    f.info.fps = TIMELAPSE_PLAYBACK_FPS;
+    uint8_t header[AVI_HEADER_BYTES];
+    avi::encodeHeader(header, f.info);
+    File aviFile = SD.open(f.path, FILE_WRITE);
+    bool ok = aviFile && aviFile.write(header, sizeof(header)) == sizeof(header);
+    aviFile.close();
+    SD.remove(f.indexPath);   // Stale sidecar from a deleted file
+    if (!ok) {
+      return false;
+    }
+    LOG_I("⏱️  Timelapse: new file %s", f.path);
+    f.open = true;
+    return true;
+  }
+  return false;
+}
+
+// Append the sidecar as idx1 and mark the header indexed
+bool timelapseFinish(TimelapseFile& f) {
+  f.open = false;
+  File index = SD.open(f.indexPath, FILE_READ);
+  File aviFile = SD.open(f.path, "r+");
+  if (!index || !aviFile) {
+    index.close();
+    aviFile.close();
+    return false;
+  }
+  uint32_t entries = index.size() / AVI_INDEX_ENTRY_BYTES;
+  uint8_t buf[512];
+  avi::encodeIndexHeader(buf, f.info, entries);
+  bool ok = aviFile.seek(AVI_HEADER_BYTES + f.info.moviBytes) && aviFile.write(buf, AVI_CHUNK_HEADER_BYTES) == AVI_CHUNK_HEADER_BYTES;
+  size_t remaining = (size_t)entries * AVI_INDEX_ENTRY_BYTES;
+  while (ok && remaining) {
+    size_t n = index.read(buf, remaining < sizeof(buf) ? remaining : sizeof(buf));
+    ok = n > 0 && aviFile.write(buf, n) == n;
+    remaining -= n;
+  }
+  if (ok) {
+    avi::encodeHeader(buf, f.info);
+    ok = aviFile.seek(0) && aviFile.write(buf, AVI_HEADER_BYTES) == AVI_HEADER_BYTES;
+  }
+  index.close();
+  aviFile.close();
+  if (ok) {
+    SD.remove(f.indexPath);
+    LOG_I("⏱️  Timelapse: finished %s (%lu frames)", f.path, (unsigned long)f.info.frames);
+  }
+  return ok;
+}
+
+// Finish files an earlier day left open (stopped or reset before midnight)
+void timelapseFinishStale(const char* today) {
+  File dir = SD.open("/video");
+  if (!dir || !dir.isDirectory()) {
+    return;
+  }
+  char stale[8][32];   // Longest timelapsePaths() name: timelapse_YYYYMMDD_255.idx
+  size_t count = 0;
+  for (File entry = dir.openNextFile(); entry && count < 8; entry = dir.openNextFile()) {
+    const char* name = entry.name();
+    size_t len = strlen(name);
+    if (strncmp(name, "timelapse_", 10) == 0 && len > 14 && len < sizeof(stale[0]) &&
+        strcmp(name + len - 4, ".idx") == 0 && strncmp(name + 10, today, strlen(today)) != 0) {
+      strlcpy(stale[count++], name, sizeof(stale[0]));
+    }
+    entry.close();
+  }
+  dir.close();
+
+  for (size_t i = 0; i < count; i++) {
+    TimelapseFile f = {};
+    snprintf(f.indexPath, sizeof(f.indexPath), "/video/%s", stale[i]);
+    strlcpy(f.path, f.indexPath, sizeof(f.path));
+    strcpy(f.path + strlen(f.path) - 4, ".avi");
+    File aviFile = SD.open(f.path, FILE_READ);
+    uint8_t header[AVI_HEADER_BYTES];
+    bool ok = aviFile && aviFile.read(header, sizeof(header)) == sizeof(header) &&
+              avi::parseHeader(header, sizeof(header), f.info) && f.info.indexBytes == 0 &&
+              aviFile.size() == avi::fileBytes(f.info);
+    aviFile.close();
+    if (!ok || !timelapseFinish(f)) {
+      LOG_W("⚠️  Timelapse: could not finish %s", f.path);
+    }
+  }
+}
+
+// Append one frame. Opens, rolls over and finishes files as needed.
+bool timelapseAppend(const hal::Frame& frame) {
+  char day[9] = "undated";
+  char ts[20];
+  if (systemClock.timestamp(ts, sizeof(ts))) {
+    strlcpy(day, ts, sizeof(day));
+  }
+  TimelapseFile& f = timelapseFile;
+  if (f.open && (strcmp(f.day, day) != 0 || f.info.width != frame.width || f.info.height != frame.height ||
+                 avi::fileBytes(f.info) + AVI_CHUNK_HEADER_BYTES + frame.len > TIMELAPSE_MAX_FILE_BYTES)) {
+    timelapseFinish(f);
+  }
+  if (!f.open && !timelapseOpen(f, day, frame.width, frame.height)) {
+    return false;
+  }
+
+  uint8_t chunk[AVI_CHUNK_HEADER_BYTES];
+  avi::encodeFrameHeader(chunk, frame.len);
+  avi::Info next = f.info;
+  uint32_t offset = avi::addFrame(next, frame.len);
+  uint8_t entry[AVI_INDEX_ENTRY_BYTES];
+  avi::encodeIndexEntry(entry, offset, frame.len);
+  uint8_t header[AVI_HEADER_BYTES];
+  avi::encodeHeader(header, next);
+
+  File aviFile = SD.open(f.path, "r+");
+  File index = SD.open(f.indexPath, FILE_APPEND);
+  static const uint8_t pad = 0;
+  bool ok = aviFile && index && aviFile.seek(avi::fileBytes(f.info)) &&
+            aviFile.write(chunk, sizeof(chunk)) == sizeof(chunk) &&
+            aviFile.write(frame.buf, frame.len) == frame.len &&
+            aviFile.write(&pad, avi::framePadding(frame.len)) == avi::framePadding(frame.len) &&
+            index.write(entry, sizeof(entry)) == sizeof(entry) &&
+            aviFile.seek(0) && aviFile.write(header, sizeof(header)) == sizeof(header);
+  aviFile.close();
+  index.close();
+  if (ok) {
+    f.info = next;
+  } else {
+    f.open = false;   // Re-validate (and likely start a new part) next time
+  }
+  return ok;
+}
+
+// Wake the sensor, let exposure settle, save one frame, back to standby
+void timelapseShot(bool powerSave) {
+  TRACE_SCOPE("timelapse.shot");
+  int64_t start = esp_timer_get_time();
+  pmlock::Hold hold(pmlock::CAPTURE);
+  cameraStandby(false);
+  applyCameraPowerLevel();
+
+  hal::Frame frame;
+  for (int i = 0; i < TIMELAPSE_WARMUP_FRAMES; i++) {
+    if (frameHub.grab(frame)) {
+      frameHub.release(frame);
+    }
+  }
+  if (frameHub.grab(frame)) {
+    bool saved = false;
+    if (sdLock(1000)) {
+      saved = timelapseAppend(frame);
+      sdUnlock();
+    }
+    frameHub.release(frame);
+    if (saved) {
+      metrics::timelapseFrames.inc();
+      metrics::timelapseShotTime.observe((uint32_t)(esp_timer_get_time() - start));
+    } else {
+      LOG_E_EVERY(60000, "❌ Timelapse: failed to save frame to %s", timelapseFile.path);
+    }
+  } else {
+    LOG_E_EVERY(60000, "❌ Timelapse: capture failed");
+  }
+
+  if (powerSave) {
+    cameraStandby(true);
+  }
+}
+
+// Handlers run one at a time on the async_tcp task
+const StringWriter& timelapseStatusJson() {
+  static FixedString<256> json;
+  json.clear();
+  JsonWriter w(json);
+  w.beginObject();
+  w.boolean("selected", timelapseMode);
+  w.boolean("running", currentState == STATE_TIMELAPSE);
+  w.num("interval", timelapseIntervalSec);
+  w.str("file", timelapseFile.open ? timelapseFile.path : "");
+  w.num("fileFrames", timelapseFile.open ? timelapseFile.info.frames : 0);
+  w.num("frames", metrics::timelapseFrames.value());
+  w.endObject();
+  return json;
+}
+
+// One frame every timelapseIntervalSec (run by recorderTask())
+void runTimelapseSession(cmdbus::Command& start) {
+  if (usbMscEnabled) {
+    LOG_E("❌ Cannot start timelapse - USB Mass Storage is active");
+    cmdbus::complete(start, bleproto::RESULT_BUSY);
+    return;
+  }
+
+  // With Wi-Fi up the sensor stays awake for /stream and the CPU for the
+  // web server; the power saving applies in BLE mode
+  bool powerSave = WiFi.status() != WL_CONNECTED;
+  LOG_I("⏱️  Timelapse started: one frame every %lu s%s", (unsigned long)timelapseIntervalSec,
+        powerSave ? ", sensor standby between shots" : "");
+
+  char today[9] = "undated";
+  char ts[20];
+  if (systemClock.timestamp(ts, sizeof(ts))) {
+    strlcpy(today, ts, sizeof(today));
+  }
+  if (sdLock(5000)) {
+    timelapseFinishStale(today);
+    sdUnlock();
+  }
+
+  currentState = STATE_TIMELAPSE;
+  cmdbus::complete(start, bleproto::RESULT_OK);
+
+  unsigned long nextShot = millis();
+  unsigned long lastBatteryCheck = 0;
+  while (recordingSessionActive()) {
+    unsigned long now = millis();
+    if (now - lastBatteryCheck > 60000) {
+      checkBatteryStatus();
+      lastBatteryCheck = now;
+      if (batteryLow) {
+        LOG_W("Battery low - stopping timelapse");
+        break;
+      }
+    }
+    if (now - lastCleanupTime > CLEANUP_INTERVAL) {
+      cleanupOldFiles();
+      lastCleanupTime = now;
+    }
+
+    long wait = (long)(nextShot - now);
+    if (wait > 0) {
+      // STOP wakes us at once; the cap lets interval changes take effect
+      recorderBus.wait(wait < 500 ? wait : 500);
+      continue;
+    }
+    timelapseShot(powerSave);
+    lastActivityTime = now;
+    nextShot += timelapseIntervalSec * 1000UL;
+    if ((long)(nextShot - millis()) < 0) {
+      nextShot = millis() + timelapseIntervalSec * 1000UL;   // Fell behind (slow card); don't burst
+    }
+  }
+
+  cameraStandby(false);
+  timelapseFile.open = false;   // Left appendable; the next start resumes it
+  LOG_I("⏱️  Timelapse stopped (%lu frames in %s)", (unsigned long)timelapseFile.info.frames, timelapseFile.path);
+}
+
+// ============================================
+// RECORDER TASK
+// ============================================
+// Created once at boot and blocked on recorderBus between sessions. START
+// runs a recording or timelapse session (by the mode at that moment) and
+// completes once the session is up; STOP completes once it has ended.
+// Commands run in order, so a STOP/START burst ends one session before the
+// next begins and two sessions can never overlap.
+void recorderTask(void *parameter) {
+  cmdbus::Command cmd;
+  for (;;) {
+    if (!recorderBus.receive(cmd, CMDBUS_FOREVER)) {
+      continue;
+    }
+    if (cmd.type != cmdbus::CMD_START) {
+      cmdbus::complete(cmd, bleproto::RESULT_OK);   // STOP: the session is over
+      continue;
+    }
+    bleRecordingActive = true;
+    recordingMode = true;
+    if (timelapseMode) {
+      runTimelapseSession(cmd);
+    } else {
+      runRecordingSession(cmd);
+    }
+    recordingMode = false;
+    if (!recorderBus.pending()) {
+      bleRecordingActive = false;   // Ended by itself (USB, battery), not by a command
+    }
+    currentState = STATE_INIT;
+  }
+}
+
+// // ============================================
+// // DISPLAY FUNCTIONS (DISABLED - defective display)
+// // ============================================
+// bool initDisplay() {
+//   Wire.begin(SDA_PIN, SCL_PIN);
+//   if(!display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS)) {
+//     Serial.println("SSD1306 allocation failed");
+//     return false;
+//   }
+//   display.clearDisplay();
+//   display.setTextSize(1);
+//   display.setTextColor(SSD1306_WHITE);
+//   display.setCursor(0, 0);
+//   display.println("ESP32-CAM");
+//   display.println("Booting...");
+//   display.display();
+//   Serial.println("Display initialized successfully");
+//   return true;
+// }
+// 
+// void updateDisplay(const char* line1, const char* line2 = "", const char* line3 = "", const char* line4 = "") {
+//   display.clearDisplay();
+//   display.setTextSize(1);
+//   display.setTextColor(SSD1306_WHITE);
+//   display.setCursor(0, 0);
+//   display.println(line1);
+//   if (strlen(line2) > 0) {
+//     display.setCursor(0, 16);
+//     display.println(line2);
+//   }
+//   if (strlen(line3) > 0) {
+//     display.setCursor(0, 32);
+//     display.println(line3);
+//   }
+//   if (strlen(line4) > 0) {
+//     display.setCursor(0, 48);
+//     display.println(line4);
+//   }
+//   display.display();
+// }
+// 
+// void displayWiFiInfo(const char* ssid, IPAddress ip) {
+//   char ipStr[16];
+//   sprintf(ipStr, "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
+//   updateDisplay("WiFi Connected", ssid, ipStr, "Ready to stream!");
+// }
+
+// Connected WebSocket client ids, their output rates (index into
+// kStreamRates) and whether they take the frame header. audioTask sends to
+// these clients only; the queue depth for /metrics is sampled from them too.
+#define WS_MAX_TRACKED_CLIENTS 8
+volatile uint32_t wsClientIds[WS_MAX_TRACKED_CLIENTS] = {0};
+volatile uint8_t wsClientRates[WS_MAX_TRACKED_CLIENTS] = {0};
+volatile bool wsClientHeaders[WS_MAX_TRACKED_CLIENTS] = {false};
+// AsyncWebSocket frees a client on async_tcp right after WS_EVT_DISCONNECT.
+// audioTask holds this while it touches client objects, and onWsEvent takes
+// it to untrack a client, so one can't be freed under a send.
+SemaphoreHandle_t wsClientsMutex = NULL;
+
+// WebSocket event handler
+void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, 
+               AwsEventType type, void *arg, uint8_t *data, size_t len) {
+  if (type == WS_EVT_CONNECT) {
+    // On connect 'arg' is the upgrade request: ws://<IP>/audio?rate=8000&seq=1
+    AsyncWebServerRequest *request = (AsyncWebServerRequest *)arg;
+    bool header = request && request->hasParam("seq") && request->getParam("seq")->value() == "1";
+    uint32_t hz = WS_AUDIO_RATE;
+    if (request && request->hasParam("rate")) {
+      hz = (uint32_t)request->getParam("rate")->value().toInt();
+    }
+    int rate = streamRateIndex(hz);
+    if (rate < 0) {
+      Serial.printf("WebSocket client #%u asked for %u Hz, not offered\n", client->id(), (unsigned)hz);
+      client->close(1003, "rate must be 16000, 12000 or 8000");
+      return;
+    }
+    for (int i = 0; i < WS_MAX_TRACKED_CLIENTS; i++) {
+      if (wsClientIds[i] == 0) {
+        wsClientRates[i] = (uint8_t)rate;
+        wsClientHeaders[i] = header;
+        wsClientIds[i] = client->id();
+        Serial.printf("WebSocket client #%u connected (%u Hz%s)\n", client->id(), (unsigned)hz,
+                      header ? ", framed" : "");
+        return;
+      }
+    }
+    Serial.printf("WebSocket client #%u rejected, %d clients already\n", client->id(), WS_MAX_TRACKED_CLIENTS);
+    client->close(1013, "too many audio clients");
+  } else if (type == WS_EVT_DISCONNECT) {
+    Serial.printf("WebSocket client #%u disconnected\n", client->id());
+    xSemaphoreTake(wsClientsMutex, portMAX_DELAY);
+    for (int i = 0; i < WS_MAX_TRACKED_CLIENTS; i++) {
+      if (wsClientIds[i] == client->id()) {
+        wsClientIds[i] = 0;
+      }
+    }
+    xSemaphoreGive(wsClientsMutex);
+  }
+}
+
+// Audio streaming task: one WebSocket message per ring block (256 samples
+// at 16 kHz, 192 at 12 kHz, 128 at 8 kHz), with AUDIO_FRAME_HEADER_SIZE
+// bytes of sequence and capture time in front for ?seq=1 clients
+audioring::Reader wsAudioReader("websocket");
+alignas(4) uint8_t streamFrame[AUDIO_FRAME_HEADER_SIZE + (AUDIORING_BLOCK_SAMPLES + 1) * sizeof(int16_t)];
+int16_t *const streamPcm = (int16_t *)(streamFrame + AUDIO_FRAME_HEADER_SIZE);
+
+void audioTask(void *parameter) {
+  bool micOn = false;
+  resample::Resampler resamplers[STREAM_RATES];   // Passthrough at SAMPLE_RATE
+  bool rateInUse[STREAM_RATES] = {false};
+  for (size_t k = 0; k < STREAM_RATES; k++) {
+    resamplers[k].begin(SAMPLE_RATE, kStreamRates[k]);
+  }
+  
+  while (true) {
+    // No listeners: leave the microphone off and sleep instead of polling
+    // it, so the CPU can drop to the DFS floor
+    metrics::wsClients.set((int32_t)ws.count());
+    if (ws.count() == 0) {
+      if (micOn) {
+        audioRing.detach(wsAudioReader);
+        micRelease();
+        micOn = false;
+      }
+      vTaskDelay(pdMS_TO_TICKS(200));
+      continue;
+    }
+    if (!micOn) {
+      micAcquire();
+      audioRing.attach(wsAudioReader);
+      micOn = true;
+    }
+    
+    const audioring::Block* block = wsAudioReader.peek();
+    if (!block) {
+      audioWaitBlock(AUDIO_READ_TIMEOUT_MS);
+      continue;
+    }
+    
+    memstats::AllocWindow window(memstats::HOT_AUDIO);
+    
+    // Each rate with listeners is resampled once per block; at SAMPLE_RATE
+    // the ring slot is sent as is. AsyncWebSocket copies the data into a
+    // message per client before binary() returns.
+    TRACE_BEGIN("audioTask.send");
+    size_t deepest = 0;
+    xSemaphoreTake(wsClientsMutex, portMAX_DELAY);
+    {
+      pmlock::Hold hold(pmlock::WIFI_TX);
+      memstats::DriverScope driver;
+      for (size_t k = 0; k < STREAM_RATES; k++) {
+        uint8_t clients = 0;
+        for (int i = 0; i < WS_MAX_TRACKED_CLIENTS; i++) {
+          clients += wsClientIds[i] && wsClientRates[i] == k;
+        }
+        wsRateClients[k] = clients;
+        if (!clients) {
+          rateInUse[k] = false;
+          continue;
+        }
+        if (!rateInUse[k]) {
+          resamplers[k].reset();   // No stale history from an earlier listener
+          rateInUse[k] = true;
+        }
+        
+        const int16_t *pcm = block->pcm;
+        size_t samples = block->samples;
+        if (resamplers[k].filter()) {
+          int64_t startUs = esp_timer_get_time();
+          samples = resamplers[k].process(block->pcm, block->samples, streamPcm,
+                                          AUDIORING_BLOCK_SAMPLES + 1);
+          streamResampleUs += esp_timer_get_time() - startUs;
+          streamResampleBlocks++;
+          pcm = streamPcm;
+        }
+        bool framed = false;
+        for (int i = 0; i < WS_MAX_TRACKED_CLIENTS; i++) {
+          uint32_t id = wsClientIds[i];
+          if (!id || wsClientRates[i] != k) {
+            continue;
+          }
+          if (!wsClientHeaders[i]) {
+            ws.binary(id, (const uint8_t*)pcm, samples * sizeof(int16_t));
+            continue;
+          }
+          if (!framed) {
+            if (pcm != streamPcm) {
+              memcpy(streamPcm, pcm, samples * sizeof(int16_t));
+            }
+            generate_audio_frame_header(streamFrame, block->seq, kStreamRates[k], unixTimeUs(block->timestampUs));
+            framed = true;
+          }
+          ws.binary(id, streamFrame, AUDIO_FRAME_HEADER_SIZE + samples * sizeof(int16_t));
+        }
+      }
+    }
+    for (int i = 0; i < WS_MAX_TRACKED_CLIENTS; i++) {
+      AsyncWebSocketClient *client = wsClientIds[i] ? ws.client(wsClientIds[i]) : nullptr;
+      if (client && client->queueLen() > deepest) {
+        deepest = client->queueLen();
+      }
+    }
+    xSemaphoreGive(wsClientsMutex);
+    TRACE_END("audioTask.send");
+    wsAudioReader.release();
+    metrics::wsQueueDepth.set((int32_t)deepest);
+  }
+}
+
+// Latest level summary as /levels JSON; false before the first one
+bool levelsJson(char* out, size_t cap, size_t& len) {
+  spectrum::Summary summary;
+  portENTER_CRITICAL(&levelsMux);
+  bool have = haveLevels;
+  summary = lastLevels;
+  portEXIT_CRITICAL(&levelsMux);
+  len = have ? spectrum::formatJson(out, cap, summary) : 0;
+  return len > 0;
+}
+
+// New /levels clients get the latest summary straight away
+void onLevelsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
+                   AwsEventType type, void *arg, uint8_t *data, size_t len) {
+  if (type == WS_EVT_CONNECT) {
+    char json[384];
+    size_t jsonLen;
+    if (levelsJson(json, sizeof(json), jsonLen)) {
+      client->text(json, jsonLen);
+    }
+  }
+}
+
+// Level and spectrum summaries, about one a second. Holds the microphone
+// while /levels has listeners (always with LEVELS_ALWAYS_ON); otherwise it
+// only analyzes while something else has the microphone on.
+void levelsTask(void *parameter) {
+  bool micOn = false;
+  char json[384];
+  
+  for (;;) {
+    bool wanted = LEVELS_ALWAYS_ON || levelsWs.count() > 0;
+    if (wanted != micOn) {
+      if (wanted) {
+        micAcquire();
+      } else {
+        micRelease();
+      }
+      micOn = wanted;
+    }
+    if (micUsers == 0) {
+      if (levelsReader.attached()) {
+        audioRing.detach(levelsReader);
+      }
+      vTaskDelay(pdMS_TO_TICKS(200));
+      continue;
+    }
+    if (!levelsReader.attached()) {
+      levelAnalyzer.reset();
+      audioRing.attach(levelsReader);
+    }
+    
+    const audioring::Block* block = levelsReader.peek();
+    if (!block) {
+      audioWaitBlock(AUDIO_READ_TIMEOUT_MS);
+      continue;
+    }
+    bool done = levelAnalyzer.process(block->pcm, block->samples, block->timestampUs);
+    if (!levelsReader.release()) {
+      levelAnalyzer.reset();   // Block was overwritten mid-read; start the period again
+      continue;
+    }
+    if (!done) {
+      continue;
+    }
+    
+    const spectrum::Summary& s = levelAnalyzer.summary();
+    metrics::audioRmsDbfs.set((int32_t)lroundf(s.rmsDbfs * 10));
+    metrics::audioPeakDbfs.set((int32_t)lroundf(s.peakDbfs * 10));
+    metrics::audioDominantHz.set(s.toneCount ? (int32_t)lroundf(s.tones[0].hz) : 0);
+    for (int b = 0; b < SPECTRUM_BANDS; b++) {
+      metrics::audioBandDbfs.set(b, (int32_t)lroundf(s.bandDbfs[b] * 10));
+    }
+    portENTER_CRITICAL(&levelsMux);
+    lastLevels = s;
+    haveLevels = true;
+    portEXIT_CRITICAL(&levelsMux);
+    
+    size_t len;
+    if (levelsWs.count() > 0 && levelsJson(json, sizeof(json), len)) {
+      pmlock::Hold hold(pmlock::WIFI_TX);
+      levelsWs.textAll(json, len);
+    }
+  }
+}
+
+// MJPEG streaming handler - each client gets its own streamer, which copies
+// each frame out of the camera buffer and sends the copy across as many
+// chunks as the TCP window needs
+void handleStream(AsyncWebServerRequest *request) {
+  // Counted before waking the sensor so loop() can't put it back to sleep
+  streamClients++;
+  cameraStandby(false);
+  std::shared_ptr<pipeline::MjpegStreamer> streamer(new pipeline::MjpegStreamer(frameHub, systemClock),
+                                                    [](pipeline::MjpegStreamer* p) {
+                                                      delete p;
+                                                      streamClients--;
+                                                      lastCameraUse = millis();
+                                                    });
+  AsyncWebServerResponse *response = request->beginChunkedResponse(
+    "multipart/x-mixed-replace; boundary=frame",
+    [streamer](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+      pmlock::Hold hold(pmlock::WIFI_TX);
+      memstats::AllocWindow window(memstats::HOT_STREAM);
+      size_t len = streamer->fill(buffer, maxLen);
+      if (len == 0) {
+        Serial.println("Camera capture failed");
+      }
+      return len;
+    }
+  );
+  
+  request->send(response);
+}
+
+// ============================================
+// RTSP server (rtsp.h)
+// ============================================
+// rtsp://<IP>/live for VLC, ffplay and NVRs: the camera's JPEGs as RTP/JPEG
+// (RFC 2435, no re-encoding) and the microphone as L16 or PCMU, with RTCP
+// sender reports for A/V sync. Clients pick interleaved TCP or UDP in
+// SETUP and the audio codec with ?audio=l16|pcmu|none. rtspTask() owns
+// the sockets and sessions; it takes frames from the hub (frameHub) with
+// /stream, /live and the recorder and follows the audio ring with its own
+// reader.
+#define RTSP_PORT 554
+#define RTSP_RTP_PORT 6970              // Server UDP ports: RTP, RTCP = +1
+#define RTSP_MAX_CLIENTS 2
+#define RTSP_MAX_FPS 15
+#define RTSP_AUDIO rtsp::AUDIO_L16      // For clients that do not ask
+#define RTSP_IDLE_TIMEOUT_MS (2 * RTSP_SESSION_TIMEOUT_S * 1000)   // No request or RTCP for this long
+
+WiFiServer rtspServer(RTSP_PORT);
+WiFiUDP rtspRtp;
+WiFiUDP rtspRtcp;
+
+class WiFiLink : public rtsp::Link {
+ public:
+  WiFiClient client;
+  IPAddress peer;
+  
+  bool sendTcp(const uint8_t* data, size_t len) override {
+    return client.write(data, len) == len;
+  }
+  
+  bool sendUdp(uint16_t port, bool rtcp, const uint8_t* data, size_t len) override {
+    WiFiUDP& udp = rtcp ? rtspRtcp : rtspRtp;
+    return udp.beginPacket(peer, port) && udp.write(data, len) == len && udp.endPacket();
+  }
+};
+
+struct RtspClient {
+  bool active;
+  WiFiLink link;
+  rtsp::Session session;
+  unsigned long lastHeardMs;
+};
+RtspClient rtspClients[RTSP_MAX_CLIENTS];
+audioring::Reader rtspAudioReader("rtsp");
+const rtsp::Config rtspConfig = {"esp32-cam-streamer", RTSP_AUDIO, SAMPLE_RATE, RTSP_RTP_PORT};
+// One JPEG, grown in PSRAM to the largest frame seen
+uint8_t *rtspFrameCopy = NULL;
+size_t rtspFrameCap = 0;
+
+// Copy the JPEG into rtspFrameCopy; false if it can't grow
+bool rtspCopyFrame(const hal::Frame& frame) {
+  if (frame.len > rtspFrameCap) {
+    size_t cap = (frame.len + 16383) & ~(size_t)16383;
+    if (rtspFrameCopy) {
+      memstats::release(memstats::TAG_RTSP, rtspFrameCopy);
+    }
+    rtspFrameCopy = (uint8_t *)memstats::alloc(memstats::TAG_RTSP, cap, MALLOC_CAP_SPIRAM);
+    rtspFrameCap = rtspFrameCopy ? cap : 0;
+    if (!rtspFrameCopy) {
+      return false;
+    }
+  }
+  memcpy(rtspFrameCopy, frame.buf, frame.len);
+  return true;
+}
+
+void rtspClose(RtspClient& c, const char* why) {
+  LOG_I("RTSP client %s %s (%u frames, %u skipped)", c.link.peer.toString().c_str(), why,
+        (unsigned)c.session.framesSent(), (unsigned)c.session.framesSkipped());
+  c.link.client.stop();
+  c.active = false;
+}
+
+void rtspTask(void *parameter) {
+  bool micOn = false;
+  bool cameraOn = false;
+  int64_t nextFrameUs = 0;
+  resample::Resampler toPcmu;   // PCMU is 8 kHz
+  toPcmu.begin(SAMPLE_RATE, 8000);
+  int16_t pcmu[AUDIORING_BLOCK_SAMPLES + 1];
+  uint8_t buf[512];
+  
+  for (;;) {
+    const int64_t nowUs = esp_timer_get_time();
+    
+    WiFiClient incoming = rtspServer.accept();
+    if (incoming) {
+      RtspClient* slot = nullptr;
+      for (int i = 0; i < RTSP_MAX_CLIENTS && !slot; i++) {
+        slot = rtspClients[i].active ? nullptr : &rtspClients[i];
+      }
+      if (!slot) {
+        LOG_W("RTSP client %s rejected, %d clients already", incoming.remoteIP().toString().c_str(),
+              RTSP_MAX_CLIENTS);
+        incoming.stop();
+      } else {
+        incoming.setNoDelay(true);
+        slot->link.client = incoming;
+        slot->link.peer = incoming.remoteIP();
+        slot->session.begin(rtspConfig, esp_random());
+        slot->lastHeardMs = millis();
+        slot->active = true;
+        LOG_I("RTSP client %s connected", slot->link.peer.toString().c_str());
+      }
+    }
+    
+    // Requests (and interleaved RTCP from the client)
+    bool wantVideo = false, wantL16 = false, wantPcmu = false;
+    uint8_t clients = 0;
+    for (int i = 0; i < RTSP_MAX_CLIENTS; i++) {
+      RtspClient& c = rtspClients[i];
+      if (!c.active) {
+        continue;
+      }
+      int n;
+      while (c.active && (n = c.link.client.read(buf, sizeof(buf))) > 0) {
+        c.lastHeardMs = millis();
+        if (!c.session.receive(buf, n, nowUs, c.link)) {
+          rtspClose(c, "closed the session");
+        }
+      }
+      if (c.active && !c.link.client.connected()) {
+        rtspClose(c, "disconnected");
+      } else if (c.active && millis() - c.lastHeardMs > RTSP_IDLE_TIMEOUT_MS) {
+        rtspClose(c, "timed out");
+      }
+      if (!c.active) {
+        continue;
+      }
+      clients++;
+      wantVideo |= c.session.playing(rtsp::VIDEO);
+      wantL16 |= c.session.playing(rtsp::AUDIO) && c.session.audioCodec() == rtsp::AUDIO_L16;
+      wantPcmu |= c.session.playing(rtsp::AUDIO) && c.session.audioCodec() == rtsp::AUDIO_PCMU;
+    }
+    metrics::rtspClients.set(clients);
+    
+    // The sensor stays awake while anyone plays video; counted like a /stream
+    if (wantVideo && !cameraOn) {
+      streamClients++;
+      cameraStandby(false);
+      cameraOn = true;
+      nextFrameUs = nowUs;
+    } else if (!wantVideo && cameraOn) {
+      streamClients--;
+      lastCameraUse = millis();
+      cameraOn = false;
+    }
+    if ((wantL16 || wantPcmu) && !micOn) {
+      micAcquire();
+      audioRing.attach(rtspAudioReader);
+      toPcmu.reset();
+      micOn = true;
+    } else if (!(wantL16 || wantPcmu) && micOn) {
+      audioRing.detach(rtspAudioReader);
+      micRelease();
+      micOn = false;
+    }
+    if (!clients) {
+      vTaskDelay(pdMS_TO_TICKS(50));
+      continue;
+    }
+    
+    {
+      pmlock::Hold hold(pmlock::WIFI_TX);
+      
+      // One capture per frame interval, packetized for every viewer. The
+      // sends block on slow clients, so they work from a copy and the
+      // frame goes straight back to the hub.
+      hal::Frame frame;
+      if (wantVideo && nowUs >= nextFrameUs && frameHub.grab(frame)) {
+        nextFrameUs = nowUs + 1000000 / RTSP_MAX_FPS;
+        lastCameraUse = millis();
+        const size_t len = frame.len;
+        const int64_t timestampUs = frame.timestampUs;
+        bool copied = rtspCopyFrame(frame);
+        frameHub.release(frame);
+        if (!copied) {
+          LOG_W_EVERY(10000, "⚠️  RTSP frame dropped: no PSRAM for a %u byte copy", (unsigned)len);
+        }
+        for (int i = 0; copied && i < RTSP_MAX_CLIENTS; i++) {
+          RtspClient& c = rtspClients[i];
+          if (!c.active || !c.session.playing(rtsp::VIDEO)) {
+            continue;
+          }
+          uint32_t skipped = c.session.framesSkipped();
+          if (!c.session.sendFrame(rtspFrameCopy, len, timestampUs, c.link)) {
+            rtspClose(c, "stopped reading");
+          } else if (c.session.framesSkipped() != skipped) {
+            metrics::rtspFramesSkipped.inc();
+            LOG_W_EVERY(10000, "⚠️  RTSP frame skipped: %s", c.session.lastError());
+          } else {
+            metrics::rtspFrames.inc();
+          }
+        }
+      }
+      
+      // Every block the ring has, so a slow frame send loses no audio
+      const audioring::Block* block;
+      while (micOn && (block = rtspAudioReader.peek()) != nullptr) {
+        size_t pcmuSamples = wantPcmu ? toPcmu.process(block->pcm, block->samples, pcmu, AUDIORING_BLOCK_SAMPLES + 1) : 0;
+        for (int i = 0; i < RTSP_MAX_CLIENTS; i++) {
+          RtspClient& c = rtspClients[i];
+          if (!c.active || !c.session.playing(rtsp::AUDIO)) {
+            continue;
+          }
+          bool ok = c.session.audioCodec() == rtsp::AUDIO_PCMU
+                        ? c.session.sendAudio(pcmu, pcmuSamples, block->timestampUs, c.link)
+                        : c.session.sendAudio(block->pcm, block->samples, block->timestampUs, c.link);
+          if (!ok) {
+            rtspClose(c, "stopped reading");
+          }
+        }
+        rtspAudioReader.release();
+      }
+      
+      for (int i = 0; i < RTSP_MAX_CLIENTS; i++) {
+        RtspClient& c = rtspClients[i];
+        if (c.active && !c.session.sendReports(nowUs, unixTimeUs(nowUs), c.link)) {
+          rtspClose(c, "stopped reading");
+        }
+      }
+    }
+    
+    if (micOn) {
+      audioWaitBlock(10);
+    } else {
+      vTaskDelay(pdMS_TO_TICKS(5));
+    }
+  }
+}
+
+// ============================================
+// /live: video, audio and control on one WebSocket (live.h)
+// ============================================
+// ws://<IP>/live?video=1&audio=1&rate=16000 carries camera frames, audio
+// blocks and control messages on a single connection, all stamped with
+// esp_timer capture times so the page can sync them. Video is sent against
+// the viewer's acks and only into a near-empty send queue, so a slow
+// viewer sees a lower frame rate rather than growing latency. liveTask()
+// shares captures with /stream, RTSP and the recorder through frameHub and
+// follows the audio ring with its own reader.
+#define LIVE_MAX_CLIENTS 4
+#define LIVE_MAX_FPS 15
+
+AsyncWebSocket liveWs("/live");
+
+struct LiveViewer {
+  volatile uint32_t id;     // 0 = free
+  volatile uint8_t rate;    // Index into kStreamRates
+  live::Flow flow;
+};
+LiveViewer liveViewers[LIVE_MAX_CLIENTS];
+// Slots are claimed, freed and acked on async_tcp while liveTask sends from
+// core 1, and AsyncWebSocket frees a client right after WS_EVT_DISCONNECT.
+// liveTask holds this while it uses viewers and their clients; onLiveEvent
+// takes it to change a slot, so neither a reused slot's counters nor a
+// client can change under a send.
+SemaphoreHandle_t liveMutex = NULL;
+audioring::Reader liveAudioReader("live");
+alignas(4) uint8_t liveAudioFrame[LIVE_HEADER_SIZE + (AUDIORING_BLOCK_SAMPLES + 1) * sizeof(int16_t)];
+int16_t *const liveAudioPcm = (int16_t *)(liveAudioFrame + LIVE_HEADER_SIZE);
+// Header + JPEG for one frame, grown in PSRAM to the largest frame seen
+uint8_t *liveVideoMessage = NULL;
+size_t liveVideoCap = 0;
+
+LiveViewer* liveViewer(uint32_t id) {
+  for (int i = 0; i < LIVE_MAX_CLIENTS; i++) {
+    if (liveViewers[i].id == id) {
+      return &liveViewers[i];
+    }
+  }
+  return nullptr;
+}
+
+// Connect/disconnect keep liveViewers; text messages are the page's acks,
+// pings and config changes (live.h)
+void onLiveEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
+                 AwsEventType type, void *arg, uint8_t *data, size_t len) {
+  if (type == WS_EVT_CONNECT) {
+    AsyncWebServerRequest *request = (AsyncWebServerRequest *)arg;
+    bool video = !(request && request->hasParam("video") && request->getParam("video")->value() == "0");
+    bool audio = !(request && request->hasParam("audio") && request->getParam("audio")->value() == "0");
+    uint32_t hz = WS_AUDIO_RATE;
+    if (request && request->hasParam("rate")) {
+      hz = (uint32_t)request->getParam("rate")->value().toInt();
+    }
+    int rate = streamRateIndex(hz);
+    if (rate < 0) {
+      client->close(1003, "rate must be 16000, 12000 or 8000");
+      return;
+    }
+    xSemaphoreTake(liveMutex, portMAX_DELAY);
+    LiveViewer* viewer = liveViewer(0);
+    if (viewer) {
+      viewer->flow.begin(video, audio);
+      viewer->rate = (uint8_t)rate;
+      viewer->id = client->id();
+    }
+    xSemaphoreGive(liveMutex);
+    if (!viewer) {
+      LOG_W("/live client #%u rejected, %d clients already", client->id(), LIVE_MAX_CLIENTS);
+      client->close(1013, "too many live clients");
+      return;
+    }
+    char hello[128];
+    size_t n = live::formatHello(hello, sizeof(hello), esp_timer_get_time(), LIVE_MAX_FPS, hz);
+    client->text(hello, n);
+    LOG_I("/live client #%u connected (video %s, audio %s at %u Hz)", client->id(), video ? "on" : "off",
+          audio ? "on" : "off", (unsigned)hz);
+  } else if (type == WS_EVT_DISCONNECT) {
+    xSemaphoreTake(liveMutex, portMAX_DELAY);
+    LiveViewer* viewer = liveViewer(client->id());
+    if (viewer) {
+      LOG_I("/live client #%u disconnected (%u frames, %u skipped)", client->id(),
+            (unsigned)viewer->flow.framesSent(), (unsigned)viewer->flow.framesSkipped());
+      viewer->id = 0;
     }
-    
-    File file = SD.open(filename, FILE_WRITE);
-    if (!file) {
-      Serial.println("Failed to open file for writing");
-      xSemaphoreGive(sdMutex);
-      free(rec_buffer);
+    xSemaphoreGive(liveMutex);
+  } else if (type == WS_EVT_DATA) {
+    AwsFrameInfo *info = (AwsFrameInfo *)arg;
+    LiveViewer* viewer = liveViewer(client->id());
+    live::Control control;
+    if (!viewer || !info->final || info->index != 0 || info->len != len || info->opcode != WS_TEXT ||
+        !live::parseControl((const char *)data, len, control)) {
       return;
     }
-    
-    // Write the header to the WAV file
-    uint8_t wav_header[WAV_HEADER_SIZE];
-    generate_wav_header(wav_header, record_size, SAMPLE_RATE);
-    file.write(wav_header, WAV_HEADER_SIZE);
-    
-    // Write data to the WAV file
-    Serial.printf("Writing to the file ...\n");
-    size_t written = file.write(rec_buffer, record_size);
-    file.close();
-    
-    // Release SD mutex
-    xSemaphoreGive(sdMutex);
-    
-    if (written != record_size) {
-      Serial.printf("Write file Failed! Wrote %d of %d bytes\n", written, record_size);
-    } else {
-      Serial.printf("Recording saved: %s\n", filename);
+    if (control.kind == live::Control::PING) {
+      char pong[96];
+      size_t n = live::formatPong(pong, sizeof(pong), control.t, esp_timer_get_time());
+      client->text(pong, n);
+      return;
     }
-  } else {
-    Serial.println("⚠️  Failed to acquire SD mutex for audio");
+    xSemaphoreTake(liveMutex, portMAX_DELAY);
+    if (control.kind == live::Control::ACK) {
+      viewer->flow.acked();
+    } else if (control.kind == live::Control::CONFIG) {
+      int rate = control.rate ? streamRateIndex(control.rate) : viewer->rate;
+      if (rate >= 0) {
+        viewer->rate = (uint8_t)rate;
+      }
+      viewer->flow.configure(control.video, control.audio);
+    }
+    xSemaphoreGive(liveMutex);
   }
-  
-  free(rec_buffer);
 }
 
-// Recording task for SD card mode with continuous recording
-void recordingTask(void *parameter) {
-  // Check if USB MSC is active
-  if (usbMscEnabled) {
-    Serial.println("❌ Cannot start recording - USB Mass Storage is active");
-    Serial.println("   Send DISABLE_USB command first");
-    recordingMode = false;
-    bleRecordingActive = false;
-    vTaskDelete(NULL);
-    return;
+// Copy header + JPEG into liveVideoMessage; false if it can't grow
+bool liveFrameMessage(const hal::Frame& frame, uint32_t seq) {
+  size_t need = LIVE_HEADER_SIZE + frame.len;
+  if (need > liveVideoCap) {
+    size_t cap = (need + 16383) & ~(size_t)16383;
+    if (liveVideoMessage) {
+      memstats::release(memstats::TAG_LIVE, liveVideoMessage);
+    }
+    liveVideoMessage = (uint8_t *)memstats::alloc(memstats::TAG_LIVE, cap, MALLOC_CAP_SPIRAM);
+    liveVideoCap = liveVideoMessage ? cap : 0;
+    if (!liveVideoMessage) {
+      return false;
+    }
   }
-  
-  Serial.println("Starting 10-second interval recording...");
-  Serial.println("========================================");
-  
-  // Display recording mode
-  if (audioOnlyMode) {
-    Serial.println("Mode: AUDIO ONLY - Recording audio files every 10 seconds");
-  } else if (videoOnlyMode) {
-    Serial.println("Mode: VIDEO ONLY - Recording 10-second video clips");
-  } else {
-    Serial.println("Mode: AUDIO + VIDEO - Recording 10-second clips of both");
+  live::writeHeader(liveVideoMessage, live::LIVE_VIDEO, 0, seq, frame.timestampUs);
+  memcpy(liveVideoMessage + LIVE_HEADER_SIZE, frame.buf, frame.len);
+  return true;
+}
+
+void liveTask(void *parameter) {
+  bool micOn = false;
+  bool cameraOn = false;
+  int64_t nextFrameUs = 0;
+  int64_t nextStatsUs = 0;
+  uint32_t frameSeq = 0;
+  resample::Resampler resamplers[STREAM_RATES];
+  bool rateInUse[STREAM_RATES] = {false};
+  for (size_t k = 0; k < STREAM_RATES; k++) {
+    resamplers[k].begin(SAMPLE_RATE, kStreamRates[k]);
   }
-  Serial.println("========================================\n");
-  
-  unsigned long lastAudioTime = 0;
-  unsigned long lastVideoTime = 0;
-  const unsigned long clipInterval = 10000; // Record clips every 10 seconds
-  
-  currentState = STATE_RECORDING;
   
-  while (recordingMode && !usbMscEnabled) {
-    unsigned long currentTime = millis();
-    
-    // Check battery status periodically
-    static unsigned long lastBatteryCheck = 0;
-    if (currentTime - lastBatteryCheck > 60000) {
-      checkBatteryStatus();
-      lastBatteryCheck = currentTime;
-      if (batteryLow) {
-        Serial.println("Battery low - stopping recording");
-        break;
+  for (;;) {
+    const int64_t nowUs = esp_timer_get_time();
+    bool wantVideo = false, wantAudio = false;
+    uint8_t clients = 0;
+    for (int i = 0; i < LIVE_MAX_CLIENTS; i++) {
+      if (liveViewers[i].id) {
+        clients++;
+        wantVideo |= liveViewers[i].flow.video();
+        wantAudio |= liveViewers[i].flow.audio();
       }
     }
+    metrics::liveClients.set(clients);
     
-    // Run cleanup periodically
-    if (currentTime - lastCleanupTime > CLEANUP_INTERVAL) {
-      cleanupOldFiles();
-      lastCleanupTime = currentTime;
+    // Camera and microphone as in rtspTask()
+    if (wantVideo && !cameraOn) {
+      streamClients++;
+      cameraStandby(false);
+      cameraOn = true;
+      nextFrameUs = nowUs;
+    } else if (!wantVideo && cameraOn) {
+      streamClients--;
+      lastCameraUse = millis();
+      cameraOn = false;
+    }
+    if (wantAudio && !micOn) {
+      micAcquire();
+      audioRing.attach(liveAudioReader);
+      micOn = true;
+    } else if (!wantAudio && micOn) {
+      audioRing.detach(liveAudioReader);
+      micRelease();
+      micOn = false;
+    }
+    if (!clients) {
+      vTaskDelay(pdMS_TO_TICKS(50));
+      continue;
     }
     
-    // VIDEO RECORDING (only if not audio-only mode) - 10-second clips
-    if (!audioOnlyMode && (currentTime - lastVideoTime >= clipInterval)) {
-      Serial.println("📹 Recording 10-second video clip...");
-      unsigned long clipStart = millis();
-      unsigned long clipFrameCount = 0;
+    xSemaphoreTake(liveMutex, portMAX_DELAY);
+    {
+      pmlock::Hold hold(pmlock::WIFI_TX);
       
-      // Capture frames for 10 seconds
-      while (millis() - clipStart < 10000 && recordingMode) {
-        camera_fb_t *fb = esp_camera_fb_get();
-        if (!fb) {
-          Serial.println("❌ Error getting framebuffer!");
-          vTaskDelay(pdMS_TO_TICKS(100)); // Wait a bit before retry
-        } else {
-          bool saved = saveFrameToSD(fb);
-          esp_camera_fb_return(fb);
-          
-          if (saved) {
-            clipFrameCount++;
+      // Audio first: blocks are small and late audio is heard, a late
+      // frame only shows as a lower frame rate
+      const audioring::Block* block;
+      while (micOn && (block = liveAudioReader.peek()) != nullptr) {
+        for (size_t k = 0; k < STREAM_RATES; k++) {
+          bool used = false;
+          for (int i = 0; i < LIVE_MAX_CLIENTS; i++) {
+            used |= liveViewers[i].id && liveViewers[i].rate == k && liveViewers[i].flow.audio();
+          }
+          if (!used) {
+            rateInUse[k] = false;
+            continue;
+          }
+          if (!rateInUse[k]) {
+            resamplers[k].reset();
+            rateInUse[k] = true;
+          }
+          size_t samples = block->samples;
+          if (resamplers[k].filter()) {
+            samples = resamplers[k].process(block->pcm, block->samples, liveAudioPcm, AUDIORING_BLOCK_SAMPLES + 1);
           } else {
-            Serial.println("⚠️  Frame save failed, continuing...");
+            memcpy(liveAudioPcm, block->pcm, samples * sizeof(int16_t));
+          }
+          live::writeHeader(liveAudioFrame, live::LIVE_AUDIO, (uint16_t)kStreamRates[k], block->seq, block->timestampUs);
+          for (int i = 0; i < LIVE_MAX_CLIENTS; i++) {
+            LiveViewer& v = liveViewers[i];
+            uint32_t id = v.id;
+            if (!id || v.rate != k || !v.flow.audio()) {
+              continue;
+            }
+            AsyncWebSocketClient *client = liveWs.client(id);
+            if (client && v.flow.audioReady(client->queueLen())) {
+              liveWs.binary(id, liveAudioFrame, LIVE_HEADER_SIZE + samples * sizeof(int16_t));
+              v.flow.audioSent();
+            } else {
+              v.flow.audioDropped();
+              metrics::liveAudioDropped.inc();
+            }
           }
         }
-        vTaskDelay(1); // Minimal delay for watchdog
+        liveAudioReader.release();
       }
       
-      Serial.printf("✓ Video clip complete: %lu frames captured\n", clipFrameCount);
-      lastActivityTime = currentTime;
-      lastVideoTime = currentTime;
+      // A frame only when some viewer has credit for it. The camera buffer
+      // goes back before sending; AsyncWebSocket copies per client.
+      bool ready = false;
+      for (int i = 0; i < LIVE_MAX_CLIENTS && !ready; i++) {
+        AsyncWebSocketClient *client = liveViewers[i].id ? liveWs.client(liveViewers[i].id) : nullptr;
+        ready = client && liveViewers[i].flow.videoReady(client->queueLen());
+      }
+      hal::Frame frame;
+      if (wantVideo && ready && nowUs >= nextFrameUs && frameHub.grab(frame)) {
+        nextFrameUs = nowUs + 1000000 / LIVE_MAX_FPS;
+        lastCameraUse = millis();
+        size_t len = LIVE_HEADER_SIZE + frame.len;
+        bool built = liveFrameMessage(frame, frameSeq++);
+        frameHub.release(frame);
+        if (!built) {
+          LOG_W_EVERY(10000, "⚠️  /live frame buffer allocation failed (%u bytes)", (unsigned)len);
+        }
+        for (int i = 0; built && i < LIVE_MAX_CLIENTS; i++) {
+          LiveViewer& v = liveViewers[i];
+          uint32_t id = v.id;
+          if (!id || !v.flow.video()) {
+            continue;
+          }
+          AsyncWebSocketClient *client = liveWs.client(id);
+          if (client && v.flow.videoReady(client->queueLen())) {
+            liveWs.binary(id, liveVideoMessage, len);
+            v.flow.videoSent();
+            metrics::liveFrames.inc();
+          } else {
+            v.flow.videoSkipped();
+            metrics::liveFramesSkipped.inc();
+          }
+        }
+      }
+      
+      if (nowUs >= nextStatsUs) {
+        nextStatsUs = nowUs + 1000000;
+        for (int i = 0; i < LIVE_MAX_CLIENTS; i++) {
+          uint32_t id = liveViewers[i].id;
+          AsyncWebSocketClient *client = id ? liveWs.client(id) : nullptr;
+          if (client) {
+            char stats[192];
+            size_t n = live::formatStats(stats, sizeof(stats), liveViewers[i].flow, client->queueLen());
+            liveWs.text(id, stats, n);
+          }
+        }
+      }
     }
+    xSemaphoreGive(liveMutex);
     
-    // AUDIO RECORDING (only if not video-only mode)
-    if (!videoOnlyMode && (currentTime - lastAudioTime >= clipInterval)) {
-      Serial.println("🎙️  Recording audio clip...");
-      record_wav();
-      lastActivityTime = currentTime;
-      lastAudioTime = currentTime;
+    if (micOn) {
+      audioWaitBlock(10);
+    } else {
+      vTaskDelay(pdMS_TO_TICKS(5));
     }
-    
-    // Sleep between clips
-    vTaskDelay(pdMS_TO_TICKS(100));
   }
-  
-  Serial.println("========================================");
-  Serial.println("Recording stopped");
-  Serial.printf("Total frames captured: %lu\n", frameCount);
-  Serial.printf("Total audio files: %lu\n", audioFileCount);
-  Serial.println("========================================");
-  currentState = STATE_INIT;
-  vTaskDelete(NULL);
 }
 
-// // ============================================
-// // DISPLAY FUNCTIONS (DISABLED - defective display)
-// // ============================================
-// bool initDisplay() {
-//   Wire.begin(SDA_PIN, SCL_PIN);
-//   if(!display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS)) {
-//     Serial.println("SSD1306 allocation failed");
-//     return false;
-//   }
-//   display.clearDisplay();
-//   display.setTextSize(1);
-//   display.setTextColor(SSD1306_WHITE);
-//   display.setCursor(0, 0);
-//   display.println("ESP32-CAM");
-//   display.println("Booting...");
-//   display.display();
-//   Serial.println("Display initialized successfully");
-//   return true;
-// }
-// 
-// void updateDisplay(const char* line1, const char* line2 = "", const char* line3 = "", const char* line4 = "") {
-//   display.clearDisplay();
-//   display.setTextSize(1);
-//   display.setTextColor(SSD1306_WHITE);
-//   display.setCursor(0, 0);
-//   display.println(line1);
-//   if (strlen(line2) > 0) {
-//     display.setCursor(0, 16);
-//     display.println(line2);
-//   }
-//   if (strlen(line3) > 0) {
-//     display.setCursor(0, 32);
-//     display.println(line3);
-//   }
-//   if (strlen(line4) > 0) {
-//     display.setCursor(0, 48);
-//     display.println(line4);
-//   }
-//   display.display();
-// }
-// 
-// void displayWiFiInfo(const char* ssid, IPAddress ip) {
-//   char ipStr[16];
-//   sprintf(ipStr, "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
-//   updateDisplay("WiFi Connected", ssid, ipStr, "Ready to stream!");
-// }
+// Web interface with video and audio
+// Jitter-buffered audio player for the page: loaded with <script> for the
+// ScriptProcessor fallback and as the AudioWorklet module
+const char* playerJs = R"rawliteral(
+// Jitter buffer for /audio?seq=1 frames. Runs in the AudioWorklet, or on
+// the main thread behind a ScriptProcessorNode where AudioWorklet is not
+// available (it needs a secure context; the device serves plain HTTP).
+class JitterBuffer {
+  constructor(rate) {
+    this.rate = rate;
+    this.ring = new Float32Array(rate * 4);
+    this.written = 0;          // Samples written, ever
+    this.readPos = 0;          // Fractional read position, same scale
+    this.nextSeq = -1;
+    this.anchor = null;        // {seq, ms, samples}: media clock origin
+    this.transits = [];        // Arrival minus media time, last few seconds
+    this.targetMs = 60;
+    this.jitterMs = 0;
+    this.level = 0;            // Smoothed buffered samples
+    this.ratio = 1;
+    this.playing = false;
+    this.underruns = 0;
+    this.lost = 0;
+    this.late = 0;
+    this.skips = 0;
+  }
 
-// WebSocket event handler
-void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, 
-               AwsEventType type, void *arg, uint8_t *data, size_t len) {
-  if (type == WS_EVT_CONNECT) {
-    Serial.printf("WebSocket client #%u connected\n", client->id());
-  } else if (type == WS_EVT_DISCONNECT) {
-    Serial.printf("WebSocket client #%u disconnected\n", client->id());
+  buffered() {
+    return this.written - this.readPos;
   }
-}
 
-// Audio streaming task
-void audioTask(void *parameter) {
-  const size_t bufferSize = 256; // 256 samples = 512 bytes
-  uint8_t audioBuffer[bufferSize * 2];
-  
-  while (true) {
-    // Read audio data from I2S/PDM microphone
-    size_t bytesRead = 0;
-    for (size_t i = 0; i < bufferSize && bytesRead < bufferSize * 2; i++) {
-      int sample = I2S.read();
-      if (sample != -1 && sample != 0 && sample != 1) {
-        audioBuffer[bytesRead++] = sample & 0xFF;
-        audioBuffer[bytesRead++] = (sample >> 8) & 0xFF;
+  // One frame: 'arrival' in ms on the page's clock, 'pcm' Float32Array
+  push(seq, arrival, pcm) {
+    const n = pcm.length;
+    if (this.nextSeq >= 0 && seq < this.nextSeq) {
+      this.late++;
+      return;
+    }
+    if (this.nextSeq >= 0 && seq > this.nextSeq) {
+      // Blocks dropped on the device: fill short gaps with silence so the
+      // timeline holds, start over after long ones
+      const missing = seq - this.nextSeq;
+      this.lost += missing;
+      if (missing * n <= this.rate / 4) {
+        this.write(new Float32Array(missing * n));
+      } else {
+        this.anchor = null;
+        this.transits = [];
       }
     }
-    
-    if (bytesRead > 0 && ws.count() > 0) {
-      // Send audio data to all connected WebSocket clients
-      ws.binaryAll(audioBuffer, bytesRead);
+    this.nextSeq = seq + 1;
+
+    // Jitter: spread of (arrival - media time) over the last 3 s
+    if (!this.anchor) {
+      this.anchor = {seq: seq, ms: arrival, samples: n};
+    }
+    const mediaMs = (seq - this.anchor.seq) * this.anchor.samples * 1000 / this.rate;
+    this.transits.push(arrival - this.anchor.ms - mediaMs);
+    if (this.transits.length > 3 * this.rate / n) {
+      this.transits.shift();
+    }
+    this.jitterMs = Math.max(...this.transits) - Math.min(...this.transits);
+
+    // Target: the spread plus two frames, between 40 and 500 ms. It grows
+    // at once and shrinks over a few seconds.
+    const frameMs = n * 1000 / this.rate;
+    const want = Math.min(500, Math.max(40, this.jitterMs + 2 * frameMs));
+    this.targetMs = want > this.targetMs ? want : this.targetMs + (want - this.targetMs) * 0.005;
+
+    this.write(pcm);
+
+    // Bound the latency: far above target (a burst after a stall), drop
+    // back to it in one step and measure the jitter afresh
+    const target = this.targetMs * this.rate / 1000;
+    if (this.buffered() > 2 * target + this.rate / 5) {
+      this.readPos = this.written - target;
+      this.level = target;
+      this.anchor = null;
+      this.transits = [];
+      this.skips++;
     }
-    
-    vTaskDelay(1); // Small delay to prevent watchdog
   }
-}
 
-// MJPEG streaming handler
-void handleStream(AsyncWebServerRequest *request) {
-  AsyncWebServerResponse *response = request->beginChunkedResponse(
-    "multipart/x-mixed-replace; boundary=frame",
-    [](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
-      camera_fb_t *fb = esp_camera_fb_get();
-      if (!fb) {
-        Serial.println("Camera capture failed");
-        return 0;
+  write(pcm) {
+    const len = this.ring.length;
+    for (let i = 0; i < pcm.length; i++) {
+      this.ring[(this.written + i) % len] = pcm[i];
+    }
+    this.written += pcm.length;
+    if (this.buffered() > len - 1) {
+      this.readPos = this.written - (len - 1);
+    }
+  }
+
+  // Fill 'out' (Float32Array) for playback
+  read(out) {
+    const target = this.targetMs * this.rate / 1000;
+    if (!this.playing) {
+      if (this.buffered() < target) {
+        out.fill(0);
+        return;
       }
-      
-      size_t len = 0;
-      if (index == 0) {
-        // Write boundary and headers
-        len = snprintf((char *)buffer, maxLen,
-          "--frame\r\n"
-          "Content-Type: image/jpeg\r\n"
-          "Content-Length: %u\r\n\r\n",
-          fb->len);
+      this.playing = true;
+      this.level = this.buffered();
+    }
+
+    // Drift: read up to 1% fast or slow, linearly interpolated, to hold the
+    // buffer at the target whatever the two clocks do
+    this.level += (this.buffered() - this.level) * 0.02;
+    const error = (this.level - target) / target;
+    this.ratio = 1 + Math.max(-0.01, Math.min(0.01, error * 0.02));
+
+    const len = this.ring.length;
+    for (let i = 0; i < out.length; i++) {
+      if (this.buffered() < 2) {
+        // Ran dry: rebuffer, and to a deeper target
+        out.fill(0, i);
+        this.playing = false;
+        this.underruns++;
+        this.targetMs = Math.min(500, this.targetMs + 20);
+        return;
       }
-      
-      // Copy JPEG data
-      size_t remaining = fb->len - (index - len);
-      if (remaining > 0) {
-        size_t copyLen = (remaining > maxLen) ? maxLen : remaining;
-        memcpy(buffer, fb->buf + (index - len), copyLen);
-        len = copyLen;
+      const at = Math.floor(this.readPos);
+      const frac = this.readPos - at;
+      const a = this.ring[at % len];
+      const b = this.ring[(at + 1) % len];
+      out[i] = a + (b - a) * frac;
+      this.readPos += this.ratio;
+    }
+  }
+
+  report() {
+    return {
+      bufferedMs: this.buffered() * 1000 / this.rate,
+      targetMs: this.targetMs,
+      jitterMs: this.jitterMs,
+      ratio: this.ratio,
+      underruns: this.underruns,
+      lost: this.lost,
+      late: this.late,
+      skips: this.skips
+    };
+  }
+}
+
+if (typeof AudioWorkletProcessor !== 'undefined') {
+  class JitterPlayer extends AudioWorkletProcessor {
+    constructor() {
+      super();
+      this.buffer = new JitterBuffer(sampleRate);
+      this.lastReport = 0;
+      this.port.onmessage = (e) => this.buffer.push(e.data.seq, e.data.arrival, e.data.pcm);
+    }
+
+    process(inputs, outputs) {
+      this.buffer.read(outputs[0][0]);
+      if (currentTime - this.lastReport >= 0.25) {
+        this.lastReport = currentTime;
+        this.port.postMessage(this.buffer.report());
       }
-      
-      esp_camera_fb_return(fb);
-      return len;
+      return true;
     }
-  );
-  
-  request->send(response);
+  }
+  registerProcessor('jitter-player', JitterPlayer);
 }
+)rawliteral";
 
-// Web interface with video and audio
 const char* html = R"rawliteral(
 <!DOCTYPE html>
 <html>
@@ -1511,7 +4615,7 @@ const char* html = R"rawliteral(
     h1 {
       margin-bottom: 20px;
     }
-    img {
+    canvas {
       max-width: 100%;
       height: auto;
       border: 2px solid #444;
@@ -1553,34 +4657,220 @@ const char* html = R"rawliteral(
       font-size: 14px;
       color: #aaa;
     }
+    .latency {
+      margin-top: 10px;
+      font-size: 13px;
+      font-family: monospace;
+      color: #aaa;
+    }
+    .clock {
+      display: none;
+      margin: 10px auto;
+      font-size: 48px;
+      font-family: monospace;
+      background-color: white;
+      color: black;
+      width: fit-content;
+      padding: 0 12px;
+    }
   </style>
 </head>
 <body>
   <h1>📹 ESP32-CAM Video & Audio Stream</h1>
-  <img src="/stream" alt="Video Stream">
+  <canvas id="video" width="800" height="600"></canvas>
+  <div class="clock" id="clock"></div>
   
   <div class="controls">
     <button id="audioBtn" onclick="toggleAudio()">🔊 Enable Audio</button>
+    <select id="audioRate" title="Stream sample rate">
+      <option value="16000">16 kHz</option>
+      <option value="12000">12 kHz</option>
+      <option value="8000">8 kHz (voice)</option>
+    </select>
+    <button id="clockBtn" onclick="toggleClock()" title="Point the camera at this clock to measure glass-to-glass latency">⏱ Clock</button>
+    <span>Live: <span class="status" id="liveStatus"></span></span>
     <span>Audio: <span class="status" id="audioStatus"></span></span>
+    <div class="latency" id="videoLatency"></div>
+    <div class="latency" id="audioLatency"></div>
   </div>
   
   <div class="info">
-    <p>XIAO ESP32S3 Sense - MJPEG Video + PDM Audio</p>
-    <p>Resolution: 800x600 (SVGA) | Audio: 16kHz 16-bit PCM</p>
+    <p>XIAO ESP32S3 Sense - JPEG Video + PDM Audio on one WebSocket (/live)</p>
+    <p>Resolution: 800x600 (SVGA) | Audio: 16-bit PCM at 16, 12 or 8 kHz</p>
   </div>
 
+  <script src="/player.js"></script>
   <script>
+    // Video, audio and control share ws://<IP>/live. Media carries capture
+    // times on the device clock; pings map them onto performance.now().
+    let live;
     let audioContext;
-    let websocket;
-    let audioQueue = [];
-    let isPlaying = false;
+    let pushFrame;          // Hands an audio block to the jitter buffer
+    let statsTimer;
+    let extraMs = 0;        // ScriptProcessor buffering, outside the jitter buffer
+    let bufferedMs = 0;     // Jitter buffer depth from its last report
+    let networkMs = null;   // Audio capture to arrival, smoothed
+    let clockOffset = null; // Device ms minus page ms, from the best ping
+    let bestRtt = Infinity;
+    let deviceStats = null; // Last {"type":"stats"} from the device
+    let frames = [];        // Decoded frames waiting for their paint time
+    let painted = 0;
+    let replaced = 0;       // Decoded but overtaken before they were painted
+    let paintMs = null;     // Capture to paint, smoothed
+    let syncMs = 0;         // How long video is held back to match audio
+    const canvas = document.getElementById('video');
+    const ctx = canvas.getContext('2d');
+
+    function send(msg) {
+      if (live && live.readyState === WebSocket.OPEN) {
+        live.send(JSON.stringify(msg));
+      }
+    }
+
+    function connect() {
+      // Video only until audio is enabled; config switches it on in place
+      live = new WebSocket('ws://' + location.hostname + '/live?audio=0');
+      live.binaryType = 'arraybuffer';
+      live.onopen = () => {
+        document.getElementById('liveStatus').classList.add('active');
+        ping();
+        if (audioContext) {
+          send({type: 'config', audio: 1, rate: audioContext.sampleRate});
+        }
+      };
+      live.onmessage = (event) => {
+        if (typeof event.data === 'string') {
+          onControl(JSON.parse(event.data));
+        } else {
+          onMedia(event.data);
+        }
+      };
+      live.onclose = () => {
+        document.getElementById('liveStatus').classList.remove('active');
+        clockOffset = null;
+        bestRtt = Infinity;
+        setTimeout(connect, 1000);
+      };
+    }
+
+    function ping() {
+      send({type: 'ping', t: performance.now()});
+    }
+
+    function onControl(msg) {
+      if (msg.type === 'pong') {
+        // The fastest round trip bounds the offset error best; the bound
+        // relaxes slowly so the offset follows clock drift
+        const rtt = performance.now() - msg.t;
+        if (rtt <= bestRtt) {
+          bestRtt = rtt;
+          clockOffset = msg.device / 1000 - (msg.t + rtt / 2);
+        }
+        bestRtt += 0.5;
+      } else if (msg.type === 'stats') {
+        deviceStats = msg;
+      }
+    }
+
+    function onMedia(data) {
+      if (data.byteLength <= 16) {
+        return;
+      }
+      const header = new DataView(data, 0, 16);
+      const type = header.getUint8(0);
+      const seq = header.getUint32(4, true);
+      const captureMs = Number(header.getBigInt64(8, true)) / 1000;
+      if (type === 1) {
+        // Ack once decoded: the device sends the next frame against it
+        createImageBitmap(new Blob([new Uint8Array(data, 16)], {type: 'image/jpeg'}))
+          .then((bitmap) => {
+            send({type: 'ack', seq});
+            frames.push({bitmap, captureMs});
+            while (frames.length > 8) {
+              frames.shift().bitmap.close();
+              replaced++;
+            }
+          })
+          .catch(() => send({type: 'ack', seq}));
+      } else if (type === 2 && pushFrame) {
+        if (clockOffset !== null) {
+          const ms = performance.now() - (captureMs - clockOffset);
+          networkMs = networkMs === null ? ms : networkMs + (ms - networkMs) * 0.05;
+        }
+        const int16Data = new Int16Array(data, 16);
+        const float32Data = new Float32Array(int16Data.length);
+        for (let i = 0; i < int16Data.length; i++) {
+          float32Data[i] = int16Data[i] / 32768.0;
+        }
+        pushFrame(seq, performance.now(), float32Data);
+      }
+    }
+
+    // Capture to ear: network, jitter buffer, then the audio output path
+    function audioDelayMs() {
+      const outputMs = ((audioContext.outputLatency || 0) + (audioContext.baseLatency || 0)) * 1000;
+      return (networkMs || 0) + bufferedMs + extraMs + outputMs;
+    }
+
+    // Paint the newest frame whose time has come. With audio on, a frame is
+    // due at capture time + the audio delay, so picture and sound line up.
+    function render() {
+      requestAnimationFrame(render);
+      const now = performance.now();
+      const clock = document.getElementById('clock');
+      if (clock.style.display === 'block') {
+        clock.textContent = (Date.now() % 100000 / 1000).toFixed(3);
+      }
+      syncMs = audioContext && pushFrame && clockOffset !== null ? audioDelayMs() : 0;
+      let pick = -1;
+      for (let i = 0; i < frames.length; i++) {
+        if (clockOffset === null || frames[i].captureMs - clockOffset + syncMs <= now) {
+          pick = i;
+        }
+      }
+      if (pick < 0) {
+        return;
+      }
+      const due = frames.splice(0, pick + 1);
+      const frame = due.pop();
+      due.forEach((f) => f.bitmap.close());
+      replaced += due.length;
+      if (canvas.width !== frame.bitmap.width || canvas.height !== frame.bitmap.height) {
+        canvas.width = frame.bitmap.width;
+        canvas.height = frame.bitmap.height;
+      }
+      ctx.drawImage(frame.bitmap, 0, 0);
+      frame.bitmap.close();
+      painted++;
+      if (clockOffset !== null) {
+        const ms = now - (frame.captureMs - clockOffset);
+        paintMs = paintMs === null ? ms : paintMs + (ms - paintMs) * 0.1;
+      }
+    }
+
+    let lastPainted = 0;
+    function showVideoStats() {
+      const fps = (painted - lastPainted) * 2;
+      lastPainted = painted;
+      const skipped = (deviceStats ? deviceStats.framesSkipped : 0) + replaced;
+      document.getElementById('videoLatency').textContent =
+        'Video capture→paint ' + (paintMs === null ? '-' : paintMs.toFixed(0) + ' ms') +
+        ' | sync delay ' + syncMs.toFixed(0) + ' ms | ' + fps + ' fps | skipped ' + skipped +
+        (deviceStats ? ' | in flight ' + deviceStats.inFlight : '') +
+        ' | clock ±' + (bestRtt === Infinity ? '-' : (bestRtt / 2).toFixed(0) + ' ms');
+    }
+
+    function toggleClock() {
+      const clock = document.getElementById('clock');
+      clock.style.display = clock.style.display === 'block' ? 'none' : 'block';
+    }
 
     function toggleAudio() {
       const btn = document.getElementById('audioBtn');
       const status = document.getElementById('audioStatus');
       
       if (!audioContext) {
-        startAudio();
+        startAudio().catch((err) => console.error('Audio start failed:', err));
         btn.textContent = '🔇 Disable Audio';
         status.classList.add('active');
       } else {
@@ -1590,68 +4880,82 @@ const char* html = R"rawliteral(
       }
     }
 
-    function startAudio() {
+    async function startAudio() {
+      const sampleRate = parseInt(document.getElementById('audioRate').value, 10);
+      document.getElementById('audioRate').disabled = true;
       audioContext = new (window.AudioContext || window.webkitAudioContext)({
-        sampleRate: 16000
+        sampleRate: sampleRate
       });
       
-      websocket = new WebSocket('ws://' + location.hostname + '/audio');
-      websocket.binaryType = 'arraybuffer';
-      
-      websocket.onopen = () => {
-        console.log('Audio WebSocket connected');
-      };
-      
-      websocket.onmessage = (event) => {
-        const audioData = new Int16Array(event.data);
-        playAudio(audioData);
-      };
-      
-      websocket.onerror = (error) => {
-        console.error('WebSocket error:', error);
-      };
-      
-      websocket.onclose = () => {
-        console.log('Audio WebSocket disconnected');
-      };
+      // AudioWorklet where the browser allows it (secure contexts only),
+      // otherwise the same jitter buffer behind a ScriptProcessorNode
+      let node;
+      if (audioContext.audioWorklet) {
+        await audioContext.audioWorklet.addModule('/player.js');
+        node = new AudioWorkletNode(audioContext, 'jitter-player', {outputChannelCount: [1]});
+        node.port.onmessage = (e) => showStats(e.data);
+        pushFrame = (seq, arrival, pcm) => node.port.postMessage({seq, arrival, pcm}, [pcm.buffer]);
+        extraMs = 0;
+      } else {
+        const buffer = new JitterBuffer(sampleRate);
+        node = audioContext.createScriptProcessor(512, 1, 1);
+        node.onaudioprocess = (e) => buffer.read(e.outputBuffer.getChannelData(0));
+        pushFrame = (seq, arrival, pcm) => buffer.push(seq, arrival, pcm);
+        statsTimer = setInterval(() => showStats(buffer.report()), 250);
+        extraMs = 512 * 1000 / sampleRate;
+      }
+      node.connect(audioContext.destination);
+      send({type: 'config', audio: 1, rate: sampleRate});
     }
 
     function stopAudio() {
-      if (websocket) {
-        websocket.close();
-        websocket = null;
-      }
+      send({type: 'config', audio: 0});
       if (audioContext) {
         audioContext.close();
         audioContext = null;
       }
-      audioQueue = [];
-      isPlaying = false;
+      clearInterval(statsTimer);
+      pushFrame = null;
+      networkMs = null;
+      bufferedMs = 0;
+      document.getElementById('audioRate').disabled = false;
+      document.getElementById('audioLatency').textContent = '';
     }
 
-    function playAudio(int16Data) {
-      // Convert Int16 to Float32 for Web Audio API
-      const float32Data = new Float32Array(int16Data.length);
-      for (let i = 0; i < int16Data.length; i++) {
-        float32Data[i] = int16Data[i] / 32768.0;
+    // Mic-to-ear latency: capture to arrival (device clock mapped through
+    // the pings), time in the jitter buffer, then the audio output path
+    function showStats(s) {
+      if (!audioContext) {
+        return;
       }
-      
-      const audioBuffer = audioContext.createBuffer(1, float32Data.length, 16000);
-      audioBuffer.getChannelData(0).set(float32Data);
-      
-      const source = audioContext.createBufferSource();
-      source.buffer = audioBuffer;
-      source.connect(audioContext.destination);
-      source.start(audioContext.currentTime);
+      bufferedMs = s.bufferedMs;
+      const total = networkMs === null ? '-' : audioDelayMs().toFixed(0) + ' ms';
+      document.getElementById('audioLatency').textContent =
+        'Audio latency ' + total + ' | buffer ' + s.bufferedMs.toFixed(0) + '/' + s.targetMs.toFixed(0) +
+        ' ms | jitter ' + s.jitterMs.toFixed(0) + ' ms | rate ' + ((s.ratio - 1) * 100).toFixed(2) +
+        '% | lost ' + s.lost + ' | underruns ' + s.underruns + ' | skips ' + s.skips;
     }
+
+    connect();
+    setInterval(ping, 1000);
+    setInterval(showVideoStats, 500);
+    requestAnimationFrame(render);
   </script>
 </body>
 </html>
 )rawliteral";
 
 void setup() {
+  // Duty-cycle timer wake: capture and go back to sleep without the full boot
+  if (rtcState.magic == RTC_STATE_MAGIC && rtcState.dutyCycle &&
+      esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER) {
+    dutyCycleWake();
+  }
+  
   Serial.begin(115200);
   delay(1000);
+  // Hot paths log through the async ring; the drain task owns the UART writes
+  logger::begin();
   Serial.println("\n\n========================================");
   Serial.println("XIAO ESP32S3 Camera & Audio Streamer v3.0");
   Serial.println("Features: BLE Control | Continuous Recording | Timestamps");
@@ -1670,6 +4974,26 @@ void setup() {
     while (1) { delay(1000); }
   }
   
+#if TRACE_ENABLED
+  // Event tracer rings live in PSRAM
+  if (tracer::begin()) {
+    Serial.printf("✓ Tracer enabled (%u events per core)\n", TRACE_EVENTS_PER_CORE);
+    Serial.printf("  Overhead: %u ns/event\n", tracer::benchmark(1000));
+  } else {
+    Serial.println("⚠️  Tracer disabled - PSRAM allocation failed");
+  }
+#endif
+  
+  // Baseline memory snapshot at boot (history then fills every 5 minutes)
+  memstats::sample();
+  
+  // Task CPU / stack / watchdog monitor
+  if (taskmon::begin()) {
+    Serial.println("✓ Task monitor started");
+  } else {
+    Serial.println("⚠️  Task monitor failed to start");
+  }
+  
   // Initialize status LED
   pinMode(LED_BUILTIN, OUTPUT);
   digitalWrite(LED_BUILTIN, HIGH);
@@ -1677,6 +5001,9 @@ void setup() {
   // Initialize activity tracking
   lastActivityTime = millis();
   
+  // Storage cursor and duty-cycle stats from before the last deep sleep
+  restoreRtcState();
+  
   // Initialize camera
   Serial.println("\nInitializing camera...");
   if (!initCamera()) {
@@ -1688,6 +5015,7 @@ void setup() {
       delay(100);
     }
   }
+  frameHub.begin();
   Serial.println("✓ Camera initialized");
   
   // Initialize microphone
@@ -1710,6 +5038,18 @@ void setup() {
     }
   }
   
+  recorder.setListener(&recorderLog);
+  
+  // Command bus and the recorder task that owns START/STOP
+  if (!controlBus.begin(CMDBUS_DEPTH) || !recorderBus.begin(CMDBUS_DEPTH) ||
+      xTaskCreatePinnedToCore(recorderTask, "Recorder", 8192, NULL, 1, NULL, 0) != pdPASS) {
+    Serial.println("❌ Command bus / recorder task failed to start");
+  }
+  
+  // Power governor: start at full power; the first trend needs ~20 minutes
+  powerGovernor.begin(governor::defaultConfig(powerTargetMinutes), millis());
+  applyPmConfig();
+  
   // Initialize BLE first (primary control method)
   Serial.println("\n========================================");
   Serial.println("Starting in BLE CONTROL MODE");
@@ -1730,6 +5070,8 @@ void setup() {
   Serial.println("  LIST_VIDEO  - List all video files");
   Serial.println("  LIST_AUDIO  - List all audio files");
   Serial.println("  LIST_ALL    - List all recorded files");
+  Serial.println("  TASKS       - Core load, tightest stack, WDT near-misses");
+  Serial.println("  BENCH       - Time data-path kernels (cycles/op)");
   Serial.println("\nRecording Modes:");
   Serial.println("  AUDIO_ONLY  - Record only audio (no video)");
   Serial.println("  VIDEO_ONLY  - Record only video (continuous)");
@@ -1744,6 +5086,42 @@ void setup() {
   currentState = STATE_INIT;
 }
 
+// Parse a single "bytes=a-b" / "bytes=a-" / "bytes=-n" Range header against
+// a file of 'size' bytes. Returns false when the range is unsatisfiable.
+bool parseByteRange(const String& header, size_t size, size_t& start, size_t& end) {
+  if (!header.startsWith("bytes=") || header.indexOf(',') >= 0 || size == 0) {
+    return false;
+  }
+  String spec = header.substring(6);
+  int dash = spec.indexOf('-');
+  if (dash < 0) {
+    return false;
+  }
+  String first = spec.substring(0, dash);
+  String last = spec.substring(dash + 1);
+  first.trim();
+  last.trim();
+  if (first.length() == 0) {
+    // Suffix range: the last n bytes
+    size_t n = strtoul(last.c_str(), nullptr, 10);
+    if (n == 0) {
+      return false;
+    }
+    start = n >= size ? 0 : size - n;
+    end = size - 1;
+    return true;
+  }
+  start = strtoul(first.c_str(), nullptr, 10);
+  end = last.length() ? strtoul(last.c_str(), nullptr, 10) : size - 1;
+  if (start >= size || end < start) {
+    return false;
+  }
+  if (end >= size) {
+    end = size - 1;
+  }
+  return true;
+}
+
 void startWiFiMode() {
   Serial.println("\n========================================");
   Serial.println("Switching to WiFi Mode...");
@@ -1751,183 +5129,530 @@ void startWiFiMode() {
   
   // Disable BLE to free resources
   if (bleEnabled) {
+    xfer.cancel = true;
+    for (int i = 0; i < 100 && xfer.active; i++) {
+      delay(10);   // Let a file transfer wind down before its characteristics go away
+    }
     BLEDevice::deinit(true);
     bleEnabled = false;
     Serial.println("✓ BLE disabled");
   }
   
-  // Connect to WiFi
+  // Connect to WiFi; updateWiFi() in loop() takes it from here
   Serial.println("Connecting to WiFi...");
   Serial.printf("SSID: %s\n", wifi_ssid);
   
   currentState = STATE_WIFI_CONNECTING;
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(wifi_ssid, wifi_password);
-  
-  int attempts = 0;
-  while (WiFi.status() != WL_CONNECTED && attempts < 40) {
-    delay(500);
-    Serial.print(".");
-    updateStatusLED();
-    attempts++;
+  wifimgr::begin(wifi_ssid, wifi_password);
+}
+
+// Send a FixedString document, or a 500 if it was cut off
+void sendJson(AsyncWebServerRequest *request, int code, const StringWriter& json) {
+  if (json.truncated()) {
+    request->send(500, "application/json", "{\"error\":\"Response too large\"}");
+    return;
   }
-  Serial.println();
+  request->send(code, "application/json", json.c_str());
+}
+
+// Web server, OTA and audio streaming; set up once, on the first connection
+bool streamingStarted = false;
+
+void startStreaming() {
+  // WiFi connected - start streaming mode
+  currentState = STATE_WIFI_CONNECTED;
+  IPAddress IP = WiFi.localIP();
+  LOG_I("✓ WiFi Connected!");
+  LOG_I("========================================");
+  LOG_I("IP Address: http://%s", IP.toString().c_str());
+  LOG_I("Stream URL: http://%s/stream", IP.toString().c_str());
+  LOG_I("OTA Updates: http://%s:3232", IP.toString().c_str());
+  LOG_I("========================================");
   
-  if (WiFi.status() != WL_CONNECTED) {
-    Serial.println("\n❌ WiFi connection failed!");
-    Serial.println("Returning to BLE mode...");
-    
-    // Restart BLE
-    initBLE();
-    bleEnabled = true;
-    return;
-  } else {
-    // WiFi connected - start streaming mode
-    currentState = STATE_WIFI_CONNECTED;
-    IPAddress IP = WiFi.localIP();
-    Serial.println("\n✓ WiFi Connected!");
-    Serial.println("========================================");
-    Serial.printf("IP Address: http://%s\n", IP.toString().c_str());
-    Serial.printf("Stream URL: http://%s/stream\n", IP.toString().c_str());
-    Serial.printf("OTA Updates: http://%s:3232\n", IP.toString().c_str());
-    Serial.println("========================================\n");
-    
-    // Initialize NTP time
-    initTime();
-    
-    // Initialize OTA updates
-    initOTA();
-    
-    // Setup WebSocket for audio
-    ws.onEvent(onWsEvent);
-    server.addHandler(&ws);
-    
-    // Setup web server routes
-    server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
-      request->send(200, "text/html", html);
-    });
-    
-    server.on("/stream", HTTP_GET, handleStream);
+  // NTP sync runs in the background (pollTimeSync())
+  startTimeSync();
+  
+  // Initialize OTA updates
+  initOTA();
+  
+  // Setup WebSocket for audio
+  wsClientsMutex = xSemaphoreCreateMutex();
+  ws.onEvent(onWsEvent);
+  server.addHandler(&ws);
+  levelsWs.onEvent(onLevelsEvent);
+  server.addHandler(&levelsWs);
+  liveMutex = xSemaphoreCreateMutex();
+  liveWs.onEvent(onLiveEvent);
+  server.addHandler(&liveWs);
+  
+  // Setup web server routes
+  server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
+    request->send(200, "text/html", html);
+  });
+  
+  server.on("/player.js", HTTP_GET, [](AsyncWebServerRequest *request) {
+    request->send(200, "application/javascript", playerJs);
+  });
+  
+  server.on("/stream", HTTP_GET, handleStream);
+  
+  // Add status endpoint
+  server.on("/api/status", HTTP_GET, [](AsyncWebServerRequest *request) {
+    char timestamp[32];
+    StatusSnapshot snap;
+    snap.uptimeSeconds = millis() / 1000;
+    snap.freeHeap = ESP.getFreeHeap();
+    snap.sdFreeMB = (uint32_t)((sdTotalBytesCached - sdUsedBytesCached) / (1024 * 1024));
+    snap.sdTotalMB = (uint32_t)(sdTotalBytesCached / (1024 * 1024));
+    snap.frames = frameCount;
+    snap.audioFiles = audioFileCount;
+    snap.batteryVoltage = getBatteryVoltage();
+    snap.rssi = WiFi.RSSI();
+    snap.timestamp = formatTimestamp(timestamp, sizeof(timestamp));
+    char json[320];
+    formatStatusJson(json, sizeof(json), snap);
+    request->send(200, "application/json", json);
+  });
+  
+  // Prometheus metrics endpoint
+  server.on("/metrics", HTTP_GET, [](AsyncWebServerRequest *request) {
+    metrics::uptimeSeconds.set(millis() / 1000);
+    metrics::freeHeap.set(ESP.getFreeHeap());
+    metrics::freePsram.set(ESP.getFreePsram());
+    metrics::wifiRssi.set(WiFi.RSSI());
     
-    // Add status endpoint
-    server.on("/api/status", HTTP_GET, [](AsyncWebServerRequest *request) {
-      String json = "{";
-      json += "\"uptime\":" + String(millis() / 1000) + ",";
-      json += "\"freeHeap\":" + String(ESP.getFreeHeap()) + ",";
-      json += "\"sdFree\":" + String((SD.totalBytes() - SD.usedBytes()) / (1024 * 1024)) + ",";
-      json += "\"sdTotal\":" + String(SD.totalBytes() / (1024 * 1024)) + ",";
-      json += "\"frames\":" + String(frameCount) + ",";
-      json += "\"audioFiles\":" + String(audioFileCount) + ",";
-      json += "\"batteryVoltage\":" + String(getBatteryVoltage(), 2) + ",";
-      json += "\"rssi\":" + String(WiFi.RSSI()) + ",";
-      json += "\"timestamp\":\"" + getTimestamp() + "\"";
-      json += "}";
-      request->send(200, "application/json", json);
+    AsyncResponseStream *response = request->beginResponseStream("text/plain; version=0.0.4");
+    metrics::writePrometheus([](void* ctx, const char* data, size_t len) {
+      static_cast<AsyncResponseStream*>(ctx)->write((const uint8_t*)data, len);
+    }, response);
+    request->send(response);
+  });
+  
+  // FreeRTOS task monitor snapshot
+  server.on("/api/tasks", HTTP_GET, [](AsyncWebServerRequest *request) {
+    taskmon::Snapshot snap;
+    if (!taskmon::latest(snap)) {
+      request->send(503, "application/json", "{\"error\":\"No sample yet\"}");
+      return;
+    }
+    // Handlers run one at a time on the async_tcp task
+    static FixedString<5120> json;
+    json.clear();
+    JsonWriter w(json);
+    w.beginObject();
+    w.num("intervalMs", snap.intervalMs);
+    w.beginArray("coreLoad").num(nullptr, snap.coreLoad[0]).num(nullptr, snap.coreLoad[1]).endArray();
+    w.num("watchdogNearMisses", snap.watchdogNearMisses);
+    w.num("lastNearMissCore", snap.lastNearMissCore);
+    w.str("lastNearMissTask", snap.lastNearMissTask);
+    w.num("lowStackTasks", snap.lowStackTasks);
+    w.num("tasksOmitted", snap.tasksOmitted);
+    w.beginArray("tasks");
+    for (uint8_t i = 0; i < snap.taskCount; i++) {
+      const taskmon::TaskInfo& t = snap.tasks[i];
+      char state[2] = {t.state, '\0'};
+      w.beginObject();
+      w.str("name", t.name);
+      w.num("cpu", t.cpuPercent);
+      w.num("core", t.core);
+      w.num("priority", t.priority);
+      w.str("state", state);
+      w.num("stackFree", t.stackFreeBytes);
+      w.endObject();
+    }
+    w.endArray().endObject();
+    if (json.truncated()) {
+      request->send(500, "application/json", "{\"error\":\"Response too large\"}");
+      return;
+    }
+    request->send(200, "application/json", json.c_str());
+  });
+  
+  // Heap/PSRAM fragmentation, tagged allocations and snapshot history
+  server.on("/api/memory", HTTP_GET, [](AsyncWebServerRequest *request) {
+    static FixedString<4096> json;
+    json.clear();
+    JsonWriter w(json);
+    w.beginObject().beginObject("regions");
+    for (int r = 0; r < memstats::REGION_COUNT; r++) {
+      memstats::RegionStats rs;
+      memstats::readRegion((memstats::Region)r, rs);
+      w.beginObject(memstats::regionName((memstats::Region)r));
+      w.num("free", rs.freeBytes);
+      w.num("largestBlock", rs.largestFreeBlock);
+      w.num("minFree", rs.minFreeBytes);
+      w.num("fragmentation", rs.fragmentationPct);
+      w.endObject();
+    }
+    w.endObject().beginObject("tags");
+    for (int t = 0; t < memstats::TAG_COUNT; t++) {
+      memstats::TagStats ts;
+      memstats::tagStats((memstats::Tag)t, ts);
+      w.beginObject(memstats::tagName((memstats::Tag)t));
+      w.num("allocs", ts.allocs);
+      w.num("frees", ts.frees);
+      w.num("failures", ts.failures);
+      w.num("liveBytes", ts.liveBytes);
+      w.num("peakBytes", ts.peakBytes);
+      w.endObject();
+    }
+    // Allocations inside the audited hot paths; "allocs" should stay 0
+    w.endObject().beginObject("hotPaths");
+    w.boolean("audit", memstats::auditEnabled());
+    for (int p = 0; p < memstats::HOT_PATH_COUNT; p++) {
+      memstats::HotPathStats hp;
+      memstats::hotPathStats((memstats::HotPath)p, hp);
+      w.beginObject(memstats::hotPathName((memstats::HotPath)p));
+      w.num("runs", hp.runs);
+      w.num("allocs", hp.allocs);
+      w.num("driverAllocs", hp.driverAllocs);
+      w.endObject();
+    }
+    // History rows: [uptimeSec, internalFree, internalLargest, psramFree, psramLargest]
+    w.endObject().beginArray("history");
+    static memstats::Sample samples[MEMSTATS_HISTORY_LEN];
+    size_t n = memstats::history(samples, MEMSTATS_HISTORY_LEN);
+    for (size_t i = 0; i < n; i++) {
+      const memstats::Sample& smp = samples[i];
+      w.beginArray().num(nullptr, smp.uptimeSec);
+      for (int r = 0; r < memstats::REGION_COUNT; r++) {
+        w.num(nullptr, smp.regions[r].freeBytes).num(nullptr, smp.regions[r].largestFreeBlock);
+      }
+      w.endArray();
+    }
+    w.endArray().endObject();
+    request->send(200, "application/json", json.c_str());
+  });
+  
+  // Chrome trace-event download. Recording pauses while any export is
+  // open; the last one to finish, complete or cancelled, puts back the
+  // state the first one found.
+  server.on("/api/trace", HTTP_GET, [](AsyncWebServerRequest *request) {
+    static uint8_t exports = 0;        // Only touched on the async_tcp task
+    static bool resumeTracing = false;
+    bool clearAfter = request->hasParam("clear");
+    if (exports++ == 0) {
+      resumeTracing = tracer::enabled();
+      tracer::setEnabled(false);
+    }
+    std::shared_ptr<tracer::ExportCursor> cursor(new tracer::ExportCursor(), [](tracer::ExportCursor* p) {
+      delete p;
+      if (--exports == 0) {
+        tracer::setEnabled(resumeTracing);
+      }
     });
+    AsyncWebServerResponse *response = request->beginChunkedResponse(
+      "application/json",
+      [cursor, clearAfter](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+        size_t len = tracer::exportChunk(*cursor, (char *)buffer, maxLen);
+        if (len == 0 && clearAfter) {
+          tracer::clear();
+        }
+        return len;
+      }
+    );
+    response->addHeader("Content-Disposition", "attachment; filename=\"trace.json\"");
+    request->send(response);
+  });
+  
+  // Tracer overhead benchmark (scratch ring; the recorded trace is kept)
+  server.on("/api/trace/bench", HTTP_GET, [](AsyncWebServerRequest *request) {
+    uint32_t iterations = 10000;
+    if (request->hasParam("n")) {
+      long n = request->getParam("n")->value().toInt();
+      iterations = n < 1 ? 1 : (n > TRACE_BENCH_MAX_ITERATIONS ? TRACE_BENCH_MAX_ITERATIONS : (uint32_t)n);
+    }
+    uint32_t nsPerEvent = tracer::benchmark(iterations);
+    String json = "{\"events\":" + String(iterations * 2) + ",\"nsPerEvent\":" + String(nsPerEvent) + "}";
+    request->send(200, "application/json", json);
+  });
+  
+  // File browser API endpoints - list files in directory
+  server.on("/api/files/list", HTTP_GET, [](AsyncWebServerRequest *request) {
+    String path = "/";
+    if (request->hasParam("path")) {
+      path = request->getParam("path")->value();
+    }
     
-    // File browser API endpoints - list files in directory
-    server.on("/api/files/list", HTTP_GET, [](AsyncWebServerRequest *request) {
-      String path = "/";
-      if (request->hasParam("path")) {
-        path = request->getParam("path")->value();
+    if (sdLock(1000)) {
+      File dir = SD.open(path);
+      if (!dir || !dir.isDirectory()) {
+        sdUnlock();
+        request->send(404, "application/json", "{\"error\":\"Directory not found\"}");
+        return;
       }
       
-      if (sdMutex && xSemaphoreTake(sdMutex, pdMS_TO_TICKS(1000)) == pdTRUE) {
-        File dir = SD.open(path);
-        if (!dir || !dir.isDirectory()) {
-          xSemaphoreGive(sdMutex);
-          request->send(404, "application/json", "{\"error\":\"Directory not found\"}");
-          return;
-        }
-        
-        String json = "{\"path\":\"" + path + "\",\"files\":[";
-        bool first = true;
-        File file = dir.openNextFile();
-        while (file) {
-          if (!first) json += ",";
-          first = false;
-          json += "{\"name\":\"" + String(file.name()) + "\",";
-          json += "\"size\":" + String(file.size()) + ",";
-          json += "\"isDir\":" + String(file.isDirectory() ? "true" : "false") + "}";
-          file = dir.openNextFile();
-        }
-        json += "]}";
-        dir.close();
-        xSemaphoreGive(sdMutex);
-        
-        request->send(200, "application/json", json);
-      } else {
-        request->send(503, "application/json", "{\"error\":\"SD card busy\"}");
+      String json = "{\"path\":\"" + path + "\",\"files\":[";
+      bool first = true;
+      File file = dir.openNextFile();
+      while (file) {
+        if (!first) json += ",";
+        first = false;
+        json += "{\"name\":\"" + String(file.name()) + "\",";
+        json += "\"size\":" + String(file.size()) + ",";
+        json += "\"isDir\":" + String(file.isDirectory() ? "true" : "false") + "}";
+        file = dir.openNextFile();
       }
-    });
+      json += "]}";
+      dir.close();
+      sdUnlock();
+      
+      request->send(200, "application/json", json);
+    } else {
+      request->send(503, "application/json", "{\"error\":\"SD card busy\"}");
+    }
+  });
+  
+  // Download file endpoint
+  server.on("/api/files/download", HTTP_GET, [](AsyncWebServerRequest *request) {
+    if (!request->hasParam("path")) {
+      request->send(400, "application/json", "{\"error\":\"Missing path parameter\"}");
+      return;
+    }
     
-    // Download file endpoint
-    server.on("/api/files/download", HTTP_GET, [](AsyncWebServerRequest *request) {
-      if (!request->hasParam("path")) {
-        request->send(400, "application/json", "{\"error\":\"Missing path parameter\"}");
+    String filePath = request->getParam("path")->value();
+    
+    if (sdLock(1000)) {
+      File file = SD.open(filePath);
+      if (!file || file.isDirectory()) {
+        sdUnlock();
+        request->send(404, "application/json", "{\"error\":\"File not found\"}");
         return;
       }
       
-      String filePath = request->getParam("path")->value();
-      
-      if (sdMutex && xSemaphoreTake(sdMutex, pdMS_TO_TICKS(1000)) == pdTRUE) {
-        File file = SD.open(filePath);
-        if (!file || file.isDirectory()) {
-          xSemaphoreGive(sdMutex);
-          request->send(404, "application/json", "{\"error\":\"File not found\"}");
+      size_t fileSize = file.size();
+      size_t start = 0;
+      size_t end = fileSize ? fileSize - 1 : 0;
+      bool partial = false;
+      if (request->hasHeader("Range")) {
+        if (!parseByteRange(request->header("Range"), fileSize, start, end)) {
+          file.close();
+          sdUnlock();
+          AsyncWebServerResponse *response = request->beginResponse(416, "application/json", "{\"error\":\"Range not satisfiable\"}");
+          response->addHeader("Content-Range", "bytes */" + String(fileSize));
+          request->send(response);
           return;
         }
-        
-        // Stream file to client
-        AsyncWebServerResponse *response = request->beginResponse(
-          "application/octet-stream",
-          file.size(),
-          [file](uint8_t *buffer, size_t maxLen, size_t index) mutable -> size_t {
-            return file.read(buffer, maxLen);
+        partial = true;
+        file.seek(start);
+      }
+      sdUnlock();
+      
+      // Stream file to client. The lambda owns the File; each chunk takes
+      // the SD lock briefly so recording is never stalled for a whole
+      // download, and backs off with RESPONSE_TRY_AGAIN while it is busy.
+      size_t length = fileSize ? end - start + 1 : 0;
+      AsyncWebServerResponse *response = request->beginResponse(
+        "application/octet-stream",
+        length,
+        [file](uint8_t *buffer, size_t maxLen, size_t index) mutable -> size_t {
+          if (!sdLock(50)) {
+            return RESPONSE_TRY_AGAIN;
           }
-        );
-        
-        // Extract filename for download
-        String filename = filePath;
-        int lastSlash = filename.lastIndexOf('/');
-        if (lastSlash >= 0) {
-          filename = filename.substring(lastSlash + 1);
+          size_t n = file.read(buffer, maxLen);
+          sdUnlock();
+          return n;
         }
-        response->addHeader("Content-Disposition", "attachment; filename=\"" + filename + "\"");
-        
-        request->send(response);
-        file.close();
-        xSemaphoreGive(sdMutex);
-      } else {
-        request->send(503, "application/json", "{\"error\":\"SD card busy\"}");
-      }
-    });
-    
-    // Delete file endpoint
-    server.on("/api/files/delete", HTTP_DELETE, [](AsyncWebServerRequest *request) {
-      if (!request->hasParam("path")) {
-        request->send(400, "application/json", "{\"error\":\"Missing path parameter\"}");
-        return;
+      );
+      if (partial) {
+        response->setCode(206);
+        response->addHeader("Content-Range", "bytes " + String(start) + "-" + String(end) + "/" + String(fileSize));
       }
+      response->addHeader("Accept-Ranges", "bytes");
       
-      String filePath = request->getParam("path")->value();
+      // Extract filename for download
+      String filename = filePath;
+      int lastSlash = filename.lastIndexOf('/');
+      if (lastSlash >= 0) {
+        filename = filename.substring(lastSlash + 1);
+      }
+      response->addHeader("Content-Disposition", "attachment; filename=\"" + filename + "\"");
       
-      if (sdMutex && xSemaphoreTake(sdMutex, pdMS_TO_TICKS(1000)) == pdTRUE) {
-        if (SD.remove(filePath)) {
-          xSemaphoreGive(sdMutex);
-          request->send(200, "application/json", "{\"success\":true}");
-        } else {
-          xSemaphoreGive(sdMutex);
-          request->send(500, "application/json", "{\"error\":\"Failed to delete file\"}");
-        }
+      request->send(response);
+    } else {
+      request->send(503, "application/json", "{\"error\":\"SD card busy\"}");
+    }
+  });
+  
+  // Delete file endpoint
+  server.on("/api/files/delete", HTTP_DELETE, [](AsyncWebServerRequest *request) {
+    if (!request->hasParam("path")) {
+      request->send(400, "application/json", "{\"error\":\"Missing path parameter\"}");
+      return;
+    }
+    
+    String filePath = request->getParam("path")->value();
+    
+    if (sdLock(1000)) {
+      if (SD.remove(filePath)) {
+        sdUnlock();
+        request->send(200, "application/json", "{\"success\":true}");
       } else {
-        request->send(503, "application/json", "{\"error\":\"SD card busy\"}");
+        sdUnlock();
+        request->send(500, "application/json", "{\"error\":\"Failed to delete file\"}");
       }
-    });
-    
-    // File browser web UI
-    server.on("/files", HTTP_GET, [](AsyncWebServerRequest *request) {
-      const char* fileBrowserHtml = R"rawliteral(
+    } else {
+      request->send(503, "application/json", "{\"error\":\"SD card busy\"}");
+    }
+  });
+
+  // Batch delete job - runs in the background, accepts query or form params:
+  //   path=/video/2024*.jpg  (glob on the last path component)
+  //   from=<epoch>&to=<epoch> (optional last-write time range)
+  server.on("/api/jobs/delete", HTTP_POST, [](AsyncWebServerRequest *request) {
+    auto param = [request](const char* name) -> String {
+      if (request->hasParam(name, true)) return request->getParam(name, true)->value();
+      if (request->hasParam(name)) return request->getParam(name)->value();
+      return String();
+    };
+
+    String glob = param("path");
+    if (glob.length() == 0 || glob[0] != '/') {
+      request->send(400, "application/json", "{\"error\":\"Missing or relative path parameter\"}");
+      return;
+    }
+    if (deleteJob.state == JOB_RUNNING) {
+      request->send(409, "application/json", "{\"error\":\"Delete job already running\"}");
+      return;
+    }
+
+    time_t fromTime = (time_t)param("from").toInt();
+    time_t toTime = (time_t)param("to").toInt();
+    uint32_t id = startDeleteJob(glob, fromTime, toTime);
+    if (id == 0) {
+      request->send(500, "application/json", "{\"error\":\"Failed to start delete job\"}");
+      return;
+    }
+    sendJson(request, 202, deleteJobStatusJson());
+  });
+
+  // Batch delete job progress (most recent job)
+  server.on("/api/jobs/status", HTTP_GET, [](AsyncWebServerRequest *request) {
+    if (request->hasParam("id") &&
+        (uint32_t)request->getParam("id")->value().toInt() != deleteJob.id) {
+      request->send(404, "application/json", "{\"error\":\"Job not found\"}");
+      return;
+    }
+    sendJson(request, 200, deleteJobStatusJson());
+  });
+
+  // Cancel the running batch delete job
+  server.on("/api/jobs/cancel", HTTP_POST, [](AsyncWebServerRequest *request) {
+    if (deleteJob.state != JOB_RUNNING) {
+      request->send(409, "application/json", "{\"error\":\"No job running\"}");
+      return;
+    }
+    deleteJob.cancelRequested = true;
+    sendJson(request, 202, deleteJobStatusJson());
+  });
+
+  // Timelapse state
+  server.on("/api/timelapse", HTTP_GET, [](AsyncWebServerRequest *request) {
+    sendJson(request, 200, timelapseStatusJson());
+  });
+
+  // Timelapse control, query or form params:
+  //   interval=<seconds> (2-3600)
+  //   enable=1 selects timelapse mode and starts it, enable=0 stops it
+  server.on("/api/timelapse", HTTP_POST, [](AsyncWebServerRequest *request) {
+    auto param = [request](const char* name) -> String {
+      if (request->hasParam(name, true)) return request->getParam(name, true)->value();
+      if (request->hasParam(name)) return request->getParam(name)->value();
+      return String();
+    };
+
+    String interval = param("interval");
+    if (interval.length() && cmdTimelapseInterval((uint32_t)interval.toInt()) != bleproto::RESULT_OK) {
+      request->send(400, "application/json", "{\"error\":\"interval must be 2-3600 seconds\"}");
+      return;
+    }
+    String enable = param("enable");
+    if (enable == "1") {
+      if (cmdSetMode(bleproto::MODE_TIMELAPSE) != bleproto::RESULT_OK) {
+        request->send(409, "application/json", "{\"error\":\"Stop recording first\"}");
+        return;
+      }
+      if (cmdStart() == bleproto::RESULT_FAILED) {
+        request->send(500, "application/json", "{\"error\":\"Failed to start timelapse\"}");
+        return;
+      }
+    } else if (enable == "0" && timelapseMode) {
+      cmdStop();
+    }
+    sendJson(request, 200, timelapseStatusJson());
+  });
+
+  server.on("/api/power", HTTP_GET, [](AsyncWebServerRequest *request) {
+    sendJson(request, 200, powerStatusJson());
+  });
+
+  server.on("/api/audio", HTTP_GET, [](AsyncWebServerRequest *request) {
+    sendJson(request, 200, audioStatusJson());
+  });
+
+  // Sound activity gating, query or form params (either or both):
+  //   gate=0|1   audio clips only while sound is active
+  //   video=0|1  video clips only while sound is active
+  server.on("/api/audio/sad", HTTP_POST, [](AsyncWebServerRequest *request) {
+    const char* names[2] = {"gate", "video"};
+    bool* flags[2] = {&sadGateAudio, &sadTriggerVideo};
+    bool any = false;
+    for (int i = 0; i < 2; i++) {
+      String v = request->hasParam(names[i], true) ? request->getParam(names[i], true)->value()
+               : request->hasParam(names[i]) ? request->getParam(names[i])->value() : String();
+      if (!v.length()) {
+        continue;
+      }
+      if (v != "0" && v != "1") {
+        request->send(400, "application/json", "{\"error\":\"gate and video take 0 or 1\"}");
+        return;
+      }
+      *flags[i] = v == "1";
+      any = true;
+    }
+    if (!any) {
+      request->send(400, "application/json", "{\"error\":\"gate or video required\"}");
+      return;
+    }
+    sendJson(request, 200, audioStatusJson());
+  });
+
+  server.on("/api/commands", HTTP_GET, [](AsyncWebServerRequest *request) {
+    sendJson(request, 200, commandsJson());
+  });
+
+  server.on("/api/pm", HTTP_GET, [](AsyncWebServerRequest *request) {
+    sendJson(request, 200, pmStatusJson());
+  });
+
+  // Start a new residency window, e.g. before a current measurement
+  server.on("/api/pm/reset", HTTP_POST, [](AsyncWebServerRequest *request) {
+    pmlock::reset();
+    sendJson(request, 200, pmStatusJson());
+  });
+
+  // Runtime target for the power governor, query or form param:
+  //   target=<minutes> (0-2880, 0 = state-of-charge floors only)
+  server.on("/api/power", HTTP_POST, [](AsyncWebServerRequest *request) {
+    String target = request->hasParam("target", true) ? request->getParam("target", true)->value()
+                  : request->hasParam("target") ? request->getParam("target")->value() : String();
+    long minutes = target.toInt();
+    bleproto::Result r = !target.length() || minutes < 0 ? bleproto::RESULT_BAD_VALUE
+                       : cmdPowerTarget((uint32_t)minutes);
+    if (r == bleproto::RESULT_BUSY) {
+      request->send(503, "application/json", "{\"error\":\"command queue full\"}");
+      return;
+    }
+    if (r != bleproto::RESULT_ACCEPTED) {
+      request->send(400, "application/json", "{\"error\":\"target must be 0-2880 minutes\"}");
+      return;
+    }
+    request->send(202, "application/json", "{\"targetMinutes\":" + String(minutes) + "}");
+  });
+
+  // File browser web UI
+  server.on("/files", HTTP_GET, [](AsyncWebServerRequest *request) {
+    const char* fileBrowserHtml = R"rawliteral(
 <!DOCTYPE html>
 <html>
 <head>
@@ -1982,6 +5707,8 @@ void startWiFiMode() {
   <div class="path" id="currentPath">/</div>
   <button onclick="location.href='/'">🏠 Home</button>
   <button onclick="refreshFiles()">🔄 Refresh</button>
+  <button class="delete" onclick="batchDelete()">🧹 Delete Matching</button>
+  <div class="path" id="jobStatus"></div>
   <div class="file-list" id="fileList">
     <div class="loading">Loading...</div>
   </div>
@@ -2082,63 +5809,190 @@ void startWiFiMode() {
       loadFiles(currentPath);
     }
     
+    async function batchDelete() {
+      const base = currentPath === '/' ? '' : currentPath;
+      const glob = prompt('Delete files matching (wildcards * and ?):', base + '/*');
+      if (!glob) return;
+      
+      try {
+        const response = await fetch('/api/jobs/delete?path=' + encodeURIComponent(glob), {
+          method: 'POST'
+        });
+        const data = await response.json();
+        if (data.error) {
+          alert('Error: ' + data.error);
+          return;
+        }
+        pollJob(data.id);
+      } catch (error) {
+        alert('Error: ' + error.message);
+      }
+    }
+    
+    async function pollJob(id) {
+      const response = await fetch('/api/jobs/status?id=' + id);
+      const job = await response.json();
+      const status = document.getElementById('jobStatus');
+      status.innerHTML = 'Delete job ' + job.id + ': ' + job.state + ' - ' +
+        job.deleted + ' deleted / ' + job.scanned + ' scanned (' + formatSize(job.bytesFreed) + ' freed)';
+      if (job.state === 'running') {
+        status.innerHTML += ' <button onclick="fetch(\'/api/jobs/cancel\', {method: \'POST\'})">✋ Cancel</button>';
+        setTimeout(() => pollJob(id), 1000);
+      } else {
+        refreshFiles();
+      }
+    }
+    
     // Load root directory on page load
     loadFiles('/');
   </script>
 </body>
 </html>
 )rawliteral";
-      request->send(200, "text/html", fileBrowserHtml);
-    });
-    
-    // Start server
-    server.begin();
-    Serial.println("\n✓ Web server started");
-    
-    currentState = STATE_STREAMING;
-    
-    // Start audio streaming task on Core 0 (Core 1 handles WiFi/camera)
-    xTaskCreatePinnedToCore(
-      audioTask,       // Task function
-      "AudioStream",   // Task name
-      4096,            // Stack size
-      NULL,            // Parameters
-      1,               // Priority
-      NULL,            // Task handle
-      0                // Core 0
-    );
+    request->send(200, "text/html", fileBrowserHtml);
+  });
+  
+  // Start server
+  server.begin();
+  LOG_I("✓ Web server started");
+  
+  currentState = STATE_STREAMING;
+  
+  // Start audio streaming task on Core 0 (Core 1 handles WiFi/camera)
+  xTaskCreatePinnedToCore(
+    audioTask,       // Task function
+    "AudioStream",   // Task name
+    4096,            // Stack size
+    NULL,            // Parameters
+    1,               // Priority
+    NULL,            // Task handle
+    0                // Core 0
+  );
+  
+  LOG_I("✓ Audio streaming task started");
+  
+  // Level/spectrum summaries for /levels, /api/audio and /metrics
+  xTaskCreatePinnedToCore(levelsTask, "AudioLevels", 4096, NULL, 1, NULL, 0);
+  
+  // RTSP: rtsp://<IP>/live
+  rtspServer.begin();
+  rtspRtp.begin(RTSP_RTP_PORT);
+  rtspRtcp.begin(RTSP_RTP_PORT + 1);
+  xTaskCreatePinnedToCore(rtspTask, "Rtsp", 6144, NULL, 1, NULL, 1);
+  
+  // /live: video, audio and control on one WebSocket
+  xTaskCreatePinnedToCore(liveTask, "Live", 4096, NULL, 1, NULL, 1);
+  LOG_I("Ready to stream video & audio!");
+  LOG_I("Click 'Enable Audio' button in browser to start audio");
+  LOG_I("📊 Status API: http://%s/api/status", IP.toString().c_str());
+  LOG_I("📁 File Browser: http://%s/files", IP.toString().c_str());
+  LOG_I("🎥 RTSP: rtsp://%s/live", IP.toString().c_str());
+  LOG_I("⚡ Live: ws://%s/live", IP.toString().c_str());
+}
+
+// Drive the Wi-Fi connection manager (WiFi mode only)
+void updateWiFi() {
+  if (bleEnabled) {
+    return;
+  }
+  static wifimgr::State lastState = wifimgr::WM_IDLE;
+  wifimgr::State state = wifimgr::poll();
+  if (state == lastState) {
+    return;
+  }
+  lastState = state;
+  
+  if (state == wifimgr::WM_CONNECTED) {
+    if (!streamingStarted) {
+      streamingStarted = true;
+      startStreaming();
+    } else {
+      currentState = STATE_STREAMING;
+      LOG_I("✓ WiFi reconnected: http://%s", WiFi.localIP().toString().c_str());
+    }
+  } else if (state == wifimgr::WM_FAILED) {
+    LOG_E("❌ WiFi connection failed!");
+    LOG_I("Returning to BLE mode...");
+    wifimgr::stop();
+    lastState = wifimgr::WM_IDLE;
+    currentState = STATE_INIT;
     
-    Serial.println("✓ Audio streaming task started");
-    Serial.println("\nReady to stream video & audio!");
-    Serial.println("Click 'Enable Audio' button in browser to start audio");
-    Serial.println("\n📊 Status API: http://" + IP.toString() + "/api/status");
-    Serial.println("📁 File Browser: http://" + IP.toString() + "/files");
+    // Restart BLE
+    initBLE();
+    bleEnabled = true;
+  } else if (streamingStarted && currentState == STATE_STREAMING) {
+    currentState = STATE_WIFI_CONNECTING;   // Link lost; LED shows reconnecting
+  }
+}
+
+// Control commands from BLE and HTTP (loop() has the stack for listings
+// and the benchmark, and owns Wi-Fi, USB and sleep transitions)
+void runControlCommand(cmdbus::Command& cmd) {
+  bleproto::Result result = bleproto::RESULT_OK;
+  switch (cmd.type) {
+    case cmdbus::CMD_LIST:
+      if (cmd.arg == 0) {
+        listVideoFiles();
+      } else if (cmd.arg == 1) {
+        listAudioFiles();
+      } else {
+        listAllFiles();
+      }
+      break;
+    case cmdbus::CMD_BENCH:
+      runBenchmarks();
+      break;
+    case cmdbus::CMD_WIFI:
+      wifiRequested = false;
+      if (bleEnabled) {
+        startWiFiMode();
+      } else {
+        result = bleproto::RESULT_NO_CHANGE;
+      }
+      break;
+    case cmdbus::CMD_POWER_TARGET:
+      setPowerTarget(cmd.arg);
+      break;
+    case cmdbus::CMD_USB:
+      if ((cmd.arg != 0) == usbMscEnabled) {
+        result = bleproto::RESULT_NO_CHANGE;
+      } else if (!cmd.arg) {
+        disableUSBMSC();
+        bleNotifyText("USB:Disabled");
+        LOG_I("💾 USB Mass Storage DISABLED");
+      } else if (initUSBMSC()) {
+        bleNotifyText("USB:Enabled");
+        LOG_I("💾 USB Mass Storage ENABLED");
+        LOG_I("   Connect USB cable to access SD card files");
+      } else {
+        bleNotifyText("USB:Failed");
+        result = bleproto::RESULT_FAILED;
+      }
+      break;
+    case cmdbus::CMD_DUTY_CYCLE:
+      // Recording may have started since the command was accepted
+      if (bleRecordingActive || usbMscEnabled) {
+        result = bleproto::RESULT_BUSY;
+        break;
+      }
+      // Completed first: on success startDutyCycle() never returns
+      cmdbus::complete(cmd, result);
+      startDutyCycle(cmd.arg, (uint8_t)cmd.arg2);
+      return;
+    default:
+      result = bleproto::RESULT_UNKNOWN_OP;
+      break;
   }
+  cmdbus::complete(cmd, result);
 }
 
 void loop() {
   // Update status LED
   updateStatusLED();
   
-  // Handle file listing requests (process in main loop to avoid stack overflow in BLE task)
-  if (listVideoRequested) {
-    listVideoRequested = false;
-    listVideoFiles();
-  }
-  if (listAudioRequested) {
-    listAudioRequested = false;
-    listAudioFiles();
-  }
-  if (listAllRequested) {
-    listAllRequested = false;
-    listAllFiles();
-  }
-  
-  // Handle WiFi mode request from BLE
-  if (wifiRequested && bleEnabled) {
-    wifiRequested = false;
-    startWiFiMode();
-  }
+  // Wi-Fi connect/reconnect and background NTP
+  updateWiFi();
+  pollTimeSync();
   
   // Handle OTA updates (only in WiFi mode)
   if (WiFi.status() == WL_CONNECTED) {
@@ -2146,24 +6000,63 @@ void loop() {
   }
   
   // Update BLE status notifications
-  if (bleEnabled && deviceConnected && pStatusCharacteristic) {
+  if (bleEnabled && deviceConnected) {
+    // Binary status: state tags as soon as they change, counters at most
+    // every BLE_COUNTER_NOTIFY_MS, nothing at all while idle
+    static unsigned long lastStatusPoll = 0;
+    static unsigned long lastCounterNotify = 0;
+    if (millis() - lastStatusPoll >= BLE_STATUS_POLL_MS) {
+      uint32_t mask = BLEPROTO_STATE_TAGS;
+      if (millis() - lastCounterNotify >= BLE_COUNTER_NOTIFY_MS) {
+        mask = BLEPROTO_ALL_TAGS;
+        lastCounterNotify = millis();
+      }
+      bool full = bleFullStatusPending;
+      bleFullStatusPending = false;
+      blePublishStatus(mask, full);
+      lastStatusPoll = millis();
+    }
+    
+    // Legacy text status every 5 seconds, only when it changed
     static unsigned long lastBLEUpdate = 0;
-    if (millis() - lastBLEUpdate > 5000) {  // Every 5 seconds
-      String status = "Frames:" + String(frameCount) + 
-                     "|Audio:" + String(audioFileCount) + 
-                     "|Recording:" + String(bleRecordingActive ? "ON" : "OFF");
-      pStatusCharacteristic->setValue(status.c_str());
-      pStatusCharacteristic->notify();
+    static char lastTextStatus[64] = "";
+    if (millis() - lastBLEUpdate > 5000) {
+      FixedString<64> status;
+      status.append("Frames:").appendUint(frameCount)
+            .append("|Audio:").appendUint(audioFileCount)
+            .append("|Recording:").append(bleRecordingActive ? "ON" : "OFF");
+      if (strcmp(status.c_str(), lastTextStatus) != 0) {
+        bleNotifyText(status.c_str());
+        strlcpy(lastTextStatus, status.c_str(), sizeof(lastTextStatus));
+      }
       lastBLEUpdate = millis();
     }
   }
   
-  // Check battery status
+  // Periodic heap/PSRAM fragmentation snapshot
+  static unsigned long lastMemSample = 0;
+  if (millis() - lastMemSample > MEMSTATS_SAMPLE_INTERVAL_MS) {
+    memstats::sample();
+    lastMemSample = millis();
+  }
+  
+  // Refresh cached SD usage for /api/status and /metrics
+  if (millis() - lastSdUsageRefresh > SD_USAGE_REFRESH_INTERVAL) {
+    refreshSdUsage();
+  }
+  
+  // Check battery status and let the power governor act on it
   static unsigned long lastBatteryCheck = 0;
-  if (millis() - lastBatteryCheck > 60000) {  // Check every minute
+  if (millis() - lastBatteryCheck > GOVERNOR_UPDATE_MS) {
     checkBatteryStatus();
+    updatePowerGovernor();
     lastBatteryCheck = millis();
   }
+  // The recording and timelapse tasks reconfigure (and wake) the sensor themselves
+  if (currentState != STATE_RECORDING && currentState != STATE_TIMELAPSE) {
+    applyCameraPowerLevel();
+    cameraIdleStandby();
+  }
   
   // Stop recording if USB MSC becomes active
   if (usbMscEnabled && recordingMode) {
@@ -2179,8 +6072,8 @@ void loop() {
   if (recordingMode) {
     static unsigned long lastStatus = 0;
     if (millis() - lastStatus > 30000) {  // Every 30 seconds
-      uint64_t totalSpace = SD.totalBytes() / (1024 * 1024);
-      uint64_t usedSpace = SD.usedBytes() / (1024 * 1024);
+      uint64_t totalSpace = sdTotalBytesCached / (1024 * 1024);
+      uint64_t usedSpace = sdUsedBytesCached / (1024 * 1024);
       uint64_t freeSpace = totalSpace - usedSpace;
       
       Serial.println("========================================");
@@ -2194,12 +6087,19 @@ void loop() {
         Serial.printf("  BLE: Connected\n");
       }
       if (timeInitialized) {
-        Serial.printf("  Time: %s\n", getTimestamp().c_str());
+        char timestamp[32];
+        Serial.printf("  Time: %s\n", formatTimestamp(timestamp, sizeof(timestamp)));
       }
       Serial.println("========================================");
       lastStatus = millis();
     }
   }
   
-  delay(100);
+  // Sleep until the next pass, or run commands as soon as they are posted
+  cmdbus::Command cmd;
+  uint32_t waitMs = 100;
+  while (controlBus.receive(cmd, waitMs)) {
+    runControlCommand(cmd);
+    waitMs = 0;
+  }
 }
\ No newline at end of file
@@ -0,0 +1,316 @@
+#include "memstats.h"
+
+#include <string.h>
+
+#include <atomic>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "metrics.h"
+
+static const char* TAG = "memstats";
+
+namespace memstats {
+
+static const uint32_t regionCaps[REGION_COUNT] = {
+  MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+  MALLOC_CAP_SPIRAM
+};
+
+static TagStats tags[TAG_COUNT];
+static portMUX_TYPE tagLock = portMUX_INITIALIZER_UNLOCKED;
+
+static Sample ring[MEMSTATS_HISTORY_LEN];
+static size_t ringHead = 0;
+static size_t ringCount = 0;
+static portMUX_TYPE ringLock = portMUX_INITIALIZER_UNLOCKED;
+
+static metrics::Gauge largestInternal("videostreamer_heap_largest_free_block_bytes",
+                                      "Largest free block in internal RAM");
+static metrics::Gauge largestPsram("videostreamer_psram_largest_free_block_bytes",
+                                   "Largest free block in PSRAM");
+static metrics::Gauge fragInternal("videostreamer_heap_fragmentation_percent",
+                                   "Internal RAM fragmentation (1 - largest/free)");
+static metrics::Gauge fragPsram("videostreamer_psram_fragmentation_percent",
+                                "PSRAM fragmentation (1 - largest/free)");
+static metrics::Counter allocFailures("videostreamer_tagged_alloc_failures_total",
+                                      "Tagged allocations that returned NULL");
+
+void* alloc(Tag tag, size_t size, uint32_t caps) {
+  void* ptr = heap_caps_malloc(size, caps);
+  size_t actual = ptr ? heap_caps_get_allocated_size(ptr) : 0;
+
+  portENTER_CRITICAL(&tagLock);
+  TagStats& t = tags[tag];
+  if (ptr) {
+    t.allocs++;
+    t.liveBytes += actual;
+    if (t.liveBytes > t.peakBytes) {
+      t.peakBytes = t.liveBytes;
+    }
+  } else {
+    t.failures++;
+  }
+  portEXIT_CRITICAL(&tagLock);
+
+  if (!ptr) {
+    allocFailures.inc();
+  }
+  return ptr;
+}
+
+void release(Tag tag, void* ptr) {
+  if (!ptr) {
+    return;
+  }
+  size_t actual = heap_caps_get_allocated_size(ptr);
+  heap_caps_free(ptr);
+
+  portENTER_CRITICAL(&tagLock);
+  TagStats& t = tags[tag];
+  t.frees++;
+  t.liveBytes = t.liveBytes > actual ? t.liveBytes - actual : 0;
+  portEXIT_CRITICAL(&tagLock);
+}
+
+void readRegion(Region region, RegionStats& out) {
+  multi_heap_info_t info;
+  heap_caps_get_info(&info, regionCaps[region]);
+  out.freeBytes = (uint32_t)info.total_free_bytes;
+  out.largestFreeBlock = (uint32_t)info.largest_free_block;
+  out.minFreeBytes = (uint32_t)info.minimum_free_bytes;
+  out.fragmentationPct = out.freeBytes
+    ? (uint8_t)(100U - (uint32_t)(((uint64_t)out.largestFreeBlock * 100U) / out.freeBytes))
+    : 0;
+}
+
+void sample() {
+  Sample s;
+  s.uptimeSec = (uint32_t)(esp_timer_get_time() / 1000000);
+  for (int r = 0; r < REGION_COUNT; r++) {
+    readRegion((Region)r, s.regions[r]);
+  }
+
+  largestInternal.set((int32_t)s.regions[REGION_INTERNAL].largestFreeBlock);
+  largestPsram.set((int32_t)s.regions[REGION_PSRAM].largestFreeBlock);
+  fragInternal.set(s.regions[REGION_INTERNAL].fragmentationPct);
+  fragPsram.set(s.regions[REGION_PSRAM].fragmentationPct);
+
+  portENTER_CRITICAL(&ringLock);
+  ring[ringHead] = s;
+  ringHead = (ringHead + 1) % MEMSTATS_HISTORY_LEN;
+  if (ringCount < MEMSTATS_HISTORY_LEN) {
+    ringCount++;
+  }
+  portEXIT_CRITICAL(&ringLock);
+}
+
+size_t history(Sample* out, size_t max) {
+  portENTER_CRITICAL(&ringLock);
+  size_t n = ringCount < max ? ringCount : max;
+  size_t start = (ringHead + MEMSTATS_HISTORY_LEN - ringCount) % MEMSTATS_HISTORY_LEN;
+  // Skip the oldest entries if the caller asked for fewer than we hold
+  start = (start + (ringCount - n)) % MEMSTATS_HISTORY_LEN;
+  for (size_t i = 0; i < n; i++) {
+    out[i] = ring[(start + i) % MEMSTATS_HISTORY_LEN];
+  }
+  portEXIT_CRITICAL(&ringLock);
+  return n;
+}
+
+void tagStats(Tag tag, TagStats& out) {
+  portENTER_CRITICAL(&tagLock);
+  out = tags[tag];
+  portEXIT_CRITICAL(&tagLock);
+}
+
+const char* tagName(Tag tag) {
+  switch (tag) {
+    case TAG_RAMDISK: return "ramdisk";
+    case TAG_WAV:     return "wav";
+    case TAG_TRACER:  return "tracer";
+    case TAG_BLE_XFER: return "blexfer";
+    case TAG_LIVE:    return "live";
+    case TAG_RTSP:    return "rtsp";
+    default:          return "other";
+  }
+}
+
+const char* regionName(Region region) {
+  return region == REGION_PSRAM ? "psram" : "internal";
+}
+
+// ============================================
+// Hot-path allocation audit
+// ============================================
+// Each audited task gets a slot the first time it opens a window. The
+// malloc wrappers below look the caller up with a handful of pointer
+// compares, so unaudited tasks pay almost nothing.
+struct TaskCounters {
+  std::atomic<void*> task;
+  std::atomic<uint32_t> allocs;
+  std::atomic<uint32_t> driverAllocs;
+  uint8_t driverDepth;       // Only touched by the owning task
+};
+
+static TaskCounters audited[MEMSTATS_AUDIT_TASKS];
+static HotPathStats hotPaths[HOT_PATH_COUNT];
+static bool hotPathWarned[HOT_PATH_COUNT];
+static portMUX_TYPE hotPathLock = portMUX_INITIALIZER_UNLOCKED;
+
+static metrics::Counter hotPathAllocs("videostreamer_hot_path_allocs_total",
+                                      "Heap allocations inside audited hot paths (expect 0)");
+
+static int findSlot(void* task) {
+  for (int i = 0; i < MEMSTATS_AUDIT_TASKS; i++) {
+    if (audited[i].task.load(std::memory_order_relaxed) == task) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int claimSlot() {
+  void* self = xTaskGetCurrentTaskHandle();
+  int slot = findSlot(self);
+  for (int i = 0; slot < 0 && i < MEMSTATS_AUDIT_TASKS; i++) {
+    void* expected = nullptr;
+    if (audited[i].task.compare_exchange_strong(expected, self)) {
+      slot = i;
+    }
+  }
+  return slot;
+}
+
+static inline void countAlloc() {
+  void* self = xTaskGetCurrentTaskHandle();
+  if (!self) {
+    return;   // Before the scheduler starts
+  }
+  int slot = findSlot(self);
+  if (slot < 0) {
+    return;
+  }
+  TaskCounters& c = audited[slot];
+  if (c.driverDepth) {
+    c.driverAllocs.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    c.allocs.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+AllocWindow::AllocWindow(HotPath path) : path_(path), slot_(claimSlot()), startAllocs_(0), startDriver_(0) {
+  if (slot_ >= 0) {
+    startAllocs_ = audited[slot_].allocs.load(std::memory_order_relaxed);
+    startDriver_ = audited[slot_].driverAllocs.load(std::memory_order_relaxed);
+  }
+}
+
+AllocWindow::~AllocWindow() {
+  if (slot_ < 0) {
+    return;
+  }
+  uint32_t allocs = audited[slot_].allocs.load(std::memory_order_relaxed) - startAllocs_;
+  uint32_t driver = audited[slot_].driverAllocs.load(std::memory_order_relaxed) - startDriver_;
+
+  bool warn = false;
+  portENTER_CRITICAL(&hotPathLock);
+  HotPathStats& hp = hotPaths[path_];
+  hp.runs++;
+  hp.allocs += allocs;
+  hp.driverAllocs += driver;
+  if (allocs && !hotPathWarned[path_]) {
+    hotPathWarned[path_] = true;
+    warn = true;
+  }
+  portEXIT_CRITICAL(&hotPathLock);
+
+  if (allocs) {
+    hotPathAllocs.inc(allocs);
+  }
+  if (warn) {
+    ESP_LOGW(TAG, "%s hot path allocated %u time(s) in one run", hotPathName(path_), allocs);
+  }
+}
+
+DriverScope::DriverScope() {
+  slot_ = findSlot(xTaskGetCurrentTaskHandle());
+  if (slot_ >= 0) {
+    audited[slot_].driverDepth++;
+  }
+}
+
+DriverScope::~DriverScope() {
+  if (slot_ >= 0) {
+    audited[slot_].driverDepth--;
+  }
+}
+
+void forgetTask() {
+  int slot = findSlot(xTaskGetCurrentTaskHandle());
+  if (slot >= 0) {
+    audited[slot].driverDepth = 0;
+    audited[slot].task.store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+bool auditEnabled() {
+  return ALLOC_AUDIT != 0;
+}
+
+void hotPathStats(HotPath path, HotPathStats& out) {
+  portENTER_CRITICAL(&hotPathLock);
+  out = hotPaths[path];
+  portEXIT_CRITICAL(&hotPathLock);
+}
+
+const char* hotPathName(HotPath path) {
+  switch (path) {
+    case HOT_RECORD: return "record";
+    case HOT_STREAM: return "stream";
+    default:         return "audio";
+  }
+}
+
+}  // namespace memstats
+
+// ============================================
+// Allocator wrappers (-Wl,--wrap=...)
+// ============================================
+#if ALLOC_AUDIT
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void* __real_heap_caps_malloc(size_t size, uint32_t caps);
+void* __real_heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+
+void* __wrap_malloc(size_t size) {
+  memstats::countAlloc();
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+  memstats::countAlloc();
+  return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+  memstats::countAlloc();
+  return __real_realloc(ptr, size);
+}
+
+void* __wrap_heap_caps_malloc(size_t size, uint32_t caps) {
+  memstats::countAlloc();
+  return __real_heap_caps_malloc(size, caps);
+}
+
+void* __wrap_heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+  memstats::countAlloc();
+  return __real_heap_caps_calloc(n, size, caps);
+}
+}
+#endif
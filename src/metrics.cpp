@@ -0,0 +1,265 @@
+#include "metrics.h"
+
+#include <stdio.h>
+
+namespace metrics {
+
+// Registry list head. Constant-initialised, so metrics constructed during
+// static initialisation in any translation unit can safely link in.
+static Metric* registryHead = nullptr;
+
+Metric::Metric(const char* name, const char* help, Unit unit)
+  : name_(name), help_(help), unit_(unit), next_(registryHead) {
+  registryHead = this;
+}
+
+const Metric* first() {
+  return registryHead;
+}
+
+// Format 'v' in the metric's export unit. Microseconds become seconds with
+// six decimals so no floating point is needed on the scrape path.
+static int formatValue(char* buf, size_t cap, uint64_t v, Unit unit) {
+  if (unit == UNIT_MICROS) {
+    return snprintf(buf, cap, "%llu.%06u", (unsigned long long)(v / 1000000U), (unsigned)(v % 1000000U));
+  }
+  return snprintf(buf, cap, "%llu", (unsigned long long)v);
+}
+
+// Signed variant for gauges; tenths keep their sign on values above -1
+static int formatSigned(char* buf, size_t cap, int32_t v, Unit unit) {
+  if (unit == UNIT_TENTHS) {
+    uint32_t mag = v < 0 ? (uint32_t)(-(int64_t)v) : (uint32_t)v;
+    return snprintf(buf, cap, "%s%u.%u", v < 0 ? "-" : "", (unsigned)(mag / 10), (unsigned)(mag % 10));
+  }
+  if (unit == UNIT_MICROS && v >= 0) {
+    return formatValue(buf, cap, (uint32_t)v, unit);
+  }
+  return snprintf(buf, cap, "%d", (int)v);
+}
+
+static void emit(WriteFn write, void* ctx, const char* line, int len, size_t cap) {
+  if (len <= 0) {
+    return;
+  }
+  write(ctx, line, (size_t)len < cap ? (size_t)len : cap - 1);
+}
+
+static void writeHeader(WriteFn write, void* ctx, const Metric& m, const char* type) {
+  char line[192];
+  int len = snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n",
+                     m.name(), m.help(), m.name(), type);
+  emit(write, ctx, line, len, sizeof(line));
+}
+
+void Counter::write(WriteFn write, void* ctx) const {
+  writeHeader(write, ctx, *this, "counter");
+  char value[24];
+  formatValue(value, sizeof(value), this->value(), unit_);
+  char line[128];
+  int len = snprintf(line, sizeof(line), "%s %s\n", name_, value);
+  emit(write, ctx, line, len, sizeof(line));
+}
+
+void Gauge::write(WriteFn write, void* ctx) const {
+  writeHeader(write, ctx, *this, "gauge");
+  char value[24];
+  formatSigned(value, sizeof(value), this->value(), unit_);
+  char line[128];
+  int len = snprintf(line, sizeof(line), "%s %s\n", name_, value);
+  emit(write, ctx, line, len, sizeof(line));
+}
+
+GaugeVec::GaugeVec(const char* name, const char* help, const char* label,
+                   const char* const* labelValues, size_t count, Unit unit)
+  : Metric(name, help, unit),
+    label_(label),
+    labelValues_(labelValues),
+    count_(count > METRICS_MAX_SERIES ? METRICS_MAX_SERIES : count) {
+  for (size_t i = 0; i < METRICS_MAX_SERIES; i++) {
+    values_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void GaugeVec::write(WriteFn write, void* ctx) const {
+  writeHeader(write, ctx, *this, "gauge");
+  char value[24];
+  char line[160];
+  for (size_t i = 0; i < count_; i++) {
+    formatSigned(value, sizeof(value), this->value(i), unit_);
+    int len = snprintf(line, sizeof(line), "%s{%s=\"%s\"} %s\n", name_, label_, labelValues_[i], value);
+    emit(write, ctx, line, len, sizeof(line));
+  }
+}
+
+Histogram::Histogram(const char* name, const char* help, const uint32_t* bounds,
+                     size_t bucketCount, Unit unit)
+  : Metric(name, help, unit),
+    bounds_(bounds),
+    bucketCount_(bucketCount > METRICS_MAX_BUCKETS ? METRICS_MAX_BUCKETS : bucketCount),
+    count_(0),
+    sumLo_(0),
+    sumHi_(0) {
+  for (size_t i = 0; i <= METRICS_MAX_BUCKETS; i++) {
+    buckets_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::observe(uint32_t v) {
+  size_t i = 0;
+  while (i < bucketCount_ && v > bounds_[i]) {
+    i++;
+  }
+  buckets_[i].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  uint32_t lo = sumLo_.fetch_add(v, std::memory_order_relaxed);
+  if (lo + v < lo) {
+    sumHi_.fetch_add(1, std::memory_order_release);
+  }
+}
+
+// A reader racing a carry between the two adds can come up 2^32 short for
+// that one read; the retry only guards against a carry landing mid-read.
+uint64_t Histogram::sum() const {
+  uint32_t hi, lo;
+  do {
+    hi = sumHi_.load(std::memory_order_acquire);
+    lo = sumLo_.load(std::memory_order_relaxed);
+  } while (hi != sumHi_.load(std::memory_order_acquire));
+  return ((uint64_t)hi << 32) | lo;
+}
+
+uint32_t Histogram::quantile(float q) const {
+  uint32_t total = count();
+  if (total == 0) {
+    return 0;
+  }
+  uint32_t rank = (uint32_t)(q * total + 0.5f);
+  if (rank == 0) rank = 1;
+  uint32_t cumulative = 0;
+  for (size_t i = 0; i < bucketCount_; i++) {
+    cumulative += buckets_[i].load(std::memory_order_relaxed);
+    if (cumulative >= rank) {
+      return bounds_[i];
+    }
+  }
+  // Landed in +Inf: report the largest finite bound
+  return bucketCount_ ? bounds_[bucketCount_ - 1] : 0;
+}
+
+void Histogram::write(WriteFn write, void* ctx) const {
+  writeHeader(write, ctx, *this, "histogram");
+
+  // Buckets are stored per-range; Prometheus wants them cumulative
+  char line[160];
+  char bound[24];
+  uint32_t cumulative = 0;
+  for (size_t i = 0; i < bucketCount_; i++) {
+    cumulative += buckets_[i].load(std::memory_order_relaxed);
+    formatValue(bound, sizeof(bound), bounds_[i], unit_);
+    int len = snprintf(line, sizeof(line), "%s_bucket{le=\"%s\"} %u\n",
+                       name_, bound, (unsigned)cumulative);
+    emit(write, ctx, line, len, sizeof(line));
+  }
+  cumulative += buckets_[bucketCount_].load(std::memory_order_relaxed);
+  int len = snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %u\n", name_, (unsigned)cumulative);
+  emit(write, ctx, line, len, sizeof(line));
+
+  formatValue(bound, sizeof(bound), sum(), unit_);
+  len = snprintf(line, sizeof(line), "%s_sum %s\n%s_count %u\n",
+                 name_, bound, name_, (unsigned)cumulative);
+  emit(write, ctx, line, len, sizeof(line));
+}
+
+void writePrometheus(WriteFn write, void* ctx) {
+  for (const Metric* m = first(); m; m = m->next()) {
+    m->write(write, ctx);
+  }
+}
+
+// ============================================
+// Bucket layouts
+// ============================================
+const uint32_t kLatencyBucketsUs[] = {
+  100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 500000, 5000000
+};
+const size_t kLatencyBucketCount = sizeof(kLatencyBucketsUs) / sizeof(kLatencyBucketsUs[0]);
+
+const uint32_t kFrameSizeBuckets[] = {
+  4096, 8192, 16384, 32768, 65536, 131072, 262144, 524288
+};
+const size_t kFrameSizeBucketCount = sizeof(kFrameSizeBuckets) / sizeof(kFrameSizeBuckets[0]);
+
+// ============================================
+// Firmware metrics
+// ============================================
+// Defined in one translation unit so registration order (and therefore
+// /metrics output order) is stable; listed in reverse of output order.
+static const char* const kAudioBandLabels[] = {"63", "125", "250", "500", "1000", "2000", "4000", "8000"};   // spectrum.h bands
+GaugeVec audioBandDbfs("videostreamer_audio_band_dbfs", "Audio level per octave band (last spectrum summary)",
+                       "hz", kAudioBandLabels, sizeof(kAudioBandLabels) / sizeof(kAudioBandLabels[0]), UNIT_TENTHS);
+Gauge audioDominantHz("videostreamer_audio_dominant_hz", "Strongest tone in the last spectrum summary (0 = none)");
+Gauge audioPeakDbfs("videostreamer_audio_peak_dbfs", "Audio sample peak over the last summary period", UNIT_TENTHS);
+Gauge audioRmsDbfs("videostreamer_audio_rms_dbfs", "Audio RMS level over the last summary period", UNIT_TENTHS);
+Gauge batteryMv("videostreamer_battery_millivolts", "Battery voltage (filtered by the power governor)");
+Gauge powerLevel("videostreamer_power_level", "Power governor operating point (0 = full)");
+Gauge logRingHighWater("videostreamer_log_ring_high_water", "Deepest the async log ring has been (slots)");
+Gauge uptimeSeconds("videostreamer_uptime_seconds", "Seconds since boot");
+Gauge wifiRssi("videostreamer_wifi_rssi_dbm", "Wi-Fi station RSSI");
+Gauge sdFreeBytesMB("videostreamer_sd_free_megabytes", "Free SD card space (refreshed periodically)");
+Gauge freePsram("videostreamer_psram_free_bytes", "Free PSRAM");
+Gauge freeHeap("videostreamer_heap_free_bytes", "Free internal heap");
+Gauge liveClients("videostreamer_live_clients", "Connected /live WebSocket viewers");
+Gauge rtspClients("videostreamer_rtsp_clients", "Connected RTSP clients");
+Gauge wsQueueDepth("videostreamer_ws_queue_depth", "Deepest outbound WebSocket message queue");
+Gauge wsClients("videostreamer_ws_clients", "Connected audio WebSocket clients");
+
+Histogram commandLatency("videostreamer_command_seconds", "Command post (BLE/HTTP) to completion",
+                         kLatencyBucketsUs, kLatencyBucketCount, UNIT_MICROS);
+Histogram timelapseShotTime("videostreamer_timelapse_shot_seconds", "Timelapse sensor wake to frame appended",
+                            kLatencyBucketsUs, kLatencyBucketCount, UNIT_MICROS);
+Histogram wakeToFrame("videostreamer_wake_to_frame_seconds", "Duty-cycle wake (app start) to first frame",
+                      kLatencyBucketsUs, kLatencyBucketCount, UNIT_MICROS);
+Histogram wifiConnectTime("videostreamer_wifi_connect_seconds", "Wi-Fi begin() or link loss to IP",
+                          kLatencyBucketsUs, kLatencyBucketCount, UNIT_MICROS);
+Histogram sdMutexWait("videostreamer_sd_mutex_wait_seconds", "Time spent waiting for sdMutex",
+                      kLatencyBucketsUs, kLatencyBucketCount, UNIT_MICROS);
+Histogram streamSendTime("videostreamer_stream_send_seconds", "Time from capture to last byte of one /stream frame",
+                         kLatencyBucketsUs, kLatencyBucketCount, UNIT_MICROS);
+Histogram frameSize("videostreamer_frame_size_bytes", "Captured JPEG frame size",
+                    kFrameSizeBuckets, kFrameSizeBucketCount);
+Histogram sdWriteLatency("videostreamer_sd_write_seconds", "SD open+write+close latency per file",
+                         kLatencyBucketsUs, kLatencyBucketCount, UNIT_MICROS);
+Histogram captureLatency("videostreamer_capture_seconds", "esp_camera_fb_get() latency",
+                         kLatencyBucketsUs, kLatencyBucketCount, UNIT_MICROS);
+
+Counter liveAudioDropped("videostreamer_live_audio_dropped_total", "Audio blocks not sent to a /live viewer with a deep queue");
+Counter liveFramesSkipped("videostreamer_live_frames_skipped_total", "Frames a /live viewer missed for lack of credit");
+Counter liveFrames("videostreamer_live_frames_total", "Frames sent to /live viewers");
+Counter rtspFramesSkipped("videostreamer_rtsp_frames_skipped_total", "Camera frames RTP/JPEG (RFC 2435) cannot carry");
+Counter rtspFrames("videostreamer_rtsp_frames_total", "Frames sent to RTSP clients");
+Counter soundEvents("videostreamer_sound_events_total", "Sound activity detector events");
+Counter audioReadErrors("videostreamer_audio_read_errors_total", "I2S reads that returned no samples");
+Counter audioBlocks("videostreamer_audio_blocks_total", "Audio blocks published to the capture ring");
+Counter commandsDropped("videostreamer_commands_dropped_total", "Commands refused because the bus queue was full");
+Counter commandsCompleted("videostreamer_commands_total", "Commands run to completion by their consumer task");
+Counter powerTransitions("videostreamer_power_transitions_total", "Power governor operating point changes");
+Counter timelapseFrames("videostreamer_timelapse_frames_total", "Frames appended to timelapse AVI files");
+Counter dutyCycleFailedWakes("videostreamer_duty_cycle_failed_wakes_total", "Duty-cycle wakes that saved no frame");
+Counter dutyCycleWakes("videostreamer_duty_cycle_wakes_total", "Deep-sleep duty-cycle wakes (counted at the next full boot)");
+Counter wifiLinkLosses("videostreamer_wifi_link_losses_total", "Wi-Fi disconnects after a connection was up");
+Counter wifiFastConnects("videostreamer_wifi_fast_connects_total", "Connections made on the cached BSSID/channel without a scan");
+Counter wifiConnects("videostreamer_wifi_connects_total", "Wi-Fi connections established");
+Counter logSuppressed("videostreamer_log_suppressed_total", "Log lines swallowed by per-site rate limits");
+Counter logDropped("videostreamer_log_dropped_total", "Log lines lost because the log ring was full");
+Counter logWritten("videostreamer_log_lines_total", "Log lines written by the drain task");
+Counter sdMutexTimeouts("videostreamer_sd_mutex_timeouts_total", "sdMutex acquisitions that timed out");
+Counter streamBytes("videostreamer_stream_bytes_total", "Bytes sent on /stream");
+Counter streamFrames("videostreamer_stream_frames_total", "Frames sent on /stream");
+Counter audioClipsSaved("videostreamer_audio_clips_saved_total", "WAV clips written to SD");
+Counter frameSaveErrors("videostreamer_frame_save_errors_total", "Frames that failed to save");
+Counter framesSaved("videostreamer_frames_saved_total", "Frames written to SD");
+Counter captureErrors("videostreamer_capture_errors_total", "esp_camera_fb_get() failures");
+Counter framesCaptured("videostreamer_frames_captured_total", "Frames returned by the camera");
+
+}  // namespace metrics
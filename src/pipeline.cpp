@@ -0,0 +1,275 @@
+#include "pipeline.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "metrics.h"
+#include "tracer.h"
+
+// Generate WAV file header (per Seeed example)
+void generate_wav_header(uint8_t *wav_header, uint32_t wav_size, uint32_t sample_rate) {
+  // See this for reference: http://soundfile.sapp.org/doc/WaveFormat/
+  uint32_t file_size = wav_size + WAV_HEADER_SIZE - 8;
+  uint32_t byte_rate = sample_rate * SAMPLE_BITS / 8;
+  const uint8_t set_wav_header[] = {
+    'R', 'I', 'F', 'F', // ChunkID
+    (uint8_t)file_size, (uint8_t)(file_size >> 8), (uint8_t)(file_size >> 16), (uint8_t)(file_size >> 24), // ChunkSize
+    'W', 'A', 'V', 'E', // Format
+    'f', 'm', 't', ' ', // Subchunk1ID
+    0x10, 0x00, 0x00, 0x00, // Subchunk1Size (16 for PCM)
+    0x01, 0x00, // AudioFormat (1 for PCM)
+    0x01, 0x00, // NumChannels (1 channel)
+    (uint8_t)sample_rate, (uint8_t)(sample_rate >> 8), (uint8_t)(sample_rate >> 16), (uint8_t)(sample_rate >> 24), // SampleRate
+    (uint8_t)byte_rate, (uint8_t)(byte_rate >> 8), (uint8_t)(byte_rate >> 16), (uint8_t)(byte_rate >> 24), // ByteRate
+    0x02, 0x00, // BlockAlign
+    0x10, 0x00, // BitsPerSample (16 bits)
+    'd', 'a', 't', 'a', // Subchunk2ID
+    (uint8_t)wav_size, (uint8_t)(wav_size >> 8), (uint8_t)(wav_size >> 16), (uint8_t)(wav_size >> 24), // Subchunk2Size
+  };
+  memcpy(wav_header, set_wav_header, sizeof(set_wav_header));
+}
+
+void generate_audio_frame_header(uint8_t *header, uint32_t seq, uint32_t sample_rate, int64_t capture_unix_us) {
+  for (int i = 0; i < 4; i++) {
+    header[i] = (uint8_t)(seq >> (8 * i));
+    header[4 + i] = (uint8_t)(sample_rate >> (8 * i));
+  }
+  for (int i = 0; i < 8; i++) {
+    header[8 + i] = (uint8_t)((uint64_t)capture_unix_us >> (8 * i));
+  }
+}
+
+void apply_gain(uint8_t *pcm, size_t len, int gain) {
+  for (size_t i = 0; i + 1 < len; i += SAMPLE_BITS / 8) {
+    uint16_t v = (uint16_t)(pcm[i] | (pcm[i + 1] << 8));
+    v <<= gain;
+    pcm[i] = v & 0xFF;
+    pcm[i + 1] = v >> 8;
+  }
+}
+
+namespace pipeline {
+
+// ============================================
+// Recorder
+// ============================================
+Recorder::Recorder(hal::Camera& camera, hal::Microphone& mic, hal::Storage& storage, hal::Clock& clock)
+  : camera_(camera), mic_(mic), storage_(storage), clock_(clock), listener_(nullptr), frameIntervalMs_(0) {}
+
+void Recorder::frameFilename(char* out, size_t cap, uint32_t frameNo) {
+  char ts[32];
+  if (clock_.timestamp(ts, sizeof(ts))) {
+    snprintf(out, cap, "/video/%s_frame_%06lu.jpg", ts, (unsigned long)frameNo);
+  } else {
+    snprintf(out, cap, "/video/frame_%06lu.jpg", (unsigned long)frameNo);
+  }
+}
+
+void Recorder::audioFilename(char* out, size_t cap, uint32_t clipNo) {
+  char ts[32];
+  if (clock_.timestamp(ts, sizeof(ts))) {
+    snprintf(out, cap, "/%s_%s_%06lu.wav", WAV_FILE_NAME, ts, (unsigned long)clipNo);
+  } else {
+    snprintf(out, cap, "/%s_%06lu.wav", WAV_FILE_NAME, (unsigned long)clipNo);
+  }
+}
+
+SaveResult Recorder::saveFrame(const hal::Frame& frame, uint32_t frameNo, char* pathOut, size_t pathCap) {
+  TRACE_SCOPE("saveFrameToSD");
+  frameFilename(pathOut, pathCap, frameNo);
+
+  if (!storage_.beginWrite(pathOut, 1000)) {
+    metrics::frameSaveErrors.inc();
+    return storage_.lastBeginTimedOut() ? SAVE_LOCK_TIMEOUT : SAVE_OPEN_FAILED;
+  }
+
+  TRACE_BEGIN("sd.write");
+  int64_t writeStart = clock_.micros();
+  size_t written = storage_.append(frame.buf, frame.len);
+  storage_.endWrite();
+  metrics::sdWriteLatency.observe((uint32_t)(clock_.micros() - writeStart));
+  TRACE_END("sd.write");
+
+  if (written != frame.len) {
+    metrics::frameSaveErrors.inc();
+    return SAVE_SHORT_WRITE;
+  }
+  metrics::framesSaved.inc();
+  return SAVE_OK;
+}
+
+Recorder::ClipStats Recorder::recordVideoClip(uint32_t durationMs, const volatile bool* running,
+                                              volatile unsigned long& frameCounter) {
+  TRACE_SCOPE("recordingTask.video_clip");
+  ClipStats stats = {0, 0, 0, 0};
+  uint32_t clipStart = clock_.millis();
+  char path[64];
+
+  while (clock_.millis() - clipStart < durationMs && (!running || *running)) {
+    uint32_t frameStart = clock_.millis();
+    hal::Frame frame;
+    TRACE_BEGIN("camera.fb_get");
+    int64_t captureStart = clock_.micros();
+    bool ok = camera_.grab(frame);
+    metrics::captureLatency.observe((uint32_t)(clock_.micros() - captureStart));
+    TRACE_END("camera.fb_get");
+
+    if (!ok) {
+      stats.captureErrors++;
+      metrics::captureErrors.inc();
+      if (listener_) listener_->onCaptureError();
+      clock_.delayMs(100);  // Wait a bit before retry
+    } else {
+      stats.captured++;
+      metrics::framesCaptured.inc();
+      metrics::frameSize.observe((uint32_t)frame.len);
+
+      uint32_t frameNo = (uint32_t)frameCounter;
+      SaveResult result = saveFrame(frame, frameNo, path, sizeof(path));
+      size_t len = frame.len;
+      camera_.release(frame);
+
+      if (result == SAVE_OK) {
+        stats.saved++;
+        frameCounter++;
+      } else {
+        stats.saveErrors++;
+      }
+      if (listener_) listener_->onFrameSaved(frameNo, path, len, result);
+    }
+    uint32_t spent = clock_.millis() - frameStart;
+    uint32_t interval = frameIntervalMs_;
+    clock_.delayMs(spent + 1 < interval ? interval - spent : 1);  // Frame rate cap, or minimal delay for watchdog
+  }
+  return stats;
+}
+
+SaveResult Recorder::recordAudioClip(uint8_t* buffer, size_t capacity, uint32_t clipNo,
+                                     char* pathOut, size_t pathCap, const volatile bool* running) {
+  // Read from the microphone BEFORE taking the card so the lock isn't held for seconds
+  // Give up at twice the clip length so a stalled microphone can't hang the recorder
+  TRACE_BEGIN("record_wav.capture");
+  uint32_t captureStart = clock_.millis();
+  uint32_t deadlineMs = (uint32_t)((uint64_t)capacity * 1000U * 2U / (mic_.sampleRate() * 2U)) + 1000U;
+  size_t bytesRead = 0;
+  while (bytesRead + 1 < capacity && clock_.millis() - captureStart < deadlineMs && (!running || *running)) {
+    bytesRead += mic_.read((int16_t*)(buffer + bytesRead), (capacity - bytesRead) / 2) * 2;
+  }
+  TRACE_END("record_wav.capture");
+
+  if (bytesRead == 0) {
+    return SAVE_NO_DATA;
+  }
+
+  // Increase volume
+  apply_gain(buffer, bytesRead, VOLUME_GAIN);
+
+  audioFilename(pathOut, pathCap, clipNo);
+  if (!storage_.beginWrite(pathOut, 2000)) {
+    return storage_.lastBeginTimedOut() ? SAVE_LOCK_TIMEOUT : SAVE_OPEN_FAILED;
+  }
+
+  TRACE_BEGIN("sd.write");
+  int64_t writeStart = clock_.micros();
+  uint8_t wav_header[WAV_HEADER_SIZE];
+  generate_wav_header(wav_header, (uint32_t)bytesRead, mic_.sampleRate());
+  storage_.append(wav_header, WAV_HEADER_SIZE);
+  size_t written = storage_.append(buffer, bytesRead);
+  storage_.endWrite();
+  metrics::sdWriteLatency.observe((uint32_t)(clock_.micros() - writeStart));
+  TRACE_END("sd.write");
+
+  if (written != bytesRead) {
+    return SAVE_SHORT_WRITE;
+  }
+  metrics::audioClipsSaved.inc();
+  return SAVE_OK;
+}
+
+// ============================================
+// MJPEG streamer
+// ============================================
+static const char kTrailer[] = "\r\n";
+static const size_t kTrailerLen = sizeof(kTrailer) - 1;
+
+MjpegStreamer::MjpegStreamer(hal::Camera& camera, hal::Clock& clock)
+  : camera_(camera), clock_(clock), copy_(nullptr), copyCap_(0), frameLen_(0), haveFrame_(false),
+    frameStartUs_(0), headerLen_(0), offset_(0), framesSent_(0) {
+}
+
+MjpegStreamer::~MjpegStreamer() {
+  free(copy_);
+}
+
+size_t MjpegStreamer::fill(uint8_t* buf, size_t maxLen) {
+  TRACE_SCOPE("handleStream.chunk");
+
+  if (!haveFrame_) {
+    frameStartUs_ = clock_.micros();
+    hal::Frame frame;
+    bool ok = camera_.grab(frame);
+    metrics::captureLatency.observe((uint32_t)(clock_.micros() - frameStartUs_));
+    if (!ok) {
+      metrics::captureErrors.inc();
+      return 0;
+    }
+    metrics::framesCaptured.inc();
+    metrics::frameSize.observe((uint32_t)frame.len);
+    if (frame.len > copyCap_) {
+      // Rounded up so small size changes don't reallocate every frame
+      size_t cap = (frame.len + 16383) & ~(size_t)16383;
+      uint8_t* grown = (uint8_t*)realloc(copy_, cap);
+      if (!grown) {
+        camera_.release(frame);
+        return 0;
+      }
+      copy_ = grown;
+      copyCap_ = cap;
+    }
+    memcpy(copy_, frame.buf, frame.len);
+    frameLen_ = frame.len;
+    camera_.release(frame);
+    haveFrame_ = true;
+    offset_ = 0;
+    int n = snprintf(header_, sizeof(header_),
+                     "--frame\r\n"
+                     "Content-Type: image/jpeg\r\n"
+                     "Content-Length: %u\r\n\r\n",
+                     (unsigned)frameLen_);
+    headerLen_ = n > 0 ? (size_t)n : 0;
+  }
+
+  // Part layout: header | JPEG body | trailer
+  size_t total = headerLen_ + frameLen_ + kTrailerLen;
+  size_t used = 0;
+  while (used < maxLen && offset_ < total) {
+    const uint8_t* src;
+    size_t avail;
+    if (offset_ < headerLen_) {
+      src = (const uint8_t*)header_ + offset_;
+      avail = headerLen_ - offset_;
+    } else if (offset_ < headerLen_ + frameLen_) {
+      src = copy_ + (offset_ - headerLen_);
+      avail = headerLen_ + frameLen_ - offset_;
+    } else {
+      src = (const uint8_t*)kTrailer + (offset_ - headerLen_ - frameLen_);
+      avail = total - offset_;
+    }
+    size_t n = avail < maxLen - used ? avail : maxLen - used;
+    memcpy(buf + used, src, n);
+    used += n;
+    offset_ += n;
+  }
+
+  if (offset_ >= total) {
+    haveFrame_ = false;
+    framesSent_++;
+    metrics::streamFrames.inc();
+    metrics::streamSendTime.observe((uint32_t)(clock_.micros() - frameStartUs_));
+  }
+  metrics::streamBytes.inc((uint32_t)used);
+  return used;
+}
+
+}  // namespace pipeline
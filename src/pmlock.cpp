@@ -0,0 +1,188 @@
+#include "pmlock.h"
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_attr.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char* TAG = "pmlock";
+
+namespace pmlock {
+
+struct LockDef {
+  const char* name;
+  esp_pm_lock_type_t type;
+};
+
+static const LockDef kLocks[LOCK_COUNT] = {
+  {"camera",  ESP_PM_NO_LIGHT_SLEEP},
+  {"capture", ESP_PM_CPU_FREQ_MAX},
+  {"sd",      ESP_PM_NO_LIGHT_SLEEP},
+  {"audio",   ESP_PM_NO_LIGHT_SLEEP},
+  {"wifi_tx", ESP_PM_CPU_FREQ_MAX},
+  {"usb_msc", ESP_PM_NO_LIGHT_SLEEP},
+};
+
+static esp_pm_lock_handle_t handles[LOCK_COUNT] = {};
+static bool pmEnabled = false;
+
+// Accounting, guarded by statsLock
+static portMUX_TYPE statsLock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t holders[LOCK_COUNT] = {};
+static uint32_t acquisitions[LOCK_COUNT] = {};
+static uint64_t heldUs[LOCK_COUNT] = {};
+static int64_t heldSinceUs[LOCK_COUNT] = {};
+static uint64_t stateUs[STATE_COUNT] = {};
+static State state = STATE_IDLE;
+static int64_t stateSinceUs = 0;
+static int64_t windowStartUs = 0;
+
+static volatile int64_t lightSleepUs = -1;
+static volatile uint32_t lightSleeps = 0;
+
+// Caller holds statsLock
+static State currentState() {
+  bool awake = false;
+  for (int i = 0; i < LOCK_COUNT; i++) {
+    if (!holders[i]) {
+      continue;
+    }
+    if (kLocks[i].type == ESP_PM_CPU_FREQ_MAX) {
+      return STATE_CPU_MAX;
+    }
+    awake = true;
+  }
+  return awake ? STATE_AWAKE : STATE_IDLE;
+}
+
+// Caller holds statsLock
+static void updateState(int64_t now) {
+  stateUs[state] += (uint64_t)(now - stateSinceUs);
+  stateSinceUs = now;
+  state = currentState();
+}
+
+#if defined(CONFIG_PM_LIGHT_SLEEP_CALLBACKS)
+// Runs on the idle task with the scheduler stopped
+static esp_err_t IRAM_ATTR onLightSleepExit(int64_t sleptUs, void* arg) {
+  (void)arg;
+  lightSleepUs = lightSleepUs + sleptUs;
+  lightSleeps = lightSleeps + 1;
+  return ESP_OK;
+}
+#endif
+
+bool begin() {
+  for (int i = 0; i < LOCK_COUNT; i++) {
+    if (!handles[i] && esp_pm_lock_create(kLocks[i].type, 0, kLocks[i].name, &handles[i]) != ESP_OK) {
+      ESP_LOGW(TAG, "Cannot create PM lock %s", kLocks[i].name);
+      return false;
+    }
+  }
+#if defined(CONFIG_PM_LIGHT_SLEEP_CALLBACKS)
+  if (lightSleepUs < 0) {
+    esp_pm_sleep_cbs_register_config_t cbs = {};
+    cbs.exit_cb = onLightSleepExit;
+    if (esp_pm_light_sleep_register_cbs(&cbs) == ESP_OK) {
+      lightSleepUs = 0;
+    }
+  }
+#endif
+
+  // Locks taken before begin() only counted; take them for real now
+  portENTER_CRITICAL(&statsLock);
+  uint32_t held[LOCK_COUNT];
+  memcpy(held, holders, sizeof(held));
+  pmEnabled = true;
+  portEXIT_CRITICAL(&statsLock);
+  for (int i = 0; i < LOCK_COUNT; i++) {
+    for (uint32_t n = 0; n < held[i]; n++) {
+      esp_pm_lock_acquire(handles[i]);
+    }
+  }
+  return true;
+}
+
+void acquire(Id id) {
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&statsLock);
+  bool live = pmEnabled;
+  if (holders[id]++ == 0) {
+    heldSinceUs[id] = now;
+    acquisitions[id]++;
+    updateState(now);
+  }
+  portEXIT_CRITICAL(&statsLock);
+  if (live) {
+    esp_pm_lock_acquire(handles[id]);
+  }
+}
+
+void release(Id id) {
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&statsLock);
+  if (!holders[id]) {
+    portEXIT_CRITICAL(&statsLock);
+    return;   // Unbalanced release
+  }
+  bool live = pmEnabled;
+  if (--holders[id] == 0) {
+    heldUs[id] += (uint64_t)(now - heldSinceUs[id]);
+    updateState(now);
+  }
+  portEXIT_CRITICAL(&statsLock);
+  if (live) {
+    esp_pm_lock_release(handles[id]);
+  }
+}
+
+const char* stateName(State s) {
+  switch (s) {
+    case STATE_CPU_MAX: return "cpu_max";
+    case STATE_AWAKE:   return "awake";
+    case STATE_IDLE:    return "idle";
+    default:            return "?";
+  }
+}
+
+void snapshot(Residency& residency, LockStats locks[LOCK_COUNT]) {
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&statsLock);
+  updateState(now);
+  memcpy(residency.stateUs, stateUs, sizeof(stateUs));
+  residency.sinceUs = (uint64_t)windowStartUs;
+  residency.pmEnabled = pmEnabled;
+  for (int i = 0; i < LOCK_COUNT; i++) {
+    locks[i].name = kLocks[i].name;
+    locks[i].cpuMax = kLocks[i].type == ESP_PM_CPU_FREQ_MAX;
+    locks[i].holders = holders[i];
+    locks[i].acquisitions = acquisitions[i];
+    locks[i].heldUs = heldUs[i] + (holders[i] ? (uint64_t)(now - heldSinceUs[i]) : 0);
+  }
+  portEXIT_CRITICAL(&statsLock);
+  residency.lightSleepUs = lightSleepUs;
+  residency.lightSleeps = lightSleeps;
+}
+
+void reset() {
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&statsLock);
+  memset(stateUs, 0, sizeof(stateUs));
+  memset(heldUs, 0, sizeof(heldUs));
+  memset(acquisitions, 0, sizeof(acquisitions));
+  for (int i = 0; i < LOCK_COUNT; i++) {
+    heldSinceUs[i] = now;
+  }
+  stateSinceUs = now;
+  windowStartUs = now;
+  portEXIT_CRITICAL(&statsLock);
+  if (lightSleepUs >= 0) {
+    lightSleepUs = 0;
+  }
+  lightSleeps = 0;
+}
+
+}  // namespace pmlock
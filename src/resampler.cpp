@@ -0,0 +1,188 @@
+#include "resampler.h"
+
+#include <string.h>
+
+#define RESAMPLE_COEFF_BITS 14
+
+namespace resample {
+
+// ============================================
+// Compile-time filter design
+// ============================================
+// Kaiser-windowed sinc, evaluated by constexpr code so the tables are in
+// flash with no start-up cost. Double-precision series stand in for
+// <cmath>, which is not constexpr. Taps are Q14 rather than Q15: a long
+// sinc sums to a little over 2 in absolute value, which a full-scale input
+// could push past int32 at Q15.
+namespace design {
+
+constexpr double kPi = 3.14159265358979323846;
+
+constexpr double sine(double x) {
+  while (x > kPi) x -= 2 * kPi;
+  while (x < -kPi) x += 2 * kPi;
+  double term = x, sum = x;
+  for (int n = 1; n < 14; n++) {
+    term *= -x * x / ((2 * n) * (2 * n + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr double squareRoot(double v) {
+  if (v <= 0) return 0;
+  double x = v > 1 ? v : 1;
+  for (int i = 0; i < 40; i++) x = 0.5 * (x + v / x);
+  return x;
+}
+
+// Modified Bessel function of the first kind, order 0
+constexpr double besselI0(double x) {
+  double sum = 1, term = 1;
+  for (int k = 1; k < 40; k++) {
+    term *= (x / (2 * k)) * (x / (2 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+template <int Up, int Taps>
+struct Bank {
+  alignas(16) int16_t c[Up][Taps];
+  int32_t absSum[Up];   // Worst-case gain per phase, Q14
+};
+
+// 'cutoff' in cycles per sample at the design rate (Up x input rate);
+// beta 5.65 gives about 60 dB of stopband rejection
+template <int Up, int Taps>
+constexpr Bank<Up, Taps> lowpass(double cutoff, double beta) {
+  constexpr int N = Up * Taps;
+  double h[N] = {};
+  double sum = 0;
+  for (int i = 0; i < N; i++) {
+    double m = i - (N - 1) / 2.0;
+    double sinc = m == 0 ? 2 * cutoff : sine(2 * kPi * cutoff * m) / (kPi * m);
+    double r = 2.0 * i / (N - 1) - 1;
+    h[i] = sinc * besselI0(beta * squareRoot(1 - r * r)) / besselI0(beta);
+    sum += h[i];
+  }
+  Bank<Up, Taps> bank = {};
+  for (int p = 0; p < Up; p++) {
+    bank.absSum[p] = 0;
+    for (int j = 0; j < Taps; j++) {
+      double v = h[j * Up + p] * Up / sum * (1 << RESAMPLE_COEFF_BITS);   // DC gain 1 per phase
+      int32_t q = v >= 0 ? (int32_t)(v + 0.5) : -(int32_t)(-v + 0.5);
+      q = q > 32767 ? 32767 : q < -32768 ? -32768 : q;
+      bank.c[p][Taps - 1 - j] = (int16_t)q;   // Reversed: oldest sample first
+      bank.absSum[p] += q < 0 ? -q : q;
+    }
+  }
+  return bank;
+}
+
+// int32 accumulation is safe while sum(|c|) * 32768 < 2^31
+template <int Up, int Taps>
+constexpr bool fitsAccumulator(const Bank<Up, Taps>& bank) {
+  for (int p = 0; p < Up; p++) {
+    if (bank.absSum[p] >= 65536) return false;
+  }
+  return true;
+}
+
+}  // namespace design
+
+// 16 -> 8 kHz: pass 0-3.4 kHz, stop from 4 kHz
+constexpr design::Bank<1, 104> kHalf = design::lowpass<1, 104>(3700.0 / 16000, 5.65);
+// 16 -> 12 kHz (up 3 to 48 kHz, down 4): pass 0-5 kHz, stop from 6 kHz
+constexpr design::Bank<3, 64> kThreeQuarters = design::lowpass<3, 64>(5500.0 / 48000, 5.65);
+
+static_assert(design::fitsAccumulator(kHalf), "16->8 kHz filter can overflow the accumulator");
+static_assert(design::fitsAccumulator(kThreeQuarters), "16->12 kHz filter can overflow the accumulator");
+
+const Filter kFilters[] = {
+  {1, 2, 104, 3400.0f, 4000.0f, &kHalf.c[0][0]},
+  {3, 4, 64, 5000.0f, 6000.0f, &kThreeQuarters.c[0][0]},
+};
+const size_t kFilterCount = sizeof(kFilters) / sizeof(kFilters[0]);
+
+// ============================================
+// Runtime
+// ============================================
+static uint32_t gcd(uint32_t a, uint32_t b) {
+  while (b) {
+    uint32_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+bool Resampler::begin(uint32_t inRate, uint32_t outRate) {
+  filter_ = nullptr;
+  inRate_ = inRate;
+  outRate_ = outRate;
+  if (inRate && inRate != outRate) {
+    uint32_t g = gcd(inRate, outRate);
+    for (size_t i = 0; i < kFilterCount; i++) {
+      if (kFilters[i].up == outRate / g && kFilters[i].down == inRate / g) {
+        filter_ = &kFilters[i];
+      }
+    }
+    if (!filter_) {
+      return false;
+    }
+  }
+  reset();
+  return inRate != 0;
+}
+
+void Resampler::reset() {
+  memset(history_, 0, sizeof(history_));
+  pos_ = 0;
+  phase_ = 0;
+}
+
+size_t Resampler::maxOutput(size_t n) const {
+  return filter_ ? (n * filter_->up + filter_->down - 1) / filter_->down + 1 : n;
+}
+
+// Q14 dot product, rounded and saturated
+static inline int16_t dot(const int16_t* x, const int16_t* c, int taps) {
+  int32_t acc = 1 << (RESAMPLE_COEFF_BITS - 1);
+  for (int i = 0; i < taps; i++) {
+    acc += (int32_t)x[i] * c[i];
+  }
+  acc >>= RESAMPLE_COEFF_BITS;
+  return (int16_t)(acc > 32767 ? 32767 : acc < -32768 ? -32768 : acc);
+}
+
+size_t Resampler::process(const int16_t* in, size_t n, int16_t* out, size_t cap) {
+  if (!filter_) {
+    size_t count = n < cap ? n : cap;
+    memcpy(out, in, count * sizeof(int16_t));
+    return count;
+  }
+  const int taps = filter_->taps;
+  const int up = filter_->up;
+  const int down = filter_->down;
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++) {
+    history_[pos_] = in[i];
+    history_[pos_ + taps] = in[i];
+    if (++pos_ == taps) {
+      pos_ = 0;
+    }
+    // Every output whose position on the up-sampled grid falls at or after
+    // this input sample and before the next one
+    while (phase_ < up) {
+      if (count < cap) {
+        out[count++] = dot(&history_[pos_], filter_->coeffs + phase_ * taps, taps);
+      }
+      phase_ += down;
+    }
+    phase_ -= up;
+  }
+  return count;
+}
+
+}  // namespace resample
@@ -0,0 +1,364 @@
+#include "rtp.h"
+
+#include <string.h>
+
+#define RTCP_PT_SR 200
+#define RTCP_PT_SDES 202
+#define NTP_UNIX_OFFSET 2208988800ULL   // 1900 -> 1970, seconds
+
+namespace rtp {
+
+static void put16(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)(v >> 8);
+  p[1] = (uint8_t)v;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+static uint16_t get16(const uint8_t* p) {
+  return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+// ============================================
+// Stream
+// ============================================
+void Stream::begin(uint8_t payloadType, uint32_t clockRate, uint32_t ssrc, uint16_t firstSeq, uint32_t firstTimestamp) {
+  payloadType_ = payloadType;
+  clockRate_ = clockRate;
+  ssrc_ = ssrc;
+  seq_ = firstSeq;
+  anchored_ = false;
+  anchorUs_ = 0;
+  anchorTs_ = firstTimestamp;
+  packets_ = 0;
+  octets_ = 0;
+}
+
+uint32_t Stream::timestampAt(int64_t us) const {
+  if (!anchored_) {
+    return anchorTs_;
+  }
+  int64_t ticks = (us - anchorUs_) * (int64_t)clockRate_ / 1000000;
+  return anchorTs_ + (uint32_t)ticks;
+}
+
+void Stream::anchor(int64_t us, uint32_t timestamp) {
+  anchorUs_ = us;
+  anchorTs_ = timestamp;
+  anchored_ = true;
+}
+
+size_t Stream::header(uint8_t* out, uint32_t timestamp, bool marker, size_t payloadBytes) {
+  out[0] = 0x80;   // Version 2, no padding, no extension, no CSRCs
+  out[1] = (uint8_t)((marker ? 0x80 : 0) | payloadType_);
+  put16(out + 2, seq_++);
+  put32(out + 4, timestamp);
+  put32(out + 8, ssrc_);
+  packets_++;
+  octets_ += (uint32_t)payloadBytes;
+  return RTP_HEADER_SIZE;
+}
+
+size_t Stream::senderReport(uint8_t* out, size_t cap, int64_t nowUs, int64_t unixUs, const char* cname) const {
+  const size_t nameLen = strlen(cname) < 255 ? strlen(cname) : 255;
+  const size_t sdesLen = (8 + 2 + nameLen + 1 + 3) & ~(size_t)3;   // Item list ends with a zero, padded to 32 bits
+  if (cap < 28 + sdesLen) {
+    return 0;
+  }
+  uint64_t ntpSeconds = (uint64_t)(unixUs / 1000000) + NTP_UNIX_OFFSET;
+  uint64_t ntpFraction = ((uint64_t)(unixUs % 1000000) << 32) / 1000000;
+
+  out[0] = 0x80;   // No reception report blocks
+  out[1] = RTCP_PT_SR;
+  put16(out + 2, 6);
+  put32(out + 4, ssrc_);
+  put32(out + 8, (uint32_t)ntpSeconds);
+  put32(out + 12, (uint32_t)ntpFraction);
+  put32(out + 16, timestampAt(nowUs));
+  put32(out + 20, packets_);
+  put32(out + 24, octets_);
+
+  uint8_t* sdes = out + 28;
+  memset(sdes, 0, sdesLen);
+  sdes[0] = 0x81;   // One chunk
+  sdes[1] = RTCP_PT_SDES;
+  put16(sdes + 2, (uint32_t)(sdesLen / 4 - 1));
+  put32(sdes + 4, ssrc_);
+  sdes[8] = 1;      // CNAME
+  sdes[9] = (uint8_t)nameLen;
+  memcpy(sdes + 10, cname, nameLen);
+  return 28 + sdesLen;
+}
+
+// ============================================
+// JPEG (RFC 2435)
+// ============================================
+const uint8_t kStdDcLuma[1 + 16 + 12] = {
+  0x00,
+  0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0,
+  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11
+};
+
+const uint8_t kStdDcChroma[1 + 16 + 12] = {
+  0x01,
+  0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0,
+  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11
+};
+
+const uint8_t kStdAcLuma[1 + 16 + 162] = {
+  0x10,
+  0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d,
+  0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+  0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+  0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+  0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+  0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+  0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+  0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+  0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+  0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+  0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+  0xf9, 0xfa
+};
+
+const uint8_t kStdAcChroma[1 + 16 + 162] = {
+  0x11,
+  0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77,
+  0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+  0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+  0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+  0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+  0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+  0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+  0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+  0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+  0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+  0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+  0xf9, 0xfa
+};
+
+// One table of a DHT segment against the standard one for its class/id;
+// returns its length, or 0 if it differs
+static size_t standardHuffman(const uint8_t* p, const uint8_t* end) {
+  if (end - p < 17) {
+    return 0;
+  }
+  size_t symbols = 0;
+  for (int i = 1; i <= 16; i++) {
+    symbols += p[i];
+  }
+  size_t len = 17 + symbols;
+  if ((size_t)(end - p) < len) {
+    return 0;
+  }
+  const uint8_t* std;
+  size_t stdLen;
+  switch (p[0]) {
+    case 0x00: std = kStdDcLuma; stdLen = sizeof(kStdDcLuma); break;
+    case 0x01: std = kStdDcChroma; stdLen = sizeof(kStdDcChroma); break;
+    case 0x10: std = kStdAcLuma; stdLen = sizeof(kStdAcLuma); break;
+    case 0x11: std = kStdAcChroma; stdLen = sizeof(kStdAcChroma); break;
+    default: return 0;
+  }
+  return len == stdLen && memcmp(p, std, len) == 0 ? len : 0;
+}
+
+const char* parseJpeg(const uint8_t* jpeg, size_t len, JpegInfo& out) {
+  memset(&out, 0, sizeof(out));
+  if (len < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8) {
+    return "not a JPEG";
+  }
+  bool haveFrame = false;
+  size_t pos = 2;
+  while (pos + 4 <= len) {
+    if (jpeg[pos] != 0xFF) {
+      return "corrupt marker";
+    }
+    const uint8_t marker = jpeg[pos + 1];
+    if (marker == 0xFF) {   // Fill byte
+      pos++;
+      continue;
+    }
+    const size_t seg = pos + 4;
+    const size_t end = pos + 2 + get16(jpeg + pos + 2);
+    if (end > len || end < seg) {
+      return "truncated segment";
+    }
+
+    if (marker == 0xDB) {   // DQT
+      for (size_t p = seg; p < end; p += 65) {
+        if (jpeg[p] >> 4) {
+          return "16-bit quantization tables";
+        }
+        if (p + 65 > end) {
+          return "truncated DQT";
+        }
+        if ((jpeg[p] & 0x0F) < 2) {
+          out.qtables[jpeg[p] & 0x0F] = jpeg + p + 1;
+        }
+      }
+    } else if (marker == 0xC0) {   // SOF0, baseline
+      if (end - seg < 15 || jpeg[seg] != 8 || jpeg[seg + 5] != 3) {
+        return "not 8-bit YCbCr";
+      }
+      out.height = get16(jpeg + seg + 1);
+      out.width = get16(jpeg + seg + 3);
+      const uint8_t* c = jpeg + seg + 6;   // id, sampling, table per component
+      if (c[1] == 0x21) {
+        out.type = 0;
+      } else if (c[1] == 0x22) {
+        out.type = 1;
+      } else {
+        return "luma sampling not 4:2:2 or 4:2:0";
+      }
+      if (c[2] != 0 || c[4] != 0x11 || c[5] != 1 || c[7] != 0x11 || c[8] != 1) {
+        return "unexpected chroma sampling or tables";
+      }
+      haveFrame = true;
+    } else if (marker >= 0xC1 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+      return "not baseline JPEG";
+    } else if (marker == 0xC4) {   // DHT
+      for (size_t p = seg; p < end;) {
+        size_t n = standardHuffman(jpeg + p, jpeg + end);
+        if (!n) {
+          return "non-standard Huffman tables";
+        }
+        p += n;
+      }
+    } else if (marker == 0xDD) {   // DRI
+      out.restartInterval = get16(jpeg + seg);
+    } else if (marker == 0xDA) {   // SOS
+      if (!haveFrame) {
+        return "no SOF0 before SOS";
+      }
+      if (!out.qtables[0] || !out.qtables[1]) {
+        return "missing quantization tables";
+      }
+      if (jpeg[seg] != 3 || jpeg[seg + 2] != 0x00 || jpeg[seg + 4] != 0x11 || jpeg[seg + 6] != 0x11) {
+        return "unexpected scan tables";
+      }
+      if (out.width == 0 || out.height == 0 || out.width > 2040 || out.height > 2040 ||
+          out.width % 8 || out.height % 8) {
+        return "size not a multiple of 8 up to 2040";
+      }
+      if (out.restartInterval) {
+        out.type += 64;
+      }
+      out.scan = jpeg + end;
+      out.scanLen = len - end;
+      // Drop EOI and anything the driver left after it; byte stuffing keeps
+      // FF D9 out of the scan itself
+      for (size_t i = out.scanLen; i >= 2; i--) {
+        if (out.scan[i - 2] == 0xFF && out.scan[i - 1] == 0xD9) {
+          out.scanLen = i - 2;
+          break;
+        }
+      }
+      return nullptr;
+    }
+    pos = end;
+  }
+  return "no SOS";
+}
+
+void JpegPacketizer::begin(const JpegInfo& info, uint32_t timestamp) {
+  info_ = info;
+  timestamp_ = timestamp;
+  offset_ = 0;
+  done_ = info.scanLen == 0;
+}
+
+size_t JpegPacketizer::next(Stream& stream, uint8_t* out, size_t cap) {
+  const bool restart = info_.type >= 64;
+  const bool tables = offset_ == 0;
+  const size_t headers = RTP_HEADER_SIZE + 8 + (restart ? 4 : 0) + (tables ? 4 + 128 : 0);
+  if (done_ || cap <= headers) {
+    return 0;
+  }
+  size_t chunk = info_.scanLen - offset_;
+  if (chunk > cap - headers) {
+    chunk = cap - headers;
+  }
+  const bool last = offset_ + chunk == info_.scanLen;
+
+  uint8_t* p = out + stream.header(out, timestamp_, last, headers - RTP_HEADER_SIZE + chunk);
+  p[0] = 0;   // Type-specific
+  p[1] = (uint8_t)(offset_ >> 16);
+  p[2] = (uint8_t)(offset_ >> 8);
+  p[3] = (uint8_t)offset_;
+  p[4] = info_.type;
+  p[5] = 255;   // Q: tables in-band
+  p[6] = (uint8_t)(info_.width / 8);
+  p[7] = (uint8_t)(info_.height / 8);
+  p += 8;
+  if (restart) {
+    // Restart intervals are not aligned to packets: F = L = 1, count 0x3FFF
+    put16(p, info_.restartInterval);
+    put16(p + 2, 0xFFFF);
+    p += 4;
+  }
+  if (tables) {
+    p[0] = 0;   // MBZ
+    p[1] = 0;   // 8-bit tables
+    put16(p + 2, 128);
+    memcpy(p + 4, info_.qtables[0], 64);
+    memcpy(p + 68, info_.qtables[1], 64);
+    p += 4 + 128;
+  }
+  memcpy(p, info_.scan + offset_, chunk);
+  offset_ += chunk;
+  done_ = last;
+  return headers + chunk;
+}
+
+// ============================================
+// Audio
+// ============================================
+size_t packL16(const int16_t* pcm, size_t samples, uint8_t* out) {
+  for (size_t i = 0; i < samples; i++) {
+    put16(out + 2 * i, (uint16_t)pcm[i]);
+  }
+  return samples * 2;
+}
+
+uint8_t linearToUlaw(int16_t sample) {
+  const int kBias = 0x84;
+  const int kClip = 32635;
+  int s = sample;
+  int sign = 0;
+  if (s < 0) {
+    s = -s;
+    sign = 0x80;
+  }
+  if (s > kClip) {
+    s = kClip;
+  }
+  s += kBias;
+  int exponent = 7;
+  for (int mask = 0x4000; !(s & mask) && exponent > 0; mask >>= 1) {
+    exponent--;
+  }
+  int mantissa = (s >> (exponent + 3)) & 0x0F;
+  return (uint8_t)~(sign | (exponent << 4) | mantissa);
+}
+
+int16_t ulawToLinear(uint8_t code) {
+  code = (uint8_t)~code;
+  int exponent = (code >> 4) & 0x07;
+  int s = ((((code & 0x0F) << 3) + 0x84) << exponent) - 0x84;
+  return (int16_t)(code & 0x80 ? -s : s);
+}
+
+size_t packPcmu(const int16_t* pcm, size_t samples, uint8_t* out) {
+  for (size_t i = 0; i < samples; i++) {
+    out[i] = linearToUlaw(pcm[i]);
+  }
+  return samples;
+}
+
+}  // namespace rtp
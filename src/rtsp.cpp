@@ -0,0 +1,392 @@
+#include "rtsp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define RTSP_PCMU_RATE 8000
+
+namespace rtsp {
+
+static uint32_t nextRandom(uint32_t& state) {
+  // xorshift32; only needs to differ between sessions
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+// Value of header 'name' in a request head into 'out'; false if absent
+static bool findHeader(const char* head, const char* name, char* out, size_t cap) {
+  const size_t nameLen = strlen(name);
+  for (const char* line = strstr(head, "\r\n"); line; line = strstr(line, "\r\n")) {
+    line += 2;
+    if (strncasecmp(line, name, nameLen) == 0 && line[nameLen] == ':') {
+      const char* v = line + nameLen + 1;
+      while (*v == ' ' || *v == '\t') v++;
+      size_t n = 0;
+      while (v[n] && v[n] != '\r' && v[n] != '\n' && n + 1 < cap) {
+        out[n] = v[n];
+        n++;
+      }
+      out[n] = '\0';
+      return true;
+    }
+  }
+  return false;
+}
+
+void Session::begin(const Config& config, uint32_t seed) {
+  config_ = config;
+  uint32_t state = seed ? seed : 0x2545F491;
+  id_ = nextRandom(state);
+  cseq_ = 0;
+  audio_ = config.audio;
+  playing_ = false;
+  for (int t = 0; t < TRACKS; t++) {
+    setup_[t] = false;
+    transport_[t] = Transport();
+    streams_[t].begin(0, 1, nextRandom(state), (uint16_t)nextRandom(state), nextRandom(state));
+  }
+  lastReportUs_[VIDEO] = lastReportUs_[AUDIO] = 0;
+  lastError_ = nullptr;
+  framesSent_ = 0;
+  framesSkipped_ = 0;
+  audioNextUs_ = -1;
+  requestLen_ = 0;
+  skip_ = 0;
+  url_[0] = '\0';
+}
+
+uint32_t Session::audioRate() const {
+  switch (audio_) {
+    case AUDIO_L16: return config_.captureRate;
+    case AUDIO_PCMU: return RTSP_PCMU_RATE;
+    default: return 0;
+  }
+}
+
+// ============================================
+// Requests
+// ============================================
+bool Session::receive(const uint8_t* data, size_t len, int64_t nowUs, Link& link) {
+  size_t i = 0;
+  while (i < len) {
+    if (skip_) {
+      size_t n = len - i < skip_ ? len - i : skip_;
+      skip_ -= n;
+      i += n;
+      continue;
+    }
+    if (requestLen_ >= RTSP_MAX_REQUEST) {
+      return false;
+    }
+    request_[requestLen_++] = (char)data[i++];
+
+    // RTCP receiver reports come back interleaved: $, channel, length
+    if (request_[0] == '$') {
+      if (requestLen_ == 4) {
+        skip_ = ((uint8_t)request_[2] << 8) | (uint8_t)request_[3];
+        requestLen_ = 0;
+      }
+      continue;
+    }
+    if (requestLen_ >= 4 && memcmp(request_ + requestLen_ - 4, "\r\n\r\n", 4) == 0) {
+      request_[requestLen_] = '\0';
+      requestLen_ = 0;
+      char value[16];
+      if (findHeader(request_, "Content-Length", value, sizeof(value))) {
+        skip_ = (size_t)atoi(value);   // Bodies (SET_PARAMETER) are not used
+      }
+      if (!handleRequest(request_, nowUs, link)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool Session::respond(Link& link, int status, const char* reason, const char* headers, const char* body) {
+  char out[1024];
+  size_t bodyLen = body ? strlen(body) : 0;
+  int len = snprintf(out, sizeof(out),
+                     "RTSP/1.0 %d %s\r\n"
+                     "CSeq: %u\r\n"
+                     "Server: %s\r\n"
+                     "%s"
+                     "Content-Length: %u\r\n\r\n"
+                     "%s",
+                     status, reason, (unsigned)cseq_, config_.name, headers ? headers : "",
+                     (unsigned)bodyLen, body ? body : "");
+  if (len <= 0 || (size_t)len >= sizeof(out)) {
+    return false;
+  }
+  return link.sendTcp((const uint8_t*)out, (size_t)len);
+}
+
+// Base URL (no query, trailing slash) and audio choice from DESCRIBE
+void Session::describe(const char* url) {
+  const char* query = strchr(url, '?');
+  size_t n = query ? (size_t)(query - url) : strlen(url);
+  if (n > sizeof(url_) - 2) {
+    n = sizeof(url_) - 2;
+  }
+  memcpy(url_, url, n);
+  if (n == 0 || url_[n - 1] != '/') {
+    url_[n++] = '/';
+  }
+  url_[n] = '\0';
+
+  audio_ = config_.audio;
+  const char* choice = query ? strstr(query, "audio=") : nullptr;
+  if (choice) {
+    choice += 6;
+    if (strncmp(choice, "none", 4) == 0) {
+      audio_ = AUDIO_NONE;
+    } else if (strncmp(choice, "l16", 3) == 0) {
+      audio_ = AUDIO_L16;
+    } else if (strncmp(choice, "pcmu", 4) == 0) {
+      audio_ = AUDIO_PCMU;
+    }
+  }
+}
+
+bool Session::handleRequest(const char* head, int64_t nowUs, Link& link) {
+  char method[16];
+  char url[160];
+  if (sscanf(head, "%15s %159s RTSP/1.0", method, url) != 2) {
+    return false;
+  }
+  char value[160];
+  cseq_ = findHeader(head, "CSeq", value, sizeof(value)) ? (uint32_t)strtoul(value, nullptr, 10) : 0;
+  if (findHeader(head, "Session", value, sizeof(value)) && strtoul(value, nullptr, 16) != id_) {
+    return respond(link, 454, "Session Not Found", nullptr, nullptr);
+  }
+  char headers[320];
+
+  if (strcmp(method, "OPTIONS") == 0) {
+    return respond(link, 200, "OK", "Public: OPTIONS, DESCRIBE, SETUP, PLAY, PAUSE, TEARDOWN, GET_PARAMETER\r\n", nullptr);
+  }
+
+  if (strcmp(method, "DESCRIBE") == 0) {
+    describe(url);
+    char sdp[512];
+    int len = snprintf(sdp, sizeof(sdp),
+                       "v=0\r\n"
+                       "o=- %u 1 IN IP4 0.0.0.0\r\n"
+                       "s=%s\r\n"
+                       "c=IN IP4 0.0.0.0\r\n"
+                       "t=0 0\r\n"
+                       "a=control:*\r\n"
+                       "a=range:npt=0-\r\n"
+                       "m=video 0 RTP/AVP %d\r\n"
+                       "a=control:track1\r\n",
+                       (unsigned)id_, config_.name, RTP_PT_JPEG);
+    if (audio_ == AUDIO_L16) {
+      len += snprintf(sdp + len, sizeof(sdp) - len,
+                      "m=audio 0 RTP/AVP %d\r\n"
+                      "a=rtpmap:%d L16/%u/1\r\n"
+                      "a=control:track2\r\n",
+                      RTP_PT_L16, RTP_PT_L16, (unsigned)config_.captureRate);
+    } else if (audio_ == AUDIO_PCMU) {
+      len += snprintf(sdp + len, sizeof(sdp) - len,
+                      "m=audio 0 RTP/AVP %d\r\n"
+                      "a=rtpmap:%d PCMU/%d/1\r\n"
+                      "a=control:track2\r\n",
+                      RTP_PT_PCMU, RTP_PT_PCMU, RTSP_PCMU_RATE);
+    }
+    snprintf(headers, sizeof(headers), "Content-Base: %s\r\nContent-Type: application/sdp\r\n", url_);
+    return respond(link, 200, "OK", headers, sdp);
+  }
+
+  if (strcmp(method, "SETUP") == 0) {
+    if (!url_[0]) {
+      describe(url);   // SETUP without DESCRIBE: the client knows the tracks
+    }
+    Track track;
+    if (strstr(url, "track1")) {
+      track = VIDEO;
+    } else if (strstr(url, "track2") && audio_ != AUDIO_NONE) {
+      track = AUDIO;
+    } else {
+      return respond(link, 404, "Stream Not Found", nullptr, nullptr);
+    }
+    if (!findHeader(head, "Transport", value, sizeof(value)) || strstr(value, "multicast")) {
+      return respond(link, 461, "Unsupported Transport", nullptr, nullptr);
+    }
+    Transport& tr = transport_[track];
+    const char* p;
+    if (strstr(value, "RTP/AVP/TCP")) {
+      tr.interleaved = true;
+      tr.channel = (uint8_t)(2 * track);
+      if ((p = strstr(value, "interleaved=")) != nullptr) {
+        tr.channel = (uint8_t)atoi(p + 12);
+      }
+    } else if ((p = strstr(value, "client_port=")) != nullptr) {
+      tr.interleaved = false;
+      tr.clientPort = (uint16_t)atoi(p + 12);
+    } else {
+      return respond(link, 461, "Unsupported Transport", nullptr, nullptr);
+    }
+
+    rtp::Stream& stream = streams_[track];
+    if (!setup_[track]) {
+      if (track == VIDEO) {
+        stream.begin(RTP_PT_JPEG, RTP_VIDEO_CLOCK, stream.ssrc(), stream.nextSeq(), stream.timestampAt(0));
+      } else {
+        stream.begin(audio_ == AUDIO_PCMU ? RTP_PT_PCMU : RTP_PT_L16, audioRate(), stream.ssrc(),
+                     stream.nextSeq(), stream.timestampAt(0));
+      }
+      setup_[track] = true;
+    }
+    int len;
+    if (tr.interleaved) {
+      len = snprintf(headers, sizeof(headers), "Transport: RTP/AVP/TCP;unicast;interleaved=%u-%u;ssrc=%08X\r\n",
+                     tr.channel, tr.channel + 1, (unsigned)stream.ssrc());
+    } else {
+      len = snprintf(headers, sizeof(headers),
+                     "Transport: RTP/AVP;unicast;client_port=%u-%u;server_port=%u-%u;ssrc=%08X\r\n",
+                     tr.clientPort, tr.clientPort + 1, config_.serverPort, config_.serverPort + 1,
+                     (unsigned)stream.ssrc());
+    }
+    snprintf(headers + len, sizeof(headers) - len, "Session: %08X;timeout=%d\r\n", (unsigned)id_, RTSP_SESSION_TIMEOUT_S);
+    return respond(link, 200, "OK", headers, nullptr);
+  }
+
+  if (strcmp(method, "PLAY") == 0) {
+    if (!setup_[VIDEO] && !setup_[AUDIO]) {
+      return respond(link, 455, "Method Not Valid in This State", nullptr, nullptr);
+    }
+    // RTP-Info: where each stream's sequence and clock start
+    int len = snprintf(headers, sizeof(headers), "Session: %08X\r\nRange: npt=0.000-\r\nRTP-Info: ", (unsigned)id_);
+    bool first = true;
+    for (int t = 0; t < TRACKS; t++) {
+      if (!setup_[t]) {
+        continue;
+      }
+      rtp::Stream& stream = streams_[t];
+      if (!stream.anchored()) {
+        stream.anchor(nowUs, stream.timestampAt(nowUs));
+      }
+      len += snprintf(headers + len, sizeof(headers) - len, "%surl=%strack%d;seq=%u;rtptime=%u",
+                      first ? "" : ",", url_, t + 1, stream.nextSeq(), (unsigned)stream.timestampAt(nowUs));
+      first = false;
+    }
+    snprintf(headers + len, sizeof(headers) - len, "\r\n");
+    playing_ = true;
+    lastReportUs_[VIDEO] = lastReportUs_[AUDIO] = 0;
+    return respond(link, 200, "OK", headers, nullptr);
+  }
+
+  snprintf(headers, sizeof(headers), "Session: %08X\r\n", (unsigned)id_);
+  if (strcmp(method, "PAUSE") == 0) {
+    playing_ = false;
+    return respond(link, 200, "OK", headers, nullptr);
+  }
+  if (strcmp(method, "TEARDOWN") == 0) {
+    playing_ = false;
+    respond(link, 200, "OK", headers, nullptr);
+    return false;
+  }
+  if (strcmp(method, "GET_PARAMETER") == 0 || strcmp(method, "SET_PARAMETER") == 0) {
+    return respond(link, 200, "OK", headers, nullptr);   // Keepalive
+  }
+  return respond(link, 501, "Not Implemented", nullptr, nullptr);
+}
+
+// ============================================
+// Media
+// ============================================
+// The packet is at packet_ + 4, leaving room for the interleave header
+bool Session::sendPacket(Track track, bool rtcp, const uint8_t* data, size_t len, Link& link) {
+  const Transport& tr = transport_[track];
+  if (!tr.interleaved) {
+    return link.sendUdp((uint16_t)(tr.clientPort + (rtcp ? 1 : 0)), rtcp, data, len);
+  }
+  uint8_t* framed = (uint8_t*)data - 4;
+  framed[0] = '$';
+  framed[1] = (uint8_t)(tr.channel + (rtcp ? 1 : 0));
+  framed[2] = (uint8_t)(len >> 8);
+  framed[3] = (uint8_t)len;
+  return link.sendTcp(framed, len + 4);
+}
+
+bool Session::sendFrame(const uint8_t* jpeg, size_t len, int64_t captureUs, Link& link) {
+  if (!playing(VIDEO)) {
+    return true;
+  }
+  rtp::JpegInfo info;
+  const char* error = rtp::parseJpeg(jpeg, len, info);
+  if (error) {
+    lastError_ = error;
+    framesSkipped_++;
+    return true;
+  }
+  rtp::Stream& stream = streams_[VIDEO];
+  uint32_t ts = stream.timestampAt(captureUs);
+  stream.anchor(captureUs, ts);
+  jpeg_.begin(info, ts);
+  uint8_t* packet = packet_ + 4;
+  for (size_t n; (n = jpeg_.next(stream, packet, RTP_MAX_PACKET)) > 0;) {
+    if (!sendPacket(VIDEO, false, packet, n, link)) {
+      return false;
+    }
+  }
+  framesSent_++;
+  return true;
+}
+
+bool Session::sendAudio(const int16_t* pcm, size_t samples, int64_t captureUs, Link& link) {
+  if (!playing(AUDIO) || !samples) {
+    return true;
+  }
+  rtp::Stream& stream = streams_[AUDIO];
+  const uint32_t rate = audioRate();
+  // Consecutive blocks get consecutive timestamps; capture time only
+  // re-anchors the clock after a gap (ring overrun, pause)
+  const int64_t blockUs = (int64_t)samples * 1000000 / rate;
+  uint32_t ts;
+  if (audioNextUs_ >= 0 && llabs(captureUs - audioNextUs_) < blockUs) {
+    ts = audioNextTs_;
+  } else {
+    ts = stream.timestampAt(captureUs);
+  }
+  stream.anchor(captureUs, ts);
+  audioNextTs_ = ts + (uint32_t)samples;
+  audioNextUs_ = captureUs + blockUs;
+
+  const size_t bytesPerSample = audio_ == AUDIO_PCMU ? 1 : 2;
+  const size_t perPacket = (RTP_MAX_PACKET - RTP_HEADER_SIZE) / bytesPerSample;
+  uint8_t* packet = packet_ + 4;
+  for (size_t at = 0; at < samples; at += perPacket) {
+    size_t n = samples - at < perPacket ? samples - at : perPacket;
+    uint8_t* payload = packet + RTP_HEADER_SIZE;
+    size_t bytes = audio_ == AUDIO_PCMU ? rtp::packPcmu(pcm + at, n, payload) : rtp::packL16(pcm + at, n, payload);
+    stream.header(packet, ts + (uint32_t)at, false, bytes);
+    if (!sendPacket(AUDIO, false, packet, RTP_HEADER_SIZE + bytes, link)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Session::sendReports(int64_t nowUs, int64_t unixUs, Link& link) {
+  // Each stream reports once it has sent something, then every interval
+  for (int t = 0; t < TRACKS; t++) {
+    const rtp::Stream& stream = streams_[t];
+    if (!playing((Track)t) || stream.packets() == 0 ||
+        (lastReportUs_[t] && nowUs - lastReportUs_[t] < (int64_t)RTSP_REPORT_INTERVAL_MS * 1000)) {
+      continue;
+    }
+    lastReportUs_[t] = nowUs;
+    uint8_t* packet = packet_ + 4;
+    size_t n = stream.senderReport(packet, RTP_MAX_PACKET, nowUs, unixUs ? unixUs : nowUs, config_.name);
+    if (n && !sendPacket((Track)t, true, packet, n, link)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace rtsp
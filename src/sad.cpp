@@ -0,0 +1,161 @@
+#include "sad.h"
+
+#include <math.h>
+
+#include "fft.h"
+
+#define SAD_MIN_FLOOR_DB -90.0f   // Digital silence must not drag the floor below the mic's own noise
+#define SAD_FLOOR_FALL 0.5f       // Fraction of the gap closed per quieter frame
+
+namespace sad {
+
+Config defaultConfig() {
+  Config c;
+  c.onDb = 9.0f;
+  c.offDb = 6.0f;
+  c.loudDb = 25.0f;
+  c.maxFlatness = 0.45f;
+  c.noiseZcr = 0.3f;
+  c.bandLoHz = 200;
+  c.bandHiHz = 4000;
+  c.floorRiseDbPerSec = 1.5f;
+  c.attackMs = 32;
+  c.hangoverMs = 600;
+  c.warmupMs = 250;
+  return c;
+}
+
+static uint16_t framesFor(uint32_t ms, uint32_t sampleRate) {
+  uint32_t frameUs = (uint32_t)((uint64_t)SAD_FRAME_SAMPLES * 1000000 / sampleRate);
+  uint32_t n = (ms * 1000 + frameUs - 1) / frameUs;
+  return (uint16_t)(n ? n : 1);
+}
+
+void Detector::begin(const Config& config, uint32_t sampleRate) {
+  config_ = config;
+  sampleRate_ = sampleRate;
+  const float binHz = (float)sampleRate / SAD_FRAME_SAMPLES;
+  binLo_ = (uint16_t)(config.bandLoHz / binHz);
+  binHi_ = (uint16_t)(config.bandHiHz / binHz);
+  if (binLo_ < 1) binLo_ = 1;
+  if (binHi_ > SAD_BINS - 1) binHi_ = SAD_BINS - 1;
+  if (binHi_ < binLo_) binHi_ = binLo_;
+  attackFrames_ = framesFor(config.attackMs, sampleRate);
+  hangoverFrames_ = framesFor(config.hangoverMs, sampleRate);
+  warmupFrames_ = framesFor(config.warmupMs, sampleRate);
+  floorRisePerFrame_ = config.floorRiseDbPerSec * SAD_FRAME_SAMPLES / sampleRate;
+
+  fft::begin();
+  float windowPower = fft::hann(window_, SAD_FRAME_SAMPLES);
+  // Parseval: a full-scale sine puts N * sum(w^2) * A^2/2 into the whole
+  // spectrum, half of it in the one-sided bins
+  fullScale_ = SAD_FRAME_SAMPLES * windowPower * (32767.0f * 32767.0f / 2.0f) / 2.0f;
+  reset();
+}
+
+void Detector::reset() {
+  primed_ = false;
+  active_ = false;
+  run_ = 0;
+  quiet_ = 0;
+  frames_ = 0;
+  floorDb_ = SAD_MIN_FLOOR_DB;
+  features_ = Features();
+}
+
+Transition Detector::process(const int16_t* pcm, size_t samples, int64_t timestampUs) {
+  if (samples > SAD_FRAME_SAMPLES) {
+    samples = SAD_FRAME_SAMPLES;
+  }
+
+  // Zero crossings and DC, straight off the integer samples
+  int32_t sum = 0;
+  uint32_t crossings = 0;
+  for (size_t i = 0; i < samples; i++) {
+    sum += pcm[i];
+  }
+  for (size_t i = 1; i < samples; i++) {
+    crossings += (uint32_t)((pcm[i - 1] ^ pcm[i]) < 0);
+  }
+  const float dc = samples ? (float)sum / samples : 0.0f;
+
+  for (size_t i = 0; i < samples; i++) {
+    frame_[i] = (float)pcm[i] - dc;
+  }
+  for (size_t i = samples; i < SAD_FRAME_SAMPLES; i++) {
+    frame_[i] = 0.0f;
+  }
+  fft::windowReal(frame_, window_, data_, SAD_FRAME_SAMPLES);
+  fft::forward(data_, SAD_FRAME_SAMPLES);
+  for (int k = 0; k < SAD_BINS; k++) {
+    power_[k] = data_[2 * k] * data_[2 * k] + data_[2 * k + 1] * data_[2 * k + 1];
+  }
+
+  // Band energy and flatness
+  float energy = 0;
+  float logSum = 0;
+  const int bins = binHi_ - binLo_ + 1;
+  for (int k = binLo_; k <= binHi_; k++) {
+    const float p = power_[k] + 1.0f;
+    energy += p;
+    logSum += logf(p);
+  }
+  const float mean = energy / bins;
+  features_.flatness = expf(logSum / bins) / mean;
+  features_.zcr = samples > 1 ? (float)crossings / (samples - 1) : 0.0f;
+  features_.energyDb = 10.0f * log10f(energy / fullScale_ + 1e-12f);
+
+  // Compare with the floor so far, then move the floor
+  if (!primed_) {
+    floorDb_ = features_.energyDb > SAD_MIN_FLOOR_DB ? features_.energyDb : SAD_MIN_FLOOR_DB;
+    primed_ = true;
+  }
+  features_.floorDb = floorDb_;
+  features_.snrDb = features_.energyDb - floorDb_;
+  if (features_.energyDb < floorDb_) {
+    floorDb_ += SAD_FLOOR_FALL * (features_.energyDb - floorDb_);
+    if (floorDb_ < SAD_MIN_FLOOR_DB) floorDb_ = SAD_MIN_FLOOR_DB;
+  } else {
+    float gap = features_.energyDb - floorDb_;
+    floorDb_ += gap < floorRisePerFrame_ ? gap : floorRisePerFrame_;
+  }
+
+  const bool noiseLike = features_.flatness > config_.maxFlatness && features_.zcr > config_.noiseZcr;
+  const float threshold = active_ ? config_.offDb : config_.onDb;
+  features_.sound = frames_ >= warmupFrames_ && features_.snrDb >= threshold &&
+                    (!noiseLike || features_.snrDb >= config_.loudDb);
+  frames_++;
+
+  // Attack and hangover
+  if (features_.sound) {
+    soundFrames_++;
+    if (run_ == 0) {
+      runStartUs_ = timestampUs;
+      runPeakDb_ = features_.snrDb;
+    }
+    if (run_ < UINT16_MAX) run_++;
+    if (features_.snrDb > runPeakDb_) runPeakDb_ = features_.snrDb;
+    lastSoundEndUs_ = timestampUs + (int64_t)samples * 1000000 / sampleRate_;
+    quiet_ = 0;
+    if (active_) {
+      if (features_.snrDb > event_.peakSnrDb) event_.peakSnrDb = features_.snrDb;
+    } else if (run_ >= attackFrames_) {
+      active_ = true;
+      events_++;
+      event_.startUs = runStartUs_;
+      event_.endUs = 0;
+      event_.peakSnrDb = runPeakDb_;
+      return ONSET;
+    }
+    return NONE;
+  }
+  run_ = 0;
+  if (active_ && ++quiet_ >= hangoverFrames_) {
+    active_ = false;
+    event_.endUs = lastSoundEndUs_;
+    return OFFSET;
+  }
+  return NONE;
+}
+
+}  // namespace sad
@@ -0,0 +1,180 @@
+#include "spectrum.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "fft.h"
+
+#define SPECTRUM_MIN_TONE_BIN 3        // ~47 Hz at 16 kHz; below is DC and window leakage
+#define SPECTRUM_TONE_PROMINENCE 10.0f // Power over the neighbouring bins (10 dB)
+
+namespace spectrum {
+
+const uint16_t kBandCenterHz[SPECTRUM_BANDS] = {63, 125, 250, 500, 1000, 2000, 4000, 8000};
+
+static float toDb(float ratio) {
+  float db = ratio > 0 ? 10.0f * log10f(ratio) : SPECTRUM_MIN_DB;
+  return db < SPECTRUM_MIN_DB ? SPECTRUM_MIN_DB : db;
+}
+
+void Analyzer::begin(uint32_t sampleRate, uint32_t periodMs) {
+  sampleRate_ = sampleRate;
+  uint32_t periodSamples = (uint32_t)((uint64_t)periodMs * sampleRate / 1000);
+  framesPerSummary_ = (uint16_t)((periodSamples + SPECTRUM_FFT_SIZE - 1) / SPECTRUM_FFT_SIZE);
+  if (framesPerSummary_ == 0) framesPerSummary_ = 1;
+
+  const float binHz = (float)sampleRate / SPECTRUM_FFT_SIZE;
+  for (int b = 0; b < SPECTRUM_BANDS; b++) {
+    uint32_t lo = (uint32_t)ceilf(kBandCenterHz[b] / (float)M_SQRT2 / binHz);
+    uint32_t hi = (uint32_t)ceilf(kBandCenterHz[b] * (float)M_SQRT2 / binHz);
+    bandLo_[b] = (uint16_t)(lo < SPECTRUM_BINS ? lo : SPECTRUM_BINS);
+    bandHi_[b] = (uint16_t)(hi < SPECTRUM_BINS ? hi : SPECTRUM_BINS);
+  }
+
+  fft::begin();
+  float windowPower = fft::hann(window_, SPECTRUM_FFT_SIZE);
+  fullScale_ = SPECTRUM_FFT_SIZE * windowPower * (32767.0f * 32767.0f / 2.0f) / 2.0f;
+  reset();
+}
+
+void Analyzer::reset() {
+  fill_ = 0;
+  frames_ = 0;
+  periodStartUs_ = -1;
+  sumSquares_ = 0;
+  samples_ = 0;
+  peak_ = 0;
+  memset(power_, 0, sizeof(power_));
+}
+
+bool Analyzer::process(const int16_t* pcm, size_t samples, int64_t timestampUs) {
+  bool completed = false;
+  size_t i = 0;
+  while (i < samples) {
+    if (periodStartUs_ < 0) {
+      periodStartUs_ = timestampUs + (int64_t)i * 1000000 / sampleRate_;
+    }
+    size_t n = samples - i;
+    if (n > SPECTRUM_FFT_SIZE - fill_) {
+      n = SPECTRUM_FFT_SIZE - fill_;
+    }
+
+    // Level and conversion in one pass over the integer samples
+    uint64_t squares = 0;
+    int32_t peak = peak_;
+    for (size_t k = 0; k < n; k++) {
+      int32_t v = pcm[i + k];
+      squares += (uint64_t)(v * v);
+      int32_t mag = v < 0 ? -v : v;
+      peak = mag > peak ? mag : peak;
+      frame_[fill_ + k] = (float)v;
+    }
+    sumSquares_ += squares;
+    samples_ += n;
+    peak_ = peak;
+    fill_ += n;
+    i += n;
+
+    if (fill_ == SPECTRUM_FFT_SIZE) {
+      transform();
+      fill_ = 0;
+      if (++frames_ >= framesPerSummary_) {
+        finish();
+        completed = true;
+      }
+    }
+  }
+  return completed;
+}
+
+void Analyzer::transform() {
+  fft::windowReal(frame_, window_, data_, SPECTRUM_FFT_SIZE);
+  fft::forward(data_, SPECTRUM_FFT_SIZE);
+  for (int k = 0; k < SPECTRUM_BINS; k++) {
+    power_[k] += data_[2 * k] * data_[2 * k] + data_[2 * k + 1] * data_[2 * k + 1];
+  }
+}
+
+void Analyzer::finish() {
+  Summary& s = summary_;
+  s.startUs = periodStartUs_;
+  s.durationMs = (uint32_t)((uint64_t)samples_ * 1000 / sampleRate_);
+  s.rmsDbfs = toDb(samples_ ? (float)((double)sumSquares_ / samples_) / (32767.0f * 32767.0f / 2.0f) : 0);
+  s.peakDbfs = toDb((float)peak_ * peak_ / (32767.0f * 32767.0f));
+
+  const float scale = 1.0f / (frames_ * fullScale_);
+  for (int b = 0; b < SPECTRUM_BANDS; b++) {
+    float sum = 0;
+    for (int k = bandLo_[b]; k < bandHi_[b]; k++) {
+      sum += power_[k];
+    }
+    s.bandDbfs[b] = toDb(sum * scale);
+  }
+
+  // Tones: local maxima well above the bins around them, strongest first
+  const float binHz = (float)sampleRate_ / SPECTRUM_FFT_SIZE;
+  s.toneCount = 0;
+  for (int k = SPECTRUM_MIN_TONE_BIN; k < SPECTRUM_BINS - 2; k++) {
+    const float p = power_[k];
+    if (p <= power_[k - 1] || p < power_[k + 1]) {
+      continue;
+    }
+    float around = 0;
+    int count = 0;
+    for (int d = 4; d <= 8; d++) {
+      if (k - d >= 1) { around += power_[k - d]; count++; }
+      if (k + d < SPECTRUM_BINS) { around += power_[k + d]; count++; }
+    }
+    if (!count || p < SPECTRUM_TONE_PROMINENCE * around / count) {
+      continue;
+    }
+    float level = toDb((power_[k - 2] + power_[k - 1] + p + power_[k + 1] + power_[k + 2]) * scale);
+    if (level <= SPECTRUM_MIN_DB) {
+      continue;
+    }
+    // Parabolic interpolation on the log spectrum
+    const float a = logf(power_[k - 1] + 1e-9f), b = logf(p + 1e-9f), c = logf(power_[k + 1] + 1e-9f);
+    const float denom = a - 2 * b + c;
+    const float delta = denom != 0 ? 0.5f * (a - c) / denom : 0;
+    Tone tone = {(k + delta) * binHz, level};
+
+    int at = s.toneCount;
+    while (at > 0 && s.tones[at - 1].dbfs < tone.dbfs) {
+      if (at < SPECTRUM_TONES) s.tones[at] = s.tones[at - 1];
+      at--;
+    }
+    if (at < SPECTRUM_TONES) {
+      s.tones[at] = tone;
+      if (s.toneCount < SPECTRUM_TONES) s.toneCount++;
+    }
+  }
+
+  fill_ = 0;
+  frames_ = 0;
+  periodStartUs_ = -1;
+  sumSquares_ = 0;
+  samples_ = 0;
+  peak_ = 0;
+  memset(power_, 0, sizeof(power_));
+}
+
+size_t formatJson(char* out, size_t cap, const Summary& s) {
+  int len = snprintf(out, cap, "{\"t\":%lld,\"ms\":%u,\"rms\":%.1f,\"peak\":%.1f,\"bands\":[",
+                     (long long)(s.startUs / 1000), (unsigned)s.durationMs, s.rmsDbfs, s.peakDbfs);
+  for (int b = 0; b < SPECTRUM_BANDS && len > 0 && (size_t)len < cap; b++) {
+    len += snprintf(out + len, cap - len, "%s%.1f", b ? "," : "", s.bandDbfs[b]);
+  }
+  if (len > 0 && (size_t)len < cap) {
+    len += snprintf(out + len, cap - len, "],\"tones\":[");
+  }
+  for (int t = 0; t < s.toneCount && len > 0 && (size_t)len < cap; t++) {
+    len += snprintf(out + len, cap - len, "%s[%.1f,%.1f]", t ? "," : "", s.tones[t].hz, s.tones[t].dbfs);
+  }
+  if (len > 0 && (size_t)len < cap) {
+    len += snprintf(out + len, cap - len, "]}");
+  }
+  return len > 0 && (size_t)len < cap ? (size_t)len : 0;
+}
+
+}  // namespace spectrum
@@ -0,0 +1,18 @@
+#include "statusjson.h"
+
+#include <stdio.h>
+
+size_t formatStatusJson(char* out, size_t cap, const StatusSnapshot& s) {
+  int n = snprintf(out, cap,
+                   "{\"uptime\":%lu,\"freeHeap\":%lu,\"sdFree\":%lu,\"sdTotal\":%lu,"
+                   "\"frames\":%lu,\"audioFiles\":%lu,\"batteryVoltage\":%.2f,"
+                   "\"rssi\":%d,\"timestamp\":\"%s\"}",
+                   (unsigned long)s.uptimeSeconds, (unsigned long)s.freeHeap,
+                   (unsigned long)s.sdFreeMB, (unsigned long)s.sdTotalMB,
+                   s.frames, s.audioFiles, (double)s.batteryVoltage,
+                   s.rssi, s.timestamp ? s.timestamp : "");
+  if (n < 0 || (size_t)n >= cap) {
+    return 0;
+  }
+  return (size_t)n;
+}
@@ -0,0 +1,241 @@
+#include "taskmon.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_freertos_hooks.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#ifndef CONFIG_ESP_TASK_WDT_TIMEOUT_S
+#define CONFIG_ESP_TASK_WDT_TIMEOUT_S 5
+#endif
+
+static const char* TAG = "taskmon";
+
+namespace taskmon {
+
+// Idle-hook counters; a core whose counter stops moving is starved
+static volatile uint32_t idleTicks[portNUM_PROCESSORS] = {0};
+static uint32_t lastIdleTicks[portNUM_PROCESSORS] = {0};
+static int64_t idleStalledSinceUs[portNUM_PROCESSORS] = {0};
+static bool nearMissReported[portNUM_PROCESSORS] = {false};
+
+static bool idleHookCore0() { idleTicks[0]++; return true; }
+#if portNUM_PROCESSORS > 1
+static bool idleHookCore1() { idleTicks[1]++; return true; }
+#endif
+
+static Snapshot current;
+static bool haveSample = false;
+static portMUX_TYPE snapshotLock = portMUX_INITIALIZER_UNLOCKED;
+
+#if configUSE_TRACE_FACILITY
+// uxTaskGetSystemState() reports nothing unless the array holds every task,
+// so these grow with the task count. Only the sampler task touches them.
+static TaskStatus_t* statusBuf = nullptr;
+static UBaseType_t statusCap = 0;
+
+// Previous run-time counters, matched by task handle
+static TaskHandle_t* prevHandles = nullptr;
+static uint32_t* prevRuntime = nullptr;
+static UBaseType_t prevCount = 0;
+
+static bool reserve(UBaseType_t tasks) {
+  if (tasks <= statusCap) {
+    return true;
+  }
+  UBaseType_t cap = tasks + 8;   // Headroom for tasks created meanwhile
+  TaskStatus_t* status = (TaskStatus_t*)realloc(statusBuf, cap * sizeof(TaskStatus_t));
+  if (status) statusBuf = status;
+  TaskHandle_t* handles = (TaskHandle_t*)realloc(prevHandles, cap * sizeof(TaskHandle_t));
+  if (handles) prevHandles = handles;
+  uint32_t* runtime = (uint32_t*)realloc(prevRuntime, cap * sizeof(uint32_t));
+  if (runtime) prevRuntime = runtime;
+  if (!status || !handles || !runtime) {
+    return false;
+  }
+  statusCap = cap;
+  return true;
+}
+#endif
+
+static char stateChar(eTaskState state) {
+  switch (state) {
+    case eRunning:   return 'X';
+    case eReady:     return 'R';
+    case eBlocked:   return 'B';
+    case eSuspended: return 'S';
+    case eDeleted:   return 'D';
+    default:         return '?';
+  }
+}
+
+static void sample(Snapshot& snap, uint32_t intervalMs) {
+  memset(&snap, 0, sizeof(snap));
+  snap.takenAtMs = (uint32_t)(esp_timer_get_time() / 1000);
+  snap.intervalMs = intervalMs;
+  snap.coreLoad[0] = snap.coreLoad[1] = -1;
+
+#if configUSE_TRACE_FACILITY
+  uint32_t totalRuntime = 0;
+  UBaseType_t count = 0;
+  if (reserve(uxTaskGetNumberOfTasks())) {
+    count = uxTaskGetSystemState(statusBuf, statusCap, &totalRuntime);
+  }
+  (void)totalRuntime;
+
+  uint32_t idleDelta[2] = {0, 0};
+  uint32_t busiestDelta[2] = {0, 0};
+  int busiest[2] = {-1, -1};
+
+  // Every task counts towards core load; the first TASKMON_MAX_TASKS are listed
+  for (UBaseType_t i = 0; i < count; i++) {
+    const TaskStatus_t& st = statusBuf[i];
+    TaskInfo scratch;
+    TaskInfo& info = i < TASKMON_MAX_TASKS ? snap.tasks[i] : scratch;
+    memset(&info, 0, sizeof(info));
+    strncpy(info.name, st.pcTaskName, sizeof(info.name) - 1);
+    info.stackFreeBytes = st.usStackHighWaterMark;  // Bytes on ESP-IDF (stack is byte-addressed)
+    info.priority = (uint8_t)st.uxCurrentPriority;
+    info.state = stateChar(st.eCurrentState);
+#if configTASKLIST_INCLUDE_COREID
+    info.core = st.xCoreID == tskNO_AFFINITY ? -1 : (int8_t)st.xCoreID;
+#else
+    info.core = -1;
+#endif
+    info.cpuPercent = -1;
+    if (info.stackFreeBytes < TASKMON_STACK_LOW_BYTES) {
+      snap.lowStackTasks++;
+    }
+
+#if configGENERATE_RUN_TIME_STATS
+    uint32_t delta = 0;
+    for (UBaseType_t j = 0; j < prevCount; j++) {
+      if (prevHandles[j] == st.xHandle) {
+        delta = st.ulRunTimeCounter - prevRuntime[j];
+        break;
+      }
+    }
+    // Run-time counter ticks in microseconds (esp_timer)
+    uint32_t windowUs = intervalMs * 1000U;
+    if (windowUs > 0) {
+      uint32_t pct = (uint32_t)(((uint64_t)delta * 100U) / windowUs);
+      info.cpuPercent = (int8_t)(pct > 100 ? 100 : pct);
+    }
+    int core = info.core < 0 ? 0 : info.core;
+    if (strncmp(info.name, "IDLE", 4) == 0 && core < 2) {
+      idleDelta[core] = delta;
+    } else if (core < 2 && delta > busiestDelta[core]) {
+      busiestDelta[core] = delta;
+      busiest[core] = (int)i;
+    }
+#endif
+  }
+  snap.taskCount = (uint8_t)(count < TASKMON_MAX_TASKS ? count : TASKMON_MAX_TASKS);
+  snap.tasksOmitted = (uint8_t)(count - snap.taskCount);
+
+#if configGENERATE_RUN_TIME_STATS
+  uint32_t windowUs = intervalMs * 1000U;
+  for (int c = 0; c < portNUM_PROCESSORS && c < 2; c++) {
+    if (windowUs > 0) {
+      uint32_t idlePct = (uint32_t)(((uint64_t)idleDelta[c] * 100U) / windowUs);
+      snap.coreLoad[c] = (int8_t)(idlePct > 100 ? 0 : 100 - idlePct);
+    }
+  }
+  for (UBaseType_t i = 0; i < count; i++) {
+    prevHandles[i] = statusBuf[i].xHandle;
+    prevRuntime[i] = statusBuf[i].ulRunTimeCounter;
+  }
+  prevCount = count;
+#endif
+#endif  // configUSE_TRACE_FACILITY
+
+  // Watchdog near-miss: idle hook silent for over half the TWDT timeout
+  int64_t now = esp_timer_get_time();
+  const int64_t nearMissUs = (int64_t)CONFIG_ESP_TASK_WDT_TIMEOUT_S * 1000000LL / 2;
+  for (int c = 0; c < portNUM_PROCESSORS && c < 2; c++) {
+    uint32_t ticks = idleTicks[c];
+    if (ticks != lastIdleTicks[c]) {
+      lastIdleTicks[c] = ticks;
+      idleStalledSinceUs[c] = now;
+      nearMissReported[c] = false;
+      continue;
+    }
+    if (!nearMissReported[c] && now - idleStalledSinceUs[c] > nearMissUs) {
+      nearMissReported[c] = true;
+      current.watchdogNearMisses++;
+      current.lastNearMissCore = (int8_t)c;
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+      if (busiest[c] >= 0) {
+        strncpy(current.lastNearMissTask, statusBuf[busiest[c]].pcTaskName, sizeof(current.lastNearMissTask) - 1);
+      }
+#endif
+      ESP_LOGW(TAG, "Watchdog near-miss: core %d idle starved for %lld ms (busiest: %s)",
+               c, (now - idleStalledSinceUs[c]) / 1000,
+               current.lastNearMissTask[0] ? current.lastNearMissTask : "unknown");
+    }
+  }
+}
+
+static void samplerTask(void* parameter) {
+  static Snapshot next;
+  TickType_t lastWake = xTaskGetTickCount();
+  int64_t lastSampleUs = esp_timer_get_time();
+
+  while (true) {
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(TASKMON_SAMPLE_INTERVAL_MS));
+    int64_t now = esp_timer_get_time();
+    sample(next, (uint32_t)((now - lastSampleUs) / 1000));
+    lastSampleUs = now;
+
+    // Near-miss bookkeeping lives in 'current'; carry it into the new sample
+    portENTER_CRITICAL(&snapshotLock);
+    next.watchdogNearMisses = current.watchdogNearMisses;
+    next.lastNearMissCore = current.lastNearMissCore;
+    memcpy(next.lastNearMissTask, current.lastNearMissTask, sizeof(next.lastNearMissTask));
+    memcpy(&current, &next, sizeof(current));
+    haveSample = true;
+    portEXIT_CRITICAL(&snapshotLock);
+  }
+}
+
+bool begin() {
+  current.lastNearMissCore = -1;
+  int64_t now = esp_timer_get_time();
+  for (int c = 0; c < portNUM_PROCESSORS; c++) {
+    idleStalledSinceUs[c] = now;
+  }
+
+  esp_register_freertos_idle_hook_for_cpu(idleHookCore0, 0);
+#if portNUM_PROCESSORS > 1
+  esp_register_freertos_idle_hook_for_cpu(idleHookCore1, 1);
+#endif
+
+  // Priority 2 keeps sampling punctual under recording load (priority 1)
+  return xTaskCreatePinnedToCore(samplerTask, "TaskMonitor", 3072, NULL, 2, NULL, tskNO_AFFINITY) == pdPASS;
+}
+
+bool latest(Snapshot& out) {
+  portENTER_CRITICAL(&snapshotLock);
+  bool ok = haveSample;
+  if (ok) {
+    memcpy(&out, &current, sizeof(out));
+  }
+  portEXIT_CRITICAL(&snapshotLock);
+  return ok;
+}
+
+const TaskInfo* tightestStack(const Snapshot& snap) {
+  const TaskInfo* tightest = nullptr;
+  for (uint8_t i = 0; i < snap.taskCount; i++) {
+    if (!tightest || snap.tasks[i].stackFreeBytes < tightest->stackFreeBytes) {
+      tightest = &snap.tasks[i];
+    }
+  }
+  return tightest;
+}
+
+}  // namespace taskmon
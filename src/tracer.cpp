@@ -0,0 +1,206 @@
+#include "tracer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+#if defined(ESP_PLATFORM)
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "memstats.h"
+#else
+#include <chrono>
+#include <functional>
+#include <thread>
+#endif
+
+namespace tracer {
+
+static_assert((TRACE_EVENTS_PER_CORE & (TRACE_EVENTS_PER_CORE - 1)) == 0,
+              "TRACE_EVENTS_PER_CORE must be a power of two");
+static_assert((TRACE_BENCH_EVENTS & (TRACE_BENCH_EVENTS - 1)) == 0, "TRACE_BENCH_EVENTS must be a power of two");
+
+// ============================================
+// Platform hooks
+// ============================================
+#if defined(ESP_PLATFORM)
+static inline int64_t nowUs() { return esp_timer_get_time(); }
+static inline uint8_t coreId() { return (uint8_t)xPortGetCoreID(); }
+static inline uint32_t taskId() { return (uint32_t)(uintptr_t)xTaskGetCurrentTaskHandle(); }
+static void* allocRing(size_t bytes) { return memstats::alloc(memstats::TAG_TRACER, bytes, MALLOC_CAP_SPIRAM); }
+#else
+static inline int64_t nowUs() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+static inline uint8_t coreId() { return 0; }
+static inline uint32_t taskId() {
+  return (uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id());
+}
+static void* allocRing(size_t bytes) { return malloc(bytes); }
+#endif
+
+struct Ring {
+  Event* events;
+  std::atomic<uint32_t> head;   // Total events ever reserved
+};
+
+static Ring rings[TRACE_MAX_CORES];
+static Ring scratch;            // benchmark() only, TRACE_BENCH_EVENTS
+static std::atomic<bool> recording(false);
+
+bool begin() {
+  for (int c = 0; c < TRACE_MAX_CORES; c++) {
+    if (!rings[c].events) {
+      rings[c].events = (Event*)allocRing(sizeof(Event) * TRACE_EVENTS_PER_CORE);
+      if (!rings[c].events) {
+        return false;
+      }
+    }
+    rings[c].head.store(0, std::memory_order_relaxed);
+  }
+  recording.store(true, std::memory_order_release);
+  return true;
+}
+
+void setEnabled(bool enabled) {
+  if (enabled && !rings[0].events) {
+    return;
+  }
+  recording.store(enabled, std::memory_order_release);
+}
+
+bool enabled() {
+  return recording.load(std::memory_order_relaxed);
+}
+
+void clear() {
+  for (int c = 0; c < TRACE_MAX_CORES; c++) {
+    rings[c].head.store(0, std::memory_order_relaxed);
+  }
+}
+
+// 'mask' is the ring size minus one
+static inline void put(Ring& ring, uint32_t mask, uint8_t core, const char* name, Phase phase) {
+  // Tasks on the same core can preempt each other, so slots are reserved
+  // atomically rather than assuming a single writer per ring
+  uint32_t slot = ring.head.fetch_add(1, std::memory_order_relaxed) & mask;
+  Event& e = ring.events[slot];
+  e.ts = nowUs();
+  e.name = name;
+  e.task = taskId();
+  e.phase = phase;
+  e.core = core;
+}
+
+void record(const char* name, Phase phase) {
+  if (!recording.load(std::memory_order_relaxed)) {
+    return;
+  }
+  uint8_t core = coreId();
+  put(rings[core < TRACE_MAX_CORES ? core : 0], TRACE_EVENTS_PER_CORE - 1, core, name, phase);
+}
+
+static uint32_t ringCount(const Ring& ring) {
+  uint32_t head = ring.head.load(std::memory_order_relaxed);
+  return head < TRACE_EVENTS_PER_CORE ? head : TRACE_EVENTS_PER_CORE;
+}
+
+size_t eventCount() {
+  size_t total = 0;
+  for (int c = 0; c < TRACE_MAX_CORES; c++) {
+    if (rings[c].events) {
+      total += ringCount(rings[c]);
+    }
+  }
+  return total;
+}
+
+// ============================================
+// Chrome trace-event JSON export
+// ============================================
+static int formatEvent(char* line, size_t cap, const Event& e, bool comma) {
+  return snprintf(line, cap,
+                  "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":%u,\"tid\":%u%s}",
+                  comma ? ",\n" : "", e.name, (char)e.phase, (long long)e.ts,
+                  (unsigned)e.core, (unsigned)e.task,
+                  e.phase == PHASE_INSTANT ? ",\"s\":\"t\"" : "");
+}
+
+size_t exportChunk(ExportCursor& cursor, char* buf, size_t maxLen) {
+  size_t used = 0;
+  char line[192];
+
+  while (cursor.stage < 3) {
+    int len = 0;
+
+    if (cursor.stage == 0) {
+      len = snprintf(line, sizeof(line),
+                     "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+                     "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"core 0\"}},\n"
+                     "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"core 1\"}}");
+      cursor.needComma = true;
+    } else if (cursor.stage == 1) {
+      if (cursor.core >= TRACE_MAX_CORES) {
+        cursor.stage = 2;
+        continue;
+      }
+      const Ring& ring = rings[cursor.core];
+      uint32_t count = ring.events ? ringCount(ring) : 0;
+      if (cursor.index >= count) {
+        cursor.core++;
+        cursor.index = 0;
+        continue;
+      }
+      // Oldest surviving event first
+      uint32_t head = ring.head.load(std::memory_order_relaxed);
+      uint32_t slot = (head - count + cursor.index) & (TRACE_EVENTS_PER_CORE - 1);
+      len = formatEvent(line, sizeof(line), ring.events[slot], cursor.needComma);
+    } else {
+      len = snprintf(line, sizeof(line), "\n]}\n");
+    }
+
+    if (len <= 0 || (size_t)len >= sizeof(line)) {
+      len = 0;  // Malformed name - skip the event rather than emit broken JSON
+    } else if (used + (size_t)len > maxLen) {
+      break;    // Resume here on the next chunk
+    }
+
+    memcpy(buf + used, line, (size_t)len);
+    used += (size_t)len;
+
+    if (cursor.stage == 1) {
+      cursor.index++;
+      cursor.needComma = true;
+    } else {
+      cursor.stage++;
+    }
+  }
+  return used;
+}
+
+uint32_t benchmark(uint32_t iterations) {
+  if (!scratch.events) {
+    scratch.events = (Event*)allocRing(sizeof(Event) * TRACE_BENCH_EVENTS);
+  }
+  if (!scratch.events || iterations == 0) {
+    return 0;
+  }
+  if (iterations > TRACE_BENCH_MAX_ITERATIONS) {
+    iterations = TRACE_BENCH_MAX_ITERATIONS;
+  }
+  // The store record() makes, into the scratch ring
+  uint8_t core = coreId();
+  int64_t start = nowUs();
+  for (uint32_t i = 0; i < iterations; i++) {
+    put(scratch, TRACE_BENCH_EVENTS - 1, core, "bench", PHASE_BEGIN);
+    put(scratch, TRACE_BENCH_EVENTS - 1, core, "bench", PHASE_END);
+  }
+  int64_t elapsed = nowUs() - start;
+  return (uint32_t)((elapsed * 1000) / ((int64_t)iterations * 2));
+}
+
+}  // namespace tracer
@@ -0,0 +1,271 @@
+#include "wifimgr.h"
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <Preferences.h>
+#include "esp_random.h"
+#include "esp_wifi_types.h"
+#include "metrics.h"
+#include "logger.h"
+
+namespace wifimgr {
+
+static const char* kPrefsNamespace = "wifimgr";
+
+struct Cache {
+  bool valid;
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint32_t ip, gateway, mask, dns;
+};
+
+static const char* ssid_ = nullptr;
+static const char* password_ = nullptr;
+static State state_ = WM_IDLE;
+static Cache cache_;
+static uint32_t attemptStartMs_ = 0;   // Current association attempt
+static uint32_t connectStartMs_ = 0;   // begin() or link loss
+static uint32_t retryAtMs_ = 0;
+static uint32_t backoffMs_ = WIFI_BACKOFF_MIN_MS;
+static uint8_t scanFailures_ = 0;
+static bool everConnected_ = false;
+static uint32_t lastConnectMs_ = 0;
+static bool eventsRegistered_ = false;
+
+// Set from the Wi-Fi event task, consumed by poll()
+static volatile bool gotIp_ = false;
+static volatile bool disconnected_ = false;
+static volatile uint8_t disconnectReason_ = 0;
+
+static void onEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      gotIp_ = true;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+      // WiFi.begin() drops any previous association first; that one is ours
+      if (info.wifi_sta_disconnected.reason != WIFI_REASON_ASSOC_LEAVE) {
+        disconnectReason_ = info.wifi_sta_disconnected.reason;
+        disconnected_ = true;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+// ============================================
+// Cache (Preferences)
+// ============================================
+static void loadCache() {
+  memset(&cache_, 0, sizeof(cache_));
+  Preferences prefs;
+  if (!prefs.begin(kPrefsNamespace, true)) {
+    return;
+  }
+  char ssid[33] = "";
+  prefs.getString("ssid", ssid, sizeof(ssid));
+  cache_.valid = strcmp(ssid, ssid_) == 0 &&
+                 prefs.getBytes("bssid", cache_.bssid, sizeof(cache_.bssid)) == sizeof(cache_.bssid);
+  cache_.channel = prefs.getUChar("channel", 0);
+  cache_.ip = prefs.getULong("ip", 0);
+  cache_.gateway = prefs.getULong("gateway", 0);
+  cache_.mask = prefs.getULong("mask", 0);
+  cache_.dns = prefs.getULong("dns", 0);
+  prefs.end();
+  if (cache_.channel == 0) {
+    cache_.valid = false;
+  }
+}
+
+// Write only when something changed, to spare the flash
+static void saveCache() {
+  Cache fresh;
+  memset(&fresh, 0, sizeof(fresh));
+  fresh.valid = true;
+  memcpy(fresh.bssid, WiFi.BSSID(), sizeof(fresh.bssid));
+  fresh.channel = (uint8_t)WiFi.channel();
+  fresh.ip = (uint32_t)WiFi.localIP();
+  fresh.gateway = (uint32_t)WiFi.gatewayIP();
+  fresh.mask = (uint32_t)WiFi.subnetMask();
+  fresh.dns = (uint32_t)WiFi.dnsIP();
+  if (memcmp(&fresh, &cache_, sizeof(fresh)) == 0) {
+    return;
+  }
+  Preferences prefs;
+  if (!prefs.begin(kPrefsNamespace, false)) {
+    return;
+  }
+  prefs.putString("ssid", ssid_);
+  prefs.putBytes("bssid", fresh.bssid, sizeof(fresh.bssid));
+  prefs.putUChar("channel", fresh.channel);
+  prefs.putULong("ip", fresh.ip);
+  prefs.putULong("gateway", fresh.gateway);
+  prefs.putULong("mask", fresh.mask);
+  prefs.putULong("dns", fresh.dns);
+  prefs.end();
+  cache_ = fresh;
+}
+
+void forgetCache() {
+  Preferences prefs;
+  if (prefs.begin(kPrefsNamespace, false)) {
+    prefs.clear();
+    prefs.end();
+  }
+  memset(&cache_, 0, sizeof(cache_));
+}
+
+// ============================================
+// Attempts
+// ============================================
+static void startScan() {
+  gotIp_ = false;
+  disconnected_ = false;
+  WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);   // DHCP
+  WiFi.begin(ssid_, password_);
+  state_ = WM_SCAN_CONNECT;
+  attemptStartMs_ = millis();
+}
+
+static void startFast() {
+  if (!cache_.valid) {
+    startScan();
+    return;
+  }
+  gotIp_ = false;
+  disconnected_ = false;
+#if WIFI_REUSE_LEASE
+  if (cache_.ip) {
+    WiFi.config(IPAddress(cache_.ip), IPAddress(cache_.gateway), IPAddress(cache_.mask), IPAddress(cache_.dns));
+  } else {
+    WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+  }
+#else
+  WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+#endif
+  WiFi.begin(ssid_, password_, cache_.channel, cache_.bssid, true);
+  state_ = WM_FAST_CONNECT;
+  attemptStartMs_ = millis();
+}
+
+static void scheduleRetry() {
+  uint32_t jitter = esp_random() % (backoffMs_ / 4 + 1);
+  retryAtMs_ = millis() + backoffMs_ + jitter;
+  LOG_I("📡 WiFi retry in %lu ms", (unsigned long)(backoffMs_ + jitter));
+  backoffMs_ = backoffMs_ * 2 < WIFI_BACKOFF_MAX_MS ? backoffMs_ * 2 : WIFI_BACKOFF_MAX_MS;
+  state_ = WM_BACKOFF;
+}
+
+static void onConnected() {
+  bool fast = state_ == WM_FAST_CONNECT;
+  lastConnectMs_ = millis() - connectStartMs_;
+  state_ = WM_CONNECTED;
+  everConnected_ = true;
+  scanFailures_ = 0;
+  backoffMs_ = WIFI_BACKOFF_MIN_MS;
+  metrics::wifiConnects.inc();
+  if (fast) {
+    metrics::wifiFastConnects.inc();
+  }
+  metrics::wifiConnectTime.observe(lastConnectMs_ * 1000);
+  LOG_I("✓ WiFi connected in %lu ms (%s, channel %d, RSSI %d)", (unsigned long)lastConnectMs_,
+        fast ? "cached BSSID" : "scan", WiFi.channel(), WiFi.RSSI());
+  saveCache();
+}
+
+// ============================================
+// Public API
+// ============================================
+void begin(const char* ssid, const char* password) {
+  ssid_ = ssid;
+  password_ = password;
+  if (!eventsRegistered_) {
+    WiFi.onEvent(onEvent);
+    eventsRegistered_ = true;
+  }
+  WiFi.persistent(false);        // The SDK's own NVS copy is rewritten on every begin() otherwise
+  WiFi.setAutoReconnect(false);  // Reconnects are ours, with the fast path and backoff
+  WiFi.mode(WIFI_STA);
+  loadCache();
+  scanFailures_ = 0;
+  everConnected_ = false;
+  backoffMs_ = WIFI_BACKOFF_MIN_MS;
+  connectStartMs_ = millis();
+  startFast();
+}
+
+void stop() {
+  WiFi.disconnect(true);
+  state_ = WM_IDLE;
+}
+
+State poll() {
+  switch (state_) {
+    case WM_FAST_CONNECT:
+      if (gotIp_) {
+        onConnected();
+      } else if (disconnected_ || millis() - attemptStartMs_ > WIFI_FAST_TIMEOUT_MS) {
+        // AP moved channel or is gone; a scan finds it if it's anywhere
+        LOG_W("📡 WiFi fast connect failed (reason %u), scanning", disconnectReason_);
+        startScan();
+      }
+      break;
+    case WM_SCAN_CONNECT:
+      if (gotIp_) {
+        onConnected();
+      } else if (disconnected_ || millis() - attemptStartMs_ > WIFI_SCAN_TIMEOUT_MS) {
+        WiFi.disconnect();
+        scanFailures_++;
+        LOG_W("❌ WiFi connect failed (reason %u, attempt %u)", disconnectReason_, scanFailures_);
+        if (!everConnected_ && scanFailures_ >= WIFI_INITIAL_ATTEMPTS) {
+          state_ = WM_FAILED;
+        } else {
+          scheduleRetry();
+        }
+      }
+      break;
+    case WM_CONNECTED:
+      if (disconnected_) {
+        metrics::wifiLinkLosses.inc();
+        LOG_W("⚠️  WiFi link lost (reason %u), reconnecting", disconnectReason_);
+        connectStartMs_ = millis();
+        startFast();
+      }
+      break;
+    case WM_BACKOFF:
+      if ((int32_t)(millis() - retryAtMs_) >= 0) {
+        startFast();
+      }
+      break;
+    default:
+      break;
+  }
+  return state_;
+}
+
+State state() {
+  return state_;
+}
+
+bool connected() {
+  return state_ == WM_CONNECTED;
+}
+
+uint32_t lastConnectMs() {
+  return lastConnectMs_;
+}
+
+const char* stateName(State s) {
+  switch (s) {
+    case WM_IDLE:         return "idle";
+    case WM_FAST_CONNECT: return "fast_connect";
+    case WM_SCAN_CONNECT: return "scan_connect";
+    case WM_CONNECTED:    return "connected";
+    case WM_BACKOFF:      return "backoff";
+    case WM_FAILED:       return "failed";
+    default:              return "unknown";
+  }
+}
+
+}  // namespace wifimgr